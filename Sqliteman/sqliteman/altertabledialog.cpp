@@ -119,18 +119,7 @@ bool AlterTableDialog::execSql(const QString & statement, const QString & messag
 
 QStringList AlterTableDialog::originalSource()
 {
-	QString ixsql("select sql from \"%1\".sqlite_master where type in ('index', 'trigger') and tbl_name = '%2';");
-	QSqlQuery query(ixsql.arg(m_schema).arg(m_table), QSqlDatabase::database(SESSION_NAME));
-	QStringList ret;
-
-	if (query.lastError().isValid())
-	{
-		ui.resultEdit->append(tr("Cannot get index list. %1").arg(query.lastError().text()));
-		return QStringList();
-	}
-	while(query.next())
-		ret.append(query.value(0).toString());
-	return ret;
+	return Database::tableDependentSql(m_table, m_schema);
 }
 
 bool AlterTableDialog::renameTable()
@@ -22,18 +22,11 @@ AlterTriggerDialog::AlterTriggerDialog(const QString & name, const QString & sch
 	ui.createButton->setText(tr("&Alter"));
 	setWindowTitle("Alter Trigger");
 
-	QString sql(QString("select sql from \"%1\".sqlite_master where name = '%2';").arg(schema).arg(name));
-	QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
-	if (query.lastError().isValid())
+	QString sql(Database::describeObject(name, schema));
+	if (sql.isEmpty())
 		ui.textEdit->setText(tr("Cannot get trigger from the database."));
 	else
-	{
-		while (query.next())
-		{
-			ui.textEdit->setText(query.value(0).toString());
-			break;
-		}
-	}
+		ui.textEdit->setText(sql);
 
 	connect(ui.createButton, SIGNAL(clicked()), this, SLOT(createButton_clicked()));
 }
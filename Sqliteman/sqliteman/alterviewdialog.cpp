@@ -24,11 +24,9 @@ AlterViewDialog::AlterViewDialog(const QString & name, const QString & schema, Q
 	ui.databaseCombo->setDisabled(true);
 	ui.nameEdit->setDisabled(true);
 
-	QSqlQuery query(QString("select sql from \"%1\".sqlite_master where name = '%2';").arg(schema).arg(name),
-					 QSqlDatabase::database(SESSION_NAME));
-	while (query.next())
+	QString s(Database::describeObject(name, schema));
+	if (!s.isEmpty())
 	{
-		QString s(query.value(0).toString());
 // 		int pos = s.indexOf(QRegExp("(\\b|\\W)AS(\\b|\\W)",  Qt::CaseInsensitive));
 		int pos = s.indexOf(QRegExp("\\bAS\\b",  Qt::CaseInsensitive));
 		if (pos == -1)
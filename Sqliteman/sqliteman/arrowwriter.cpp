@@ -0,0 +1,574 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <cmath>
+#include <cstring>
+
+#include <QtEndian>
+
+#include "arrowwriter.h"
+#include "sqlite3.h"
+
+// Message.fbs and Schema.fbs of the Arrow format
+#define ARROW_METADATA_V5	4
+#define ARROW_HEADER_SCHEMA	1
+#define ARROW_HEADER_BATCH	3
+#define ARROW_TYPE_INT		2
+#define ARROW_TYPE_FLOAT	3
+#define ARROW_TYPE_BINARY	4
+#define ARROW_TYPE_UTF8		5
+#define ARROW_PRECISION_DOUBLE	2
+
+
+//! \brief One field of a flatbuffers table. Size 0 is a field not set.
+typedef struct
+{
+	int size;
+	qint64 value;
+}
+FlatSlot;
+
+/*! \brief Minimal flatbuffers builder for the Arrow messages.
+The buffer is built from the front: the root table first, its
+children after it. Offsets are set by setOffset() when the child
+is added - the child is always behind the offset as flatbuffers
+require. Tables are placed after their vtables.
+*/
+class FlatBuilder
+{
+	public:
+		//! \brief Size of the offset slots
+		static const int Offset = 4;
+
+		FlatBuilder() : m_data(4, '\0') {};
+
+		/*! \brief Add a table.
+		\param positions filled with the buffer positions of the slots.
+		\retval int position of the table. */
+		int table(const FlatSlot * slots, int count, int * positions)
+		{
+			// fields are aligned to their size. The table is 8 aligned.
+			QVector<int> fieldOffsets(count);
+			int size = 4;
+			for (int i = 0; i < count; ++i)
+			{
+				if (slots[i].size == 0)
+					continue;
+				size = (size + slots[i].size - 1) / slots[i].size * slots[i].size;
+				fieldOffsets[i] = size;
+				size += slots[i].size;
+			}
+
+			pad(2);
+			int vtable = m_data.size();
+			put(2, 4 + 2 * count);
+			put(2, size);
+			for (int i = 0; i < count; ++i)
+				put(2, fieldOffsets.at(i));
+
+			pad(8);
+			int table = m_data.size();
+			put(4, table - vtable);
+			m_data.append(QByteArray(size - 4, '\0'));
+			for (int i = 0; i < count; ++i)
+			{
+				positions[i] = table + fieldOffsets.at(i);
+				if (slots[i].size != 0)
+					set(positions[i], slots[i].size, slots[i].value);
+			}
+			return table;
+		};
+
+		/*! \brief Add a vector.
+		\param elements the elements in little endian. */
+		int vector(int count, const QByteArray & elements, int alignment)
+		{
+			// the count is just before the aligned elements
+			while ((m_data.size() + 4) % alignment)
+				m_data.append('\0');
+			int vector = m_data.size();
+			put(4, count);
+			m_data.append(elements);
+			return vector;
+		};
+
+		//! \brief Vector of offsets. They are at vector + 4 + 4 * i.
+		int offsets(int count)
+		{
+			return vector(count, QByteArray(count * Offset, '\0'), 4);
+		};
+
+		int string(const QByteArray & s)
+		{
+			int str = vector(s.size(), s, 4);
+			m_data.append('\0');
+			return str;
+		};
+
+		void setOffset(int position, int target)
+		{
+			set(position, 4, target - position);
+		};
+
+		void setRoot(int table) { setOffset(0, table); };
+
+		//! \brief The buffer padded to 8 bytes.
+		QByteArray data()
+		{
+			pad(8);
+			return m_data;
+		};
+
+	private:
+		QByteArray m_data;
+
+		void pad(int alignment)
+		{
+			while (m_data.size() % alignment)
+				m_data.append('\0');
+		};
+
+		void put(int size, qint64 value)
+		{
+			m_data.append(QByteArray(size, '\0'));
+			set(m_data.size() - size, size, value);
+		};
+
+		void set(int position, int size, qint64 value)
+		{
+			uchar * p = reinterpret_cast<uchar*>(m_data.data()) + position;
+			switch (size)
+			{
+				case 1:
+					*p = uchar(value);
+					break;
+				case 2:
+					qToLittleEndian<quint16>(quint16(value), p);
+					break;
+				case 4:
+					qToLittleEndian<quint32>(quint32(value), p);
+					break;
+				default:
+					qToLittleEndian<quint64>(quint64(value), p);
+					break;
+			}
+		};
+};
+
+/*! \brief Start a Message as the root.
+\retval int position of its header offset. */
+static int arrowMessage(FlatBuilder & fb, int header, qint64 bodyLength)
+{
+	FlatSlot slots[] = {
+		{ 2, ARROW_METADATA_V5 },	// version
+		{ 1, header },				// header_type
+		{ FlatBuilder::Offset, 0 },	// header
+		{ 8, bodyLength }			// bodyLength
+	};
+	int positions[4];
+	fb.setRoot(fb.table(slots, 4, positions));
+	return positions[2];
+}
+
+static void appendInt64(QByteArray & data, qint64 value)
+{
+	uchar bytes[8];
+	qToLittleEndian<quint64>(quint64(value), bytes);
+	data.append(reinterpret_cast<const char*>(bytes), 8);
+}
+
+
+ArrowWriter::ArrowWriter(ExportWriter & out, int batchRows)
+	: m_out(out),
+	  m_batchRows(qMax(1, batchRows)),
+	  m_rows(0),
+	  m_batchStart(0),
+	  m_bytes(0),
+	  m_schema(false)
+{
+}
+
+void ArrowWriter::begin(const QStringList & columns)
+{
+	m_names.clear();
+	foreach (QString c, columns)
+		m_names.append(c.toUtf8());
+	m_columns.resize(columns.count());
+	m_schema = false;
+	m_batchStart = 0;
+	clearBatch();
+}
+
+void ArrowWriter::clearBatch()
+{
+	for (int i = 0; i < m_columns.count(); ++i)
+	{
+		ArrowColumn & c = m_columns[i];
+		c.types.clear();
+		c.types.reserve(m_batchRows);
+		c.fixed.clear();
+		c.fixed.reserve(m_batchRows);
+		c.offsets.clear();
+		c.offsets.reserve(m_batchRows + 1);
+		c.offsets.append(0);
+		c.var.clear();
+		c.integers = 0;
+		c.reals = 0;
+		c.texts = 0;
+		c.blobs = 0;
+	}
+	m_rows = 0;
+	m_bytes = 0;
+}
+
+void ArrowWriter::writeRow(const QVector<ExportValue> & values)
+{
+	for (int i = 0; i < m_columns.count(); ++i)
+	{
+		const ExportValue & v = values.at(i);
+		ArrowColumn & c = m_columns[i];
+		qint64 bits = 0;
+		switch (v.type)
+		{
+			case SQLITE_INTEGER:
+				bits = v.integer;
+				++c.integers;
+				break;
+			case SQLITE_FLOAT:
+				memcpy(&bits, &v.real, sizeof(bits));
+				++c.reals;
+				break;
+			case SQLITE_NULL:
+				break;
+			case SQLITE_BLOB:
+				c.var.append(v.data, v.size);
+				m_bytes += v.size;
+				++c.blobs;
+				break;
+			default:
+				c.var.append(v.data, v.size);
+				m_bytes += v.size;
+				++c.texts;
+				break;
+		}
+		c.types.append(v.type);
+		c.fixed.append(bits);
+		c.offsets.append(c.var.size());
+	}
+	if (++m_rows >= m_batchRows || m_bytes >= MaxBatchBytes)
+		writeBatch();
+}
+
+void ArrowWriter::end()
+{
+	if (m_rows > 0)
+		writeBatch();
+	// no rows - all columns are utf8
+	if (!m_schema)
+		writeSchema();
+	// end of stream: continuation marker and zero length
+	m_out.append("\xff\xff\xff\xff\0\0\0\0", 8);
+	m_out.endRow();
+}
+
+void ArrowWriter::writeSchema()
+{
+	for (int i = 0; i < m_columns.count(); ++i)
+	{
+		ArrowColumn & c = m_columns[i];
+		if (c.texts > 0)
+			c.type = c.blobs > 0 ? Binary : Utf8;
+		else if (c.blobs > 0)
+			c.type = Binary;
+		else if (c.reals > 0)
+			c.type = Double;
+		else if (c.integers > 0)
+			c.type = Int64;
+		else
+			c.type = Utf8;
+	}
+	m_schema = true;
+
+	FlatBuilder fb;
+	int header = arrowMessage(fb, ARROW_HEADER_SCHEMA, 0);
+	FlatSlot schema[] = {
+		{ 0, 0 },					// endianness (little)
+		{ FlatBuilder::Offset, 0 }	// fields
+	};
+	int schemaPos[2];
+	fb.setOffset(header, fb.table(schema, 2, schemaPos));
+	int fields = fb.offsets(m_columns.count());
+	fb.setOffset(schemaPos[1], fields);
+
+	for (int i = 0; i < m_columns.count(); ++i)
+	{
+		int typeId = ARROW_TYPE_UTF8;
+		switch (m_columns.at(i).type)
+		{
+			case Int64:
+				typeId = ARROW_TYPE_INT;
+				break;
+			case Double:
+				typeId = ARROW_TYPE_FLOAT;
+				break;
+			case Binary:
+				typeId = ARROW_TYPE_BINARY;
+				break;
+			case Utf8:
+				break;
+		}
+		FlatSlot field[] = {
+			{ FlatBuilder::Offset, 0 },	// name
+			{ 1, 1 },					// nullable
+			{ 1, typeId },				// type_type
+			{ FlatBuilder::Offset, 0 },	// type
+			{ 0, 0 },					// dictionary
+			{ FlatBuilder::Offset, 0 }	// children
+		};
+		int fieldPos[6];
+		fb.setOffset(fields + 4 + 4 * i, fb.table(field, 6, fieldPos));
+		fb.setOffset(fieldPos[0], fb.string(m_names.at(i)));
+
+		int typePos[2];
+		int type;
+		if (typeId == ARROW_TYPE_INT)
+		{
+			FlatSlot slots[] = { { 4, 64 }, { 1, 1 } };	// bitWidth, is_signed
+			type = fb.table(slots, 2, typePos);
+		}
+		else if (typeId == ARROW_TYPE_FLOAT)
+		{
+			FlatSlot slots[] = { { 2, ARROW_PRECISION_DOUBLE } };
+			type = fb.table(slots, 1, typePos);
+		}
+		else
+			// Utf8 and Binary have no fields
+			type = fb.table(0, 0, typePos);
+		fb.setOffset(fieldPos[3], type);
+		// the readers require the children vector
+		fb.setOffset(fieldPos[5], fb.offsets(0));
+	}
+
+	writeMessage(fb.data(), QList<QByteArray>());
+}
+
+int ArrowWriter::encodeColumn(int index, QByteArray & validity,
+							  QByteArray & offsets, QByteArray & data)
+{
+	const ArrowColumn & column = m_columns.at(index);
+	validity.fill('\0', (m_rows + 7) / 8);
+	uchar * valid = reinterpret_cast<uchar*>(validity.data());
+	int nulls = 0;
+
+	if (column.type == Int64 || column.type == Double)
+	{
+		data.resize(m_rows * 8);
+		uchar * p = reinterpret_cast<uchar*>(data.data());
+		for (int r = 0; r < m_rows; ++r)
+		{
+			qint64 bits = column.fixed.at(r);
+			bool ok = true;
+			// false for the values lost by the conversion
+			bool fits = true;
+			double real;
+			switch (column.types.at(r))
+			{
+				case SQLITE_INTEGER:
+					if (column.type == Double)
+					{
+						real = double(bits);
+						memcpy(&bits, &real, sizeof(bits));
+					}
+					break;
+				case SQLITE_FLOAT:
+					if (column.type == Int64)
+					{
+						memcpy(&real, &bits, sizeof(bits));
+						// 2^63 is out of range already
+						fits = real == floor(real) && real >= -9223372036854775808.0
+							   && real < 9223372036854775808.0;
+						bits = fits ? qint64(real) : 0;
+					}
+					break;
+				case SQLITE_NULL:
+					ok = false;
+					break;
+				case SQLITE_BLOB:
+					fits = false;
+					break;
+				default:
+				{
+					QByteArray s(QByteArray::fromRawData(column.var.constData() + column.offsets.at(r),
+														 column.offsets.at(r + 1) - column.offsets.at(r)));
+					if (column.type == Int64)
+						bits = s.trimmed().toLongLong(&ok);
+					else
+					{
+						real = s.trimmed().toDouble(&ok);
+						memcpy(&bits, &real, sizeof(bits));
+					}
+					fits = ok;
+					break;
+				}
+			}
+			if (!fits)
+			{
+				if (!m_out.failed())
+					m_out.setError(tr("Row %1: the value of the column %2 is not %3. "
+									  "Arrow column types are decided by the first batch. "
+									  "Export it with bigger batches.")
+									.arg(m_batchStart + r + 1)
+									.arg(QString::fromUtf8(m_names.at(index)))
+									.arg(column.type == Int64 ? tr("an integer") : tr("a number")));
+				ok = false;
+			}
+			if (ok)
+				valid[r / 8] |= 1 << (r % 8);
+			else
+			{
+				bits = 0;
+				++nulls;
+			}
+			qToLittleEndian<quint64>(quint64(bits), p + r * 8);
+		}
+	}
+	else
+	{
+		// texts and blobs are used as they are when nothing is converted
+		bool direct = column.integers == 0 && column.reals == 0
+					  && (column.type == Binary || column.blobs == 0);
+		QVector<qint32> starts;
+		if (direct)
+		{
+			data = column.var;
+			starts = column.offsets;
+		}
+		else
+		{
+			data.clear();
+			starts.reserve(m_rows + 1);
+			starts.append(0);
+			for (int r = 0; r < m_rows; ++r)
+			{
+				const char * value = column.var.constData() + column.offsets.at(r);
+				int size = column.offsets.at(r + 1) - column.offsets.at(r);
+				double real;
+				switch (column.types.at(r))
+				{
+					case SQLITE_INTEGER:
+						data.append(QByteArray::number(column.fixed.at(r)));
+						break;
+					case SQLITE_FLOAT:
+						memcpy(&real, &column.fixed.at(r), sizeof(real));
+						data.append(QByteArray::number(real, 'g', 15));
+						break;
+					case SQLITE_BLOB:
+						// bytes are Latin-1 characters as in the text exports
+						if (column.type == Utf8)
+							data.append(QString::fromLatin1(value, size).toUtf8());
+						else
+							data.append(value, size);
+						break;
+					case SQLITE_NULL:
+						break;
+					default:
+						data.append(value, size);
+						break;
+				}
+				starts.append(data.size());
+			}
+		}
+
+		offsets.resize((m_rows + 1) * 4);
+		uchar * p = reinterpret_cast<uchar*>(offsets.data());
+		for (int r = 0; r <= m_rows; ++r)
+			qToLittleEndian<quint32>(quint32(starts.at(r)), p + r * 4);
+		for (int r = 0; r < m_rows; ++r)
+		{
+			if (column.types.at(r) == SQLITE_NULL)
+				++nulls;
+			else
+				valid[r / 8] |= 1 << (r % 8);
+		}
+	}
+
+	// the bitmap may be left out when there is no NULL
+	if (nulls == 0)
+		validity.clear();
+	return nulls;
+}
+
+void ArrowWriter::writeBatch()
+{
+	if (!m_schema)
+		writeSchema();
+
+	QList<QByteArray> body;
+	QByteArray nodes;
+	QByteArray buffers;
+	qint64 bodyLength = 0;
+	QByteArray validity;
+	QByteArray offsets;
+	QByteArray data;
+	for (int i = 0; i < m_columns.count(); ++i)
+	{
+		const ArrowColumn & c = m_columns.at(i);
+		offsets.clear();
+		int nulls = encodeColumn(i, validity, offsets, data);
+		appendInt64(nodes, m_rows);
+		appendInt64(nodes, nulls);
+
+		QList<QByteArray> columnBuffers;
+		columnBuffers << validity;
+		if (c.type == Utf8 || c.type == Binary)
+			columnBuffers << offsets;
+		columnBuffers << data;
+		foreach (QByteArray b, columnBuffers)
+		{
+			appendInt64(buffers, bodyLength);
+			appendInt64(buffers, b.size());
+			body.append(b);
+			// each buffer starts 8 aligned
+			bodyLength += (b.size() + 7) / 8 * 8;
+		}
+	}
+
+	FlatBuilder fb;
+	int header = arrowMessage(fb, ARROW_HEADER_BATCH, bodyLength);
+	FlatSlot batch[] = {
+		{ 8, m_rows },				// length
+		{ FlatBuilder::Offset, 0 },	// nodes
+		{ FlatBuilder::Offset, 0 }	// buffers
+	};
+	int batchPos[3];
+	fb.setOffset(header, fb.table(batch, 3, batchPos));
+	// FieldNode and Buffer structs are two longs - 8 aligned
+	fb.setOffset(batchPos[1], fb.vector(m_columns.count(), nodes, 8));
+	fb.setOffset(batchPos[2], fb.vector(buffers.size() / 16, buffers, 8));
+
+	writeMessage(fb.data(), body);
+	m_batchStart += m_rows;
+	clearBatch();
+}
+
+void ArrowWriter::writeMessage(const QByteArray & metadata, const QList<QByteArray> & body)
+{
+	static const char padding[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	uchar size[4];
+	// continuation marker, metadata size (padded to 8) and the metadata
+	m_out.append("\xff\xff\xff\xff", 4);
+	qToLittleEndian<quint32>(quint32(metadata.size()), size);
+	m_out.append(reinterpret_cast<const char*>(size), 4);
+	m_out.append(metadata);
+	foreach (QByteArray b, body)
+	{
+		m_out.append(b);
+		if (b.size() % 8)
+			m_out.append(padding, 8 - b.size() % 8);
+	}
+	m_out.endRow();
+}
@@ -0,0 +1,106 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef ARROWWRITER_H
+#define ARROWWRITER_H
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QVector>
+
+#include "dataexporter.h"
+
+
+/*! \brief Writer of the Apache Arrow IPC stream format.
+The stream is a schema message, record batches of batchRows rows
+and the end of stream marker. The Arrow metadata (flatbuffers) are
+built here - there is no dependency on the Arrow libraries.
+
+Columns are nullable int64, double, utf8 or binary. The column types
+are decided by the values of the first batch as sqlite has no column
+types: texts make utf8, blobs binary, reals double and integers int64.
+Values of the next batches are converted to the column type. A value
+which cannot be converted without a loss (a text which is not a number
+or a blob in a numeric column, a real with a fraction or out of range
+in an int64 column) fails the export - the schema is written already.
+A bigger batch (see DataExporter::setBatchRows()) gets the right type.
+
+Rows of the current batch are kept column by column. The batch is
+written sooner when its texts and blobs exceed MaxBatchBytes (the
+offsets of utf8 and binary are 32-bit).
+*/
+class ArrowWriter
+{
+		Q_DECLARE_TR_FUNCTIONS(ArrowWriter)
+
+	public:
+		//! \brief The batch is written when its variable data are bigger
+		static const int MaxBatchBytes = 256 * 1024 * 1024;
+
+		enum ColumnType
+		{
+			Int64,
+			Double,
+			Utf8,
+			Binary
+		};
+
+		/*! \param out output of the stream. Its codec has to be UTF-8 (none).
+		\param batchRows rows in one record batch. */
+		ArrowWriter(ExportWriter & out, int batchRows);
+
+		void begin(const QStringList & columns);
+		void writeRow(const QVector<ExportValue> & values);
+		//! \brief Write the last batch and the end of stream.
+		void end();
+
+	private:
+		/*! \brief Values of one column in the current batch.
+		They are kept as they come and converted in writeBatch(). */
+		typedef struct
+		{
+			ColumnType type;
+			//! \brief sqlite3 datatype per row
+			QVector<quint8> types;
+			//! \brief Integer or bits of the double per row
+			QVector<qint64> fixed;
+			//! \brief Start of each text or blob in var. The last one is the end.
+			QVector<qint32> offsets;
+			QByteArray var;
+			int integers;
+			int reals;
+			int texts;
+			int blobs;
+		}
+		ArrowColumn;
+
+		ExportWriter & m_out;
+		int m_batchRows;
+		QList<QByteArray> m_names;
+		QVector<ArrowColumn> m_columns;
+		//! \brief Rows of the current batch
+		int m_rows;
+		//! \brief Rows of the batches written already
+		qint64 m_batchStart;
+		int m_bytes;
+		//! \brief The column types are decided and the schema is written
+		bool m_schema;
+
+		void clearBatch();
+		void writeSchema();
+		void writeBatch();
+		/*! \brief Convert the column to its Arrow buffers.
+		A value not fitting the column type fails the output (see ArrowWriter).
+		\param index the column index.
+		\retval int count of NULLs. */
+		int encodeColumn(int index, QByteArray & validity,
+						 QByteArray & offsets, QByteArray & data);
+		//! \brief Write an encapsulated message.
+		void writeMessage(const QByteArray & metadata, const QList<QByteArray> & body);
+};
+
+#endif
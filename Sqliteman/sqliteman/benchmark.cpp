@@ -0,0 +1,394 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+
+#ifdef INTERNAL_SQLDRIVER
+#include "driver/qsql_sqlite.h"
+#endif
+
+#include "benchmark.h"
+#include "csvtokenizer.h"
+#include "dataexporter.h"
+#include "dataexportworker.h"
+#include "importtabledialog.h"
+#include "importinserter.h"
+#include "sqlrowblock.h"
+
+
+Benchmark::Benchmark(int rows)
+	: m_rows(rows),
+	  m_csvFile(QDir::temp().filePath("sqliteman-benchmark.csv")),
+	  m_dbFile(QDir::temp().filePath("sqliteman-benchmark.db")),
+	  m_exportFile(QDir::temp().filePath("sqliteman-benchmark.out")),
+	  m_db(0),
+	  m_out(stdout, QIODevice::WriteOnly)
+{
+}
+
+Benchmark::~Benchmark()
+{
+	if (m_db)
+		sqlite3_close(m_db);
+	QFile::remove(m_csvFile);
+	QFile::remove(m_dbFile);
+	QFile::remove(m_exportFile);
+}
+
+int Benchmark::run()
+{
+	m_out << tr("Sqliteman benchmark: %1 rows").arg(m_rows) << "\n";
+	if (!createCsv() || !tokenize())
+		return 1;
+
+	QFile::remove(m_dbFile);
+	if (sqlite3_open(QFile::encodeName(m_dbFile).constData(), &m_db) != SQLITE_OK)
+	{
+		m_out << tr("Cannot open database %1").arg(m_dbFile) << "\n";
+		return 1;
+	}
+	if (!execute("CREATE TABLE bench (id INTEGER, name TEXT, price REAL, note TEXT);"))
+		return 1;
+
+	if (!importPerRow() || !clearTable() || !importTyped())
+		return 1;
+	if (!fetchVariants() || !fetchRowBlock())
+		return 1;
+
+	QStringList formats;
+	formats << "csv" << "html" << "xls" << "sql" << "py" << "qore_select"
+			<< "qore_selectRows" << "arrow" << "json" << "jsonl";
+	foreach (QString format, formats)
+	{
+		if (!exportFormat(format))
+			return 1;
+	}
+	return 0;
+}
+
+bool Benchmark::createCsv()
+{
+	QFile f(m_csvFile);
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		m_out << tr("Cannot open file %1 for writing.").arg(m_csvFile) << "\n";
+		return false;
+	}
+	// quoted separators and new lines as in the real files
+	QByteArray row;
+	for (int i = 0; i < m_rows; ++i)
+	{
+		row = QByteArray::number(i + 1) + ",item " + QByteArray::number(i % 1000) + ","
+			  + QByteArray::number((i % 100000) / 100.0, 'f', 2)
+			  + ((i % 10) ? ",plain note\n" : ",\"quoted, \"\"note\"\"\nwith a new line\"\n");
+		if (f.write(row) != row.size())
+		{
+			m_out << tr("Cannot write file %1: %2").arg(m_csvFile).arg(f.errorString()) << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Benchmark::tokenize()
+{
+	QFile f(m_csvFile);
+	if (!f.open(QIODevice::ReadOnly))
+	{
+		m_out << tr("Cannot open file %1").arg(m_csvFile) << "\n";
+		return false;
+	}
+	// the file is in the memory - the parsing is measured only
+	QByteArray data(f.readAll());
+	double mb = double(data.size()) / (1024 * 1024);
+
+	m_clock.start();
+	CsvTokenizer tokenizer(",");
+	qint64 fields = 0;
+	int offset = 0;
+	int consumed;
+	while (tokenizer.parse(data.constData() + offset, data.size() - offset, true, consumed)
+		   == CsvTokenizer::Record)
+	{
+		fields += tokenizer.fieldCount();
+		offset += consumed;
+	}
+	int elapsed = qMax(1, m_clock.elapsed());
+	m_out << QString("%1 %2 ms, %3 MB/s")
+				.arg(tr("CSV, CsvTokenizer (%1):").arg(CsvTokenizer::scanner()), -32).arg(elapsed, 8)
+				.arg(mb * 1000 / elapsed, 10, 'f', 1)
+		  << "\n";
+
+	m_clock.start();
+	QBuffer buffer(&data);
+	buffer.open(QIODevice::ReadOnly);
+	QTextStream in(&buffer);
+	in.setCodec("UTF-8");
+	fields = 0;
+	while (!in.atEnd())
+		fields += in.readLine().split(",").count();
+	elapsed = qMax(1, m_clock.elapsed());
+	m_out << QString("%1 %2 ms, %3 MB/s")
+				.arg(tr("CSV, readLine().split():"), -32).arg(elapsed, 8)
+				.arg(mb * 1000 / elapsed, 10, 'f', 1)
+		  << "\n";
+	m_out.flush();
+	return true;
+}
+
+bool Benchmark::execute(const char * sql)
+{
+	char * err = 0;
+	if (sqlite3_exec(m_db, sql, 0, 0, &err) == SQLITE_OK)
+		return true;
+	m_out << tr("Benchmark failed: %1").arg(QString::fromUtf8(err)) << "\n";
+	sqlite3_free(err);
+	return false;
+}
+
+bool Benchmark::clearTable()
+{
+	return execute("DELETE FROM bench;");
+}
+
+void Benchmark::report(const QString & name, qint64 rows)
+{
+	int elapsed = qMax(1, m_clock.elapsed());
+	m_out << QString("%1 %2 ms, %3 rows/s")
+				.arg(name, -32).arg(elapsed, 8).arg(rows * 1000 / elapsed, 10)
+		  << "\n";
+	m_out.flush();
+}
+
+bool Benchmark::importPerRow()
+{
+	ImportTable::CSVReader reader(m_csvFile, ",");
+	if (!reader.open())
+	{
+		m_out << reader.errorString() << "\n";
+		return false;
+	}
+
+	m_clock.start();
+	if (!execute("BEGIN TRANSACTION;"))
+		return false;
+	QStringList row;
+	qint64 rows = 0;
+	const QString sql("INSERT INTO bench VALUES (?, ?, ?, ?);");
+	while (reader.readRow(row))
+	{
+		sqlite3_stmt * stmt = 0;
+		if (sqlite3_prepare16_v2(m_db, sql.utf16(), -1, &stmt, 0) != SQLITE_OK)
+		{
+			m_out << tr("Benchmark failed: %1").arg(QString::fromUtf8(sqlite3_errmsg(m_db))) << "\n";
+			return false;
+		}
+		for (int i = 0; i < row.count(); ++i)
+			sqlite3_bind_text16(stmt, i + 1, row.at(i).utf16(), row.at(i).size() * sizeof(ushort),
+								SQLITE_TRANSIENT);
+		sqlite3_step(stmt);
+		sqlite3_finalize(stmt);
+		++rows;
+	}
+	if (!execute("COMMIT;"))
+		return false;
+	report(tr("Import, prepared per row:"), rows);
+	return true;
+}
+
+bool Benchmark::importTyped()
+{
+	ImportTable::CSVReader reader(m_csvFile, ",");
+	if (!reader.open())
+	{
+		m_out << reader.errorString() << "\n";
+		return false;
+	}
+
+	FieldList fields;
+	const char * names[] = { "id", "name", "price", "note" };
+	const char * types[] = { "INTEGER", "TEXT", "REAL", "TEXT" };
+	for (int i = 0; i < 4; ++i)
+	{
+		DatabaseTableField f;
+		f.cid = i;
+		f.name = names[i];
+		f.type = types[i];
+		f.notnull = false;
+		f.pk = false;
+		fields.append(f);
+	}
+
+	m_clock.start();
+	ImportInserter inserter(m_db, "main", "bench", fields);
+	if (!inserter.begin())
+	{
+		m_out << tr("Benchmark failed: %1").arg(inserter.errorString()) << "\n";
+		return false;
+	}
+	QStringList row;
+	qint64 rows = 0;
+	while (reader.readRow(row))
+	{
+		inserter.insert(row);
+		++rows;
+	}
+	if (!inserter.commit())
+	{
+		m_out << tr("Benchmark failed: %1").arg(inserter.errorString()) << "\n";
+		return false;
+	}
+	report(tr("Import, ImportInserter:"), rows);
+	return true;
+}
+
+void Benchmark::reportFetch(const QString & name, qint64 rows, qint64 bytes)
+{
+	int elapsed = qMax(1, m_clock.elapsed());
+	m_out << QString("%1 %2 ms, %3 rows/s, %4 bytes/row")
+				.arg(name, -32).arg(elapsed, 8).arg(rows * 1000 / elapsed, 10)
+				.arg(rows ? bytes / rows : 0, 6)
+		  << "\n";
+	m_out.flush();
+}
+
+//! \brief Heap and inline size of a cached QVariant (Qt 4, 64-bit estimation).
+static int variantBytes(const QVariant & value)
+{
+	// QVariant, QString/QByteArray Data header
+	int bytes = sizeof(QVariant);
+	if (value.type() == QVariant::String)
+		bytes += 24 + (value.toString().size() + 1) * sizeof(QChar);
+	else if (value.type() == QVariant::ByteArray)
+		bytes += 24 + value.toByteArray().size() + 1;
+	return bytes;
+}
+
+bool Benchmark::fetchVariants()
+{
+	QString name("sqliteman-benchmark");
+	{
+#ifdef INTERNAL_SQLDRIVER
+		QSqlDatabase db = QSqlDatabase::addDatabase(new QSQLiteDriver(), name);
+#else
+		QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+#endif
+		db.setDatabaseName(m_dbFile);
+		if (!db.open())
+		{
+			m_out << tr("Benchmark failed: %1").arg(db.lastError().text()) << "\n";
+			return false;
+		}
+
+		m_clock.start();
+		// not forward only - all rows stay in the QSqlCachedResult
+		QSqlQuery query(db);
+		if (!query.exec("SELECT * FROM bench;"))
+		{
+			m_out << tr("Benchmark failed: %1").arg(query.lastError().text()) << "\n";
+			return false;
+		}
+		qint64 rows = 0;
+		qint64 bytes = 0;
+		int columns = query.record().count();
+		while (query.next())
+		{
+			for (int i = 0; i < columns; ++i)
+				bytes += variantBytes(query.value(i));
+			++rows;
+		}
+		reportFetch(tr("Fetch, QVariant cells (est.):"), rows, bytes);
+	}
+	QSqlDatabase::removeDatabase(name);
+	return true;
+}
+
+bool Benchmark::fetchRowBlock()
+{
+	sqlite3_stmt * stmt = 0;
+	if (sqlite3_prepare_v2(m_db, "SELECT * FROM bench;", -1, &stmt, 0) != SQLITE_OK)
+	{
+		m_out << tr("Benchmark failed: %1").arg(QString::fromUtf8(sqlite3_errmsg(m_db))) << "\n";
+		return false;
+	}
+
+	m_clock.start();
+	SqlRowBlock block(sqlite3_column_count(stmt));
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+		block.appendRow(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+	{
+		m_out << tr("Benchmark failed: %1").arg(QString::fromUtf8(sqlite3_errmsg(m_db))) << "\n";
+		return false;
+	}
+	reportFetch(tr("Fetch, SqlRowBlock:"), block.rowCount(), block.bytes());
+	return true;
+}
+
+bool Benchmark::exportFormat(const QString & format)
+{
+	QFile f(m_exportFile);
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		m_out << tr("Cannot open file %1 for writing.").arg(m_exportFile) << "\n";
+		return false;
+	}
+	sqlite3_stmt * stmt = 0;
+	if (sqlite3_prepare_v2(m_db, "SELECT * FROM bench;", -1, &stmt, 0) != SQLITE_OK)
+	{
+		m_out << tr("Benchmark failed: %1").arg(QString::fromUtf8(sqlite3_errmsg(m_db))) << "\n";
+		return false;
+	}
+
+	m_clock.start();
+	QStringList columns;
+	for (int i = 0; i < sqlite3_column_count(stmt); ++i)
+		columns << QString::fromUtf8(sqlite3_column_name(stmt, i));
+	DataExporter exporter(format, "bench");
+	exporter.begin(&f, columns);
+	// blocks as the DataExportWorker fetches them
+	SqlRowBlock block(columns.count());
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+	{
+		block.appendRow(stmt);
+		if (block.rowCount() == DataExportWorker::BlockRows)
+		{
+			for (int i = 0; i < block.rowCount(); ++i)
+				exporter.writeRow(block, i);
+			block.clear();
+		}
+	}
+	for (int i = 0; i < block.rowCount(); ++i)
+		exporter.writeRow(block, i);
+	sqlite3_finalize(stmt);
+	bool res = exporter.end();
+	f.close();
+	if (rc != SQLITE_DONE || !res)
+	{
+		m_out << tr("Benchmark failed: %1")
+				.arg(res ? QString::fromUtf8(sqlite3_errmsg(m_db)) : exporter.errorString())
+			  << "\n";
+		return false;
+	}
+
+	int elapsed = qMax(1, m_clock.elapsed());
+	m_out << QString("%1 %2 ms, %3 MB/s")
+				.arg(tr("Export, %1:").arg(format), -32).arg(elapsed, 8)
+				.arg(double(exporter.bytesWritten()) * 1000 / elapsed / (1024 * 1024), 10, 'f', 1)
+		  << "\n";
+	m_out.flush();
+	return true;
+}
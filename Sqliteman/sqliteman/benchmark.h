@@ -0,0 +1,81 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QTime>
+
+#include "sqlite3.h"
+
+
+/*! \brief Throughput of the import and export code paths.
+It's run by "sqliteman --benchmark [rows]" without any GUI. A CSV file
+with the given count of generated rows is split into fields by
+CsvTokenizer and by the old readLine().split() (which ignores quotes)
+in the memory. The scanner of the build is printed - build with
+-mavx2 (or -march=native) and without it to compare AVX2 and SSE2.
+The file is imported into a temporary database:
+ - by the old way (the INSERT prepared for each row, all values bound
+   as text) as the baseline,
+ - by ImportInserter (one prepared statement, typed values).
+The table is fetched then by the Qt driver (one QVariant per cell kept
+by QSqlCachedResult as QSqlQueryModel does) and into a SqlRowBlock
+(as SqlResultModel does). Rows/s and memory per row are compared.
+The imported table is exported then by DataExporter in each format
+(the SqlRowBlock path of the query exports) into a temporary file.
+The results (rows/s and MB/s) are printed to stdout. The temporary
+files are removed at the end.
+*/
+class Benchmark
+{
+		Q_DECLARE_TR_FUNCTIONS(Benchmark)
+
+	public:
+		static const int DefaultRows = 200000;
+
+		Benchmark(int rows);
+		~Benchmark();
+
+		//! \retval int the exit code of the program.
+		int run();
+
+	private:
+		int m_rows;
+		QString m_csvFile;
+		QString m_dbFile;
+		QString m_exportFile;
+		sqlite3 * m_db;
+		QTextStream m_out;
+		QTime m_clock;
+
+		//! \brief Write m_rows generated rows into m_csvFile.
+		bool createCsv();
+		//! \brief Run a statement. The error is printed.
+		bool execute(const char * sql);
+		//! \brief Split the CSV file by CsvTokenizer and by QString::split().
+		bool tokenize();
+		//! \brief Empty the benchmark table.
+		bool clearTable();
+		//! \brief Import with the INSERT prepared for each row.
+		bool importPerRow();
+		//! \brief Import with ImportInserter.
+		bool importTyped();
+		//! \brief Fetch all rows by QSqlQuery, values by QVariant.
+		bool fetchVariants();
+		//! \brief Fetch all rows into one SqlRowBlock.
+		bool fetchRowBlock();
+		//! \brief Export the table in the format of the key.
+		bool exportFormat(const QString & format);
+		void report(const QString & name, qint64 rows);
+		//! \brief Print rows/s and bytes per row of the fetch.
+		void reportFetch(const QString & name, qint64 rows, qint64 bytes);
+};
+
+#endif
@@ -0,0 +1,151 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QRegExp>
+
+#include "bulkload.h"
+
+
+BulkLoad::BulkLoad(sqlite3 * db, const QString & schema, const QString & table)
+	: m_db(db),
+	  m_schema(schema),
+	  m_table(table)
+{
+}
+
+BulkLoad::~BulkLoad()
+{
+	restorePragmas();
+}
+
+bool BulkLoad::execute(const QString & statement)
+{
+	char * err = 0;
+	if (sqlite3_exec(m_db, statement.toUtf8().constData(), 0, 0, &err) == SQLITE_OK)
+		return true;
+	m_error = QString::fromUtf8(err);
+	sqlite3_free(err);
+	return false;
+}
+
+QString BulkLoad::value(const QString & statement)
+{
+	sqlite3_stmt * stmt;
+	QString ret;
+	if (sqlite3_prepare16_v2(m_db, statement.utf16(), -1, &stmt, 0) != SQLITE_OK)
+	{
+		m_error = QString::fromUtf8(sqlite3_errmsg(m_db));
+		return ret;
+	}
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		ret = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+	sqlite3_finalize(stmt);
+	return ret;
+}
+
+bool BulkLoad::switchPragma(const QString & pragma, const QString & newValue)
+{
+	QString old(value(QString("PRAGMA %1;").arg(pragma)));
+	if (old.isNull())
+		return false;
+	if (!execute(QString("PRAGMA %1 = %2;").arg(pragma, newValue)))
+		return false;
+	m_pragmas.append(qMakePair(pragma, old));
+	return true;
+}
+
+bool BulkLoad::setPragmas()
+{
+	m_error = QString();
+	if (!m_db || !sqlite3_get_autocommit(m_db))
+		return true;
+
+	QString schema(QString("\"%1\".").arg(m_schema));
+	if (!switchPragma(schema + "synchronous", "OFF")
+		|| !switchPragma(schema + "cache_size", QString::number(CachePages)))
+		return false;
+	if (value("SELECT count(*) FROM sqlite_temp_master;") == "0")
+		return switchPragma("temp_store", "MEMORY");
+	return true;
+}
+
+void BulkLoad::restorePragmas()
+{
+	// in the reverse order
+	while (!m_pragmas.isEmpty())
+	{
+		QPair<QString,QString> p(m_pragmas.takeLast());
+		execute(QString("PRAGMA %1 = %2;").arg(p.first, p.second));
+	}
+}
+
+bool BulkLoad::dropDependent()
+{
+	m_error = QString();
+	m_sql.clear();
+
+	QString master(m_schema.toLower() == "temp"
+				   ? "sqlite_temp_master"
+				   : QString("\"%1\".sqlite_master").arg(m_schema));
+	QString sql(QString("SELECT type, name, sql FROM %1 "
+						"WHERE lower(tbl_name) = lower(?) "
+						"AND type IN ('index', 'trigger') AND sql IS NOT NULL;")
+				.arg(master));
+
+	sqlite3_stmt * stmt;
+	if (sqlite3_prepare16_v2(m_db, sql.utf16(), -1, &stmt, 0) != SQLITE_OK)
+	{
+		m_error = QString::fromUtf8(sqlite3_errmsg(m_db));
+		return false;
+	}
+	sqlite3_bind_text16(stmt, 1, m_table.utf16(), m_table.size() * sizeof(ushort), SQLITE_STATIC);
+
+	QStringList drops;
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+	{
+		QString type(QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))));
+		QString name(QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1))));
+		m_sql.append(QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2))));
+		drops.append(QString("DROP %1 \"%2\".\"%3\";").arg(type.toUpper(), m_schema, name));
+	}
+	sqlite3_finalize(stmt);
+
+	foreach (QString drop, drops)
+	{
+		if (!execute(drop))
+			return false;
+	}
+	return true;
+}
+
+QString BulkLoad::qualify(const QString & sql)
+{
+	// sqlite_master keeps the statement without the schema name.
+	// Unqualified objects would be created in the main database.
+	// TEMP ones are found by sqlite and they cannot be qualified.
+	if (m_schema.toLower() == "main" || m_schema.toLower() == "temp")
+		return sql;
+	QRegExp create("^\\s*CREATE\\s+(UNIQUE\\s+|TEMP\\s+|TEMPORARY\\s+)?"
+				   "(INDEX|TRIGGER)\\s+(IF\\s+NOT\\s+EXISTS\\s+)?",
+				   Qt::CaseInsensitive);
+	if (create.indexIn(sql) == -1)
+		return sql;
+	QString ret(sql);
+	return ret.insert(create.matchedLength(), QString("\"%1\".").arg(m_schema));
+}
+
+bool BulkLoad::rebuild()
+{
+	m_error = QString();
+	foreach (QString sql, m_sql)
+	{
+		if (!execute(qualify(sql)))
+			return false;
+	}
+	m_sql.clear();
+	return true;
+}
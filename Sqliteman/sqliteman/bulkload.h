@@ -0,0 +1,96 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef BULKLOAD_H
+#define BULKLOAD_H
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QPair>
+
+#include "database.h"
+
+
+/*! \brief Fast loading of many rows into one table.
+Indexes are maintained row by row during inserts. It's much faster
+to drop them, load the rows and create them again in one pass.
+The connection pragmas are switched for the load too:
+synchronous=OFF, a large cache_size and temp_store=MEMORY.
+
+Usage on one connection:
+\code
+BulkLoad bulk(db, schema, table);
+bulk.setPragmas();       // outside of a transaction
+BEGIN
+bulk.dropDependent();    // in the load transaction
+... inserts ...
+bulk.rebuild();          // ROLLBACK when it fails
+COMMIT
+bulk.restorePragmas();   // or let the destructor do it
+\endcode
+
+The indexes and triggers are the same ones as in
+Database::tableDependentSql(). Triggers are dropped too so they
+are not fired for the loaded rows. Automatic indexes of the
+PRIMARY KEY and UNIQUE constraints cannot be dropped so they stay.
+Everything happens in the load transaction so a ROLLBACK brings
+the original objects back.
+*/
+class BulkLoad
+{
+		Q_DECLARE_TR_FUNCTIONS(BulkLoad)
+
+	public:
+		//! \brief cache_size used for the load (pages)
+		static const int CachePages = 100000;
+
+		BulkLoad(sqlite3 * db, const QString & schema, const QString & table);
+		//! \brief Restores the pragmas if it's not done yet.
+		~BulkLoad();
+
+		/*! \brief Switch the pragmas for the load.
+		Nothing is changed inside of an open transaction - sqlite ignores
+		some of them there. temp_store is kept when there are TEMP objects
+		(changing it would drop them).
+		\retval bool false on error. See errorString(). */
+		bool setPragmas();
+		//! \brief Set the original pragma values back.
+		void restorePragmas();
+
+		/*! \brief Remember the SQL of the table indexes and triggers and drop them.
+		\retval bool false on error. Roll back the transaction then. */
+		bool dropDependent();
+		/*! \brief Create the dropped objects again.
+		\retval bool false on error (e.g. UNIQUE index over duplicate rows).
+		Roll back the transaction then. */
+		bool rebuild();
+
+		//! \brief SQL of the dropped objects.
+		QStringList dependentSql() const { return m_sql; };
+		QString errorString() const { return m_error; };
+
+	private:
+		sqlite3 * m_db;
+		QString m_schema;
+		QString m_table;
+		//! \brief CREATE statements of the dropped objects
+		QStringList m_sql;
+		//! \brief "pragma - original value" pairs to restore
+		QList<QPair<QString,QString> > m_pragmas;
+		QString m_error;
+
+		//! \brief Run a statement without results. Sets m_error.
+		bool execute(const QString & statement);
+		//! \brief The first column of the first row or a null string.
+		QString value(const QString & statement);
+		//! \brief Remember the pragma value and set a new one.
+		bool switchPragma(const QString & pragma, const QString & newValue);
+		//! \brief Add the schema name to the created object name.
+		QString qualify(const QString & sql);
+};
+
+#endif
@@ -45,27 +45,16 @@ ConstraintsDialog::ConstraintsDialog(const QString & tabName, const QString & sc
 	}
 
 	// get FKs
-	QString sql(QString("pragma \"%1\".foreign_key_list (\"%2\");").arg(schema).arg(tabName));
-	QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
-	
-	if(query.lastError().isValid())
-	{
-		ui.resultEdit->setText(tr("Error while parsing constraints: %1.\n\n%2")
-				.arg(query.lastError().text())
-				.arg(sql));
-		return;
-	}
-	// 2 - table - FK table; 3 - from - column name; 4 - to - fk column name
 	QString fkTab;
 	QString column;
 	QString fkColumn;
 	QString nnTemplate;
 	QString thenTemplate;
-	while (query.next())
+	foreach (DatabaseForeignKey fk, Database::foreignKeys(tabName, schema))
 	{
-		fkTab = query.value(2).toString();
-		column = query.value(3).toString();
-		fkColumn = query.value(4).toString();
+		fkTab = fk.table;
+		column = fk.from;
+		fkColumn = fk.to;
 		nnTemplate = "";
 		if (nnCols.contains(column, Qt::CaseInsensitive))
 		{
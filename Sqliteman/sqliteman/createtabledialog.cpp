@@ -6,6 +6,7 @@ for which a new license (GPL+exception) is in place.
 */
 
 #include <QCheckBox>
+#include <QComboBox>
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QMessageBox>
@@ -32,6 +33,33 @@ CreateTableDialog::CreateTableDialog(QWidget * parent)
 )");
 }
 
+void CreateTableDialog::setColumns(const QString & schema, const QString & name,
+								   const FieldList & columns)
+{
+	int ix = ui.databaseCombo->findText(schema);
+	if (ix != -1)
+		ui.databaseCombo->setCurrentIndex(ix);
+	ui.nameEdit->setText(name);
+
+	ui.columnTable->setRowCount(0);
+	foreach (DatabaseTableField f, columns)
+	{
+		addField();
+		int row = ui.columnTable->rowCount() - 1;
+		ui.columnTable->setItem(row, 0, new QTableWidgetItem(f.name));
+		QComboBox * box = qobject_cast<QComboBox*>(ui.columnTable->cellWidget(row, 1));
+		if (!box)
+			continue;
+		// e.g. "Date" is not offered by default
+		if (box->findText(f.type) == -1)
+			box->addItem(f.type);
+		box->setCurrentIndex(box->findText(f.type));
+	}
+	if (ui.columnTable->rowCount() == 0)
+		addField();
+	ui.removeButton->setEnabled(false);
+}
+
 QString CreateTableDialog::getSQLfromGUI()
 {
 	QString sql(QString("CREATE TABLE %1 (\n").arg(getFullName(ui.nameEdit->text())));
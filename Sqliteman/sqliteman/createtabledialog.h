@@ -24,6 +24,14 @@ class CreateTableDialog : public TableEditorDialog
 
 		bool update;
 
+		/*! \brief Prefill the dialog with a proposed table.
+		Used by the data import to create a table for the file.
+		\param schema a database name. It's kept when it's unknown.
+		\param name a table name.
+		\param columns names and types of the columns.
+		*/
+		void setColumns(const QString & schema, const QString & name, const FieldList & columns);
+
 	private slots:
 		void createButton_clicked();
 		void tabWidget_currentChanged(int index);
@@ -0,0 +1,232 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CSV_SSE2
+#endif
+
+#include "csvtokenizer.h"
+
+
+//! \brief Index of the lowest set bit. The mask must not be 0.
+static inline int firstBit(unsigned int mask)
+{
+#if defined(__GNUC__)
+	return __builtin_ctz(mask);
+#else
+	int i = 0;
+	while (!(mask & 1))
+	{
+		mask >>= 1;
+		++i;
+	}
+	return i;
+#endif
+}
+
+/*! \brief Find the first of a, b or c bytes.
+\retval int an index or -1 when there is none of them.
+*/
+static int findAny(const char * p, int n, char a, char b, char c)
+{
+	int i = 0;
+#if defined(__AVX2__)
+	const __m256i va = _mm256_set1_epi8(a);
+	const __m256i vb = _mm256_set1_epi8(b);
+	const __m256i vc = _mm256_set1_epi8(c);
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+		__m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, va),
+													_mm256_cmpeq_epi8(v, vb)),
+									_mm256_cmpeq_epi8(v, vc));
+		unsigned int mask = _mm256_movemask_epi8(m);
+		if (mask)
+			return i + firstBit(mask);
+	}
+#elif defined(CSV_SSE2)
+	const __m128i va = _mm_set1_epi8(a);
+	const __m128i vb = _mm_set1_epi8(b);
+	const __m128i vc = _mm_set1_epi8(c);
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+		__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va),
+											  _mm_cmpeq_epi8(v, vb)),
+								 _mm_cmpeq_epi8(v, vc));
+		unsigned int mask = _mm_movemask_epi8(m);
+		if (mask)
+			return i + firstBit(mask);
+	}
+#endif
+	// scalar fallback and the tail
+	for (; i < n; ++i)
+	{
+		char ch = p[i];
+		if (ch == a || ch == b || ch == c)
+			return i;
+	}
+	return -1;
+}
+
+
+CsvTokenizer::CsvTokenizer(const QByteArray & separator, char quote)
+	: m_separator(separator),
+	  m_quote(quote),
+	  m_record(4096, '\0'),
+	  m_used(0),
+	  m_fields(64),
+	  m_fieldCount(0),
+	  m_skip(false)
+{
+}
+
+const char * CsvTokenizer::scanner()
+{
+#if defined(__AVX2__)
+	return "AVX2";
+#elif defined(CSV_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+void CsvTokenizer::append(const char * data, int length)
+{
+	if (length <= 0 || m_skip)
+		return;
+	if (m_used + length > m_record.size())
+		m_record.resize(qMax(m_record.size() * 2, m_used + length));
+	memcpy(m_record.data() + m_used, data, length);
+	m_used += length;
+}
+
+void CsvTokenizer::endField(int start)
+{
+	if (m_fieldCount == m_fields.size())
+		m_fields.resize(m_fields.size() * 2);
+	Field & f = m_fields[m_fieldCount++];
+	f.offset = start;
+	f.length = m_used - start;
+}
+
+CsvTokenizer::Result CsvTokenizer::skip(const char * data, int size, bool atEnd, int & consumed)
+{
+	m_skip = true;
+	Result result = parse(data, size, atEnd, consumed);
+	m_skip = false;
+	m_fieldCount = 0;
+	return result;
+}
+
+CsvTokenizer::Result CsvTokenizer::parse(const char * data, int size, bool atEnd, int & consumed)
+{
+	if (size == 0)
+		return atEnd ? End : NeedMore;
+
+	m_used = 0;
+	m_fieldCount = 0;
+
+	const char sep = m_separator.isEmpty() ? ',' : m_separator.at(0);
+	const int sepLength = qMax(1, m_separator.size());
+	int pos = 0;
+
+	while (true)
+	{
+		int start = m_used;
+
+		// quoted part of the field
+		if (pos < size && data[pos] == m_quote)
+		{
+			++pos;
+			while (true)
+			{
+				int q = findAny(data + pos, size - pos, m_quote, m_quote, m_quote);
+				if (q == -1)
+				{
+					if (!atEnd)
+						return NeedMore;
+					// unterminated quote
+					append(data + pos, size - pos);
+					pos = size;
+					break;
+				}
+				append(data + pos, q);
+				pos += q + 1;
+				// "" can be split between two reads
+				if (pos == size && !atEnd)
+					return NeedMore;
+				if (pos < size && data[pos] == m_quote)
+				{
+					append(data + pos, 1);
+					++pos;
+					continue;
+				}
+				break;
+			}
+		}
+
+		// unquoted field (or garbage after the closing quote)
+		while (true)
+		{
+			int k = findAny(data + pos, size - pos, sep, '\n', '\r');
+			if (k == -1)
+			{
+				if (!atEnd)
+					return NeedMore;
+				// the last line without a line end
+				append(data + pos, size - pos);
+				endField(start);
+				consumed = size;
+				return Record;
+			}
+
+			append(data + pos, k);
+			pos += k;
+			char ch = data[pos];
+
+			if (ch == sep && ch != '\n' && ch != '\r')
+			{
+				if (sepLength > 1)
+				{
+					if (pos + sepLength > size && !atEnd)
+						return NeedMore;
+					if (pos + sepLength > size
+						|| memcmp(data + pos, m_separator.constData(), sepLength) != 0)
+					{
+						// only the first byte matches
+						append(data + pos, 1);
+						++pos;
+						continue;
+					}
+				}
+				pos += sepLength;
+				endField(start);
+				break;
+			}
+
+			// line end: LF, CRLF or CR
+			endField(start);
+			++pos;
+			if (ch == '\r')
+			{
+				if (pos == size && !atEnd)
+					return NeedMore;
+				if (pos < size && data[pos] == '\n')
+					++pos;
+			}
+			consumed = pos;
+			return Record;
+		}
+	}
+}
@@ -0,0 +1,93 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef CSVTOKENIZER_H
+#define CSVTOKENIZER_H
+
+#include <QByteArray>
+#include <QVector>
+
+
+/*! \brief RFC 4180 CSV tokenizer working on raw bytes.
+It splits one record at a time. Quoted fields can contain
+separators, new lines and doubled quotes (""). Records end with
+LF, CRLF or CR. It's lenient to the broken input: a quote inside
+an unquoted field is a plain character, text after a closing quote
+is appended to the field and an unterminated quote ends at the
+end of input.
+
+Separators, quotes and line ends are searched 16 (SSE2) or 32 (AVX2)
+bytes at a time. AVX2 is used when the compiler targets it (e.g.
+-march=native), SSE2 on any x86-64 build, plain C++ elsewhere.
+
+The input must be in an ASCII compatible encoding (UTF-8, Latin-x...).
+Fields are returned as raw bytes - decoding is up to the caller. They
+are valid until the next parse() call. No memory is allocated when
+the records are not growing.
+*/
+class CsvTokenizer
+{
+	public:
+		enum Result
+		{
+			//! \brief One record is parsed. See fieldCount().
+			Record,
+			//! \brief The record is not complete. Call it again with more data.
+			NeedMore,
+			//! \brief No more records.
+			End
+		};
+
+		/*! \param separator a field separator. It can be longer than one byte.
+		\param quote a quoting character. */
+		CsvTokenizer(const QByteArray & separator, char quote = '"');
+
+		/*! \brief Parse one record from the beginning of data.
+		\param data the input starting with a new record.
+		\param size the input size.
+		\param atEnd true when there is no more input after the size.
+		\param consumed bytes of the record including its line end. It's
+		       set for Record result only. The next record starts there.
+		*/
+		Result parse(const char * data, int size, bool atEnd, int & consumed);
+		/*! \brief Find the end of one record without copying its fields.
+		It's used to split the input into blocks of whole records.
+		Parameters are the same as for parse(). Fields are not valid after it.
+		*/
+		Result skip(const char * data, int size, bool atEnd, int & consumed);
+
+		int fieldCount() const { return m_fieldCount; };
+		const char * fieldData(int i) const { return m_record.constData() + m_fields.at(i).offset; };
+		int fieldLength(int i) const { return m_fields.at(i).length; };
+
+		//! \brief Name of the scanner used ("AVX2", "SSE2" or "scalar").
+		static const char * scanner();
+
+	private:
+		typedef struct
+		{
+			int offset;
+			int length;
+		}
+		Field;
+
+		QByteArray m_separator;
+		char m_quote;
+		//! \brief Unescaped bytes of the current record. It's never shrinked.
+		QByteArray m_record;
+		int m_used;
+		//! \brief Fields of the current record. Only m_fieldCount items are valid.
+		QVector<Field> m_fields;
+		int m_fieldCount;
+		//! \brief True inside skip(). Nothing is copied.
+		bool m_skip;
+
+		void append(const char * data, int length);
+		void endField(int start);
+};
+
+#endif
@@ -14,21 +14,33 @@ for which a new license (GPL+exception) is in place.
 #include <QMessageBox>
 
 #include "database.h"
+#include "databasesession.h"
 #include "preferences.h"
 #include "shell.h"
 
 
 void Database::exception(const QString & message)
 {
+	// background jobs report errors themselves. See DatabaseSession.
+	if (!DatabaseSession::isGuiThread())
+	{
+		qWarning("%s", message.toUtf8().data());
+		return;
+	}
 	QMessageBox::critical(0, tr("SQL Error"), message);
 }
 
+QSqlDatabase Database::database()
+{
+	return DatabaseSession().database();
+}
+
 bool Database::execSql(QString statement)
 {
-	QSqlQuery query(statement, QSqlDatabase::database(SESSION_NAME));
-	if(query.lastError().isValid())
+	DatabaseSession session;
+	if (!session.exec(statement))
 	{
-		exception(tr("Error executing: %1.").arg(query.lastError().text()));
+		exception(session.lastError().message);
 		return false;
 	}
 	return true;
@@ -41,23 +53,17 @@ QString Database::sessionName(const QString & schema)
 
 DbAttach Database::getDatabases()
 {
-	DbAttach ret;
-	QSqlQuery query("PRAGMA database_list;", QSqlDatabase::database(SESSION_NAME));
-
-	if (query.lastError().isValid())
-	{
-		exception(tr("Cannot get databases list. %1").arg(query.lastError().text()));
-		return ret;
-	}
-	while(query.next())
-		ret.insertMulti(query.value(1).toString(), query.value(2).toString());
+	DatabaseSession session;
+	DbAttach ret(session.databases());
+	if (session.failed())
+		exception(session.lastError().message);
 	return ret;
 }
 
 bool Database::dropTable(const QString & table, const QString & schema)
 {
 	QString sql = QString("DROP TABLE \"%1\".\"%2\";").arg(schema).arg(table);
-	QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
+	QSqlQuery query(sql, database());
 	
 	if(query.lastError().isValid())
 	{
@@ -69,162 +75,81 @@ bool Database::dropTable(const QString & table, const QString & schema)
 
 FieldList Database::tableFields(const QString & table, const QString & schema)
 {
-	FieldList fields;
-	QString sql(QString("PRAGMA \"%1\".TABLE_INFO(\"%2\");").arg(schema).arg(table));
-	QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
-	if (query.lastError().isValid())
-	{
-		exception(tr("Error while getting the fileds of %1: %2.").arg(table).arg(query.lastError().text()));
-		return fields;
-	}
-
-	// Build a query string to SELECT the CREATE statement from sqlite_master
-    QString createSQL(QString("SELECT sql FROM %2 WHERE name=\"%1\";").arg(table).arg(getMaster(schema)));
-//    QString createSQL(QString("SELECT sql FROM sqlite_master WHERE name=\"%1\";").arg(table));
-	// Run the query
-	QSqlQuery createQuery(createSQL, QSqlDatabase::database(SESSION_NAME));
-	// Make sure the query ran successfully
-	if(createQuery.lastError().isValid()) {
-		exception(tr("Error grabbing CREATE statement: %1: %2.").arg(table).arg(createQuery.lastError().text()));
-	}
-	// Position the Query on the first (only) result
-	createQuery.first();
-	// Grab the complete CREATE statement
-	QString createStatement = createQuery.value(0).toString();
-	// Reduce the CREATE statement down to just the field info
-	createStatement.replace(QRegExp("CREATE TABLE .* \\((.*)\\).*"), "\\1");
-	// Make a list with all of the individual field statements
-	QStringList params = createStatement.split(QRegExp(","));
-	// Initialize ourselfs a Field Map -- keys and vals are QStrings
-	QHash<QString, QString> fieldMap;
-	// Hashify the params list
-	while(!params.isEmpty())
-	{
-		// e.g. "id INTEGER PRIMARY KEY"
-		QString parameter = params.takeFirst().trimmed();
-		// Tokenize the parameter
-		QStringList words = parameter.split(" ");
-		// Grab the field name
-		QString fieldName = words.takeFirst().remove('"');
-		// Grab the full field type
-		QString fieldType = words.join(" ");
-		// Populate the hash
-		fieldMap[fieldName] = fieldType;
-	}
-
-	while (query.next())
-	{
-		DatabaseTableField field;
-		field.cid = query.value(0).toInt();
-		field.name = query.value(1).toString();
-		field.type = fieldMap[field.name];
-		if (field.type.isNull() || field.type.isEmpty())
-			field.type = "NULL";
-		field.notnull = query.value(3).toBool();
-		field.defval = query.value(4).toString();
-		field.pk = query.value(5).toBool();
-		if (field.pk) {
-			field.type += " PRIMARY KEY";
-			// autoincrement keyword?
-			// adapted from http://stackoverflow.com/questions/16724409/how-to-programmatically-determine-whether-a-column-is-set-to-autoincrement-in-sq
-            QString autoincSql(QString("SELECT 1 FROM %1 WHERE lower(name) = \"%2\" AND sql LIKE '%\"%3\" %4 AUTOINCREMENT%';").arg(getMaster(schema)).arg(table).arg(field.name).arg(field.type));
-//            QString autoincSql(QString("SELECT 1 FROM %1.sqlite_master WHERE lower(name) = \"%2\" AND sql LIKE '%\"%3\" %4 AUTOINCREMENT%';").arg(schema).arg(table).arg(field.name).arg(field.type));
-			QSqlQuery autoincQuery(autoincSql, QSqlDatabase::database(SESSION_NAME));
-			if (!autoincQuery.lastError().isValid() && autoincQuery.first())
-				field.type += " AUTOINCREMENT";
-		}
-		field.comment = "";
-		fields.append(field);
-	}
-
-	return fields;
+	DatabaseSession session;
+	FieldList ret(session.tableFields(table, schema));
+	if (session.failed())
+		exception(session.lastError().message);
+	return ret;
 }
 
 QStringList Database::indexFields(const QString & index, const QString &schema)
 {
-	QString sql(QString("PRAGMA \"%1\".INDEX_INFO(\"%2\");").arg(schema).arg(index));
-	QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
-	QStringList fields;
-
-	if (query.lastError().isValid())
-	{
-        exception(tr("Error while getting the fields of %1: %2.").arg(index).arg(query.lastError().text()));
-		return fields;
-	}
-
-	while (query.next())
-		fields.append(query.value(2).toString());
+	DatabaseSession session;
+	QStringList ret(session.indexFields(index, schema));
+	if (session.failed())
+		exception(session.lastError().message);
+	return ret;
+}
 
-	return fields;
+ForeignKeyList Database::foreignKeys(const QString & table, const QString & schema)
+{
+	DatabaseSession session;
+	ForeignKeyList ret(session.foreignKeys(table, schema));
+	if (session.failed())
+		exception(session.lastError().message);
+	return ret;
 }
 
 DbObjects Database::getObjects(const QString type, const QString schema)
 {
-	DbObjects objs;
-
-	QString sql;
-	if (type.isNull())
-        sql = QString("SELECT lower(name), lower(tbl_name) FROM %1;").arg(getMaster(schema));
-//    sql = QString("SELECT lower(name), lower(tbl_name) FROM \"%1\".sqlite_master;").arg(schema);
-	else
-        sql = QString("SELECT lower(name), lower(tbl_name) FROM %1 WHERE type = '%2' and name not like 'sqlite_%';").arg(getMaster(schema)).arg(type);
-//    sql = QString("SELECT lower(name), lower(tbl_name) FROM \"%1\".sqlite_master WHERE type = '%2' and name not like 'sqlite_%';").arg(schema).arg(type);
-
-	QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
-	while(query.next())
-		objs.insertMulti(query.value(1).toString(), query.value(0).toString());
-
-	if(query.lastError().isValid())
-		exception(tr("Error while the list of %1: %2.").arg(type).arg(query.lastError().text()));
-
-	return objs;
+	DatabaseSession session;
+	DbObjects ret(session.objects(type, schema));
+	if (session.failed())
+		exception(session.lastError().message);
+	return ret;
 }
 
 QStringList Database::getSysIndexes(const QString & table, const QString & schema)
 {
-	QStringList orig = Database::getObjects("index", schema).values(table);
-	// really all indexes
-	QStringList sysIx;
-	QSqlQuery query(QString("PRAGMA \"%1\".index_list(\"%2\");").arg(schema).arg(table),
-					QSqlDatabase::database(SESSION_NAME));
+	DatabaseSession session;
+	QStringList ret(session.sysIndexes(table, schema));
+	if (session.failed())
+		exception(session.lastError().message);
+	return ret;
+}
 
-	QString curr;
-	while(query.next())
-	{
-		curr = query.value(1).toString();
-		if (!orig.contains(curr))
-			sysIx.append(curr);
-	}
+QStringList Database::tableDependentSql(const QString & table, const QString & schema)
+{
+	DatabaseSession session;
+	QStringList ret(session.tableDependentSql(table, schema));
+	if (session.failed())
+		exception(session.lastError().message);
+	return ret;
+}
 
-	if(query.lastError().isValid())
-		exception(tr("Error while the list of the system catalogue: %2.").arg(query.lastError().text()));
+qint64 Database::statRowCount(const QString & table, const QString & schema)
+{
+	return DatabaseSession().statRowCount(table, schema);
+}
 
-	return sysIx;
+bool Database::maxRowid(const QString & table, const QString & schema, qint64 & rowid)
+{
+	return DatabaseSession().maxRowid(table, schema, rowid);
 }
 
 DbObjects Database::getSysObjects(const QString & schema)
 {
-	DbObjects objs;
-
-    QSqlQuery query(QString("SELECT lower(name), lower(tbl_name) FROM %1 WHERE type = 'table' and name like 'sqlite_%';").arg(getMaster(schema)),
-					QSqlDatabase::database(SESSION_NAME));
-//    QSqlQuery query(QString("SELECT lower(name), lower(tbl_name) FROM \"%1\".sqlite_master WHERE type = 'table' and name like 'sqlite_%';").arg(schema),
-//					QSqlDatabase::database(SESSION_NAME));
-
-	objs.insert("sqlite_master", "");
-	while(query.next())
-		objs.insertMulti(query.value(1).toString(), query.value(0).toString());
-
-	if(query.lastError().isValid())
-		exception(tr("Error while the list of the system catalogue: %2.").arg(query.lastError().text()));
-
-	return objs;
+	DatabaseSession session;
+	DbObjects ret(session.sysObjects(schema));
+	if (session.failed())
+		exception(session.lastError().message);
+	return ret;
 }
 
 bool Database::dropView(const QString & view, const QString & schema)
 {
 	QString sql = QString("DROP VIEW \"%1\".\"%2\";").arg(schema).arg(view);
-	QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
+	QSqlQuery query(sql, database());
 	
 	if(query.lastError().isValid())
 	{
@@ -237,7 +162,7 @@ bool Database::dropView(const QString & view, const QString & schema)
 bool Database::dropIndex(const QString & name, const QString & schema)
 {
 	QString sql = QString("DROP INDEX \"%1\".\"%2\"").arg(schema).arg(name);
-	QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
+	QSqlQuery query(sql, database());
 	
 	if(query.lastError().isValid())
 	{
@@ -261,7 +186,7 @@ bool Database::exportSql(const QString & fileName)
 	
 	// Run query for tables
 	QString sql = "SELECT sql FROM sqlite_master;";
-	QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
+	QSqlQuery query(sql, database());
 	
 	if (query.lastError().isValid())
 	{
@@ -316,27 +241,17 @@ bool Database::dumpDatabase(const QString & fileName)
 QString Database::describeObject(const QString & name,
 								 const QString & schema)
 {
-    QString sql("select sql from %1 where lower(name) = \"%2\";");
-    QSqlQuery query(sql.arg(getMaster(schema)).arg(name), QSqlDatabase::database(SESSION_NAME));
-//    QString sql("select sql from \"%1\".sqlite_master where lower(name) = \"%2\";");
-//	QSqlQuery query(sql.arg(schema).arg(name), QSqlDatabase::database(SESSION_NAME));
-	
-	if (query.lastError().isValid())
-	{
-		exception(tr("Error while describe object %1: %2.").arg(name).arg(query.lastError().text()));
-		return "";
-	}
-	
-	while(query.next())
-		return query.value(0).toString();
-	
-	return "";
+	DatabaseSession session;
+	QString ret(session.describeObject(name, schema));
+	if (session.failed())
+		exception(session.lastError().message);
+	return ret;
 }
 
 bool Database::dropTrigger(const QString & name, const QString & schema)
 {
 	QString sql = QString("DROP TRIGGER \"%1\".\"%2\";").arg(schema).arg(name);
-	QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
+	QSqlQuery query(sql, database());
 	
 	if(query.lastError().isValid())
 	{
@@ -364,7 +279,7 @@ QString Database::hex(const QByteArray & val)
 QString Database::pragma(const QString & name)
 {
 	QString statement("PRAGMA main.%1;");
-	QSqlQuery query(statement.arg(name), QSqlDatabase::database(SESSION_NAME));
+	QSqlQuery query(statement.arg(name), database());
 	if (query.lastError().isValid())
 	{
 		exception(tr("Error executing: %1.").arg(query.lastError().text()));
@@ -378,22 +293,10 @@ QString Database::pragma(const QString & name)
 
 sqlite3 * Database::sqlite3handle()
 {
-	QVariant v = QSqlDatabase::database(SESSION_NAME).driver()->handle();
-	if (!v.isValid())
-	{
-		exception(tr("DB driver is not valid"));
-		return 0;
-	}
-	if (qstrcmp(v.typeName(), "sqlite3*") != 0)
-	{
-		exception(tr("DB type name does not equal sqlite3"));
-		return 0;
-	}
-
-	sqlite3 *handle = *static_cast<sqlite3 **>(v.data());
-	if (handle == 0)
-		exception(tr("DB handler is not valid"));
-
+	DatabaseSession session;
+	sqlite3 * handle = session.handle();
+	if (!handle)
+		exception(session.lastError().message);
 	return handle;
 }
 
@@ -434,9 +337,15 @@ QStringList Database::loadExtension(const QStringList & list)
 		else
 			retval.append(f);
 	}
+	DatabaseSession::addExtensions(retval);
 	return retval;
 }
 
+void Database::invalidateCatalog(const QString & schema)
+{
+	DatabaseSession::invalidateCatalog(schema);
+}
+
 QString Database::getMaster(const QString &schema)
 {
     if (schema.compare(QString("temp"),Qt::CaseInsensitive)==0) return QString("sqlite_temp_master");
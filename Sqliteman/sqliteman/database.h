@@ -11,6 +11,7 @@ for which a new license (GPL+exception) is in place.
 #include <QCoreApplication>
 #include <QSqlDatabase>
 #include <QStringList>
+#include <QMap>
 
 #include "sqlite3.h"
 
@@ -41,6 +42,44 @@ typedef QList<DatabaseTableField> FieldList;
 //! \brief A map with "object name"/"its parent" - schema
 typedef QMap<QString,QString> DbObjects;
 
+/*! \brief One sqlite_master row as it is held in the DatabaseCatalog.
+Names are lowercased the same way as getObjects() returns them. */
+typedef struct
+{
+	QString type;
+	QString name;
+	QString tblName;
+	QString sql;
+}
+DatabaseObject;
+
+//! \brief One row of PRAGMA foreign_key_list.
+typedef struct
+{
+	QString table;
+	QString from;
+	QString to;
+}
+DatabaseForeignKey;
+
+//! \brief Foreign keys of a table.
+typedef QList<DatabaseForeignKey> ForeignKeyList;
+
+/*! \brief In-memory copy of the system catalogue of one schema.
+All objects are read by one sqlite_master scan. Per-table details
+(columns, index columns, FKs) are filled on the first request
+only. Everything is thrown away when PRAGMA schema_version
+of the schema changes. */
+typedef struct
+{
+	int version;
+	QList<DatabaseObject> objects;
+	QMap<QString,FieldList> fields;
+	QMap<QString,QStringList> indexFields;
+	QMap<QString,ForeignKeyList> foreignKeys;
+}
+DatabaseCatalog;
+
 
 /*!
  * @brief The database manager
@@ -53,6 +92,8 @@ typedef QMap<QString,QString> DbObjects;
  * Internally, the class uses the QtSQL API for manipulating the database.
  *
  * Almost all methods here are static so it's not needed to create a Database instance.
+ * They report errors to the user by a message box. Use DatabaseSession
+ * outside the GUI thread - it returns the errors instead.
  *
  * \author Igor Khanin
  * \author Petr Vanek <petr@scribus.info>
@@ -62,6 +103,11 @@ class Database
 		Q_DECLARE_TR_FUNCTIONS(Database)
 				
 	public:
+		/*! \brief The connection of the current thread.
+		It's the main connection in the GUI thread. See DatabaseSession.
+		*/
+		static QSqlDatabase database();
+
 		static DbAttach getDatabases();
 
         /*! \brief Gets correct sqlite_master or sqlite_temp_master.
@@ -130,6 +176,37 @@ class Database
 		
 		//! \brief Returns the list of columns in given index
 		static QStringList indexFields(const QString & index, const QString &schema);
+
+		//! \brief Returns the list of foreign keys defined for given table
+		static ForeignKeyList foreignKeys(const QString & table, const QString & schema);
+
+		/*! \brief DDL statements of all indexes and triggers of the table.
+		System indexes (UNIQUE constraints) are skipped as they have no DDL.
+		\param table a table name
+		\param schema a name of the DB schema
+		\retval QStringList with CREATE INDEX/TRIGGER statements
+		*/
+		static QStringList tableDependentSql(const QString & table, const QString & schema);
+
+		/*! \brief Row count of the table from the ANALYZE statistics.
+		It's an estimation only - the table can be changed after ANALYZE.
+		\param table a table name
+		\param schema a name of the DB schema
+		\retval qint64 row count or -1 when there is no sqlite_stat1 entry.
+		*/
+		static qint64 statRowCount(const QString & table, const QString & schema);
+
+		/*! \brief The highest rowid of the table.
+		\retval bool false for an empty table or on error. */
+		static bool maxRowid(const QString & table, const QString & schema, qint64 & rowid);
+
+		/*! \brief Forget the cached catalogue.
+		It has to be called when the schema can point to the other
+		DB file (open, attach, detach) because the schema_version
+		of the new file can be the same as the old one.
+		\param schema a name of the DB schema. All schemas when empty.
+		*/
+		static void invalidateCatalog(const QString & schema = QString());
 		
 		/*!
 		@brief Drop a view from the database
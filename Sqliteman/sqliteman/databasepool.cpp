@@ -0,0 +1,136 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QThread>
+#include <QMutexLocker>
+
+#include "databasepool.h"
+
+
+QMutex DatabasePool::m_mutex;
+QWaitCondition DatabasePool::m_released;
+QList<DatabasePoolSlot> DatabasePool::m_slots;
+
+
+int DatabasePool::readerCount()
+{
+	// one for the GUI and the rest for readers. 2 - 4 readers.
+	return qBound(2, QThread::idealThreadCount() - 1, 4);
+}
+
+void DatabasePool::init()
+{
+	if (!m_slots.isEmpty())
+		return;
+
+	for (int i = 0; i <= readerCount(); ++i)
+	{
+		DatabasePoolSlot s;
+		s.writer = (i == 0);
+		s.name = s.writer ? tr("Writer") : tr("Reader %1").arg(i);
+		s.queued = 0;
+		s.maxQueued = 0;
+		s.leases = 0;
+		s.totalWait = 0;
+		s.maxWait = 0;
+		s.busyTime = 0;
+		m_slots.append(s);
+	}
+}
+
+QList<DatabasePoolSlot> DatabasePool::statistics()
+{
+	QMutexLocker locker(&m_mutex);
+	init();
+	return m_slots;
+}
+
+void DatabasePool::resetStatistics()
+{
+	QMutexLocker locker(&m_mutex);
+	for (int i = 0; i < m_slots.count(); ++i)
+	{
+		m_slots[i].maxQueued = m_slots.at(i).queued;
+		m_slots[i].leases = 0;
+		m_slots[i].totalWait = 0;
+		m_slots[i].maxWait = 0;
+		m_slots[i].busyTime = 0;
+	}
+}
+
+int DatabasePool::acquire(bool writer, const QString & job, int & waited)
+{
+	QTime clock;
+	clock.start();
+
+	QMutexLocker locker(&m_mutex);
+	init();
+
+	int first = writer ? 0 : 1;
+	int last = writer ? 0 : m_slots.count() - 1;
+	int slot = -1;
+	bool queued = false;
+	while (true)
+	{
+		for (int i = first; i <= last && slot == -1; ++i)
+		{
+			if (m_slots.at(i).job.isEmpty())
+				slot = i;
+		}
+		if (slot != -1)
+			break;
+
+		// readers share the queue. The depth is shown for each of them.
+		if (!queued)
+		{
+			queued = true;
+			for (int i = first; i <= last; ++i)
+			{
+				++m_slots[i].queued;
+				m_slots[i].maxQueued = qMax(m_slots.at(i).maxQueued, m_slots.at(i).queued);
+			}
+		}
+		m_released.wait(&m_mutex);
+	}
+
+	if (queued)
+	{
+		for (int i = first; i <= last; ++i)
+			--m_slots[i].queued;
+	}
+
+	waited = clock.elapsed();
+	DatabasePoolSlot & s = m_slots[slot];
+	s.job = job.isEmpty() ? tr("(unnamed)") : job;
+	++s.leases;
+	s.totalWait += waited;
+	s.maxWait = qMax(s.maxWait, waited);
+	return slot;
+}
+
+void DatabasePool::release(int slot, int busy)
+{
+	QMutexLocker locker(&m_mutex);
+	m_slots[slot].job = QString();
+	m_slots[slot].busyTime += busy;
+	m_released.wakeAll();
+}
+
+
+DatabaseLease::DatabaseLease(DatabaseSession::Access access, const QString & job)
+	: m_waited(0)
+{
+	m_slot = DatabasePool::acquire(access == DatabaseSession::ReadWrite, job, m_waited);
+	m_clock.start();
+	m_session = new DatabaseSession(access);
+}
+
+DatabaseLease::~DatabaseLease()
+{
+	delete m_session;
+	DatabasePool::release(m_slot, m_clock.elapsed());
+}
@@ -0,0 +1,122 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef DATABASEPOOL_H
+#define DATABASEPOOL_H
+
+#include <QCoreApplication>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QTime>
+#include <QList>
+
+#include "databasesession.h"
+
+
+/*! \brief Usage statistics of one pool connection.
+See DatabasePool::statistics().
+*/
+typedef struct
+{
+	QString name;
+	bool writer;
+	//! \brief Label of the job holding the connection. Empty when it's free.
+	QString job;
+	//! \brief Jobs waiting now. Readers share one queue.
+	int queued;
+	//! \brief The highest queue length seen.
+	int maxQueued;
+	//! \brief Count of leases of the connection
+	qint64 leases;
+	//! \brief Total time the jobs waited for this connection (ms)
+	qint64 totalWait;
+	//! \brief The longest wait (ms)
+	int maxWait;
+	//! \brief Total time the connection was leased (ms)
+	qint64 busyTime;
+}
+DatabasePoolSlot;
+
+
+/*! \brief Limits of the concurrent background database work.
+There is one writer and readerCount() readers. The editor and
+the data grid use the main connection in the GUI thread directly -
+the writer slot serializes the background jobs which write (imports)
+so they never fight each other for the database lock. Readers
+(exports, counts, statistics) use read-only DatabaseSession
+connections so they are never blocked by the user's uncommitted
+edits in the main connection.
+
+Don't use it directly. Use DatabaseLease.
+*/
+class DatabasePool
+{
+		Q_DECLARE_TR_FUNCTIONS(DatabasePool)
+
+	public:
+		//! \brief Count of reader slots. It's derived from the CPU count.
+		static int readerCount();
+		//! \brief A copy of the current statistics. The writer is the first one.
+		static QList<DatabasePoolSlot> statistics();
+		//! \brief Reset all counters. Current leases and queues stay.
+		static void resetStatistics();
+
+	private:
+		friend class DatabaseLease;
+
+		//! \brief Guards everything below.
+		static QMutex m_mutex;
+		static QWaitCondition m_released;
+		//! \brief The writer is the slot 0.
+		static QList<DatabasePoolSlot> m_slots;
+
+		static void init();
+		/*! \brief Wait for a free slot and occupy it.
+		\param waited a time spent in the queue (ms).
+		\retval int the slot number. */
+		static int acquire(bool writer, const QString & job, int & waited);
+		/*! \brief Return the slot to the pool.
+		\param busy a time the slot was used (ms). */
+		static void release(int slot, int busy);
+};
+
+
+/*! \brief A connection leased from the DatabasePool.
+The constructor blocks until there is a free connection of the
+requested kind. Don't create it in the GUI thread - the GUI would
+freeze while the queue is full. The connection is returned to the
+pool in the destructor.
+
+\code
+DatabaseLease lease(DatabaseSession::ReadOnly, tr("Export %1").arg(table));
+QSqlQuery q(lease.session().select(sql));
+if (lease.session().failed())
+	...
+\endcode
+*/
+class DatabaseLease
+{
+	public:
+		/*! \param access ReadWrite takes the writer slot.
+		\param job a label for the pool statistics. */
+		DatabaseLease(DatabaseSession::Access access, const QString & job);
+		~DatabaseLease();
+
+		DatabaseSession & session() { return *m_session; };
+		//! \brief Time spent in the pool queue (ms)
+		int waited() const { return m_waited; };
+
+	private:
+		Q_DISABLE_COPY(DatabaseLease)
+
+		int m_slot;
+		int m_waited;
+		QTime m_clock;
+		DatabaseSession * m_session;
+};
+
+#endif
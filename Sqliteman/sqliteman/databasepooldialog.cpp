@@ -0,0 +1,81 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QTimer>
+#include <QPushButton>
+
+#include "databasepooldialog.h"
+#include "databasepool.h"
+
+
+DatabasePoolDialog::DatabasePoolDialog(QWidget * parent)
+	: QDialog(parent)
+{
+	ui.setupUi(this);
+
+	DatabaseSession session;
+	sqlite3 * handle = session.handle();
+	QString journal(tr("unknown"));
+	QSqlQuery q(session.select("PRAGMA main.journal_mode;"));
+	if (q.next())
+		journal = q.value(0).toString();
+
+	QString mode(tr("Sqlite %1, journal mode: %2. Readers share their page cache.")
+					.arg(sqlite3_libversion()).arg(journal));
+	if (journal.toLower() == "wal")
+		mode += " " + tr("Readers and the writer do not block each other (WAL).");
+	else if (sqlite3_libversion_number() >= 3007000)
+		mode += " " + tr("Readers block commits of the writer. Use PRAGMA journal_mode=WAL to avoid it.");
+	else
+		mode += " " + tr("Readers block commits of the writer (WAL requires sqlite 3.7.0).");
+	if (handle && sqlite3_get_autocommit(handle) == 0)
+		mode += "\n" + tr("The main connection has an open transaction. Readers do not see its changes.");
+	ui.modeLabel->setText(mode);
+
+	m_timer = new QTimer(this);
+	connect(m_timer, SIGNAL(timeout()), this, SLOT(refresh()));
+	connect(ui.buttonBox, SIGNAL(clicked(QAbstractButton *)),
+			this, SLOT(buttonBox_clicked(QAbstractButton *)));
+	refresh();
+	m_timer->start(500);
+}
+
+void DatabasePoolDialog::refresh()
+{
+	QList<DatabasePoolSlot> slotList(DatabasePool::statistics());
+
+	while (ui.slotTree->topLevelItemCount() > slotList.count())
+		delete ui.slotTree->takeTopLevelItem(ui.slotTree->topLevelItemCount() - 1);
+	while (ui.slotTree->topLevelItemCount() < slotList.count())
+	{
+		QTreeWidgetItem * item = new QTreeWidgetItem(ui.slotTree);
+		for (int i = 2; i < ui.slotTree->columnCount(); ++i)
+			item->setTextAlignment(i, Qt::AlignRight);
+	}
+
+	for (int i = 0; i < slotList.count(); ++i)
+	{
+		const DatabasePoolSlot & s = slotList.at(i);
+		QTreeWidgetItem * item = ui.slotTree->topLevelItem(i);
+		item->setText(0, s.name);
+		item->setText(1, s.job);
+		item->setText(2, QString::number(s.queued));
+		item->setText(3, QString::number(s.maxQueued));
+		item->setText(4, QString::number(s.leases));
+		item->setText(5, s.leases ? QString::number(s.totalWait / s.leases) : QString());
+		item->setText(6, QString::number(s.maxWait));
+		item->setText(7, QString::number(s.busyTime / 1000.0, 'f', 1));
+	}
+}
+
+void DatabasePoolDialog::buttonBox_clicked(QAbstractButton * button)
+{
+	if (ui.buttonBox->standardButton(button) != QDialogButtonBox::Reset)
+		return;
+	DatabasePool::resetStatistics();
+	refresh();
+}
@@ -0,0 +1,40 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef DATABASEPOOLDIALOG_H
+#define DATABASEPOOLDIALOG_H
+
+#include <QDialog>
+
+#include "ui_databasepooldialog.h"
+
+class QTimer;
+class QAbstractButton;
+
+
+/*! \brief Live view of the DatabasePool usage.
+Queue depth and wait times of each background connection. The state
+of the main connection is shown too - its open transaction is the usual
+reason for waiting writers.
+*/
+class DatabasePoolDialog : public QDialog
+{
+	Q_OBJECT
+
+	public:
+		DatabasePoolDialog(QWidget * parent = 0);
+
+	private:
+		Ui::DatabasePoolDialog ui;
+		QTimer * m_timer;
+
+	private slots:
+		void refresh();
+		void buttonBox_clicked(QAbstractButton * button);
+};
+
+#endif
@@ -0,0 +1,655 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QSqlDriver>
+#include <QThread>
+#include <QThreadStorage>
+#include <QMutexLocker>
+#include <QAtomicInt>
+#include <QVariant>
+#include <QRegExp>
+#include <QHash>
+
+#include "databasesession.h"
+
+#ifdef INTERNAL_SQLDRIVER
+#include "driver/qsql_sqlite.h"
+#endif
+
+
+/*! \brief Connection of one non-GUI thread.
+It's owned by the QThreadStorage so it's destroyed (and the
+connection is removed) in its own thread when the thread finishes.
+*/
+class DatabaseThreadConnection
+{
+	public:
+		DatabaseThreadConnection(const QString & name, int generation)
+			: name(name),
+			  generation(generation)
+		{
+		}
+
+		~DatabaseThreadConnection()
+		{
+			{
+				QSqlDatabase db = QSqlDatabase::database(name, false);
+				if (db.isOpen())
+				{
+					db.rollback();
+					db.close();
+				}
+			}
+			QSqlDatabase::removeDatabase(name);
+		}
+
+		QString name;
+		int generation;
+};
+
+static QThreadStorage<DatabaseThreadConnection*> threadConnections;
+static QThreadStorage<DatabaseThreadConnection*> threadReaders;
+static QThreadStorage<DatabaseThreadConnection*> threadPrivateReaders;
+static QAtomicInt threadConnectionCount(0);
+
+QMutex DatabaseSession::m_sourceMutex;
+DbAttach DatabaseSession::m_databases;
+QStringList DatabaseSession::m_extensions;
+int DatabaseSession::m_generation = 0;
+QMutex DatabaseSession::m_openMutex;
+QMutex DatabaseSession::m_catalogMutex;
+QMap<QString,DatabaseCatalog> DatabaseSession::m_catalog;
+
+
+DatabaseSession::DatabaseSession(Access access)
+{
+	clearError();
+	if (access == ReadWrite && isGuiThread())
+		m_db = QSqlDatabase::database(SESSION_NAME);
+	else
+		m_db = threadDatabase(access);
+}
+
+bool DatabaseSession::isGuiThread()
+{
+	return QCoreApplication::instance()
+			&& QThread::currentThread() == QCoreApplication::instance()->thread();
+}
+
+void DatabaseSession::setDatabases(const DbAttach & databases, bool newFile)
+{
+	QMutexLocker locker(&m_sourceMutex);
+	m_databases = databases;
+	if (newFile)
+		m_extensions.clear();
+	++m_generation;
+}
+
+void DatabaseSession::addExtensions(const QStringList & list)
+{
+	if (list.isEmpty())
+		return;
+	QMutexLocker locker(&m_sourceMutex);
+	m_extensions += list;
+	++m_generation;
+}
+
+QSqlDatabase DatabaseSession::threadDatabase(Access access)
+{
+	QMutexLocker locker(&m_sourceMutex);
+	DbAttach databases(m_databases);
+	QStringList extensions(m_extensions);
+	int generation = m_generation;
+	locker.unlock();
+
+	QThreadStorage<DatabaseThreadConnection*> & storage
+			= (access == ReadOnly) ? threadReaders
+			  : (access == PrivateReadOnly) ? threadPrivateReaders : threadConnections;
+	DatabaseThreadConnection * current = storage.localData();
+	if (current && current->generation == generation)
+		return QSqlDatabase::database(current->name);
+	// the old connection is deleted
+	storage.setLocalData(0);
+
+	QString mainFile(databases.value("main"));
+	if (mainFile.isEmpty())
+	{
+		setError(tr("No database is open"), QSqlError());
+		return QSqlDatabase();
+	}
+	if (mainFile == ":memory:")
+	{
+		setError(tr("In-memory database cannot be shared with other connection"), QSqlError());
+		return QSqlDatabase();
+	}
+
+	QString name(QString("%1-%2-%3").arg(SESSION_NAME)
+					.arg(access == ReadOnly ? "reader" : (access == PrivateReadOnly ? "private" : "thread"))
+					.arg(threadConnectionCount.fetchAndAddOrdered(1)));
+	DatabaseThreadConnection * connection = new DatabaseThreadConnection(name, generation);
+	storage.setLocalData(connection);
+
+#ifdef INTERNAL_SQLDRIVER
+	QSqlDatabase db = QSqlDatabase::addDatabase(new QSQLiteDriver(), name);
+#else
+	QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+#endif
+	db.setDatabaseName(mainFile);
+	// the GUI connection can hold a write lock for a while
+	if (access == ReadOnly)
+		db.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_ENABLE_SHARED_CACHE;QSQLITE_BUSY_TIMEOUT=5000");
+	else if (access == PrivateReadOnly)
+		db.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000");
+	else
+		db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+	// the attached files are opened in the same (shared or private) cache
+	QMutexLocker openLocker(&m_openMutex);
+	// the driver turns the shared cache on for the readers only
+	sqlite3_enable_shared_cache(0);
+	bool ok = db.open();
+	if (!ok)
+		setError(tr("Cannot open database %1: %2").arg(mainFile).arg(db.lastError().text()),
+				 db.lastError());
+
+	QMapIterator<QString,QString> it(databases);
+	while (ok && it.hasNext())
+	{
+		it.next();
+		if (it.key() == "main" || it.key() == "temp")
+			continue;
+		QString sql(QString("ATTACH DATABASE '%1' AS \"%2\";")
+						.arg(QString(it.value()).replace('\'', "''"))
+						.arg(it.key()));
+		QSqlQuery query(sql, db);
+		if (query.lastError().isValid())
+		{
+			setError(tr("Cannot attach database %1: %2").arg(it.value()).arg(query.lastError().text()),
+					 query.lastError(), sql);
+			ok = false;
+		}
+	}
+	// readers only can share the cache. A writer in the shared
+	// cache would lock tables for them.
+	sqlite3_enable_shared_cache(0);
+	openLocker.unlock();
+
+	if (!ok)
+	{
+		// try it again next time
+		db = QSqlDatabase();
+		storage.setLocalData(0);
+		return QSqlDatabase();
+	}
+
+	// extension functions can be used by the jobs too.
+	// Failures are ignored - the statement using it fails later
+	if (!extensions.isEmpty())
+	{
+		m_db = db;
+		sqlite3 * h = handle();
+		if (h && sqlite3_enable_load_extension(h, 1) == SQLITE_OK)
+		{
+			foreach (QString f, extensions)
+				sqlite3_load_extension(h, f.toUtf8().data(), 0, 0);
+		}
+		clearError();
+	}
+
+	return db;
+}
+
+void DatabaseSession::setError(const QString & message, const QSqlError & error,
+							   const QString & statement)
+{
+	m_error.message = message;
+	m_error.statement = statement;
+	m_error.code = error.number();
+}
+
+void DatabaseSession::clearError()
+{
+	m_error.message = QString();
+	m_error.statement = QString();
+	m_error.code = -1;
+}
+
+bool DatabaseSession::exec(const QString & statement)
+{
+	clearError();
+	QSqlQuery query(statement, m_db);
+	if (query.lastError().isValid())
+	{
+		setError(tr("Error executing: %1.").arg(query.lastError().text()),
+				 query.lastError(), statement);
+		return false;
+	}
+	return true;
+}
+
+bool DatabaseSession::exec(QSqlQuery & query)
+{
+	clearError();
+	if (!query.exec())
+	{
+		setError(tr("Error executing: %1.").arg(query.lastError().text()),
+				 query.lastError(), query.lastQuery());
+		return false;
+	}
+	return true;
+}
+
+QSqlQuery DatabaseSession::select(const QString & statement)
+{
+	clearError();
+	QSqlQuery query(m_db);
+	query.setForwardOnly(true);
+	if (!query.exec(statement))
+		setError(tr("Error executing: %1.").arg(query.lastError().text()),
+				 query.lastError(), statement);
+	return query;
+}
+
+bool DatabaseSession::transaction()
+{
+	clearError();
+	if (!m_db.transaction())
+	{
+		setError(tr("Cannot begin transaction: %1.").arg(m_db.lastError().text()), m_db.lastError());
+		return false;
+	}
+	return true;
+}
+
+bool DatabaseSession::commit()
+{
+	clearError();
+	if (!m_db.commit())
+	{
+		setError(tr("Cannot commit transaction: %1.").arg(m_db.lastError().text()), m_db.lastError());
+		return false;
+	}
+	return true;
+}
+
+bool DatabaseSession::rollback()
+{
+	clearError();
+	if (!m_db.rollback())
+	{
+		setError(tr("Cannot rollback transaction: %1.").arg(m_db.lastError().text()), m_db.lastError());
+		return false;
+	}
+	return true;
+}
+
+sqlite3 * DatabaseSession::handle()
+{
+	clearError();
+	if (!m_db.isValid())
+	{
+		setError(tr("DB driver is not valid"), QSqlError());
+		return 0;
+	}
+	QVariant v = m_db.driver()->handle();
+	if (!v.isValid())
+	{
+		setError(tr("DB driver is not valid"), QSqlError());
+		return 0;
+	}
+	if (qstrcmp(v.typeName(), "sqlite3*") != 0)
+	{
+		setError(tr("DB type name does not equal sqlite3"), QSqlError());
+		return 0;
+	}
+
+	sqlite3 *handle = *static_cast<sqlite3 **>(v.data());
+	if (handle == 0)
+		setError(tr("DB handler is not valid"), QSqlError());
+
+	return handle;
+}
+
+DbAttach DatabaseSession::databases()
+{
+	clearError();
+	DbAttach ret;
+	QSqlQuery query("PRAGMA database_list;", m_db);
+
+	if (query.lastError().isValid())
+	{
+		setError(tr("Cannot get databases list. %1").arg(query.lastError().text()), query.lastError());
+		return ret;
+	}
+	while(query.next())
+		ret.insertMulti(query.value(1).toString(), query.value(2).toString());
+	return ret;
+}
+
+FieldList DatabaseSession::tableFields(const QString & table, const QString & schema)
+{
+	DatabaseCatalog cat(catalog(schema));
+	QString key(table.toLower());
+	if (cat.fields.contains(key))
+		return cat.fields.value(key);
+
+	FieldList fields;
+	QString sql(QString("PRAGMA \"%1\".TABLE_INFO(\"%2\");").arg(schema).arg(table));
+	QSqlQuery query(sql, m_db);
+	if (query.lastError().isValid())
+	{
+		setError(tr("Error while getting the fileds of %1: %2.").arg(table).arg(query.lastError().text()),
+				 query.lastError(), sql);
+		return fields;
+	}
+
+	// Grab the complete CREATE statement from the catalogue
+	QString createStatement;
+	foreach (DatabaseObject obj, cat.objects)
+	{
+		if (obj.name == key)
+		{
+			createStatement = obj.sql;
+			break;
+		}
+	}
+	QString createSource(createStatement);
+	// Reduce the CREATE statement down to just the field info
+	createStatement.replace(QRegExp("CREATE TABLE .* \\((.*)\\).*"), "\\1");
+	// Make a list with all of the individual field statements
+	QStringList params = createStatement.split(QRegExp(","));
+	// Initialize ourselfs a Field Map -- keys and vals are QStrings
+	QHash<QString, QString> fieldMap;
+	// Hashify the params list
+	while(!params.isEmpty())
+	{
+		// e.g. "id INTEGER PRIMARY KEY"
+		QString parameter = params.takeFirst().trimmed();
+		// Tokenize the parameter
+		QStringList words = parameter.split(" ");
+		// Grab the field name
+		QString fieldName = words.takeFirst().remove('"');
+		// Grab the full field type
+		QString fieldType = words.join(" ");
+		// Populate the hash
+		fieldMap[fieldName] = fieldType;
+	}
+
+	while (query.next())
+	{
+		DatabaseTableField field;
+		field.cid = query.value(0).toInt();
+		field.name = query.value(1).toString();
+		field.type = fieldMap[field.name];
+		if (field.type.isNull() || field.type.isEmpty())
+			field.type = "NULL";
+		field.notnull = query.value(3).toBool();
+		field.defval = query.value(4).toString();
+		field.pk = query.value(5).toBool();
+		if (field.pk) {
+			field.type += " PRIMARY KEY";
+			// autoincrement keyword?
+			// adapted from http://stackoverflow.com/questions/16724409/how-to-programmatically-determine-whether-a-column-is-set-to-autoincrement-in-sq
+			// It's checked against the cached CREATE statement instead of
+			// the "sql LIKE '%"col" type AUTOINCREMENT%'" query.
+			if (createSource.contains(QString("\"%1\" %2 AUTOINCREMENT").arg(field.name).arg(field.type),
+									  Qt::CaseInsensitive))
+				field.type += " AUTOINCREMENT";
+		}
+		field.comment = "";
+		fields.append(field);
+	}
+
+	// the catalogue can be reloaded by other thread meanwhile
+	QMutexLocker locker(&m_catalogMutex);
+	QMap<QString,DatabaseCatalog>::iterator it = m_catalog.find(catalogKey(schema));
+	if (it != m_catalog.end() && it.value().version == cat.version)
+		it.value().fields.insert(key, fields);
+	return fields;
+}
+
+QStringList DatabaseSession::indexFields(const QString & index, const QString & schema)
+{
+	DatabaseCatalog cat(catalog(schema));
+	QString key(index.toLower());
+	if (cat.indexFields.contains(key))
+		return cat.indexFields.value(key);
+
+	QString sql(QString("PRAGMA \"%1\".INDEX_INFO(\"%2\");").arg(schema).arg(index));
+	QSqlQuery query(sql, m_db);
+	QStringList fields;
+
+	if (query.lastError().isValid())
+	{
+		setError(tr("Error while getting the fields of %1: %2.").arg(index).arg(query.lastError().text()),
+				 query.lastError(), sql);
+		return fields;
+	}
+
+	while (query.next())
+		fields.append(query.value(2).toString());
+
+	QMutexLocker locker(&m_catalogMutex);
+	QMap<QString,DatabaseCatalog>::iterator it = m_catalog.find(catalogKey(schema));
+	if (it != m_catalog.end() && it.value().version == cat.version)
+		it.value().indexFields.insert(key, fields);
+	return fields;
+}
+
+ForeignKeyList DatabaseSession::foreignKeys(const QString & table, const QString & schema)
+{
+	DatabaseCatalog cat(catalog(schema));
+	QString key(table.toLower());
+	if (cat.foreignKeys.contains(key))
+		return cat.foreignKeys.value(key);
+
+	QString sql(QString("PRAGMA \"%1\".foreign_key_list(\"%2\");").arg(schema).arg(table));
+	QSqlQuery query(sql, m_db);
+	ForeignKeyList fks;
+
+	if (query.lastError().isValid())
+	{
+		setError(tr("Error while getting the foreign keys of %1: %2.").arg(table).arg(query.lastError().text()),
+				 query.lastError(), sql);
+		return fks;
+	}
+
+	// 2 - table - FK table; 3 - from - column name; 4 - to - fk column name
+	while (query.next())
+	{
+		DatabaseForeignKey fk;
+		fk.table = query.value(2).toString();
+		fk.from = query.value(3).toString();
+		fk.to = query.value(4).toString();
+		fks.append(fk);
+	}
+
+	QMutexLocker locker(&m_catalogMutex);
+	QMap<QString,DatabaseCatalog>::iterator it = m_catalog.find(catalogKey(schema));
+	if (it != m_catalog.end() && it.value().version == cat.version)
+		it.value().foreignKeys.insert(key, fks);
+	return fks;
+}
+
+DbObjects DatabaseSession::objects(const QString & type, const QString & schema)
+{
+	DbObjects objs;
+
+	foreach (DatabaseObject obj, catalog(schema).objects)
+	{
+		if (type.isNull())
+			objs.insertMulti(obj.tblName, obj.name);
+		else if (obj.type == type && !obj.name.startsWith("sqlite_"))
+			objs.insertMulti(obj.tblName, obj.name);
+	}
+
+	return objs;
+}
+
+QStringList DatabaseSession::sysIndexes(const QString & table, const QString & schema)
+{
+	// System indexes are stored in the sqlite_master too - with NULL sql
+	// and reserved "sqlite_autoindex_" prefix.
+	QString tbl(table.toLower());
+	QStringList sysIx;
+
+	foreach (DatabaseObject obj, catalog(schema).objects)
+	{
+		if (obj.type == "index" && obj.tblName == tbl && obj.name.startsWith("sqlite_"))
+			sysIx.append(obj.name);
+	}
+
+	return sysIx;
+}
+
+DbObjects DatabaseSession::sysObjects(const QString & schema)
+{
+	DbObjects objs;
+
+	objs.insert("sqlite_master", "");
+	foreach (DatabaseObject obj, catalog(schema).objects)
+	{
+		if (obj.type == "table" && obj.name.startsWith("sqlite_"))
+			objs.insertMulti(obj.tblName, obj.name);
+	}
+
+	return objs;
+}
+
+QStringList DatabaseSession::tableDependentSql(const QString & table, const QString & schema)
+{
+	QString tbl(table.toLower());
+	QStringList ret;
+
+	foreach (DatabaseObject obj, catalog(schema).objects)
+	{
+		if ((obj.type == "index" || obj.type == "trigger")
+			&& obj.tblName == tbl && !obj.sql.isEmpty())
+			ret.append(obj.sql);
+	}
+
+	return ret;
+}
+
+QString DatabaseSession::describeObject(const QString & name, const QString & schema)
+{
+	QString key(name.toLower());
+	foreach (DatabaseObject obj, catalog(schema).objects)
+	{
+		if (obj.name == key)
+			return obj.sql;
+	}
+	return "";
+}
+
+qint64 DatabaseSession::statRowCount(const QString & table, const QString & schema)
+{
+	// no ANALYZE yet
+	if (!sysObjects(schema).contains("sqlite_stat1"))
+		return -1;
+
+	QSqlQuery query(m_db);
+	query.prepare(QString("SELECT stat FROM \"%1\".sqlite_stat1 WHERE lower(tbl) = ?;").arg(schema));
+	query.addBindValue(table.toLower());
+	if (!query.exec())
+		return -1;
+
+	// the first number of the "stat" is the count of table rows
+	qint64 ret = -1;
+	while (query.next())
+	{
+		bool ok;
+		qint64 rows = query.value(0).toString().section(' ', 0, 0).toLongLong(&ok);
+		if (ok && rows > ret)
+			ret = rows;
+	}
+	return ret;
+}
+
+bool DatabaseSession::maxRowid(const QString & table, const QString & schema, qint64 & rowid)
+{
+	// it's a lookup of the last b-tree entry - not a scan
+	QSqlQuery query(QString("SELECT max(rowid) FROM \"%1\".\"%2\";").arg(schema).arg(table), m_db);
+	if (!query.next() || query.value(0).isNull())
+		return false;
+	rowid = query.value(0).toLongLong();
+	return true;
+}
+
+int DatabaseSession::schemaVersion(const QString & schema)
+{
+	QSqlQuery query(QString("PRAGMA \"%1\".schema_version;").arg(schema), m_db);
+	if (query.lastError().isValid() || !query.next())
+		return -1;
+	return query.value(0).toInt();
+}
+
+QString DatabaseSession::catalogKey(const QString & schema) const
+{
+	QString key(schema.toLower());
+	if (key == "temp")
+		return m_db.connectionName() + ".temp";
+	return key;
+}
+
+void DatabaseSession::invalidateCatalog(const QString & schema)
+{
+	QMutexLocker locker(&m_catalogMutex);
+	if (schema.isEmpty())
+		m_catalog.clear();
+	else if (schema.toLower() == "temp")
+	{
+		foreach (QString key, m_catalog.keys())
+		{
+			if (key.endsWith(".temp"))
+				m_catalog.remove(key);
+		}
+	}
+	else
+		m_catalog.remove(schema.toLower());
+}
+
+DatabaseCatalog DatabaseSession::catalog(const QString & schema)
+{
+	clearError();
+	QString key(catalogKey(schema));
+	int version = schemaVersion(schema);
+
+	{
+		QMutexLocker locker(&m_catalogMutex);
+		QMap<QString,DatabaseCatalog>::const_iterator it = m_catalog.constFind(key);
+		if (it != m_catalog.constEnd() && version != -1 && it.value().version == version)
+			return it.value();
+	}
+
+	DatabaseCatalog cat;
+	cat.version = version;
+
+	QSqlQuery query(QString("SELECT type, lower(name), lower(tbl_name), sql FROM %1;")
+						.arg(Database::getMaster(schema)),
+					m_db);
+	while (query.next())
+	{
+		DatabaseObject obj;
+		obj.type = query.value(0).toString();
+		obj.name = query.value(1).toString();
+		obj.tblName = query.value(2).toString();
+		obj.sql = query.value(3).toString();
+		cat.objects.append(obj);
+	}
+
+	if (query.lastError().isValid())
+	{
+		setError(tr("Error while reading the system catalogue: %1.").arg(query.lastError().text()),
+				 query.lastError());
+		// do not remember the broken state
+		cat.version = -1;
+	}
+
+	QMutexLocker locker(&m_catalogMutex);
+	m_catalog.insert(key, cat);
+	return cat;
+}
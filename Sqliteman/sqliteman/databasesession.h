@@ -0,0 +1,187 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef DATABASESESSION_H
+#define DATABASESESSION_H
+
+#include <QCoreApplication>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QMutex>
+#include <QMetaType>
+
+#include "database.h"
+
+
+/*! \brief Error of the last DatabaseSession call.
+It's filled instead of the message box which is used by
+the static Database methods.
+*/
+typedef struct
+{
+	//! \brief Text for the user. Empty when there is no error.
+	QString message;
+	//! \brief Statement which failed (if any)
+	QString statement;
+	//! \brief Error number reported by the driver (sqlite3 result code) or -1
+	int code;
+}
+DatabaseError;
+
+Q_DECLARE_METATYPE(DatabaseError)
+
+
+/*! \brief Database access which can be used from any thread.
+The session uses the connection of the thread which creates it:
+ - the GUI thread uses the main connection (SESSION_NAME) as
+   the static Database methods do.
+ - any other thread gets its own connection to the same database
+   files (main and attached ones) with the same extensions loaded.
+   It's opened on the first use and closed when the thread finishes.
+   It's reopened when the GUI opens, attaches or detaches a database.
+A session object must not be passed between threads. Create it
+in the thread which uses it (it's cheap).
+
+ReadOnly sessions use a separate read-only connection of the thread
+(in the GUI thread too). They see committed data only so they are
+not blocked by an open transaction of the main connection. Readers
+share one page cache (sqlite shared cache). With sqlite 3.7.0+ and
+a WAL database they do not block the writer at all. See DatabaseLease
+for limiting count of the concurrent readers. PrivateReadOnly sessions
+are the same with their own page cache - the shared cache serializes
+the b-tree access of the readers so parallel scans need their own.
+
+Errors are never reported to the user here. Check failed() and
+lastError() after each call - the background jobs send the error
+to the GUI themselves.
+
+The system catalogue cache is shared by all sessions (and by the
+static Database methods). TEMP objects are cached per connection.
+*/
+class DatabaseSession
+{
+		Q_DECLARE_TR_FUNCTIONS(DatabaseSession)
+
+	public:
+		enum Access
+		{
+			ReadWrite,
+			ReadOnly,
+			//! \brief ReadOnly without the shared cache
+			PrivateReadOnly
+		};
+
+		DatabaseSession(Access access = ReadWrite);
+
+		/*! \brief Set the database files for the thread connections.
+		It has to be called in the GUI thread when the main connection
+		changes. Thread connections are reopened on their next use.
+		\param databases "name - file" map from Database::getDatabases().
+		\param newFile true when the main file is changed. Extensions
+		       from addExtensions() are forgotten then.
+		*/
+		static void setDatabases(const DbAttach & databases, bool newFile = false);
+		//! \brief Extensions to load into the thread connections.
+		static void addExtensions(const QStringList & list);
+		//! \brief True in the thread owning the main connection.
+		static bool isGuiThread();
+		/*! \brief Hold it while opening any sqlite connection or attaching
+		a database to it. sqlite3_enable_shared_cache() is process wide and
+		the readers turn it on for their own open and ATTACH only. It's
+		off otherwise so no other connection joins the shared cache. */
+		static QMutex * openMutex() { return &m_openMutex; };
+
+		/*! \brief Forget the cached catalogue.
+		\param schema a name of the DB schema. All schemas when empty.
+		*/
+		static void invalidateCatalog(const QString & schema = QString());
+
+		//! \brief The connection of this session. It's invalid when it cannot be opened.
+		QSqlDatabase database() const { return m_db; };
+		//! \brief True when the last call failed. See lastError().
+		bool failed() const { return !m_error.message.isEmpty(); };
+		DatabaseError lastError() const { return m_error; };
+
+		/*! \brief Execute a statement with no results.
+		\retval bool false on error. See lastError(). */
+		bool exec(const QString & statement);
+		/*! \brief Execute a prepared query of this session.
+		\retval bool false on error. See lastError(). */
+		bool exec(QSqlQuery & query);
+		/*! \brief Run a statement and return its query positioned
+		before the first row. Check failed() before reading. */
+		QSqlQuery select(const QString & statement);
+		//! \brief Empty query of this connection for prepare().
+		QSqlQuery query() const { return QSqlQuery(m_db); };
+
+		bool transaction();
+		bool commit();
+		bool rollback();
+
+		/*! \brief Native handle of the session connection.
+		\retval sqlite3* handle or 0 on error. */
+		sqlite3 * handle();
+
+		//! \brief List of the attached databases. See Database::getDatabases().
+		DbAttach databases();
+		//! \brief See Database::getObjects().
+		DbObjects objects(const QString & type = QString(), const QString & schema = "main");
+		//! \brief See Database::getSysObjects().
+		DbObjects sysObjects(const QString & schema = "main");
+		//! \brief See Database::getSysIndexes().
+		QStringList sysIndexes(const QString & table, const QString & schema);
+		//! \brief See Database::tableFields().
+		FieldList tableFields(const QString & table, const QString & schema);
+		//! \brief See Database::indexFields().
+		QStringList indexFields(const QString & index, const QString & schema);
+		//! \brief See Database::foreignKeys().
+		ForeignKeyList foreignKeys(const QString & table, const QString & schema);
+		//! \brief See Database::tableDependentSql().
+		QStringList tableDependentSql(const QString & table, const QString & schema);
+		//! \brief See Database::describeObject().
+		QString describeObject(const QString & name, const QString & schema = "main");
+		//! \brief See Database::statRowCount().
+		qint64 statRowCount(const QString & table, const QString & schema);
+		//! \brief See Database::maxRowid().
+		bool maxRowid(const QString & table, const QString & schema, qint64 & rowid);
+
+	private:
+		QSqlDatabase m_db;
+		DatabaseError m_error;
+
+		//! \brief Guards m_databases, m_extensions and m_generation.
+		static QMutex m_sourceMutex;
+		static DbAttach m_databases;
+		static QStringList m_extensions;
+		//! \brief Incremented on any source change. Thread connections compare it.
+		static int m_generation;
+
+		static QMutex m_openMutex;
+		//! \brief Guards m_catalog.
+		static QMutex m_catalogMutex;
+		//! \brief Cached catalogues. See catalogKey().
+		static QMap<QString,DatabaseCatalog> m_catalog;
+
+		//! \brief Get (and open if needed) the connection of the current thread.
+		QSqlDatabase threadDatabase(Access access);
+		//! \brief Set m_error. Code and text are taken from the driver error.
+		void setError(const QString & message, const QSqlError & error,
+					  const QString & statement = QString());
+		void clearError();
+
+		//! \brief Lowercased schema name. TEMP schema is unique for each connection.
+		QString catalogKey(const QString & schema) const;
+		/*! \brief Get a copy of the catalogue of the schema.
+		It's reloaded only when its PRAGMA schema_version differs from
+		the cached one. */
+		DatabaseCatalog catalog(const QString & schema);
+		//! \brief PRAGMA schema_version of the schema or -1 on error.
+		int schemaVersion(const QString & schema);
+};
+
+#endif
@@ -17,11 +17,20 @@ for which a new license (GPL+exception) is in place.
 #include <QCompleter>
 #include <QDirModel>
 #include <QSqlQueryModel>
+#include <QBuffer>
+#include <QTime>
+#include <QRegExp>
 
 #include "dataviewer.h"
 #include "dataexportdialog.h"
-#include "database.h"
+#include "dataexporter.h"
+#include "dataexportworker.h"
+#include "parallelexport.h"
+#include "gzipdevice.h"
+#include "sqlmodels.h"
+#include "sqlresultmodel.h"
 #include "preferences.h"
+#include "database.h"
 
 #define LF QChar(0x0A)  /* '\n' */
 #define CR QChar(0x0D)  /* '\r' */
@@ -32,11 +41,48 @@ DataExportDialog::DataExportDialog(DataViewer * parent, const QString & tableNam
 		m_tableName(tableName),
 		file(0)
 {
-	Preferences * prefs = Preferences::instance();
-
 	m_data = parent->tableData();
+	m_result = qobject_cast<SqlResultModel*>(m_data);
 	m_header = parent->tableHeader();
+
+	// the same data for the DataExportWorker
+	SqlTableModel * table = qobject_cast<SqlTableModel*>(m_data);
+	QSqlQueryModel * query = qobject_cast<QSqlQueryModel*>(m_data);
+	if (m_result)
+		m_query = m_result->query();
+	else if (table)
+	{
+		m_query = table->exportStatement();
+		m_ddlSchema = table->schema();
+		m_ddlTable = table->tableName();
+		if (table->naturalOrder())
+		{
+			m_schema = table->schema();
+			m_table = table->tableName();
+		}
+	}
+	else if (query)
+		m_query = query->query().lastQuery();
+
+	init();
+}
+
+DataExportDialog::DataExportDialog(const QString & query, QWidget * parent) :
+		QDialog(parent),
+		m_tableName("<any_table>"),
+		m_data(0),
+		m_result(0),
+		m_query(query),
+		file(0)
+{
+	init();
+}
+
+void DataExportDialog::init()
+{
+	Preferences * prefs = Preferences::instance();
 	cancelled = false;
+	progress = 0;
 
 	ui.setupUi(this);
 	formats[tr("Comma Separated Values (CSV)")] = "csv";
@@ -46,8 +92,13 @@ DataExportDialog::DataExportDialog(DataViewer * parent, const QString & tableNam
 	formats[tr("Python List")] = "py";
 	formats[tr("Qore \"select\" hash")] = "qore_select";
 	formats[tr("Qore \"selectRows\" hash")] = "qore_selectRows";
+	formats[tr("Apache Arrow IPC Stream")] = "arrow";
+	formats[tr("JSON Array")] = "json";
+	formats[tr("JSON Lines (NDJSON)")] = "jsonl";
 	ui.formatBox->addItems(formats.keys());
-	ui.formatBox->setCurrentIndex(prefs->exportFormat());
+	// the names are sorted. Their index changes with new formats.
+	int formatIx = ui.formatBox->findText(formats.key(prefs->exportFormat()));
+	ui.formatBox->setCurrentIndex(formatIx == -1 ? ui.formatBox->findText(formats.key("csv")) : formatIx);
 
 	ui.lineEndBox->addItem("UNIX (lf)");
 	ui.lineEndBox->addItem("Macintosh (cr)");
@@ -64,8 +115,17 @@ DataExportDialog::DataExportDialog(DataViewer * parent, const QString & tableNam
 	ui.fileButton->setChecked(prefs->exportDestination() == 0);
 	ui.clipboardButton->setChecked(prefs->exportDestination() == 1);
 	ui.headerCheckBox->setChecked(prefs->exportHeaders());
+	ui.gzipCheckBox->setChecked(prefs->exportGzip());
+	ui.batchSizeBox->setValue(prefs->exportBatchRows());
+	// the order of DataExporter::SqlInserts
+	ui.sqlInsertsBox->addItem(tr("One per Row"));
+	ui.sqlInsertsBox->addItem(tr("Multi-row VALUES"));
+	ui.sqlInsertsBox->addItem(tr("UNION ALL Selects"));
+	ui.sqlInsertsBox->setCurrentIndex(prefs->exportSqlInserts());
+	ui.sqlSchemaCheckBox->setChecked(prefs->exportSqlSchema());
 
 	fileButton_toggled(prefs->exportDestination() == 0);
+	formatBox_currentIndexChanged(ui.formatBox->currentIndex());
 
 	QCompleter *completer = new QCompleter(this);
 	completer->setModel(new QDirModel(completer));
@@ -79,6 +139,10 @@ DataExportDialog::DataExportDialog(DataViewer * parent, const QString & tableNam
 			this, SLOT(fileEdit_textChanged(const QString &)));
 	connect(ui.searchButton, SIGNAL(clicked()),
 			this, SLOT(searchButton_clicked()));
+	connect(ui.formatBox, SIGNAL(currentIndexChanged(int)),
+			this, SLOT(formatBox_currentIndexChanged(int)));
+	connect(ui.sqlInsertsBox, SIGNAL(currentIndexChanged(int)),
+			this, SLOT(formatBox_currentIndexChanged(int)));
 	connect(ui.buttonBox, SIGNAL(accepted()),
 			this, SLOT(slotAccepted()));
 }
@@ -86,11 +150,15 @@ DataExportDialog::DataExportDialog(DataViewer * parent, const QString & tableNam
 void DataExportDialog::slotAccepted()
 {
 	Preferences * prefs = Preferences::instance();
-	prefs->setExportFormat(ui.formatBox->currentIndex());
+	prefs->setExportFormat(formats[ui.formatBox->currentText()]);
 	prefs->setExportDestination(ui.fileButton->isChecked() ? 0 : 1);
 	prefs->setExportHeaders(ui.headerCheckBox->isChecked());
 	prefs->setExportEncoding(ui.encodingBox->currentText());
 	prefs->setExportEol(ui.lineEndBox->currentIndex());
+	prefs->setExportGzip(ui.gzipCheckBox->isChecked());
+	prefs->setExportBatchRows(ui.batchSizeBox->value());
+	prefs->setExportSqlInserts(ui.sqlInsertsBox->currentIndex());
+	prefs->setExportSqlSchema(ui.sqlSchemaCheckBox->isChecked());
 
 	accept();
 }
@@ -101,291 +169,223 @@ void DataExportDialog::checkButtonStatus()
 	// NULL
 	if (ui.fileButton->isChecked() && !ui.fileEdit->text().isEmpty())
 		e = true;
-	if (ui.clipboardButton->isChecked())
+	// binary formats cannot go to the clipboard
+	if (ui.clipboardButton->isChecked()
+		&& !DataExporter::isBinary(formats[ui.formatBox->currentText()]))
 		e = true;
 	ui.buttonBox->button(QDialogButtonBox::Ok)->setEnabled(e);
 }
 
 bool DataExportDialog::doExport()
 {
-	progress = new QProgressDialog("Exporting...", "Abort", 0, 0, this);
-	connect(progress, SIGNAL(canceled()), this, SLOT(cancel()));
-	progress->setWindowModality(Qt::WindowModal);
-	// export everything
-	while (m_data->canFetchMore())
-		m_data->fetchMore();
-
-	progress->setMaximum(m_data->rowCount());
-
-	QString curr(formats[ui.formatBox->currentText()]);
-	bool res = openStream();
-	if (curr == "csv")
-		res &= exportCSV();
-	else if (curr == "html")
-		res &= exportHTML();
-	else if (curr == "xls")
-		res &= exportExcelXML();
-	else if (curr == "sql")
-		res &= exportSql();
-	else if (curr == "py")
-		res &= exportPython();
-	else if (curr == "qore_select")
-		res &= exportQoreSelect();
-	else if (curr == "qore_selectRows")
-		res &= exportQoreSelectRows();
-	else
-		Q_ASSERT_X(0, "unhandled export", "programmer's error. Fix it, man!");
-
-	if (res)
-		res &= closeStream();
-
-	progress->setValue(m_data->rowCount());
-	delete progress;
-	progress = 0;
-
-	return res;
-}
-
-void DataExportDialog::cancel()
-{
-	cancelled = true;
-}
-
-bool DataExportDialog::setProgress(int p)
-{
-	if (cancelled)
-		return false;
-	progress->setValue(p);
-	qApp->processEvents();
-	return true;
-}
-
-bool DataExportDialog::openStream()
-{
-	// file
+	DataExporter exporter(formats[ui.formatBox->currentText()], m_tableName);
+	exporter.setHeader(header());
+	exporter.setEndOfLine(endl());
+	exporter.setBatchRows(ui.batchSizeBox->value());
+	exporter.setSqlInserts(DataExporter::SqlInserts(ui.sqlInsertsBox->currentIndex()));
+	if (ui.sqlSchemaCheckBox->isEnabled() && ui.sqlSchemaCheckBox->isChecked())
+		exporter.setSqlSchema(Database::describeObject(m_ddlTable, m_ddlSchema),
+							  Database::tableDependentSql(m_ddlTable, m_ddlSchema));
+
+	// clipboard text is collected as UTF-8
+	QBuffer clipboard;
+	QIODevice * device = &clipboard;
+	// compressed on the fly - there is no uncompressed temporary file
+	GzipDevice * gzip = 0;
 	exportFile = ui.fileButton->isChecked();
 	if (exportFile)
 	{
-		file.setFileName(ui.fileEdit->text());
-		if (!file.open(QFile::WriteOnly | QFile::Truncate))
+		QString fileName(ui.fileEdit->text());
+		if (ui.gzipCheckBox->isChecked())
+		{
+			if (!fileName.endsWith(".gz", Qt::CaseInsensitive))
+				fileName += ".gz";
+			gzip = new GzipDevice(fileName);
+			device = gzip;
+		}
+		else
+		{
+			file.setFileName(fileName);
+			device = &file;
+		}
+		if (!device->open(QFile::WriteOnly | QFile::Truncate))
 		{
 			QMessageBox::warning(this, tr("Export Error"),
-								 tr("Cannot open file %1 for writting").arg(ui.fileEdit->text()));
+								 tr("Cannot open file %1 for writting").arg(fileName));
+			delete gzip;
 			return false;
 		}
-		out.setDevice(&file);
-		out.setCodec(QTextCodec::codecForName(ui.encodingBox->currentText().toLatin1()));
-	}
-	else
-	{
-		// clipboard
-		clipboard = QString();
-		out.setString(&clipboard);
+		exporter.setEncoding(ui.encodingBox->currentText());
 	}
-	return true;
-}
-
-bool DataExportDialog::closeStream()
-{
-	out.flush();
-	if (exportFile)
-		file.close();
 	else
-	{
-		QClipboard *c = QApplication::clipboard();
-		c->setText(clipboard);
-	}
-	return true;
-}
+		clipboard.open(QIODevice::WriteOnly);
 
-bool DataExportDialog::exportCSV()
-{
-	if (header())
+	bool res;
+	if (canStream())
 	{
-		for (int i = 0; i < m_header.size(); ++i)
-		{
-			out << '"' << m_header.at(i) << '"';
-			if (i != (m_header.size() - 1))
-				out << ", ";
-		}
-		out << endl();
+		ParallelExport parallel(m_schema, m_table, &exporter, device);
+		if (!m_table.isEmpty() && parallel.prepare())
+			res = exportParallel(parallel);
+		else
+			res = exportQuery(exporter, device);
 	}
+	else
+		res = exportModel(exporter, device);
 
-	for (int i = 0; i < m_data->rowCount(); ++i)
+	if (gzip)
 	{
-		if (!setProgress(i))
-			return false;
-		QSqlRecord r = m_data->record(i);
-		for (int j = 0; j < m_header.size(); ++j)
+		// the last compressed block is written here
+		if (!gzip->finish() && res)
 		{
-			out << '"' << r.value(j).toString().replace('"', "\"\"").replace('\n', "\\n") << '"';
-			if (j != (m_header.size() - 1))
-				out << ", ";
+			QMessageBox::warning(this, tr("Export Error"), gzip->errorString());
+			res = false;
 		}
-		out << endl();
+		delete gzip;
 	}
-	return true;
+	else if (exportFile)
+		file.close();
+	else if (res)
+		QApplication::clipboard()->setText(QString::fromUtf8(clipboard.data()));
+	return res;
 }
 
-bool DataExportDialog::exportHTML()
+bool DataExportDialog::canStream()
 {
-	out << "<html>" << endl() << "<head>" << endl();
-	QString encStr("<meta http-equiv=\"Content-Type\" content=\"text/html; charset=%1\">");
-	out << encStr.arg(ui.encodingBox->currentText()) << endl();
-	out << "<title>Sqliteman export</title>" << endl() << "</head>" << endl();
-	out << "<body>" << endl() << "<table border=\"1\">" << endl();
-
-	if (header())
-	{
-		out << "<tr>";
-		for (int i = 0; i < m_header.size(); ++i)
-			out << "<th>" << Qt::escape(m_header.at(i)) << "</th>";
-		out << "</tr>" << endl();
-	}
-
-	for (int i = 0; i < m_data->rowCount(); ++i)
-	{
-		if (!setProgress(i))
-			return false;
-		out << "<tr>";
-		QSqlRecord r = m_data->record(i);
-		for (int j = 0; j < m_header.size(); ++j)
-			out << "<td>" << Qt::escape(r.value(j).toString()) << "</td>";
-		out << "</tr>" << endl();
-	}
-	out << "</table>" << endl() << "</body>" << endl() << "</html>";
-	return true;
+	if (m_query.isEmpty())
+		return false;
+	// edits not committed yet are visible in the grid only
+	SqlTableModel * table = qobject_cast<SqlTableModel*>(m_data);
+	if (table && table->pendingTransaction())
+		return false;
+	return SqlResultModel::canRunAsync(m_query);
 }
 
-bool DataExportDialog::exportExcelXML()
+bool DataExportDialog::exportModel(DataExporter & exporter, QIODevice * device)
 {
-	out << "<?xml version=\"1.0\"?>" << endl()
-		<< "<ss:Workbook xmlns:ss=\"urn:schemas-microsoft-com:office:spreadsheet\">" << endl()
-		<< "<ss:Styles><ss:Style ss:ID=\"1\"><ss:Font ss:Bold=\"1\"/></ss:Style></ss:Styles>" << endl()
-		<< "<ss:Worksheet ss:Name=\"Sqliteman Export\">" << endl()
-		<< "<ss:Table>"<< endl();
+	if (!m_data)
+		return false;
 
-	for (int i = 0; i < m_header.size(); ++i)
-		out << "<ss:Column ss:Width=\"100\"/>" << endl();
+	progress = new QProgressDialog("Exporting...", "Abort", 0, 0, this);
+	connect(progress, SIGNAL(canceled()), this, SLOT(cancel()));
+	progress->setWindowModality(Qt::WindowModal);
+	// export everything
+	if (m_result)
+		m_result->fetchAll();
+	while (m_data->canFetchMore(QModelIndex()))
+		m_data->fetchMore(QModelIndex());
 
-	if (header())
-	{
-		out << "<ss:Row ss:StyleID=\"1\">" << endl();
-		for (int i = 0; i < m_header.size(); ++i)
-			out << "<ss:Cell><ss:Data ss:Type=\"String\">" << Qt::escape(m_header.at(i)) << "</ss:Data></ss:Cell>" << endl();
-		out << "</ss:Row>" << endl();
-	}
+	progress->setMaximum(m_data->rowCount());
+	m_progressClock.start();
 
+	bool res = true;
+	QVariantList values;
+	exporter.begin(device, m_header);
 	for (int i = 0; i < m_data->rowCount(); ++i)
 	{
 		if (!setProgress(i))
-			return false;
-		out << "<ss:Row>" << endl();
-		QSqlRecord r = m_data->record(i);
+		{
+			res = false;
+			break;
+		}
+		values.clear();
 		for (int j = 0; j < m_header.size(); ++j)
-			out << "<ss:Cell><ss:Data ss:Type=\"String\">" << Qt::escape(r.value(j).toString()) << "</ss:Data></ss:Cell>" << endl();
-		out << "</ss:Row>" << endl();
+			values.append(value(i, j));
+		exporter.writeRow(values);
+	}
+	if (res && !exporter.end())
+	{
+		QMessageBox::warning(this, tr("Export Error"), exporter.errorString());
+		res = false;
 	}
 
-	out << "</ss:Table>" << endl()
-		<< "</ss:Worksheet>" << endl()
-		<< "</ss:Workbook>" << endl();
-	return true;
+	progress->setValue(m_data->rowCount());
+	delete progress;
+	progress = 0;
+
+	return res;
 }
 
-bool DataExportDialog::exportSql()
+bool DataExportDialog::exportQuery(DataExporter & exporter, QIODevice * device)
 {
-	out << "BEGIN TRANSACTION;" << endl();;
-	QString columns(m_header.join("\", \""));
-
-	for (int i = 0; i < m_data->rowCount(); ++i)
+	DataExportWorker worker(m_query, &exporter, device);
+	// count of the rows is unknown until the end - busy indicator only
+	QProgressDialog dia(tr("Exporting..."), tr("Abort"), 0, 0, this);
+	dia.setWindowModality(Qt::WindowModal);
+	dia.show();
+
+	bool aborted = false;
+	worker.start();
+	while (!worker.wait(ProgressInterval))
 	{
-		if (!setProgress(i))
-			return false;
-		out << "insert into " << m_tableName << " (\"" << columns << "\") values (";
-		QSqlRecord r = m_data->record(i);
-
-		for (int j = 0; j < m_header.size(); ++j)
+		dia.setLabelText(tr("Exporting...\nRows: %L1").arg(worker.rows()));
+		qApp->processEvents();
+		if (dia.wasCanceled() && !aborted)
 		{
-			if (r.value(j).toString().isNull())
-				out << "NULL";
-			else if (r.value(j).type() == QVariant::ByteArray)
-				out << Database::hex(r.value(j).toByteArray());
-			else
-				out << "'" << r.value(j).toString().replace('\'', "''") << "'";
-			if (j != (m_header.size() - 1))
-				out << ", ";
+			aborted = true;
+			worker.cancel();
 		}
-		out << ");" << endl();;
 	}
-	out << "COMMIT;" << endl();;
+	// reset() clears the wasCanceled() flag
+	dia.reset();
+
+	if (aborted)
+		return false;
+	if (!worker.errorString().isEmpty())
+	{
+		QMessageBox::warning(this, tr("Export Error"), worker.errorString());
+		return false;
+	}
 	return true;
 }
 
-bool DataExportDialog::exportPython()
+bool DataExportDialog::exportParallel(ParallelExport & parallel)
 {
-	out << "[" << endl();
+	QProgressDialog dia(tr("Exporting..."), tr("Abort"), 0, 1000, this);
+	dia.setWindowModality(Qt::WindowModal);
+	dia.setMinimumDuration(500);
 
-	for (int i = 0; i < m_data->rowCount(); ++i)
+	bool aborted = false;
+	parallel.start();
+	while (!parallel.wait(ProgressInterval))
 	{
-		if (!setProgress(i))
-			return false;
-		out << "	{ ";
-		QSqlRecord r = m_data->record(i);
-		for (int j = 0; j < m_header.size(); ++j)
+		dia.setLabelText(tr("Exporting...\nRows: %L1 (%2 threads)")
+						 .arg(parallel.rows()).arg(ParallelExport::scannerCount()));
+		dia.setValue(parallel.progress());
+		qApp->processEvents();
+		if (dia.wasCanceled() && !aborted)
 		{
-			// "key" : """value""" python syntax due the potentional EOLs in the strings
-			out << "\"" << m_header.at(j) << "\" : \"\"\"" << r.value(j).toString() << "\"\"\"";
-			if (j != (m_header.size() - 1))
-				out << ", ";
+			aborted = true;
+			parallel.cancel();
 		}
-		out << " }," << endl();
 	}
-	out << "]" << endl();
+	// reset() clears the wasCanceled() flag
+	dia.reset();
+
+	if (aborted)
+		return false;
+	if (!parallel.errorString().isEmpty())
+	{
+		QMessageBox::warning(this, tr("Export Error"), parallel.errorString());
+		return false;
+	}
 	return true;
 }
 
-bool DataExportDialog::exportQoreSelect()
+void DataExportDialog::cancel()
 {
-    QString strTempl("\"%1\"");
-
-	out << "my $out = ();" << endl();
-
-    for (int i = 0; i < m_header.count(); ++i)
-    {
-        out << "$out." << m_header.at(i) << " = ";
-
-        for (int j = 0; j < m_data->rowCount(); ++j)
-        {
-    		QSqlRecord r = m_data->record(j);
-            out << strTempl.arg(r.value(i).toString());
-            if (j != m_data->rowCount() - 1)
-                out << ", ";
-        }
-        out << ";" << endl();
-    }
-    return true;
+	cancelled = true;
 }
 
-bool DataExportDialog::exportQoreSelectRows()
+bool DataExportDialog::setProgress(int p)
 {
-	out << "my $out = " << endl();
-
-	for (int i = 0; i < m_data->rowCount(); ++i)
-	{
-		if (!setProgress(i))
-			return false;
-		out << "	(";
-		QSqlRecord r = m_data->record(i);
-		for (int j = 0; j < m_header.size(); ++j)
-		{
-			out << "\"" << m_header.at(j) << "\" : \"" << r.value(j).toString() << "\"";
-			if (j != (m_header.size() - 1))
-				out << ", ";
-		}
-		out << ") ," << endl();
-	}
-	out << "" << endl();
+	if (cancelled)
+		return false;
+	// the GUI is updated a few times per second only
+	if (m_progressClock.elapsed() < ProgressInterval)
+		return true;
+	m_progressClock.restart();
+	progress->setValue(p);
+	qApp->processEvents();
 	return true;
 }
 
@@ -394,6 +394,28 @@ void DataExportDialog::fileButton_toggled(bool state)
 	ui.fileEdit->setEnabled(state);
 	ui.searchButton->setEnabled(state);
 	ui.label_2->setEnabled(state);
+	// clipboard gets a text always
+	ui.gzipCheckBox->setEnabled(state);
+	checkButtonStatus();
+}
+
+void DataExportDialog::formatBox_currentIndexChanged(int)
+{
+	bool binary = DataExporter::isBinary(formats[ui.formatBox->currentText()]);
+	// text options have no meaning for binary formats
+	ui.headerCheckBox->setDisabled(binary);
+	ui.encodingBox->setDisabled(binary);
+	ui.label_4->setDisabled(binary);
+	ui.lineEndBox->setDisabled(binary);
+	ui.label_5->setDisabled(binary);
+	bool sql = formats[ui.formatBox->currentText()] == "sql";
+	ui.sqlInsertsBox->setEnabled(sql);
+	ui.sqlInsertsLabel->setEnabled(sql);
+	// there is no DDL of a query result
+	ui.sqlSchemaCheckBox->setEnabled(sql && !m_ddlTable.isEmpty());
+	bool batches = binary || (sql && ui.sqlInsertsBox->currentIndex() != DataExporter::SingleRowInserts);
+	ui.batchSizeBox->setEnabled(batches);
+	ui.batchSizeLabel->setEnabled(batches);
 	checkButtonStatus();
 }
 
@@ -425,10 +447,17 @@ void DataExportDialog::searchButton_clicked()
 		mask = tr("Qore select hash (*.q *.ql *.qc)");
 	else if (curr == "qore_selectRows")
 		mask = tr("Qore selectRows hash (*.q *.ql *.qc)");
+	else if (curr == "arrow")
+		mask = tr("Apache Arrow IPC stream (*.arrows *.arrow)");
+	else if (curr == "json")
+		mask = tr("JSON (*.json)");
+	else if (curr == "jsonl")
+		mask = tr("JSON Lines (*.jsonl *.ndjson)");
 	else
 		Q_ASSERT_X(0, "unhandled export", "fix it!");
 
-	
+	if (ui.gzipCheckBox->isChecked())
+		mask.replace(QRegExp("(\\*\\.[^ )]+)"), "\\1.gz");
 
 	QString presetPath(ui.fileEdit->text());
 	if (presetPath.isEmpty())
@@ -442,6 +471,14 @@ void DataExportDialog::searchButton_clicked()
 		ui.fileEdit->setText(fileName);
 }
 
+QVariant DataExportDialog::value(int row, int column)
+{
+	// dropped blocks are read again
+	if (m_result)
+		return m_result->value(row, column);
+	return m_data->index(row, column).data(Qt::EditRole);
+}
+
 bool DataExportDialog::header()
 {
 	return (ui.headerCheckBox->checkState() == Qt::Checked);
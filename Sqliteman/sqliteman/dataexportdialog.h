@@ -9,25 +9,38 @@ for which a new license (GPL+exception) is in place.
 #define DATAEXPORTDIALOG_H
 
 #include <QDialog>
-#include <QTextStream>
 #include <QSqlTableModel>
 #include <QFile>
+#include <QTime>
 
 #include "ui_dataexportdialog.h"
 
 class DataViewer;
 class QProgressDialog;
-class QSqlQueryModel;
+class QAbstractItemModel;
+class SqlResultModel;
+class DataExporter;
+class ParallelExport;
 
 
 /*! \brief GUI for data export into file or clipboard
+The query of the exported data is run again by DataExportWorker
+when it's possible (see SqlResultModel::canRunAsync()) so the rows
+are streamed into the output and never fetched into the model.
+Data of the model are exported otherwise.
 \author Petr Vanek <petr@scribus.info>
 */
 class DataExportDialog : public QDialog
 {
 		Q_OBJECT
 	public:
+		//! \brief Time between the progress updates (ms)
+		static const int ProgressInterval = 100;
+
 		DataExportDialog(DataViewer * parent = 0, const QString & tableName = 0);
+		/*! \brief Export the result of a query without any data view.
+		\param query a statement accepted by SqlResultModel::canRunAsync(). */
+		DataExportDialog(const QString & query, QWidget * parent = 0);
 		~DataExportDialog(){};
 
 		bool doExport();
@@ -35,34 +48,47 @@ class DataExportDialog : public QDialog
 	private:
 		const QString m_tableName;
 		bool cancelled;
-		QSqlQueryModel * m_data;
+		QAbstractItemModel * m_data;
+		//! \brief m_data when it's a SQL editor result. 0 otherwise.
+		SqlResultModel * m_result;
 		QStringList m_header;
+		//! \brief Statement of the exported data. Empty when it's unknown.
+		QString m_query;
+		/*! \brief The exported table when m_query reads it all in the rowid
+		order. Empty otherwise. See ParallelExport. */
+		QString m_schema;
+		QString m_table;
+		//! \brief The table of a table view for the DDL of the SQL export.
+		QString m_ddlSchema;
+		QString m_ddlTable;
 		QProgressDialog * progress;
+		//! \brief Time since the last progress update. See setProgress().
+		QTime m_progressClock;
 
-		QTextStream out;
-		QString clipboard;
 		QFile file;
 		bool exportFile;
 
 		Ui::DataExportDialog ui;
 		QMap<QString,QString> formats;
 
-		bool exportCSV();
-		bool exportHTML();
-		bool exportExcelXML();
-		bool exportSql();
-		bool exportPython();
-		bool exportQoreSelect();
-		bool exportQoreSelectRows();
-
-		bool openStream();
-		bool closeStream();
+		//! \brief Common constructor code
+		void init();
+		//! \brief True when m_query can be run by DataExportWorker.
+		bool canStream();
+		//! \brief Write all rows of the m_data model. They are fetched first.
+		bool exportModel(DataExporter & exporter, QIODevice * device);
+		//! \brief Run m_query again and stream its rows. See DataExportWorker.
+		bool exportQuery(DataExporter & exporter, QIODevice * device);
+		//! \brief Read m_table by rowid ranges in more threads. See ParallelExport.
+		bool exportParallel(ParallelExport & parallel);
 
 		bool setProgress(int p);
 
 		/*! \brief Export table header strings too?
 		\retval bool true = export, false = do not export header */
 		bool header();
+		//! \brief Raw (EditRole) value of the exported model.
+		QVariant value(int row, int column);
 		QString endl();
 
 		//! \brief Enable or Disable "OK" button depending on the GUI options
@@ -71,6 +97,8 @@ class DataExportDialog : public QDialog
 	private slots:
 		void fileButton_toggled(bool);
 		void clipboardButton_toggled(bool);
+		//! \brief Enable the options of the selected format (and SQL inserts).
+		void formatBox_currentIndexChanged(int);
 		void fileEdit_textChanged(const QString &);
 		void searchButton_clicked();
 		void cancel();
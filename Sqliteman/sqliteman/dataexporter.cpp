@@ -0,0 +1,657 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QIODevice>
+#include <QTextCodec>
+
+#include "dataexporter.h"
+#include "arrowwriter.h"
+#include "sqlrowblock.h"
+
+
+//! \brief "name": with the JSON escapes. Keys are written with each row.
+static QByteArray jsonKey(const QString & name)
+{
+	QString key("\"");
+	foreach (QChar c, name)
+	{
+		if (c == '"' || c == '\\')
+			key += '\\';
+		if (c.unicode() < 0x20)
+			key += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+		else
+			key += c;
+	}
+	key += "\":";
+	return key.toUtf8();
+}
+
+
+DataExporter::DataExporter(const QString & format, const QString & tableName)
+	: m_format(DataExporter::format(format)),
+	  m_tableName(tableName),
+	  m_header(true),
+	  m_eol("\n"),
+	  m_encoding("UTF-8"),
+	  m_batchRows(DefaultBatchRows),
+	  m_sqlInserts(SingleRowInserts),
+	  m_arrow(0),
+	  m_insertRows(0),
+	  m_insertBytes(0),
+	  m_rows(0)
+{
+}
+
+DataExporter::~DataExporter()
+{
+	delete m_arrow;
+}
+
+DataExporter::Format DataExporter::format(const QString & key)
+{
+	if (key == "html")
+		return HTML;
+	if (key == "xls")
+		return ExcelXML;
+	if (key == "sql")
+		return Sql;
+	if (key == "py")
+		return Python;
+	if (key == "qore_select")
+		return QoreSelect;
+	if (key == "qore_selectRows")
+		return QoreSelectRows;
+	if (key == "arrow")
+		return Arrow;
+	if (key == "json")
+		return Json;
+	if (key == "jsonl")
+		return JsonLines;
+	Q_ASSERT_X(key == "csv", "unhandled export", "programmer's error. Fix it, man!");
+	return CSV;
+}
+
+DataExporter * DataExporter::clone() const
+{
+	DataExporter * e = new DataExporter("csv", m_tableName);
+	e->m_format = m_format;
+	e->m_header = m_header;
+	e->m_eol = m_eol;
+	e->m_encoding = m_encoding;
+	e->m_batchRows = m_batchRows;
+	e->m_sqlInserts = m_sqlInserts;
+	return e;
+}
+
+void DataExporter::setSqlSchema(const QString & create, const QStringList & dependent)
+{
+	m_createSql = create;
+	m_dependentSql = dependent;
+}
+
+void DataExporter::begin(QIODevice * device, const QStringList & columns)
+{
+	beginRows(device, columns);
+
+	ExportWriter & out = m_writer;
+	switch (m_format)
+	{
+		case CSV:
+			if (!m_header)
+				break;
+			for (int i = 0; i < m_names.size(); ++i)
+			{
+				out.append('"');
+				out.append(m_names.at(i));
+				out.append('"');
+				if (i != (m_names.size() - 1))
+					out.append(", ");
+			}
+			out.append(m_eol);
+			break;
+		case HTML:
+			out.append("<html>"); out.append(m_eol);
+			out.append("<head>"); out.append(m_eol);
+			out.append(QString("<meta http-equiv=\"Content-Type\" content=\"text/html; charset=%1\">").arg(m_encoding));
+			out.append(m_eol);
+			out.append("<title>Sqliteman export</title>"); out.append(m_eol);
+			out.append("</head>"); out.append(m_eol);
+			out.append("<body>"); out.append(m_eol);
+			out.append("<table border=\"1\">"); out.append(m_eol);
+			if (!m_header)
+				break;
+			out.append("<tr>");
+			for (int i = 0; i < m_columns.size(); ++i)
+			{
+				out.append("<th>");
+				out.append(m_columns.at(i), ExportWriter::Xml);
+				out.append("</th>");
+			}
+			out.append("</tr>");
+			out.append(m_eol);
+			break;
+		case ExcelXML:
+			out.append("<?xml version=\"1.0\"?>"); out.append(m_eol);
+			out.append("<ss:Workbook xmlns:ss=\"urn:schemas-microsoft-com:office:spreadsheet\">"); out.append(m_eol);
+			out.append("<ss:Styles><ss:Style ss:ID=\"1\"><ss:Font ss:Bold=\"1\"/></ss:Style></ss:Styles>"); out.append(m_eol);
+			out.append("<ss:Worksheet ss:Name=\"Sqliteman Export\">"); out.append(m_eol);
+			out.append("<ss:Table>"); out.append(m_eol);
+			for (int i = 0; i < m_columns.size(); ++i)
+			{
+				out.append("<ss:Column ss:Width=\"100\"/>");
+				out.append(m_eol);
+			}
+			if (!m_header)
+				break;
+			out.append("<ss:Row ss:StyleID=\"1\">");
+			out.append(m_eol);
+			for (int i = 0; i < m_columns.size(); ++i)
+			{
+				out.append("<ss:Cell><ss:Data ss:Type=\"String\">");
+				out.append(m_columns.at(i), ExportWriter::Xml);
+				out.append("</ss:Data></ss:Cell>");
+				out.append(m_eol);
+			}
+			out.append("</ss:Row>");
+			out.append(m_eol);
+			break;
+		case Sql:
+			out.append("BEGIN TRANSACTION;");
+			out.append(m_eol);
+			if (!m_createSql.isEmpty())
+			{
+				out.append(m_createSql);
+				out.append(';');
+				out.append(m_eol);
+			}
+			break;
+		case Python:
+			out.append("[");
+			out.append(m_eol);
+			break;
+		case QoreSelect:
+			break;
+		case QoreSelectRows:
+			out.append("my $out = ");
+			out.append(m_eol);
+			break;
+		case Arrow:
+			// the schema is written with the first batch
+			break;
+		case Json:
+			out.append("[");
+			break;
+		case JsonLines:
+			break;
+	}
+	out.endRow();
+}
+
+void DataExporter::beginRows(QIODevice * device, const QStringList & columns)
+{
+	m_columns = columns;
+	m_names.clear();
+	foreach (QString c, columns)
+		m_names.append(c.toUtf8());
+	m_values.resize(columns.count());
+	m_texts.resize(columns.count());
+	m_qoreRows.clear();
+	m_rows = 0;
+	m_insertRows = 0;
+	m_insertBytes = 0;
+	// binary output is never converted
+	m_writer.setDevice(device, m_format == Arrow ? 0 : QTextCodec::codecForName(m_encoding.toLatin1()));
+	delete m_arrow;
+	m_arrow = 0;
+	if (m_format == Arrow)
+	{
+		m_arrow = new ArrowWriter(m_writer, m_batchRows);
+		m_arrow->begin(columns);
+	}
+	if (m_format == Sql)
+		m_insert = QString("insert into %1 (\"%2\")")
+					.arg(m_tableName).arg(m_columns.join("\", \"")).toUtf8();
+	m_jsonKeys.clear();
+	if (m_format == Json || m_format == JsonLines)
+	{
+		foreach (QString c, columns)
+			m_jsonKeys.append(jsonKey(c));
+	}
+}
+
+bool DataExporter::endRows()
+{
+	if (m_format == Sql)
+		endSqlInsert();
+	return m_writer.flush();
+}
+
+bool DataExporter::writeChunk(const QByteArray & data, qint64 rows)
+{
+	m_rows += rows;
+	return m_writer.writeEncoded(data);
+}
+
+void DataExporter::writeRow(const QVariantList & values)
+{
+	for (int i = 0; i < m_values.size(); ++i)
+	{
+		const QVariant & v = values.at(i);
+		ExportValue & e = m_values[i];
+		switch (v.type())
+		{
+			case QVariant::Int:
+			case QVariant::UInt:
+			case QVariant::LongLong:
+				e.type = SQLITE_INTEGER;
+				e.integer = v.toLongLong();
+				break;
+			case QVariant::Double:
+				e.type = SQLITE_FLOAT;
+				e.real = v.toDouble();
+				break;
+			case QVariant::ByteArray:
+				e.type = v.isNull() ? SQLITE_NULL : SQLITE_BLOB;
+				m_texts[i] = v.toByteArray();
+				break;
+			default:
+				e.type = v.toString().isNull() ? SQLITE_NULL : SQLITE_TEXT;
+				m_texts[i] = v.toString().toUtf8();
+				break;
+		}
+		if (e.type == SQLITE_BLOB || e.type == SQLITE_TEXT)
+		{
+			e.data = m_texts.at(i).constData();
+			e.size = m_texts.at(i).size();
+		}
+	}
+	writeValues();
+}
+
+void DataExporter::writeRow(const SqlRowBlock & block, int row)
+{
+	for (int i = 0; i < m_values.size(); ++i)
+	{
+		ExportValue & e = m_values[i];
+		e.type = block.type(row, i);
+		switch (e.type)
+		{
+			case SQLITE_INTEGER:
+				e.integer = block.integer(row, i);
+				break;
+			case SQLITE_FLOAT:
+				e.real = block.real(row, i);
+				break;
+			case SQLITE_NULL:
+				break;
+			default:
+				e.data = block.data(row, i, e.size);
+				break;
+		}
+	}
+	writeValues();
+}
+
+void DataExporter::appendText(const ExportValue & value, ExportWriter::Escape escape)
+{
+	switch (value.type)
+	{
+		case SQLITE_INTEGER:
+			m_writer.appendNumber(value.integer);
+			break;
+		case SQLITE_FLOAT:
+			m_writer.appendNumber(value.real);
+			break;
+		case SQLITE_NULL:
+			break;
+		case SQLITE_BLOB:
+		{
+			// bytes are Latin-1 characters as in QVariant::toString()
+			QByteArray utf8(QString::fromLatin1(value.data, value.size).toUtf8());
+			m_writer.appendEscaped(utf8.constData(), utf8.size(), escape);
+			break;
+		}
+		default:
+			m_writer.appendEscaped(value.data, value.size, escape);
+			break;
+	}
+}
+
+QByteArray DataExporter::text(const ExportValue & value)
+{
+	switch (value.type)
+	{
+		case SQLITE_INTEGER:
+			return QByteArray::number(value.integer);
+		case SQLITE_FLOAT:
+			return QByteArray::number(value.real, 'g', 15);
+		case SQLITE_NULL:
+			return QByteArray();
+		case SQLITE_BLOB:
+			return QString::fromLatin1(value.data, value.size).toUtf8();
+		default:
+			return QByteArray(value.data, value.size);
+	}
+}
+
+void DataExporter::appendSql(const ExportValue & value)
+{
+	static const char hexdigits[] = "0123456789ABCDEF";
+	switch (value.type)
+	{
+		case SQLITE_INTEGER:
+			m_writer.appendNumber(value.integer);
+			break;
+		case SQLITE_FLOAT:
+		{
+			// inf has no literal. 1e999 is read as inf, nan is NULL in sqlite.
+			if (value.real != value.real)
+			{
+				m_writer.append("NULL");
+				break;
+			}
+			if (value.real - value.real != 0.0)
+			{
+				m_writer.append(value.real < 0 ? "-1e999" : "1e999");
+				break;
+			}
+			// 17 digits restore the same double. 3.0 is not an integer after the import.
+			QByteArray number(QByteArray::number(value.real, 'g', 17));
+			m_writer.append(number);
+			if (!number.contains('.') && !number.contains('e'))
+				m_writer.append(".0");
+			break;
+		}
+		case SQLITE_NULL:
+			m_writer.append("NULL");
+			break;
+		case SQLITE_BLOB:
+			m_writer.append("X'");
+			for (int i = 0; i < value.size; ++i)
+			{
+				m_writer.append(hexdigits[(value.data[i] >> 4) & 0xf]);
+				m_writer.append(hexdigits[value.data[i] & 0xf]);
+			}
+			m_writer.append('\'');
+			break;
+		default:
+			m_writer.append('\'');
+			appendText(value, ExportWriter::SqlQuote);
+			m_writer.append('\'');
+			break;
+	}
+}
+
+void DataExporter::appendJson(const ExportValue & value)
+{
+	switch (value.type)
+	{
+		case SQLITE_INTEGER:
+			m_writer.appendNumber(value.integer);
+			break;
+		case SQLITE_FLOAT:
+			// inf and nan have no JSON number. Only they give nan here.
+			if (value.real - value.real == 0.0)
+				m_writer.appendNumber(value.real);
+			else
+				m_writer.append("null");
+			break;
+		case SQLITE_NULL:
+			m_writer.append("null");
+			break;
+		case SQLITE_BLOB:
+			m_writer.append('"');
+			m_writer.append(QByteArray::fromRawData(value.data, value.size).toBase64());
+			m_writer.append('"');
+			break;
+		default:
+			m_writer.append('"');
+			m_writer.appendEscaped(value.data, value.size, ExportWriter::Json);
+			m_writer.append('"');
+			break;
+	}
+}
+
+void DataExporter::appendJsonObject()
+{
+	m_writer.append('{');
+	for (int j = 0; j < m_values.size(); ++j)
+	{
+		if (j > 0)
+			m_writer.append(',');
+		m_writer.append(m_jsonKeys.at(j));
+		appendJson(m_values.at(j));
+	}
+	m_writer.append('}');
+}
+
+void DataExporter::appendSqlInsert()
+{
+	ExportWriter & out = m_writer;
+	int start = out.pending();
+	switch (m_sqlInserts)
+	{
+		case SingleRowInserts:
+			out.append(m_insert);
+			out.append(" values (");
+			break;
+		case MultiRowValues:
+			if (m_insertRows == 0)
+			{
+				out.append(m_insert);
+				out.append(" values");
+			}
+			else
+				out.append(',');
+			out.append(m_eol);
+			out.append('(');
+			break;
+		case UnionAllSelect:
+			if (m_insertRows == 0)
+				out.append(m_insert);
+			out.append(m_eol);
+			out.append(m_insertRows == 0 ? "select " : "union all select ");
+			break;
+	}
+	int columns = m_values.size();
+	for (int j = 0; j < columns; ++j)
+	{
+		appendSql(m_values.at(j));
+		if (j != (columns - 1))
+			out.append(", ");
+	}
+	if (m_sqlInserts != UnionAllSelect)
+		out.append(')');
+
+	// the buffer is flushed by endRow() only so it grows by the row
+	++m_insertRows;
+	m_insertBytes += out.pending() - start;
+	if (m_insertRows >= qMin(m_batchRows, int(MaxSqlRows)) || m_insertBytes >= MaxSqlBytes
+		|| m_sqlInserts == SingleRowInserts)
+		endSqlInsert();
+}
+
+void DataExporter::endSqlInsert()
+{
+	if (m_insertRows == 0)
+		return;
+	m_writer.append(';');
+	m_writer.append(m_eol);
+	m_insertRows = 0;
+	m_insertBytes = 0;
+}
+
+void DataExporter::writeValues()
+{
+	ExportWriter & out = m_writer;
+	int columns = m_values.size();
+	switch (m_format)
+	{
+		case CSV:
+			for (int j = 0; j < columns; ++j)
+			{
+				out.append('"');
+				appendText(m_values.at(j), ExportWriter::CsvQuote);
+				out.append('"');
+				if (j != (columns - 1))
+					out.append(", ");
+			}
+			out.append(m_eol);
+			break;
+		case HTML:
+			out.append("<tr>");
+			for (int j = 0; j < columns; ++j)
+			{
+				out.append("<td>");
+				appendText(m_values.at(j), ExportWriter::Xml);
+				out.append("</td>");
+			}
+			out.append("</tr>");
+			out.append(m_eol);
+			break;
+		case ExcelXML:
+			out.append("<ss:Row>");
+			out.append(m_eol);
+			for (int j = 0; j < columns; ++j)
+			{
+				out.append("<ss:Cell><ss:Data ss:Type=\"String\">");
+				appendText(m_values.at(j), ExportWriter::Xml);
+				out.append("</ss:Data></ss:Cell>");
+				out.append(m_eol);
+			}
+			out.append("</ss:Row>");
+			out.append(m_eol);
+			break;
+		case Sql:
+			appendSqlInsert();
+			break;
+		case Python:
+			out.append("	{ ");
+			for (int j = 0; j < columns; ++j)
+			{
+				// "key" : """value""" python syntax due the potentional EOLs in the strings
+				out.append('"');
+				out.append(m_names.at(j));
+				out.append("\" : \"\"\"");
+				appendText(m_values.at(j));
+				out.append("\"\"\"");
+				if (j != (columns - 1))
+					out.append(", ");
+			}
+			out.append(" },");
+			out.append(m_eol);
+			break;
+		case QoreSelect:
+		{
+			QList<QByteArray> row;
+			for (int j = 0; j < columns; ++j)
+				row.append(text(m_values.at(j)));
+			m_qoreRows.append(row);
+			break;
+		}
+		case QoreSelectRows:
+			out.append("	(");
+			for (int j = 0; j < columns; ++j)
+			{
+				out.append('"');
+				out.append(m_names.at(j));
+				out.append("\" : \"");
+				appendText(m_values.at(j));
+				out.append('"');
+				if (j != (columns - 1))
+					out.append(", ");
+			}
+			out.append(") ,");
+			out.append(m_eol);
+			break;
+		case Arrow:
+			m_arrow->writeRow(m_values);
+			break;
+		case Json:
+			if (m_rows > 0)
+				out.append(',');
+			out.append(m_eol);
+			appendJsonObject();
+			break;
+		case JsonLines:
+			appendJsonObject();
+			out.append(m_eol);
+			break;
+	}
+	++m_rows;
+	out.endRow();
+}
+
+bool DataExporter::end()
+{
+	ExportWriter & out = m_writer;
+	switch (m_format)
+	{
+		case HTML:
+			out.append("</table>"); out.append(m_eol);
+			out.append("</body>"); out.append(m_eol);
+			out.append("</html>");
+			break;
+		case ExcelXML:
+			out.append("</ss:Table>"); out.append(m_eol);
+			out.append("</ss:Worksheet>"); out.append(m_eol);
+			out.append("</ss:Workbook>"); out.append(m_eol);
+			break;
+		case Sql:
+			endSqlInsert();
+			foreach (QString sql, m_dependentSql)
+			{
+				out.append(sql);
+				out.append(';');
+				out.append(m_eol);
+			}
+			out.append("COMMIT;");
+			out.append(m_eol);
+			break;
+		case Python:
+			out.append("]");
+			out.append(m_eol);
+			break;
+		case QoreSelect:
+			out.append("my $out = ();");
+			out.append(m_eol);
+			for (int i = 0; i < m_names.count(); ++i)
+			{
+				out.append("$out.");
+				out.append(m_names.at(i));
+				out.append(" = ");
+				for (int j = 0; j < m_qoreRows.count(); ++j)
+				{
+					out.append('"');
+					out.append(m_qoreRows.at(j).at(i));
+					out.append('"');
+					if (j != m_qoreRows.count() - 1)
+						out.append(", ");
+				}
+				out.append(";");
+				out.append(m_eol);
+				out.endRow();
+			}
+			m_qoreRows.clear();
+			break;
+		case QoreSelectRows:
+			out.append(m_eol);
+			break;
+		case Arrow:
+			m_arrow->end();
+			break;
+		case Json:
+			out.append(m_eol);
+			out.append("]");
+			out.append(m_eol);
+			break;
+		case CSV:
+		case JsonLines:
+			break;
+	}
+	return out.flush();
+}
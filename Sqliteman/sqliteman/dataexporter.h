@@ -0,0 +1,222 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef DATAEXPORTER_H
+#define DATAEXPORTER_H
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+#include "exportwriter.h"
+
+class QIODevice;
+class SqlRowBlock;
+class ArrowWriter;
+
+
+/*! \brief One value of an exported row. See DataExporter.
+*/
+typedef struct
+{
+	//! \brief sqlite3 fundamental datatype (SQLITE_INTEGER etc.)
+	int type;
+	qint64 integer;
+	double real;
+	//! \brief UTF-8 of SQLITE_TEXT or the bytes of SQLITE_BLOB
+	const char * data;
+	int size;
+}
+ExportValue;
+
+
+/*! \brief Writer of the exported rows in one of the export formats.
+Rows are written as they come so the exported data never have to
+be in the memory. It's used by DataExportDialog for the rows of
+a model and by DataExportWorker for the rows of a running query.
+
+\code
+DataExporter exporter("csv", "t1");
+exporter.begin(&file, columns);
+while (...)
+	exporter.writeRow(values);
+if (!exporter.end())
+	... exporter.errorString()
+\endcode
+
+The output goes through ExportWriter. Rows of a SqlRowBlock are
+written from their UTF-8 bytes directly. Model values are the raw
+ones: QString, numbers, QByteArray for BLOBs and null QVariant for
+NULLs.
+\note "qore_select" is ordered by columns. Its rows are kept
+until end().
+\note "arrow" is the binary Apache Arrow IPC stream. See ArrowWriter.
+The encoding, line end and header options are not used.
+\note "sql" writes one insert per row by default. See setSqlInserts()
+and setSqlSchema() for the faster multi-row inserts and the .dump
+like output with the table DDL.
+\note "json" (an array of objects) and "jsonl" (JSON Lines, one object
+per line) keep the value types: numbers are unquoted, NULL is null and
+BLOBs are base64 strings. The column names are the keys always.
+*/
+class DataExporter
+{
+		Q_DECLARE_TR_FUNCTIONS(DataExporter)
+
+	public:
+		enum Format
+		{
+			CSV,
+			HTML,
+			ExcelXML,
+			Sql,
+			Python,
+			QoreSelect,
+			QoreSelectRows,
+			Arrow,
+			Json,
+			JsonLines
+		};
+
+		//! \brief Statements of the "sql" format.
+		enum SqlInserts
+		{
+			//! \brief insert into ... values (...); for each row
+			SingleRowInserts,
+			//! \brief insert into ... values (...), (...); It needs sqlite 3.7.11.
+			MultiRowValues,
+			//! \brief insert into ... select ... union all select ...;
+			UnionAllSelect
+		};
+
+		//! \brief Default rows in one batch. See setBatchRows().
+		static const int DefaultBatchRows = 65536;
+		/*! \brief Max rows of one multi-row insert. It's the default
+		SQLITE_MAX_COMPOUND_SELECT - the VALUES rows are a compound
+		select in sqlite before 3.8.8. */
+		static const int MaxSqlRows = 500;
+		//! \brief A multi-row insert ends when it's bigger (SQLITE_MAX_SQL_LENGTH is 1 MB)
+		static const int MaxSqlBytes = 512 * 1024;
+
+		/*! \param format a format key ("csv", "html", "xls", "sql",
+		       "py", "qore_select", "qore_selectRows", "arrow", "json"
+		       or "jsonl").
+		\param tableName a target table of the SQL inserts. */
+		DataExporter(const QString & format, const QString & tableName);
+		~DataExporter();
+
+		//! \brief Write the column names too. Default is true.
+		void setHeader(bool header) { m_header = header; };
+		//! \brief Line end. Default is LF.
+		void setEndOfLine(const QString & eol) { m_eol = eol.toLatin1(); };
+		//! \brief Name of the output codec. Default is UTF-8.
+		void setEncoding(const QString & encoding) { m_encoding = encoding; };
+		/*! \brief Rows in one record batch of "arrow" or in one insert of
+		"sql". The inserts have MaxSqlRows at most. */
+		void setBatchRows(int rows) { m_batchRows = rows; };
+		//! \brief Statements of the "sql" format. Default is SingleRowInserts.
+		void setSqlInserts(SqlInserts inserts) { m_sqlInserts = inserts; };
+		/*! \brief Write the table DDL into the "sql" format like the sqlite3
+		.dump does. Indexes and triggers are created after the rows - it's
+		faster than to update them with each insert.
+		\param create CREATE TABLE statement written before the rows.
+		\param dependent CREATE INDEX/TRIGGER statements written after them. */
+		void setSqlSchema(const QString & create, const QStringList & dependent);
+
+		//! \brief New exporter with the same format and options.
+		DataExporter * clone() const;
+		DataExporter::Format exportFormat() const { return m_format; };
+		/*! \brief True when parts of the rows written by more exporters
+		with beginRows() can be joined by writeChunk(). See ParallelExport. */
+		bool canSplit() const { return m_format != QoreSelect && m_format != Arrow && m_format != Json; };
+
+		/*! \brief Start the export with a header of the format.
+		\param device an opened output. It's not closed in end().
+		\param columns names of the exported columns. */
+		void begin(QIODevice * device, const QStringList & columns);
+		/*! \brief Start a part of the rows without the header. See
+		ParallelExport. The part is finished with endRows(). */
+		void beginRows(QIODevice * device, const QStringList & columns);
+		//! \brief Write one row. Its values are in the columns order.
+		void writeRow(const QVariantList & values);
+		//! \brief Write one row of the block.
+		void writeRow(const SqlRowBlock & block, int row);
+		/*! \brief Finish the format and flush the output.
+		\retval bool false when the output cannot be written. See errorString(). */
+		bool end();
+		/*! \brief Flush the rows of beginRows(). No footer is written.
+		An unfinished multi-row insert is closed. */
+		bool endRows();
+		/*! \brief Write rows formatted by other exporter with beginRows().
+		\param data the rows in the output encoding.
+		\param rows count of the rows. */
+		bool writeChunk(const QByteArray & data, qint64 rows);
+		//! \brief True when the output failed. The export can be stopped.
+		bool failed() const { return m_writer.failed(); };
+		QString errorString() const { return m_writer.errorString(); };
+
+		//! \brief Rows written so far.
+		qint64 rows() const { return m_rows; };
+		//! \brief Bytes written to the device so far.
+		qint64 bytesWritten() const { return m_writer.bytesWritten(); };
+
+		//! \brief Format of the key. See DataExporter().
+		static Format format(const QString & key);
+		//! \brief True for the formats which are not a text (no clipboard).
+		static bool isBinary(const QString & key) { return format(key) == Arrow; };
+
+	private:
+		Format m_format;
+		QString m_tableName;
+		bool m_header;
+		QByteArray m_eol;
+		QString m_encoding;
+		int m_batchRows;
+		SqlInserts m_sqlInserts;
+		QString m_createSql;
+		QStringList m_dependentSql;
+		ExportWriter m_writer;
+		//! \brief Record batches of the Arrow format. 0 for other formats.
+		ArrowWriter * m_arrow;
+		QStringList m_columns;
+		//! \brief UTF-8 of the column names
+		QList<QByteArray> m_names;
+		//! \brief Values of the current row
+		QVector<ExportValue> m_values;
+		//! \brief Texts of the current row from writeRow(QVariantList)
+		QVector<QByteArray> m_texts;
+		//! \brief Start of the SQL insert. Columns are joined already.
+		QByteArray m_insert;
+		//! \brief Rows and UTF-8 bytes of the unfinished multi-row insert
+		int m_insertRows;
+		int m_insertBytes;
+		//! \brief "name": of the JSON columns
+		QList<QByteArray> m_jsonKeys;
+		//! \brief Rows of QoreSelect waiting for end()
+		QList<QList<QByteArray> > m_qoreRows;
+		qint64 m_rows;
+
+		//! \brief Write m_values in the format.
+		void writeValues();
+		//! \brief The value as QVariant::toString() would convert it.
+		void appendText(const ExportValue & value, ExportWriter::Escape escape = ExportWriter::Raw);
+		//! \brief The value as a SQL literal.
+		void appendSql(const ExportValue & value);
+		//! \brief One row of the SQL inserts. See SqlInserts.
+		void appendSqlInsert();
+		//! \brief Finish the unfinished multi-row insert.
+		void endSqlInsert();
+		//! \brief The value as a JSON value.
+		void appendJson(const ExportValue & value);
+		//! \brief One row as a JSON object.
+		void appendJsonObject();
+		//! \brief UTF-8 of appendText() for the buffered rows.
+		static QByteArray text(const ExportValue & value);
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QMutexLocker>
+
+#include "dataexportworker.h"
+#include "dataexporter.h"
+#include "databasepool.h"
+#include "sqlrowblock.h"
+
+
+DataExportWorker::DataExportWorker(const QString & query, DataExporter * exporter, QIODevice * device)
+	: QThread(),
+	  m_query(query),
+	  m_exporter(exporter),
+	  m_device(device),
+	  m_cancelled(0),
+	  m_rows(0)
+{
+}
+
+void DataExportWorker::cancel()
+{
+	m_cancelled = 1;
+}
+
+qint64 DataExportWorker::rows()
+{
+	QMutexLocker locker(&m_mutex);
+	return m_rows;
+}
+
+QString DataExportWorker::errorString()
+{
+	QMutexLocker locker(&m_mutex);
+	return m_error;
+}
+
+void DataExportWorker::setError(const QString & error)
+{
+	QMutexLocker locker(&m_mutex);
+	m_error = error;
+}
+
+int DataExportWorker::progressHandler(void * worker)
+{
+	return static_cast<DataExportWorker*>(worker)->m_cancelled ? 1 : 0;
+}
+
+void DataExportWorker::run()
+{
+	DatabaseLease lease(DatabaseSession::ReadOnly, tr("Export"));
+	sqlite3 * db = lease.session().handle();
+	if (!db)
+	{
+		setError(lease.session().lastError().message);
+		return;
+	}
+
+	sqlite3_stmt * stmt = 0;
+	int rc = sqlite3_prepare16_v2(db, m_query.constData(),
+								  (m_query.size() + 1) * sizeof(QChar),
+								  &stmt, 0);
+	if (rc != SQLITE_OK || !stmt)
+	{
+		setError(rc == SQLITE_OK
+				 ? tr("No SQL statement")
+				 : QString(reinterpret_cast<const QChar *>(sqlite3_errmsg16(db))));
+		sqlite3_finalize(stmt);
+		return;
+	}
+
+	int columns = sqlite3_column_count(stmt);
+	QStringList names;
+	for (int i = 0; i < columns; ++i)
+		names.append(QString(reinterpret_cast<const QChar *>(sqlite3_column_name16(stmt, i))));
+	m_exporter->begin(m_device, names);
+
+	// the connection goes back to the pool - the handler is removed below
+	sqlite3_progress_handler(db, ProgressSteps, progressHandler, this);
+	SqlRowBlock block(columns);
+	do
+	{
+		rc = sqlite3_step(stmt);
+		if (rc == SQLITE_ROW)
+			block.appendRow(stmt);
+		if (block.rowCount() < BlockRows && rc == SQLITE_ROW)
+			continue;
+
+		// texts are written from their UTF-8 in the block
+		for (int r = 0; r < block.rowCount(); ++r)
+			m_exporter->writeRow(block, r);
+		QMutexLocker locker(&m_mutex);
+		m_rows += block.rowCount();
+		locker.unlock();
+		block.clear();
+	}
+	while (rc == SQLITE_ROW && !m_cancelled && !m_exporter->failed());
+	sqlite3_progress_handler(db, 0, 0, 0);
+
+	if (!m_cancelled && rc != SQLITE_DONE && rc != SQLITE_ROW)
+	{
+		// sqlite3_reset() returns the specific error code and message
+		sqlite3_reset(stmt);
+		setError(QString(reinterpret_cast<const QChar *>(sqlite3_errmsg16(db))));
+	}
+	sqlite3_finalize(stmt);
+
+	if (m_exporter->failed())
+		setError(m_exporter->errorString());
+	else if (!m_cancelled && errorString().isEmpty() && !m_exporter->end())
+		setError(m_exporter->errorString());
+}
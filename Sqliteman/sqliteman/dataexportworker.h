@@ -0,0 +1,76 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef DATAEXPORTWORKER_H
+#define DATAEXPORTWORKER_H
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QMutex>
+#include <QAtomicInt>
+
+#include "sqlite3.h"
+
+class QIODevice;
+class DataExporter;
+
+
+/*! \brief Run a query and stream its rows into a DataExporter.
+The query runs in the thread on a read-only connection of the
+DatabasePool. Rows go from sqlite3_step() to the exporter in small
+blocks (see BlockRows) so the memory used does not depend on the
+size of the result. The result is not fetched into any model.
+
+The connection sees committed data only. Use it for queries which
+SqlResultModel::canRunAsync() accepts.
+
+The caller polls rows() and wait() while the thread runs. The
+exporter and the device are used by the thread only until it
+finishes.
+*/
+class DataExportWorker : public QThread
+{
+		Q_DECLARE_TR_FUNCTIONS(DataExportWorker)
+
+	public:
+		//! \brief Rows converted and written at once
+		static const int BlockRows = 256;
+		//! \brief VM steps between the cancel checks of a running step
+		static const int ProgressSteps = 1000;
+
+		/*! \param query a statement to export.
+		\param exporter a format writer. Its begin() and end() are called here.
+		\param device an opened output. */
+		DataExportWorker(const QString & query, DataExporter * exporter, QIODevice * device);
+
+		//! \brief Stop the export. Rows written already stay in the output.
+		void cancel();
+		//! \brief Count of the rows written so far.
+		qint64 rows();
+		//! \brief Error which stopped the export. Empty when it succeeded or it was cancelled.
+		QString errorString();
+
+	protected:
+		void run();
+
+	private:
+		QString m_query;
+		DataExporter * m_exporter;
+		QIODevice * m_device;
+		QAtomicInt m_cancelled;
+
+		//! \brief Guards everything below.
+		QMutex m_mutex;
+		qint64 m_rows;
+		QString m_error;
+
+		void setError(const QString & error);
+		//! \brief Interrupt the running statement on cancel()
+		static int progressHandler(void * worker);
+};
+
+#endif
@@ -19,6 +19,7 @@ for which a new license (GPL+exception) is in place.
 #include "dataviewer.h"
 #include "dataexportdialog.h"
 #include "sqlmodels.h"
+#include "sqlresultmodel.h"
 #include "database.h"
 #include "sqldelegate.h"
 #include "utils.h"
@@ -27,7 +28,8 @@ for which a new license (GPL+exception) is in place.
 
 DataViewer::DataViewer(QWidget * parent)
 	: QMainWindow(parent),
-	  dataResized(true)
+	  dataResized(true),
+	  m_showButtons(false)
 {
 	ui.setupUi(this);
 
@@ -141,7 +143,13 @@ bool DataViewer::setTableModel(QAbstractItemModel * model, bool showButtons)
 //	delete makes snapshot window empty
 // 	delete(ui.tableView->model());
 // 	delete(ui.tableView->selectionModel());
+	if (ui.tableView->model())
+		disconnect(ui.tableView->model(), SIGNAL(rowsInserted(const QModelIndex &, int, int)),
+				   this, SLOT(tableModel_rowsInserted(const QModelIndex &, int, int)));
 	ui.tableView->setModel(model);
+	// rows of the SqlResultModel are arriving later
+	connect(model, SIGNAL(rowsInserted(const QModelIndex &, int, int)),
+			this, SLOT(tableModel_rowsInserted(const QModelIndex &, int, int)));
 	connect(ui.tableView->selectionModel(),
 			SIGNAL(selectionChanged(const QItemSelection &, const QItemSelection &)),
 			this,
@@ -149,11 +157,11 @@ bool DataViewer::setTableModel(QAbstractItemModel * model, bool showButtons)
 	ui.itemView->setModel(model);
 	ui.tabWidget->setCurrentIndex(0);
 	resizeViewToContents(model);
+	m_showButtons = showButtons;
 	setShowButtons(showButtons);
 	
 	QString cached;
-	if (qobject_cast<QSqlQueryModel*>(model)->rowCount() != 0
-		   && qobject_cast<QSqlQueryModel*>(model)->canFetchMore())
+	if (model->rowCount() != 0 && model->canFetchMore(QModelIndex()))
     {
 		cached = DataViewer::canFetchMore();
     }
@@ -170,6 +178,17 @@ void DataViewer::freeResources()
 	QSqlQueryModel * m = qobject_cast<QSqlQueryModel*>(ui.tableView->model());
 	if (m)
 		m->clear();
+	SqlResultModel * r = qobject_cast<SqlResultModel*>(ui.tableView->model());
+	if (r)
+		r->clear();
+}
+
+void DataViewer::tableModel_rowsInserted(const QModelIndex &, int start, int)
+{
+	// the first batch of the streamed result
+	if (start == 0)
+		resizeViewToContents(ui.tableView->model());
+	setShowButtons(m_showButtons);
 }
 
 void DataViewer::tableView_dataResized(int column, int oldWidth, int newWidth) 
@@ -268,6 +287,9 @@ void DataViewer::truncateTable()
 	// prevent cached data when truncating the table
 	if (model->pendingTransaction())
 		rollback();
+	// all rows - not the window of Goto Line only
+	if (model->windowStart() > 0)
+		model->seekRow(0);
 	while (model->canFetchMore())
 		model->fetchMore();
 	model->removeRows(0, model->rowCount());
@@ -287,15 +309,15 @@ void DataViewer::exportData()
 	delete dia;
 }
 
-QSqlQueryModel* DataViewer::tableData()
+QAbstractItemModel* DataViewer::tableData()
 {
-	return qobject_cast<QSqlQueryModel *>(ui.tableView->model());
+	return ui.tableView->model();
 }
 
 QStringList DataViewer::tableHeader()
 {
 	QStringList ret;
-	QSqlQueryModel *q = qobject_cast<QSqlQueryModel *>(ui.tableView->model());
+	QAbstractItemModel *q = ui.tableView->model();
 
 	for (int i = 0; i < q->columnCount() ; ++i)
 		ret << q->headerData(i, Qt::Horizontal).toString();
@@ -372,7 +394,8 @@ void DataViewer::copyHandler()
 
 void DataViewer::openStandaloneWindow()
 {
-	SqlQueryModel *qm;
+	QAbstractItemModel *qm;
+	QString statement;
 	SqlTableModel *tm = qobject_cast<SqlTableModel*>(ui.tableView->model());
 
 #ifdef WIN32
@@ -389,22 +412,30 @@ void DataViewer::openStandaloneWindow()
 		w->setWindowTitle(tm->tableName() + " - "
 				+ QDateTime::currentDateTime().toString() + " - " 
 				+ tr("Data Snapshot"));
-		qm = new SqlQueryModel(w);
-		qm->setQuery(QString("select * from \"%1\".\"%2\";").arg(tm->schema()).arg(tm->tableName()),
+		SqlQueryModel * snapshot = new SqlQueryModel(w);
+		snapshot->setQuery(QString("select * from \"%1\".\"%2\";").arg(tm->schema()).arg(tm->tableName()),
 					QSqlDatabase::database(SESSION_NAME));
+		statement = snapshot->query().lastQuery();
+		qm = snapshot;
 	}
 	else
 	{
 		w->setWindowTitle("SQL - "
 				+ QDateTime::currentDateTime().toString() + " - " 
 				+ tr("Data Snapshot"));
-		qm = qobject_cast<SqlQueryModel*>(ui.tableView->model());
+		qm = ui.tableView->model();
+		SqlQueryModel * sm = qobject_cast<SqlQueryModel*>(qm);
+		SqlResultModel * rm = qobject_cast<SqlResultModel*>(qm);
+		if (sm)
+			statement = sm->query().lastQuery();
+		else if (rm)
+			statement = rm->query();
 	}
 
 	w->setTableModel(qm);
 	w->ui.statusText->setText(tr("%1 snapshot for: %2")
 								.arg("<tt>"+QDateTime::currentDateTime().toString()+"</tt><br/>")
-								.arg("<br/><tt>" + qm->query().lastQuery())+ "</tt>");
+								.arg("<br/><tt>" + statement)+ "</tt>");
 	w->ui.mainToolBar->hide();
 	w->ui.snapshotToolBar->hide();
 	w->ui.actionClose->setVisible(true);
@@ -451,10 +482,11 @@ void DataViewer::tabWidget_currentChanged(int ix)
 				this, SLOT(itemView_indexChanged()));
 	}
 	
+	// script output and profile tabs are not related to the table
 	if (ui.actionBLOB_Preview->isChecked())
-		ui.blobPreviewBox->setVisible(ix!=2);
-	ui.statusText->setVisible(ix != 2);
-	ui.action_Goto_Line->setEnabled(ix!=2);
+		ui.blobPreviewBox->setVisible(ix < 2);
+	ui.statusText->setVisible(ix < 2);
+	ui.action_Goto_Line->setEnabled(ix < 2);
 }
 
 void DataViewer::itemView_indexChanged()
@@ -479,6 +511,70 @@ void DataViewer::sqlScriptStart()
 	ui.scriptEdit->clear();
 }
 
+void DataViewer::addProfile(const SqlStatementProfile & profile)
+{
+	QStringList l;
+	l << profile.statement.simplified()
+	  << profile.started.toString(Qt::ISODate)
+	  << (profile.elapsed < 0 ? QString() : QString::number(profile.elapsed / 1000.0))
+	  << (profile.vmTime < 0 ? QString() : QString::number(profile.vmTime / 1000000000.0))
+	  << (profile.rows < 0 ? QString() : QString::number(profile.rows) + (profile.moreRows ? "+" : ""))
+	  << (profile.fullScanSteps < 0 ? QString() : QString::number(profile.fullScanSteps))
+	  << (profile.sorts < 0 ? QString() : QString::number(profile.sorts));
+	QTreeWidgetItem * item = new QTreeWidgetItem(ui.profileTree, l);
+	item->setToolTip(0, profile.statement);
+	for (int i = 2; i < l.count(); ++i)
+		item->setTextAlignment(i, Qt::AlignRight);
+	ui.profileTree->scrollToItem(item);
+	// the same limit as the SQL editor history
+	if (ui.profileTree->topLevelItemCount() > 30)
+		delete ui.profileTree->takeTopLevelItem(0);
+}
+
+void DataViewer::setProfileTime(const QString & statement, qint64 vmTime)
+{
+	// the newest run of the statement waiting for its time
+	QString s(statement.simplified());
+	for (int i = ui.profileTree->topLevelItemCount() - 1; i >= 0; --i)
+	{
+		QTreeWidgetItem * item = ui.profileTree->topLevelItem(i);
+		if (item->text(0) == s)
+		{
+			if (item->text(3).isEmpty())
+				item->setText(3, QString::number(vmTime / 1000000000.0));
+			return;
+		}
+	}
+}
+
+void DataViewer::showQueryPlan(const QString & statement)
+{
+	QString err(ui.explainView->showPlan(statement));
+	if (!err.isEmpty())
+	{
+		// the status is not visible in the plan tab
+		setStatusText(tr("Query Error: %1\n\n%2").arg(err).arg("EXPLAIN QUERY PLAN " + statement));
+		ui.tabWidget->setCurrentIndex(0);
+		return;
+	}
+	ui.tabWidget->setCurrentIndex(4);
+	setShowButtons(false);
+}
+
+void DataViewer::showBytecode(const QString & statement)
+{
+	QString err(ui.explainView->showBytecode(statement));
+	if (!err.isEmpty())
+	{
+		// the status is not visible in the plan tab
+		setStatusText(tr("Query Error: %1\n\n%2").arg(err).arg("EXPLAIN " + statement));
+		ui.tabWidget->setCurrentIndex(0);
+		return;
+	}
+	ui.tabWidget->setCurrentIndex(4);
+	setShowButtons(false);
+}
+
 const QString DataViewer::canFetchMore()
 {
 	return tr("(More rows can be fetched. Scroll the resultset for more rows and/or read the documentation.)");
@@ -486,33 +582,43 @@ const QString DataViewer::canFetchMore()
 
 void DataViewer::gotoLine()
 {
+	QAbstractItemModel * model = ui.tableView->model();
+	// SqlResultModel has all rows already (by the rowid seek). The table
+	// browser seeks by the rowid when there are no pending changes.
+	SqlTableModel * table = qobject_cast<SqlTableModel*>(model);
+	int first = table ? table->windowStart() : 0;
+	if (table && !table->canSeek())
+		table = 0;
 	bool ok;
 	int row = QInputDialog::getInt(this, tr("Goto Line"), tr("Goto Line:"),
-								   ui.tableView->currentIndex().row(), // value
+								   first + ui.tableView->currentIndex().row(), // value
 								   1, // min
-								   ui.tableView->model()->rowCount(), // max (no fetchMore loop)
+								   table ? table->totalRowCount() : first + model->rowCount(), // max
 								   1, // step
 								   &ok);
 	if (!ok)
 		return;
 
-	QModelIndex left;
-	SqlTableModel * model = qobject_cast<SqlTableModel *>(ui.tableView->model());
 	int column = ui.tableView->currentIndex().isValid() ? ui.tableView->currentIndex().column() : 0;
 	row -= 1;
 
-	if (model)
-		left = model->createIndex(row, column);
-	else
+	if (table && (row < first || row >= first + model->rowCount()))
 	{
-		SqlQueryModel * model = qobject_cast<SqlQueryModel *>(ui.tableView->model());
-		if (model)
-			left = model->createIndex(row, column);
+		// some rows above the target stay reachable by scrolling
+		QApplication::setOverrideCursor(Qt::WaitCursor);
+		if (table->seekRow(qMax(0, row - GotoMargin)))
+			first = table->windowStart();
+		QApplication::restoreOverrideCursor();
 	}
+	row = qBound(0, row - first, model->rowCount() - 1);
+
+	QModelIndex left = model->index(row, column);
 
 	ui.tableView->selectionModel()->select(QItemSelection(left, left),
 										   QItemSelectionModel::ClearAndSelect);
 	ui.tableView->setCurrentIndex(left);
+	// SqlResultModel reads the block around the row on demand
+	ui.tableView->scrollTo(left, QAbstractItemView::PositionAtCenter);
 }
 
 void DataViewer::actOpenEditor_triggered()
@@ -10,6 +10,7 @@ for which a new license (GPL+exception) is in place.
 
 #include <QMainWindow>
 #include "ui_dataviewer.h"
+#include "sqlprofile.h"
 
 class QAbstractItemModel;
 class QTableView;
@@ -41,13 +42,15 @@ class DataViewer : public QMainWindow
 		//! \brief Show/hide status widget
 		void showStatusText(bool show);
 
-		QSqlQueryModel* tableData();
+		QAbstractItemModel* tableData();
 		QStringList tableHeader();
 
 		QByteArray saveSplitter() { return ui.splitter->saveState(); };
 		void restoreSplitter(QByteArray state) { ui.splitter->restoreState(state); };
 
 		static const QString canFetchMore();
+		//! \brief Rows above the Goto Line target kept in the table browser window
+		static const int GotoMargin = 100;
 
 		/*! \brief Free locked resources */
 		void freeResources();
@@ -57,10 +60,22 @@ class DataViewer : public QMainWindow
 		void showSqlScriptResult(QString line);
 		//! \brief Clean the "Script Result" report
 		void sqlScriptStart();
+		//! \brief Append the statement statistics to the "Profile" tab.
+		void addProfile(const SqlStatementProfile & profile);
+		/*! \brief Set sqlite3_profile() time of the latest run of the statement.
+		The main connection reports it when the statement is finished - it can
+		be much later than addProfile() for not fully fetched SELECTs. */
+		void setProfileTime(const QString & statement, qint64 vmTime);
+		//! \brief Show EXPLAIN QUERY PLAN tree of the statement in the "Query Plan" tab.
+		void showQueryPlan(const QString & statement);
+		//! \brief Show EXPLAIN bytecode with its loops in the "Query Plan" tab.
+		void showBytecode(const QString & statement);
 
 	private:
 		Ui::DataViewer ui;
 		bool dataResized;
+		//! \brief Buttons state for the current model. See setTableModel().
+		bool m_showButtons;
 
         QAction * actOpenEditor;
         QAction * actInsertNull;
@@ -101,6 +116,8 @@ class DataViewer : public QMainWindow
 		void handleBlobPreview(bool);
 		void tableView_selectionChanged(const QItemSelection &, const QItemSelection &);
 		void tableView_dataResized(int column, int oldWidth, int newWidth);
+		//! \brief Handle rows appended asynchronously (SqlResultModel).
+		void tableModel_rowsInserted(const QModelIndex &, int start, int);
 
 		//! \brief Set position in the models when user switches his views.
 		void tabWidget_currentChanged(int);
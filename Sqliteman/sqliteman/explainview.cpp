@@ -0,0 +1,304 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlError>
+#include <QHeaderView>
+#include <QRegExp>
+#include <QStack>
+#include <QFont>
+
+#include "explainview.h"
+#include "database.h"
+
+
+ExplainView::ExplainView(QWidget * parent)
+	: QTreeWidget(parent)
+{
+	setAlternatingRowColors(true);
+	setUniformRowHeights(true);
+}
+
+void ExplainView::setHeader(const QStringList & labels)
+{
+	clear();
+	setColumnCount(labels.count());
+	setHeaderLabels(labels);
+}
+
+QTreeWidgetItem * ExplainView::planItem(QTreeWidgetItem * parent, const QString & detail)
+{
+	QTreeWidgetItem * item = parent ? new QTreeWidgetItem(parent) : new QTreeWidgetItem(this);
+	item->setText(0, detail);
+
+	QString d(detail.toUpper());
+	QRegExp index("(?:USING|WITH) (?:COVERING |AUTOMATIC )*INDEX (\\S+)", Qt::CaseInsensitive);
+	bool keyed = false;
+	if (index.indexIn(detail) != -1)
+	{
+		item->setText(2, index.cap(1));
+		keyed = true;
+	}
+	else if (d.contains("PRIMARY KEY"))
+	{
+		item->setText(2, "PRIMARY KEY");
+		keyed = true;
+	}
+
+	QRegExp rows("\\(~(\\d+) rows?\\)", Qt::CaseInsensitive);
+	if (rows.indexIn(detail) != -1)
+	{
+		item->setText(3, rows.cap(1));
+		item->setTextAlignment(3, Qt::AlignRight);
+	}
+
+	bool fullScan = false;
+	if (d.startsWith("SCAN"))
+	{
+		item->setText(1, tr("Scan"));
+		fullScan = !keyed && !d.contains("VIRTUAL TABLE") && d.contains("TABLE");
+	}
+	else if (d.startsWith("SEARCH"))
+		item->setText(1, tr("Search"));
+	else if (d.contains("TEMP B-TREE"))
+		item->setText(1, tr("Temp B-Tree"));
+	else if (d.contains("SUBQUER"))
+		item->setText(1, tr("Subquery"));
+	// old libraries: "TABLE x [AS y] [WITH INDEX i] [ORDER BY]"
+	else if (d.startsWith("TABLE "))
+	{
+		item->setText(1, keyed ? tr("Search") : tr("Scan"));
+		fullScan = !keyed;
+	}
+
+	if (fullScan)
+	{
+		for (int i = 0; i < columnCount(); ++i)
+			item->setForeground(i, Qt::red);
+		item->setToolTip(0, tr("Full table scan"));
+	}
+	return item;
+}
+
+void ExplainView::addSelect(int select, QTreeWidgetItem * parent,
+							const QMap<int,PlanRows> & selects, QSet<int> & done)
+{
+	done.insert(select);
+
+	// loops are nested by their "order". Other rows belong to the select.
+	QMap<int,QTreeWidgetItem*> loops;
+	QRegExp subquery("SUBQUER(?:Y|IES) (\\d+)(?: AND (\\d+))?", Qt::CaseInsensitive);
+	foreach (PlanRows::value_type row, selects.value(select))
+	{
+		QString d(row.second.toUpper());
+		bool loop = d.startsWith("SCAN") || d.startsWith("SEARCH");
+		QTreeWidgetItem * item = planItem(loop ? loops.value(row.first - 1, parent) : parent,
+										  row.second);
+		if (loop)
+			loops[row.first] = item;
+
+		if (subquery.indexIn(row.second) != -1)
+		{
+			for (int i = 1; i <= 2; ++i)
+			{
+				bool ok;
+				int id = subquery.cap(i).toInt(&ok);
+				if (ok && selects.contains(id) && !done.contains(id))
+					addSelect(id, item, selects, done);
+			}
+		}
+	}
+}
+
+QString ExplainView::showPlan(const QString & statement)
+{
+	setHeader(QStringList() << tr("Plan") << tr("Operation")
+						    << tr("Index") << tr("Estimated Rows"));
+
+	QSqlQuery query(QSqlDatabase::database(SESSION_NAME));
+	if (!query.exec("EXPLAIN QUERY PLAN " + statement))
+		return query.lastError().text();
+
+	QSqlRecord rec(query.record());
+	int detail = rec.indexOf("detail");
+	if (detail == -1)
+		detail = rec.count() - 1;
+	int id = rec.indexOf("id");
+	int parent = rec.indexOf("parent");
+	int selectId = rec.indexOf("selectid");
+	int order = rec.indexOf("order");
+
+	if (id != -1 && parent != -1)
+	{
+		// the tree is provided by the library
+		QMap<int,QTreeWidgetItem*> nodes;
+		while (query.next())
+		{
+			QTreeWidgetItem * p = nodes.value(query.value(parent).toInt(), 0);
+			nodes[query.value(id).toInt()] = planItem(p, query.value(detail).toString());
+		}
+	}
+	else
+	{
+		// old formats have no subqueries or they are numbered by "selectid"
+		QMap<int,PlanRows> selects;
+		while (query.next())
+		{
+			int select = (selectId == -1) ? 0 : query.value(selectId).toInt();
+			int level = (order == -1) ? 0 : query.value(order).toInt();
+			QString text(query.value(detail).toString());
+			// no keyword in the oldest format. Every row is a loop.
+			if (selectId == -1)
+				text = text.startsWith("TABLE ", Qt::CaseInsensitive) ? text : "TABLE " + text;
+			selects[select].append(qMakePair(level, text));
+		}
+
+		QSet<int> done;
+		foreach (int select, selects.keys())
+		{
+			if (done.contains(select))
+				continue;
+			QTreeWidgetItem * p = 0;
+			if (select != 0)
+				p = planItem(0, tr("SUBQUERY %1").arg(select));
+			addSelect(select, p, selects, done);
+		}
+	}
+
+	expandAll();
+	for (int i = 0; i < columnCount(); ++i)
+		resizeColumnToContents(i);
+	return QString();
+}
+
+QMap<QString,ExplainView::CursorObject> ExplainView::rootPages()
+{
+	QMap<QString,CursorObject> ret;
+	QSqlQuery dbs("PRAGMA database_list;", QSqlDatabase::database(SESSION_NAME));
+	while (dbs.next())
+	{
+		QString seq(dbs.value(0).toString());
+		QString schema(dbs.value(1).toString());
+		QSqlQuery q(QString("SELECT rootpage, name, tbl_name FROM %1 WHERE rootpage > 0;")
+						.arg(Database::getMaster(schema)),
+					QSqlDatabase::database(SESSION_NAME));
+		while (q.next())
+		{
+			CursorObject o;
+			o.name = q.value(1).toString();
+			o.table = q.value(2).toString();
+			o.schema = schema;
+			ret[seq + "." + q.value(0).toString()] = o;
+		}
+	}
+	return ret;
+}
+
+QString ExplainView::showBytecode(const QString & statement)
+{
+	setHeader(QStringList() << tr("Address") << tr("Opcode")
+						    << "P1" << "P2" << "P3" << "P4" << "P5" << tr("Comment"));
+
+	QSqlQuery query(QSqlDatabase::database(SESSION_NAME));
+	if (!query.exec("EXPLAIN " + statement))
+		return query.lastError().text();
+
+	QList<QStringList> ops;
+	while (query.next())
+	{
+		QStringList op;
+		for (int i = 0; i < query.record().count() && i < 8; ++i)
+			op << query.value(i).toString();
+		while (op.count() < 8)
+			op << QString();
+		ops.append(op);
+	}
+
+	// objects iterated by cursors
+	QMap<QString,CursorObject> pages(rootPages());
+	QMap<int,CursorObject> cursors;
+	QRegExp openTemp("^(OpenEphemeral|OpenAutoindex|OpenPseudo|SorterOpen)$");
+	foreach (QStringList op, ops)
+	{
+		if (op.at(1) == "OpenRead" || op.at(1) == "OpenWrite")
+			cursors[op.at(2).toInt()] = pages.value(op.at(4) + "." + op.at(3));
+		else if (openTemp.exactMatch(op.at(1)))
+		{
+			CursorObject o;
+			o.name = tr("temporary b-tree");
+			cursors[op.at(2).toInt()] = o;
+		}
+	}
+
+	// a loop is a backward jump of Next/Prev. Outer loops first.
+	QMap<QPair<int,int>,BytecodeLoop> loops;
+	QRegExp next("^(Sorter|V)?(Next|Prev)(Idx|IfOpen)?$");
+	foreach (QStringList op, ops)
+	{
+		int addr = op.at(0).toInt();
+		int target = op.at(3).toInt();
+		if (next.exactMatch(op.at(1)) && target < addr)
+		{
+			BytecodeLoop l;
+			l.start = target;
+			l.end = addr;
+			l.cursor = op.at(2).toInt();
+			loops.insert(qMakePair(l.start, -l.end), l);
+		}
+	}
+
+	QStack<QPair<int,QTreeWidgetItem*> > open;
+	QMap<QPair<int,int>,BytecodeLoop>::const_iterator loop = loops.constBegin();
+	foreach (QStringList op, ops)
+	{
+		int addr = op.at(0).toInt();
+		while (!open.isEmpty() && addr > open.top().first)
+			open.pop();
+
+		while (loop != loops.constEnd() && loop.value().start <= addr)
+		{
+			QTreeWidgetItem * p = open.isEmpty() ? 0 : open.top().second;
+			QTreeWidgetItem * item = p ? new QTreeWidgetItem(p) : new QTreeWidgetItem(this);
+			const BytecodeLoop & l = loop.value();
+			CursorObject o(cursors.value(l.cursor));
+			// Rewind/Last before the loop = the whole object is read
+			bool scan = l.start > 0 && l.start - 1 < ops.count()
+						&& (ops.at(l.start - 1).at(1) == "Rewind"
+							|| ops.at(l.start - 1).at(1) == "Last");
+			item->setText(0, QString("%1-%2").arg(l.start).arg(l.end));
+			item->setText(1, scan ? tr("Scan") : tr("Loop"));
+			item->setText(7, o.name.isEmpty() ? tr("cursor %1").arg(l.cursor) : o.name);
+			if (!o.table.isEmpty())
+			{
+				qint64 rows = Database::statRowCount(o.table, o.schema);
+				if (rows >= 0)
+					item->setText(7, tr("%1 (%2 rows in sqlite_stat1)").arg(o.name).arg(rows));
+			}
+			QFont f(item->font(0));
+			f.setBold(true);
+			for (int i = 0; i < columnCount(); ++i)
+			{
+				item->setFont(i, f);
+				if (scan && !o.table.isEmpty())
+					item->setForeground(i, Qt::red);
+			}
+			open.push(qMakePair(l.end, item));
+			++loop;
+		}
+
+		QTreeWidgetItem * p = open.isEmpty() ? 0 : open.top().second;
+		QTreeWidgetItem * item = p ? new QTreeWidgetItem(p) : new QTreeWidgetItem(this);
+		for (int i = 0; i < op.count(); ++i)
+			item->setText(i, op.at(i));
+	}
+
+	expandAll();
+	for (int i = 0; i < columnCount(); ++i)
+		resizeColumnToContents(i);
+	return QString();
+}
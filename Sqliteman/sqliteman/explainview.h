@@ -0,0 +1,77 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef EXPLAINVIEW_H
+#define EXPLAINVIEW_H
+
+#include <QTreeWidget>
+#include <QMap>
+#include <QSet>
+#include <QPair>
+
+
+/*! \brief Display EXPLAIN QUERY PLAN and EXPLAIN results as trees.
+The query plan is rendered as nested scan/search/temp b-tree
+nodes with the used index and estimated rows when the sqlite
+library reports them. It handles all known output formats:
+ - "order, from, detail" (old libraries) - each row is nested
+   into the previous one as it is the join loop order,
+ - "selectid, order, from, detail" - subqueries are nested into
+   the rows which execute them,
+ - "id, parent, notused, detail" - the tree is provided by sqlite.
+
+The bytecode mode nests opcodes into the loops found by backward
+Next/Prev jumps. Each loop shows the table or index it iterates and
+its row count from sqlite_stat1, so the dominant loop of a join
+is visible.
+*/
+class ExplainView : public QTreeWidget
+{
+	Q_OBJECT
+
+	public:
+		ExplainView(QWidget * parent = 0);
+
+		/*! \brief Run EXPLAIN QUERY PLAN for the statement.
+		\retval QString an error message. Empty on success. */
+		QString showPlan(const QString & statement);
+		/*! \brief Run EXPLAIN for the statement.
+		\retval QString an error message. Empty on success. */
+		QString showBytecode(const QString & statement);
+
+	private:
+		//! \brief An object opened by OpenRead/OpenWrite.
+		typedef struct
+		{
+			QString name;
+			QString table;
+			QString schema;
+		}
+		CursorObject;
+		//! \brief A bytecode loop: addresses from start to the Next/Prev at end.
+		typedef struct
+		{
+			int start;
+			int end;
+			int cursor;
+		}
+		BytecodeLoop;
+		//! \brief "order" and "detail" of the query plan rows for one select.
+		typedef QList<QPair<int,QString> > PlanRows;
+
+		//! \brief Add the plan node. Detail text is parsed for columns.
+		QTreeWidgetItem * planItem(QTreeWidgetItem * parent, const QString & detail);
+		/*! \brief Add rows of the select (and its subqueries) into the parent.
+		\param done selects already displayed. */
+		void addSelect(int select, QTreeWidgetItem * parent,
+					   const QMap<int,PlanRows> & selects, QSet<int> & done);
+		//! \brief Map of rootpage "schema.page" -> object. For EXPLAIN cursors.
+		QMap<QString,CursorObject> rootPages();
+		void setHeader(const QStringList & labels);
+};
+
+#endif
@@ -0,0 +1,187 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QIODevice>
+
+#include "exportwriter.h"
+
+
+ExportWriter::ExportWriter()
+	: m_device(0),
+	  m_codec(0),
+	  m_state(0),
+	  m_data(0),
+	  m_size(0),
+	  m_written(0)
+{
+}
+
+ExportWriter::~ExportWriter()
+{
+	delete m_state;
+}
+
+void ExportWriter::setDevice(QIODevice * device, QTextCodec * codec)
+{
+	m_device = device;
+	// MIBenum 106 is UTF-8 - no conversion
+	m_codec = (codec && codec->mibEnum() != 106) ? codec : 0;
+	delete m_state;
+	// no BOM as QTextStream does by default
+	m_state = m_codec ? new QTextCodec::ConverterState(QTextCodec::IgnoreHeader) : 0;
+	m_buffer.resize(BufferSize + BufferSize / 4);
+	m_data = m_buffer.data();
+	m_size = 0;
+	m_written = 0;
+	m_error = QString();
+}
+
+void ExportWriter::append(const QString & s, Escape escape)
+{
+	QByteArray utf8(s.toUtf8());
+	appendEscaped(utf8.constData(), utf8.size(), escape);
+}
+
+void ExportWriter::appendEscaped(const char * data, int size, Escape escape)
+{
+	if (escape == Raw)
+	{
+		put(data, size);
+		return;
+	}
+
+	// runs without special characters are copied at once
+	const char * run = data;
+	const char * end = data + size;
+	for (const char * p = data; p < end; ++p)
+	{
+		// all the escaped characters are below '@' except the JSON backslash
+		if (uchar(*p) >= '@' && *p != '\\')
+			continue;
+
+		const char * replacement = 0;
+		char control[7];
+		switch (escape)
+		{
+			case CsvQuote:
+				if (*p == '"')
+					replacement = "\"\"";
+				else if (*p == '\n')
+					replacement = "\\n";
+				break;
+			case Xml:
+				if (*p == '&')
+					replacement = "&amp;";
+				else if (*p == '<')
+					replacement = "&lt;";
+				else if (*p == '>')
+					replacement = "&gt;";
+				else if (*p == '"')
+					replacement = "&quot;";
+				break;
+			case SqlQuote:
+				if (*p == '\'')
+					replacement = "''";
+				break;
+			case Json:
+				if (*p == '"')
+					replacement = "\\\"";
+				else if (*p == '\\')
+					replacement = "\\\\";
+				else if (*p == '\n')
+					replacement = "\\n";
+				else if (*p == '\r')
+					replacement = "\\r";
+				else if (*p == '\t')
+					replacement = "\\t";
+				else if (uchar(*p) < 0x20)
+				{
+					qsnprintf(control, sizeof(control), "\\u%04x", uchar(*p));
+					replacement = control;
+				}
+				break;
+			case Raw:
+				break;
+		}
+		if (!replacement)
+			continue;
+		put(run, p - run);
+		append(replacement);
+		run = p + 1;
+	}
+	put(run, end - run);
+}
+
+void ExportWriter::appendNumber(qint64 value)
+{
+	char digits[24];
+	char * p = digits + sizeof(digits);
+	// the minimum cannot be negated
+	quint64 u = (value < 0) ? quint64(0) - quint64(value) : quint64(value);
+	do
+	{
+		*--p = char('0' + u % 10);
+		u /= 10;
+	}
+	while (u);
+	if (value < 0)
+		*--p = '-';
+	put(p, digits + sizeof(digits) - p);
+}
+
+void ExportWriter::appendNumber(double value)
+{
+	append(QByteArray::number(value, 'g', 15));
+}
+
+void ExportWriter::grow(int size)
+{
+	// a huge value does not fit into the default buffer
+	m_buffer.resize(qMax(m_buffer.size() * 2, m_size + size));
+	m_data = m_buffer.data();
+}
+
+bool ExportWriter::flush()
+{
+	if (m_size == 0 || failed())
+	{
+		m_size = 0;
+		return !failed();
+	}
+
+	qint64 written;
+	if (m_codec)
+	{
+		QString text(QString::fromUtf8(m_data, m_size));
+		QByteArray encoded(m_codec->fromUnicode(text.constData(), text.size(), m_state));
+		written = (m_device->write(encoded) == encoded.size()) ? encoded.size() : -1;
+	}
+	else
+		written = (m_device->write(m_data, m_size) == m_size) ? m_size : -1;
+	m_size = 0;
+
+	if (written < 0)
+	{
+		m_error = tr("Cannot write the output: %1").arg(m_device->errorString());
+		return false;
+	}
+	m_written += written;
+	return true;
+}
+
+bool ExportWriter::writeEncoded(const QByteArray & data)
+{
+	if (!flush())
+		return false;
+	if (m_device->write(data) != data.size())
+	{
+		m_error = tr("Cannot write the output: %1").arg(m_device->errorString());
+		return false;
+	}
+	m_written += data.size();
+	return true;
+}
@@ -0,0 +1,117 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef EXPORTWRITER_H
+#define EXPORTWRITER_H
+
+#include <cstring>
+
+#include <QCoreApplication>
+#include <QByteArray>
+#include <QTextCodec>
+
+class QIODevice;
+
+
+/*! \brief Buffered output of the exports.
+Everything is appended as UTF-8 bytes into one large buffer which
+is written to the device when it's full. Values are escaped in one
+scan of their UTF-8 bytes - the escaped characters are ASCII so they
+cannot be a part of a multibyte sequence. Texts from sqlite are
+copied as they are, without any QString.
+
+Output in other encodings than UTF-8 is converted by the codec
+chunk by chunk in flush(). Call endRow() at the row ends only so
+the chunks are never split inside a UTF-8 sequence.
+*/
+class ExportWriter
+{
+		Q_DECLARE_TR_FUNCTIONS(ExportWriter)
+
+	public:
+		//! \brief The buffer is written out when it's bigger
+		static const int BufferSize = 1024 * 1024;
+
+		enum Escape
+		{
+			//! \brief No escaping
+			Raw,
+			//! \brief " to "" and new line to \n (the CSV export)
+			CsvQuote,
+			//! \brief &, <, > and " to the entities
+			Xml,
+			//! \brief ' to ''
+			SqlQuote,
+			//! \brief ", \ and control characters to the JSON string escapes
+			Json
+		};
+
+		ExportWriter();
+		~ExportWriter();
+
+		/*! \brief Start writing into an opened device.
+		\param codec the output encoding. 0 for UTF-8. */
+		void setDevice(QIODevice * device, QTextCodec * codec = 0);
+
+		void append(char c) { put(&c, 1); };
+		//! \brief Append ASCII or UTF-8 bytes as they are.
+		void append(const char * data, int size) { put(data, size); };
+		void append(const char * s) { put(s, qstrlen(s)); };
+		void append(const QByteArray & data) { put(data.constData(), data.size()); };
+		void append(const QString & s, Escape escape = Raw);
+		//! \brief Append UTF-8 bytes with the escaping.
+		void appendEscaped(const char * data, int size, Escape escape);
+		void appendNumber(qint64 value);
+		//! \brief The same text as QVariant::toString() of a double.
+		void appendNumber(double value);
+
+		//! \brief Flush the buffer when it's full. Call it after each row.
+		void endRow() { if (m_size >= BufferSize) flush(); };
+		/*! \brief Write the buffer to the device.
+		\retval bool false when the device failed. See errorString(). */
+		bool flush();
+		/*! \brief Write bytes in the output encoding already (e.g. the
+		output of other writer). The buffer is flushed first. */
+		bool writeEncoded(const QByteArray & data);
+
+		//! \brief True when a write failed. Rows appended since are lost.
+		bool failed() const { return !m_error.isEmpty(); };
+		QString errorString() const { return m_error; };
+		//! \brief Fail the output. Nothing is written to the device since.
+		void setError(const QString & error) { m_error = error; };
+		//! \brief Bytes written to the device so far.
+		qint64 bytesWritten() const { return m_written; };
+		//! \brief UTF-8 bytes in the buffer not written yet.
+		int pending() const { return m_size; };
+
+	private:
+		Q_DISABLE_COPY(ExportWriter)
+
+		QIODevice * m_device;
+		QTextCodec * m_codec;
+		//! \brief State of the codec between the chunks. 0 for UTF-8.
+		QTextCodec::ConverterState * m_state;
+		/*! \brief Storage of the buffer. Its size is the capacity. Qt
+		frees the data on resize(0) so the used part is m_size. */
+		QByteArray m_buffer;
+		char * m_data;
+		int m_size;
+		qint64 m_written;
+		QString m_error;
+
+		void put(const char * data, int size)
+		{
+			if (m_size + size > m_buffer.size())
+				grow(size);
+			memcpy(m_data + m_size, data, size);
+			m_size += size;
+		};
+		//! \brief Make room for size more bytes.
+		void grow(int size);
+};
+
+#endif
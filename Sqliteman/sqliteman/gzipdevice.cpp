@@ -0,0 +1,221 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QCoreApplication>
+
+#include "gzipdevice.h"
+
+// zlib window bits + 16 = gzip header and trailer instead of the zlib ones
+#define GZIP_WBITS (MAX_WBITS + 16)
+
+
+GzipDevice::GzipDevice(const QString & fileName, int level)
+	: QIODevice(),
+	  m_file(fileName),
+	  m_level(level),
+	  m_active(false),
+	  m_end(false),
+	  m_failed(false),
+	  m_compressed(0)
+{
+}
+
+GzipDevice::~GzipDevice()
+{
+	close();
+}
+
+bool GzipDevice::isGzip(const QString & fileName)
+{
+	QFile f(fileName);
+	if (!f.open(QIODevice::ReadOnly))
+		return false;
+	return f.read(2) == "\x1f\x8b";
+}
+
+void GzipDevice::setError(const QString & message)
+{
+	m_failed = true;
+	setErrorString(message);
+}
+
+void GzipDevice::setZlibError(const QString & message)
+{
+	setError(QCoreApplication::translate("GzipDevice", "%1 %2: %3")
+				   .arg(message).arg(m_file.fileName()).arg(m_zstream.msg ? m_zstream.msg : ""));
+}
+
+bool GzipDevice::open(OpenMode mode)
+{
+	bool writing = (mode & QIODevice::WriteOnly);
+	if (writing && (mode & QIODevice::ReadOnly))
+	{
+		setError(QCoreApplication::translate("GzipDevice", "A gzip file cannot be read and written at once."));
+		return false;
+	}
+	if (!m_file.open(writing ? QIODevice::WriteOnly | QIODevice::Truncate : QIODevice::ReadOnly))
+	{
+		setError(m_file.errorString());
+		return false;
+	}
+
+	memset(&m_zstream, 0, sizeof(m_zstream));
+	int rc = writing
+			 ? deflateInit2(&m_zstream, m_level, Z_DEFLATED, GZIP_WBITS, 8, Z_DEFAULT_STRATEGY)
+			 : inflateInit2(&m_zstream, GZIP_WBITS);
+	if (rc != Z_OK)
+	{
+		setZlibError(QCoreApplication::translate("GzipDevice", "Cannot initialize zlib for"));
+		m_file.close();
+		return false;
+	}
+	m_active = true;
+	m_end = false;
+	m_failed = false;
+	m_compressed = 0;
+	m_buffer.resize(ChunkSize);
+	if (!writing)
+		m_zstream.avail_in = 0;
+	return QIODevice::open(mode);
+}
+
+bool GzipDevice::finish()
+{
+	bool ret = true;
+	if (m_active)
+	{
+		if (openMode() & QIODevice::WriteOnly)
+		{
+			ret = deflateOut(Z_FINISH);
+			deflateEnd(&m_zstream);
+		}
+		else
+			inflateEnd(&m_zstream);
+		m_active = false;
+	}
+	if (m_file.isOpen())
+	{
+		m_file.close();
+		if (m_file.error() != QFile::NoError && ret)
+		{
+			setError(m_file.errorString());
+			ret = false;
+		}
+	}
+	return ret;
+}
+
+void GzipDevice::close()
+{
+	finish();
+	QIODevice::close();
+}
+
+qint64 GzipDevice::bytesAvailable() const
+{
+	// the uncompressed size is not known
+	return (m_end ? 0 : ChunkSize) + QIODevice::bytesAvailable();
+}
+
+bool GzipDevice::deflateOut(int flush)
+{
+	int rc;
+	do
+	{
+		m_zstream.next_out = reinterpret_cast<Bytef*>(m_buffer.data());
+		m_zstream.avail_out = m_buffer.size();
+		rc = deflate(&m_zstream, flush);
+		if (rc == Z_STREAM_ERROR)
+		{
+			setZlibError(QCoreApplication::translate("GzipDevice", "Cannot compress"));
+			return false;
+		}
+		qint64 n = m_buffer.size() - m_zstream.avail_out;
+		if (n > 0 && m_file.write(m_buffer.constData(), n) != n)
+		{
+			setError(m_file.errorString());
+			return false;
+		}
+		m_compressed += n;
+	}
+	// a full output chunk means there can be more
+	while (m_zstream.avail_out == 0 || (flush == Z_FINISH && rc != Z_STREAM_END));
+	return true;
+}
+
+qint64 GzipDevice::writeData(const char * data, qint64 maxSize)
+{
+	if (!m_active)
+		return -1;
+	// zlib takes uInt sizes
+	qint64 done = 0;
+	while (done < maxSize)
+	{
+		uInt n = uInt(qMin(maxSize - done, qint64(0x40000000)));
+		m_zstream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data + done));
+		m_zstream.avail_in = n;
+		if (!deflateOut(Z_NO_FLUSH))
+			return -1;
+		done += n;
+	}
+	return done;
+}
+
+qint64 GzipDevice::readData(char * data, qint64 maxSize)
+{
+	if (m_end || !m_active)
+		return 0;
+
+	m_zstream.next_out = reinterpret_cast<Bytef*>(data);
+	m_zstream.avail_out = uInt(qMin(maxSize, qint64(0x7fffffff)));
+	uInt wanted = m_zstream.avail_out;
+	while (m_zstream.avail_out == wanted)
+	{
+		if (m_zstream.avail_in == 0 && !m_file.atEnd())
+		{
+			qint64 n = m_file.read(m_buffer.data(), m_buffer.size());
+			if (n < 0)
+			{
+				setError(m_file.errorString());
+				m_end = true;
+				return -1;
+			}
+			m_compressed += n;
+			m_zstream.next_in = reinterpret_cast<Bytef*>(m_buffer.data());
+			m_zstream.avail_in = uInt(n);
+		}
+
+		// inflate can still have a pending output without any input
+		int rc = inflate(&m_zstream, Z_NO_FLUSH);
+		if (rc == Z_BUF_ERROR && m_zstream.avail_in == 0 && m_file.atEnd())
+		{
+			setError(QCoreApplication::translate("GzipDevice", "Unexpected end of the file %1").arg(m_file.fileName()));
+			m_end = true;
+			// return what is there - the caller checks errorString()
+			break;
+		}
+		if (rc == Z_STREAM_END)
+		{
+			// the next member follows (cat a.gz b.gz)
+			if (m_zstream.avail_in > 0 || !m_file.atEnd())
+			{
+				inflateReset(&m_zstream);
+				continue;
+			}
+			m_end = true;
+			break;
+		}
+		if (rc != Z_OK)
+		{
+			setZlibError(QCoreApplication::translate("GzipDevice", "Cannot decompress"));
+			m_end = true;
+			return -1;
+		}
+	}
+
+	return wanted - m_zstream.avail_out;
+}
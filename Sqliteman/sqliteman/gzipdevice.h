@@ -0,0 +1,78 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef GZIPDEVICE_H
+#define GZIPDEVICE_H
+
+#include <QFile>
+
+#include <zlib.h>
+
+
+/*! \brief A sequential device reading or writing a gzip file.
+Data are inflated or deflated by ChunkSize blocks on the fly so
+nothing is written or read twice. Reading handles files with
+more gzip members (e.g. concatenated by cat) too.
+
+The written file is complete after finish() (close() calls it).
+Check its result - the last block is written there.
+*/
+class GzipDevice : public QIODevice
+{
+	public:
+		//! \brief Chunk of the compressed data read or written at once
+		static const int ChunkSize = 64 * 1024;
+
+		/*! \param level zlib compression level for writing.
+		The default one is a good compromise of speed and size. */
+		GzipDevice(const QString & fileName, int level = Z_DEFAULT_COMPRESSION);
+		~GzipDevice();
+
+		//! \brief ReadOnly or WriteOnly only.
+		bool open(OpenMode mode);
+		void close();
+		/*! \brief Write the rest of the compressed data and close the file.
+		\retval bool false on write error. See errorString(). */
+		bool finish();
+		bool isSequential() const { return true; };
+		//! \brief An error occurred. QIODevice has no error state itself.
+		bool failed() const { return m_failed; };
+		qint64 bytesAvailable() const;
+
+		//! \brief Compressed bytes read or written so far.
+		qint64 compressedPosition() const { return m_compressed; };
+		//! \brief Size of the gzip file.
+		qint64 compressedSize() const { return m_file.size(); };
+		QString fileName() const { return m_file.fileName(); };
+
+		//! \brief True when the file starts with the gzip magic number.
+		static bool isGzip(const QString & fileName);
+
+	protected:
+		qint64 readData(char * data, qint64 maxSize);
+		qint64 writeData(const char * data, qint64 maxSize);
+
+	private:
+		QFile m_file;
+		int m_level;
+		z_stream m_zstream;
+		//! \brief The zstream is initialized
+		bool m_active;
+		bool m_end;
+		bool m_failed;
+		//! \brief Compressed input or output chunk
+		QByteArray m_buffer;
+		qint64 m_compressed;
+
+		/*! \brief Deflate the input of the zstream and write it out.
+		\param flush Z_NO_FLUSH or Z_FINISH. */
+		bool deflateOut(int flush);
+		void setError(const QString & message);
+		void setZlibError(const QString & message);
+};
+
+#endif
@@ -0,0 +1,79 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QSettings>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QFile>
+
+#include "importcheckpoint.h"
+#include "gzipdevice.h"
+
+
+ImportCheckpoint::ImportCheckpoint(const QString & fileName, const QString & schema, const QString & table)
+	: m_fileName(QFileInfo(fileName).absoluteFilePath()),
+	  m_schema(schema),
+	  m_table(table),
+	  m_offset(0),
+	  m_row(0)
+{
+}
+
+QString ImportCheckpoint::stateFile(const QString & fileName)
+{
+	return QFileInfo(fileName).absoluteFilePath() + ".sqliteman-import";
+}
+
+bool ImportCheckpoint::load()
+{
+	m_offset = 0;
+	m_row = 0;
+	if (!QFile::exists(stateFile(m_fileName)))
+		return false;
+
+	QSettings s(stateFile(m_fileName), QSettings::IniFormat);
+	QFileInfo fi(m_fileName);
+	// the file was changed or replaced - offsets mean nothing now
+	if (s.value("import/file").toString() != m_fileName
+		|| s.value("import/schema").toString() != m_schema
+		|| s.value("import/table").toString() != m_table
+		|| s.value("import/size").toLongLong() != fi.size()
+		|| s.value("import/modified").toUInt() != fi.lastModified().toTime_t())
+		return false;
+
+	qint64 offset = s.value("import/offset", 0).toLongLong();
+	qint64 row = s.value("import/row", 0).toLongLong();
+	// gzip offsets are in the uncompressed data - bigger than the file
+	if (offset <= 0 || row <= 0
+		|| (offset > fi.size() && !GzipDevice::isGzip(m_fileName)))
+		return false;
+	m_offset = offset;
+	m_row = row;
+	return true;
+}
+
+void ImportCheckpoint::save(qint64 offset, qint64 row)
+{
+	QFileInfo fi(m_fileName);
+	QSettings s(stateFile(m_fileName), QSettings::IniFormat);
+	s.setValue("import/file", m_fileName);
+	s.setValue("import/schema", m_schema);
+	s.setValue("import/table", m_table);
+	s.setValue("import/size", fi.size());
+	s.setValue("import/modified", fi.lastModified().toTime_t());
+	s.setValue("import/offset", offset);
+	s.setValue("import/row", row);
+	// it has to be on the disk before the next batch
+	s.sync();
+}
+
+void ImportCheckpoint::remove()
+{
+	QFile::remove(stateFile(m_fileName));
+	m_offset = 0;
+	m_row = 0;
+}
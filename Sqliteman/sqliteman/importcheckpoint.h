@@ -0,0 +1,56 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef IMPORTCHECKPOINT_H
+#define IMPORTCHECKPOINT_H
+
+#include <QString>
+
+
+/*! \brief State of an interrupted CSV import.
+The state is kept in a small INI file next to the imported file
+(see stateFile()). It's saved after each committed batch: the byte
+offset of the next record, the count of the rows done and the
+file size and modification time. The offset is always at a record
+start so the import can continue with CSVReader::seek() without
+reading the committed part again.
+
+The state is valid only for the same target table and an unchanged
+file. It's removed when the import is committed completely.
+*/
+class ImportCheckpoint
+{
+	public:
+		ImportCheckpoint(const QString & fileName, const QString & schema, const QString & table);
+
+		/*! \brief Read the saved state.
+		\retval bool true when there is a valid state to resume from. */
+		bool load();
+		/*! \brief Remember the committed position.
+		Errors are ignored - the import works without the state too
+		(e.g. in a read-only directory). It can be called from any thread.
+		\param offset bytes of the file already imported.
+		\param row rows of the file already imported (without header). */
+		void save(qint64 offset, qint64 row);
+		//! \brief Forget the state. The import is done or started again.
+		void remove();
+
+		qint64 offset() const { return m_offset; };
+		qint64 row() const { return m_row; };
+
+		//! \brief Name of the state file for the imported file.
+		static QString stateFile(const QString & fileName);
+
+	private:
+		QString m_fileName;
+		QString m_schema;
+		QString m_table;
+		qint64 m_offset;
+		qint64 m_row;
+};
+
+#endif
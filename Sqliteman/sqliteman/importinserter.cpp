@@ -0,0 +1,262 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include "importinserter.h"
+#include "bulkload.h"
+
+
+ImportInserter::ImportInserter(sqlite3 * db, const QString & schema, const QString & table,
+							   const FieldList & fields, int batchSize)
+	: m_db(db),
+	  m_stmt(0),
+	  m_schema(schema),
+	  m_table(table),
+	  m_batchSize(batchSize),
+	  m_pending(0),
+	  m_committed(0),
+	  m_nested(false),
+	  m_fatal(false),
+	  m_bulkLoad(false),
+	  m_nullValues(false),
+	  m_base64Blobs(false),
+	  m_bulk(0)
+{
+	QStringList binds;
+	foreach (DatabaseTableField f, fields)
+	{
+		m_affinity.append(affinity(f.type));
+		m_notNull.append(f.notnull);
+		m_blob.append(f.type.contains("BLOB", Qt::CaseInsensitive));
+		binds << "?";
+	}
+	m_sql = QString("insert into \"%1\".\"%2\" values (%3);")
+				.arg(schema, table, binds.join(", "));
+}
+
+ImportInserter::~ImportInserter()
+{
+	if (m_stmt)
+		sqlite3_finalize(m_stmt);
+	delete m_bulk;
+}
+
+ImportInserter::Affinity ImportInserter::affinity(const QString & type)
+{
+	// the rules of the "Column Affinity" chapter of the sqlite docs
+	QString t(type.toUpper());
+	if (t.contains("INT"))
+		return IntegerAffinity;
+	if (t.contains("CHAR") || t.contains("CLOB") || t.contains("TEXT"))
+		return TextAffinity;
+	if (t.contains("BLOB") || t.isEmpty())
+		return NoneAffinity;
+	if (t.contains("REAL") || t.contains("FLOA") || t.contains("DOUB"))
+		return RealAffinity;
+	return NumericAffinity;
+}
+
+bool ImportInserter::execute(const QString & statement)
+{
+	char * err = 0;
+	if (sqlite3_exec(m_db, statement.toUtf8().constData(), 0, 0, &err) == SQLITE_OK)
+		return true;
+	m_error = QString::fromUtf8(err);
+	sqlite3_free(err);
+	return false;
+}
+
+bool ImportInserter::begin()
+{
+	m_error = QString();
+	if (!m_db)
+	{
+		m_error = tr("No database connection");
+		return false;
+	}
+
+	m_nested = !sqlite3_get_autocommit(m_db);
+	if (m_bulkLoad)
+	{
+		m_bulk = new BulkLoad(m_db, m_schema, m_table);
+		// one transaction only
+		m_batchSize = 0;
+		if (!m_bulk->setPragmas())
+		{
+			m_error = m_bulk->errorString();
+			delete m_bulk;
+			m_bulk = 0;
+			return false;
+		}
+	}
+	if (!execute(m_nested ? "SAVEPOINT sqliteman_import;" : "BEGIN TRANSACTION;"))
+		return false;
+	if (m_bulk && !m_bulk->dropDependent())
+	{
+		QString error(m_bulk->errorString());
+		rollback();
+		m_error = error;
+		return false;
+	}
+
+	if (sqlite3_prepare16_v2(m_db, m_sql.utf16(), -1, &m_stmt, 0) != SQLITE_OK)
+	{
+		m_error = QString::fromUtf8(sqlite3_errmsg(m_db));
+		m_stmt = 0;
+		QString error(m_error);
+		rollback();
+		m_error = error;
+		return false;
+	}
+	return true;
+}
+
+bool ImportInserter::isBase64(const QString & value)
+{
+	// QByteArray::fromBase64() skips invalid characters silently
+	if (value.size() % 4 != 0)
+		return false;
+	for (int i = 0; i < value.size(); ++i)
+	{
+		ushort c = value.at(i).unicode();
+		if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')
+			|| c == '+' || c == '/')
+			continue;
+		// padding at the end only
+		if (c == '=' && i >= value.size() - 2
+			&& (i == value.size() - 1 || value.at(i + 1) == '='))
+			continue;
+		return false;
+	}
+	return true;
+}
+
+void ImportInserter::bind(int column, const QString & value, bool number)
+{
+	Affinity a = m_affinity.at(column - 1);
+	bool ok = false;
+
+	if (m_nullValues && value.isNull())
+	{
+		sqlite3_bind_null(m_stmt, column);
+		return;
+	}
+	if (number || a == IntegerAffinity || a == RealAffinity || a == NumericAffinity)
+	{
+		if (value.isEmpty() && !m_notNull.at(column - 1))
+		{
+			sqlite3_bind_null(m_stmt, column);
+			return;
+		}
+		if (a != RealAffinity)
+		{
+			qlonglong i = value.toLongLong(&ok);
+			if (ok)
+			{
+				sqlite3_bind_int64(m_stmt, column, i);
+				return;
+			}
+		}
+		double d = value.toDouble(&ok);
+		if (ok)
+		{
+			sqlite3_bind_double(m_stmt, column, d);
+			return;
+		}
+	}
+
+	if (m_base64Blobs && m_blob.at(column - 1) && isBase64(value))
+	{
+		QByteArray data(QByteArray::fromBase64(value.toLatin1()));
+		sqlite3_bind_blob(m_stmt, column, data.constData(), data.size(), SQLITE_TRANSIENT);
+		return;
+	}
+
+	// the value lives until sqlite3_step() is done
+	sqlite3_bind_text16(m_stmt, column, value.utf16(), value.size() * sizeof(ushort),
+						SQLITE_STATIC);
+}
+
+bool ImportInserter::insert(const QStringList & values, const QBitArray & numbers)
+{
+	if (m_fatal || !m_stmt)
+		return false;
+	if (values.count() != columnCount())
+	{
+		m_error = tr("Imported values = %1; Table columns count = %2")
+					.arg(values.count()).arg(columnCount());
+		return false;
+	}
+
+	for (int i = 0; i < values.count(); ++i)
+		bind(i + 1, values.at(i), i < numbers.size() && numbers.testBit(i));
+
+	int rc = sqlite3_step(m_stmt);
+	if (rc != SQLITE_DONE)
+		m_error = QString::fromUtf8(sqlite3_errmsg(m_db));
+	sqlite3_reset(m_stmt);
+	if (rc != SQLITE_DONE)
+		return false;
+
+	++m_pending;
+	return true;
+}
+
+bool ImportInserter::commitBatch()
+{
+	if (m_fatal || m_nested)
+		return false;
+	// the statement is reset so it does not hold the transaction
+	if (!execute("COMMIT;"))
+	{
+		m_fatal = true;
+		return false;
+	}
+	m_committed += m_pending;
+	m_pending = 0;
+	if (!execute("BEGIN TRANSACTION;"))
+	{
+		m_fatal = true;
+		return false;
+	}
+	return true;
+}
+
+bool ImportInserter::commit()
+{
+	if (m_fatal)
+		return false;
+	// not needed anymore. Do not keep it over the DDL of rebuild().
+	if (m_stmt)
+	{
+		sqlite3_finalize(m_stmt);
+		m_stmt = 0;
+	}
+	if (m_bulk && !m_bulk->rebuild())
+	{
+		m_error = tr("Cannot create the indexes again: %1").arg(m_bulk->errorString());
+		return false;
+	}
+	if (!execute(m_nested ? "RELEASE sqliteman_import;" : "COMMIT;"))
+		return false;
+	m_committed += m_pending;
+	m_pending = 0;
+	if (m_bulk)
+		m_bulk->restorePragmas();
+	return true;
+}
+
+void ImportInserter::rollback()
+{
+	if (m_nested)
+		execute("ROLLBACK TO sqliteman_import; RELEASE sqliteman_import;");
+	else if (!sqlite3_get_autocommit(m_db))
+		execute("ROLLBACK;");
+	m_pending = 0;
+	// the dropped objects are back now
+	if (m_bulk)
+		m_bulk->restorePragmas();
+}
@@ -0,0 +1,136 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef IMPORTINSERTER_H
+#define IMPORTINSERTER_H
+
+#include <QCoreApplication>
+#include <QBitArray>
+#include <QStringList>
+
+#include "database.h"
+
+class BulkLoad;
+
+
+/*! \brief Insert imported rows with one prepared statement.
+The INSERT is prepared once and reused with sqlite3_reset().
+Values are bound by the declared column affinity - numbers
+as int64 or double, empty values of numeric columns as NULL
+(NOT NULL columns get an empty string as before). Values which
+are numbers in a typed input (JSON) are bound as numbers in any
+column. Everything else is bound as text.
+
+Rows are inserted in a transaction started by begin(). When the
+batch size is set the caller commits each full batch with
+commitBatch() - at a point of the input it can resume from (see
+ImportCheckpoint). When the connection is already in a transaction
+a savepoint is used and batches are ignored.
+
+With setBulkLoad() the table indexes and triggers are dropped in
+begin() and created again in commit() (see BulkLoad). Batches are
+not used then - everything has to be rolled back on failure.
+
+It uses the native handle only so it can run in any thread which
+owns the connection.
+*/
+class ImportInserter
+{
+		Q_DECLARE_TR_FUNCTIONS(ImportInserter)
+
+	public:
+		//! \brief Column affinity as described in the sqlite docs.
+		enum Affinity
+		{
+			IntegerAffinity,
+			RealAffinity,
+			NumericAffinity,
+			TextAffinity,
+			NoneAffinity
+		};
+
+		/*! \param db an open connection.
+		\param schema target database schema.
+		\param table target table.
+		\param fields columns of the table. See Database::tableFields().
+		\param batchSize rows per transaction. 0 for one transaction.
+		*/
+		ImportInserter(sqlite3 * db, const QString & schema, const QString & table,
+					   const FieldList & fields, int batchSize = 0);
+		~ImportInserter();
+
+		//! \brief Use the bulk-load mode. It must be called before begin().
+		void setBulkLoad(bool bulk) { m_bulkLoad = bulk; };
+		//! \brief Bind null QStrings as NULL. See ImportTable::Reader::nullValues().
+		void setNullValues(bool nulls) { m_nullValues = nulls; };
+		/*! \brief Decode base64 values of the columns declared BLOB.
+		Values which are not valid base64 are bound as text.
+		See ImportTable::Reader::base64Blobs(). */
+		void setBase64Blobs(bool base64) { m_base64Blobs = base64; };
+
+		//! \brief Affinity of the declared column type.
+		static Affinity affinity(const QString & type);
+
+		/*! \brief Start the transaction and prepare the statement.
+		\retval bool false on error. See errorString(). */
+		bool begin();
+		/*! \brief Insert one row. It must have columnCount() values.
+		\param numbers values which are numbers in the input. They are bound
+		as int64 or double whatever the column affinity is. See
+		ImportTable::Reader::numberValues().
+		\retval bool false when the row is not inserted. See errorString()
+		and fatal(). */
+		bool insert(const QStringList & values, const QBitArray & numbers = QBitArray());
+		//! \brief True when the batch size is reached. See commitBatch().
+		bool batchFull() const { return m_batchSize > 0 && !m_nested && m_pending >= m_batchSize; };
+		/*! \brief Commit the inserted rows and start a new transaction.
+		\retval bool false on error. fatal() is set then. */
+		bool commitBatch();
+		/*! \brief Commit the rest of the rows.
+		\retval bool false on error. The transaction is still open then. */
+		bool commit();
+		//! \brief Roll back the rows not committed yet.
+		void rollback();
+
+		int columnCount() const { return m_affinity.count(); };
+		//! \brief Rows already committed by batches.
+		qint64 committed() const { return m_committed; };
+		//! \brief True when a batch commit failed. Nothing can be inserted then.
+		bool fatal() const { return m_fatal; };
+		QString errorString() const { return m_error; };
+
+	private:
+		sqlite3 * m_db;
+		sqlite3_stmt * m_stmt;
+		QString m_schema;
+		QString m_table;
+		QString m_sql;
+		QList<Affinity> m_affinity;
+		QList<bool> m_notNull;
+		//! \brief True for the columns declared BLOB
+		QList<bool> m_blob;
+		int m_batchSize;
+		//! \brief Rows inserted since the last commit
+		int m_pending;
+		qint64 m_committed;
+		//! \brief True when a savepoint is used instead of a transaction.
+		bool m_nested;
+		bool m_fatal;
+		bool m_bulkLoad;
+		bool m_nullValues;
+		bool m_base64Blobs;
+		BulkLoad * m_bulk;
+		QString m_error;
+
+		//! \brief Run a statement without results. Sets m_error.
+		bool execute(const QString & statement);
+		void bind(int column, const QString & value, bool number);
+		//! \brief True when the value is complete base64 text.
+		static bool isBase64(const QString & value);
+};
+
+#endif
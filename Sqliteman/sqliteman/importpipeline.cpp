@@ -0,0 +1,413 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QMutexLocker>
+
+#include "importpipeline.h"
+#include "csvtokenizer.h"
+#include "databasepool.h"
+#include "importinserter.h"
+#include "importcheckpoint.h"
+
+
+ImportStageThread::ImportStageThread(ImportPipeline * pipeline, Stage stage)
+	: QThread(),
+	  m_pipeline(pipeline),
+	  m_stage(stage)
+{
+}
+
+void ImportStageThread::run()
+{
+	switch (m_stage)
+	{
+		case Reader:
+			m_pipeline->runReader();
+			break;
+		case Parser:
+			m_pipeline->runParser();
+			break;
+		case Writer:
+			m_pipeline->runWriter();
+			break;
+	}
+}
+
+
+ImportPipeline::ImportPipeline(ImportTable::Reader * reader, int skipHeader,
+							   const QString & schema, const QString & table,
+							   const FieldList & fields, int batchSize)
+	: m_reader(reader),
+	  m_csv(dynamic_cast<ImportTable::CSVReader*>(reader)),
+	  m_skipHeader(skipHeader),
+	  m_schema(schema),
+	  m_table(table),
+	  m_fields(fields),
+	  m_batchSize(batchSize),
+	  m_bulkLoad(false),
+	  m_nullValues(reader->nullValues()),
+	  m_base64Blobs(reader->base64Blobs()),
+	  m_checkpoint(0),
+	  m_firstRow(0),
+	  m_blocks(0),
+	  m_readerDone(false),
+	  m_parsersRunning(0),
+	  m_cancelled(false),
+	  m_writerState(Inserting),
+	  m_commit(false),
+	  m_committed(false),
+	  m_lostLog(0)
+{
+	m_stats.size = reader->size();
+	m_stats.read = 0;
+	m_stats.written = 0;
+	m_stats.rowsParsed = 0;
+	m_stats.rowsInserted = 0;
+	m_stats.rowsFailed = 0;
+	m_stats.rowsCommitted = 0;
+	m_stats.parsers = 0;
+	m_stats.readBusy = 0;
+	m_stats.parseBusy = 0;
+	m_stats.writeBusy = 0;
+	m_stats.elapsed = 0;
+}
+
+ImportPipeline::~ImportPipeline()
+{
+	cancel();
+	foreach (ImportStageThread * t, m_threads)
+		t->wait();
+	qDeleteAll(m_threads);
+}
+
+bool ImportPipeline::canRun(const QString & schema)
+{
+	DbAttach databases(Database::getDatabases());
+	QString mainFile(databases.value("main"));
+	QString file(databases.value(schema));
+	if (schema.toLower() == "temp" || file.isEmpty() || file == ":memory:"
+		|| mainFile.isEmpty() || mainFile == ":memory:")
+		return false;
+
+	// an open transaction of the main connection would block the writer
+	DatabaseSession session;
+	sqlite3 * handle = session.handle();
+	return handle && sqlite3_get_autocommit(handle);
+}
+
+int ImportPipeline::parserCount()
+{
+	// the reader, the writer and the GUI take the rest
+	return qBound(1, QThread::idealThreadCount() - 2, 8);
+}
+
+void ImportPipeline::start()
+{
+	m_clock.start();
+
+	m_threads.append(new ImportStageThread(this, ImportStageThread::Writer));
+	m_threads.append(new ImportStageThread(this, ImportStageThread::Reader));
+	if (m_csv)
+	{
+		m_stats.parsers = parserCount();
+		m_parsersRunning = m_stats.parsers;
+		for (int i = 0; i < m_stats.parsers; ++i)
+			m_threads.append(new ImportStageThread(this, ImportStageThread::Parser));
+	}
+
+	foreach (ImportStageThread * t, m_threads)
+		t->start();
+}
+
+bool ImportPipeline::waitForInserted(int ms)
+{
+	QMutexLocker locker(&m_mutex);
+	if (m_writerState == Inserting)
+		m_changed.wait(&m_mutex, ms);
+	return m_writerState != Inserting;
+}
+
+void ImportPipeline::cancel()
+{
+	QMutexLocker locker(&m_mutex);
+	m_cancelled = true;
+	m_changed.wakeAll();
+}
+
+bool ImportPipeline::finish(bool commit)
+{
+	QMutexLocker locker(&m_mutex);
+	m_commit = commit;
+	if (m_writerState == Inserted)
+		m_writerState = Committing;
+	m_changed.wakeAll();
+	locker.unlock();
+
+	foreach (ImportStageThread * t, m_threads)
+		t->wait();
+
+	locker.relock();
+	return m_committed;
+}
+
+ImportPipelineStatistics ImportPipeline::statistics()
+{
+	QMutexLocker locker(&m_mutex);
+	m_stats.elapsed = m_clock.elapsed();
+	return m_stats;
+}
+
+QStringList ImportPipeline::log()
+{
+	QMutexLocker locker(&m_mutex);
+	QStringList ret(m_log);
+	if (m_lostLog > 0)
+		ret.append(tr("... and %1 more errors").arg(m_lostLog));
+	return ret;
+}
+
+QString ImportPipeline::errorString()
+{
+	QMutexLocker locker(&m_mutex);
+	return m_error;
+}
+
+void ImportPipeline::addLog(const QString & line)
+{
+	if (m_log.count() < MaxLogLines)
+		m_log.append(line);
+	else
+		++m_lostLog;
+}
+
+bool ImportPipeline::waitForSpace()
+{
+	QMutexLocker locker(&m_mutex);
+	while (m_blocks >= MaxBlocks && !m_cancelled)
+		m_changed.wait(&m_mutex);
+	return !m_cancelled;
+}
+
+void ImportPipeline::runReader()
+{
+	QTime busy;
+	int sequence = 0;
+	QStringList row;
+
+	busy.start();
+	for (int i = 0; i < m_skipHeader && m_reader->readRow(row); ++i)
+		;
+	m_mutex.lock();
+	m_stats.readBusy += busy.elapsed();
+	m_mutex.unlock();
+
+	while (waitForSpace())
+	{
+		busy.restart();
+		if (m_csv)
+		{
+			RawBlock raw;
+			if (!m_csv->readBlock(raw.data))
+				break;
+			raw.sequence = sequence++;
+			// a record boundary. See ImportCheckpoint.
+			raw.position = m_csv->recordPosition();
+
+			QMutexLocker locker(&m_mutex);
+			m_raw.enqueue(raw);
+			++m_blocks;
+			m_stats.read = raw.position;
+			m_stats.readBusy += busy.elapsed();
+			m_changed.wakeAll();
+		}
+		else
+		{
+			// the reader parses the rows itself
+			RowBlock block;
+			while (block.rows.count() < BlockRows && m_reader->readRow(row))
+			{
+				block.rows.append(row);
+				block.numbers.append(m_reader->numberValues());
+			}
+			if (block.rows.isEmpty())
+				break;
+			block.position = m_reader->position();
+
+			QMutexLocker locker(&m_mutex);
+			m_parsed.insert(sequence++, block);
+			++m_blocks;
+			m_stats.read = block.position;
+			m_stats.rowsParsed += block.rows.count();
+			m_stats.readBusy += busy.elapsed();
+			m_changed.wakeAll();
+		}
+	}
+
+	QMutexLocker locker(&m_mutex);
+	if (!m_reader->errorString().isEmpty())
+		addLog(m_reader->errorString());
+	m_readerDone = true;
+	m_changed.wakeAll();
+}
+
+void ImportPipeline::runParser()
+{
+	CsvTokenizer tokenizer(m_csv->encodedSeparator());
+	QStringList row;
+	QTime busy;
+
+	while (true)
+	{
+		RawBlock raw;
+		{
+			QMutexLocker locker(&m_mutex);
+			while (m_raw.isEmpty() && !m_readerDone && !m_cancelled)
+				m_changed.wait(&m_mutex);
+			if (m_raw.isEmpty() || m_cancelled)
+				break;
+			raw = m_raw.dequeue();
+		}
+
+		busy.start();
+		RowBlock block;
+		block.position = raw.position;
+		int offset = 0;
+		int consumed;
+		// blocks contain whole records only
+		while (tokenizer.parse(raw.data.constData() + offset, raw.data.size() - offset,
+							   true, consumed) == CsvTokenizer::Record)
+		{
+			offset += consumed;
+			m_csv->decodeRecord(tokenizer, row);
+			block.rows.append(row);
+		}
+
+		QMutexLocker locker(&m_mutex);
+		m_parsed.insert(raw.sequence, block);
+		m_stats.rowsParsed += block.rows.count();
+		m_stats.parseBusy += busy.elapsed();
+		m_changed.wakeAll();
+	}
+
+	QMutexLocker locker(&m_mutex);
+	--m_parsersRunning;
+	m_changed.wakeAll();
+}
+
+void ImportPipeline::runWriter()
+{
+	DatabaseLease lease(DatabaseSession::ReadWrite, tr("Import into %1").arg(m_table));
+	DatabaseSession & session = lease.session();
+	sqlite3 * handle = session.handle();
+	ImportInserter inserter(handle, m_schema, m_table, m_fields, m_batchSize);
+	inserter.setBulkLoad(m_bulkLoad);
+	inserter.setNullValues(m_nullValues);
+	inserter.setBase64Blobs(m_base64Blobs);
+	bool committed = false;
+
+	if (!handle || !inserter.begin())
+	{
+		QMutexLocker locker(&m_mutex);
+		m_error = handle ? inserter.errorString() : session.lastError().message;
+		// stop the other stages
+		m_cancelled = true;
+	}
+	else
+	{
+		int columns = inserter.columnCount();
+		QTime busy;
+		qint64 row = m_firstRow;
+		int next = 0;
+
+		while (true)
+		{
+			RowBlock block;
+			{
+				QMutexLocker locker(&m_mutex);
+				// blocks are inserted in the input order
+				while (!m_parsed.contains(next) && !m_cancelled
+					   && (!m_readerDone || m_parsersRunning > 0))
+					m_changed.wait(&m_mutex);
+				if (m_cancelled || !m_parsed.contains(next))
+					break;
+				block = m_parsed.take(next++);
+				--m_blocks;
+				m_changed.wakeAll();
+			}
+
+			busy.start();
+			qint64 inserted = 0;
+			QStringList log;
+			for (int i = 0; i < block.rows.count(); ++i)
+			{
+				const QStringList & l = block.rows.at(i);
+				++row;
+				if (l.count() != columns)
+				{
+					log.append(tr("Row = %1; Imported values = %2; Table columns count = %3; Values = (%4)")
+							.arg(row).arg(l.count()).arg(columns).arg(l.join(", ")));
+					continue;
+				}
+
+				if (inserter.insert(l, block.numbers.isEmpty() ? QBitArray() : block.numbers.at(i)))
+					++inserted;
+				else
+				{
+					log.append(tr("Row = %1; %2").arg(row).arg(inserter.errorString()));
+					if (inserter.fatal())
+						break;
+				}
+			}
+			// the block ends at a record boundary - safe to resume from
+			if (inserter.batchFull() && inserter.commitBatch() && m_checkpoint)
+				m_checkpoint->save(block.position, row);
+
+			QMutexLocker locker(&m_mutex);
+			foreach (QString line, log)
+				addLog(line);
+			m_stats.rowsInserted += inserted;
+			m_stats.rowsFailed += log.count();
+			m_stats.rowsCommitted = inserter.committed();
+			m_stats.written = block.position;
+			m_stats.writeBusy += busy.elapsed();
+			if (inserter.fatal())
+			{
+				m_error = inserter.errorString();
+				m_cancelled = true;
+			}
+		}
+
+		// wait for the user's decision. See finish().
+		QMutexLocker locker(&m_mutex);
+		m_writerState = Inserted;
+		m_changed.wakeAll();
+		while (m_writerState == Inserted && !m_cancelled)
+			m_changed.wait(&m_mutex);
+		bool commit = m_commit && !m_cancelled;
+		locker.unlock();
+
+		if (commit)
+		{
+			committed = inserter.commit();
+			if (!committed)
+			{
+				locker.relock();
+				m_error = inserter.errorString();
+				locker.unlock();
+				inserter.rollback();
+			}
+		}
+		else
+			inserter.rollback();
+	}
+
+	QMutexLocker locker(&m_mutex);
+	m_committed = committed;
+	m_stats.rowsCommitted = inserter.committed();
+	m_writerState = Finished;
+	m_changed.wakeAll();
+}
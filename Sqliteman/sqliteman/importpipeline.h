@@ -0,0 +1,239 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef IMPORTPIPELINE_H
+#define IMPORTPIPELINE_H
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QMap>
+#include <QStringList>
+#include <QTime>
+
+#include "importtabledialog.h"
+
+class ImportPipeline;
+class ImportCheckpoint;
+
+
+/*! \brief Counters of the ImportPipeline stages.
+Busy times are the time the stage worked (not waited). Parser
+busy time is a sum of all parser threads.
+See ImportPipeline::statistics().
+*/
+typedef struct
+{
+	//! \brief Size of the input in the reader units (bytes for CSV)
+	qint64 size;
+	//! \brief Input read by the reader stage
+	qint64 read;
+	//! \brief Input already inserted by the writer stage
+	qint64 written;
+	qint64 rowsParsed;
+	qint64 rowsInserted;
+	qint64 rowsFailed;
+	//! \brief Rows committed by the batches (see ImportInserter)
+	qint64 rowsCommitted;
+	//! \brief Count of the parser threads. 0 when the reader parses itself.
+	int parsers;
+	int readBusy;
+	int parseBusy;
+	int writeBusy;
+	//! \brief Time since start() (ms)
+	int elapsed;
+}
+ImportPipelineStatistics;
+
+
+/*! \brief A thread running one stage of the ImportPipeline.
+*/
+class ImportStageThread : public QThread
+{
+	public:
+		enum Stage
+		{
+			Reader,
+			Parser,
+			Writer
+		};
+
+		ImportStageThread(ImportPipeline * pipeline, Stage stage);
+
+	protected:
+		void run();
+
+	private:
+		ImportPipeline * m_pipeline;
+		Stage m_stage;
+};
+
+
+/*! \brief Import rows into a table in the background threads.
+The work is split into stages running concurrently:
+ - one reader thread reads the input. CSV files are read in
+   blocks of whole records (see ImportTable::CSVReader::readBlock()).
+   Other readers parse the rows themselves.
+ - parser threads split the CSV blocks into fields and decode them.
+   There is parserCount() of them.
+ - one writer thread inserts the rows in the input order with
+   ImportInserter. It uses the writer connection of the DatabasePool.
+
+The count of blocks in memory is limited by MaxBlocks so the reader
+waits when the writer is the bottleneck.
+
+With a batch size the writer commits after the block which fills
+the batch. The checkpoint (see setCheckpoint()) is saved then with
+the end of the block - a record boundary of the input.
+
+The writer does not commit the last transaction itself. When all rows
+are inserted (waitForInserted()) the caller decides with finish()
+so the user can check the error log first.
+
+Use canRun() first. The writer thread has its own connection so
+it cannot see TEMP tables and in-memory databases of the main
+connection. It would also wait for the lock forever when the main
+connection has an open transaction.
+*/
+class ImportPipeline
+{
+		Q_DECLARE_TR_FUNCTIONS(ImportPipeline)
+
+	public:
+		//! \brief Max count of error lines kept for the log
+		static const int MaxLogLines = 1000;
+		//! \brief Max count of the blocks read and not inserted yet
+		static const int MaxBlocks = 16;
+		//! \brief Rows in one block of the readers without readBlock()
+		static const int BlockRows = 1000;
+
+		/*! \param reader an opened input. It must live until the
+		pipeline is finished. It's used in the reader thread only.
+		\param skipHeader count of rows to skip at the start.
+		\param schema target database schema.
+		\param table target table.
+		\param fields columns of the table.
+		\param batchSize rows per transaction. 0 for one transaction.
+		*/
+		ImportPipeline(ImportTable::Reader * reader, int skipHeader,
+					   const QString & schema, const QString & table,
+					   const FieldList & fields, int batchSize);
+		//! \brief Cancels the import when it's still running.
+		~ImportPipeline();
+
+		//! \brief Use ImportInserter::setBulkLoad(). Call it before start().
+		void setBulkLoad(bool bulk) { m_bulkLoad = bulk; };
+		/*! \brief Save the committed batches into the checkpoint.
+		It must live until the pipeline is finished. Call it before start(). */
+		void setCheckpoint(ImportCheckpoint * checkpoint) { m_checkpoint = checkpoint; };
+		/*! \brief Rows of the input imported before (a resumed import).
+		Row numbers of the log and the checkpoint continue from it. */
+		void setFirstRow(qint64 row) { m_firstRow = row; };
+
+		//! \brief True when the pipeline can import into the schema.
+		static bool canRun(const QString & schema);
+		//! \brief Count of the CSV parser threads. It's derived from the CPU count.
+		static int parserCount();
+
+		void start();
+		/*! \brief Wait until all rows are inserted or the import fails.
+		\param ms max time to wait.
+		\retval bool true when the writer waits for finish(). */
+		bool waitForInserted(int ms);
+		//! \brief Stop all stages. The transaction is rolled back.
+		void cancel();
+		/*! \brief Commit or roll back the transaction and stop the threads.
+		\retval bool true when the transaction is committed. */
+		bool finish(bool commit);
+
+		ImportPipelineStatistics statistics();
+		//! \brief Rows which failed and the reader errors.
+		QStringList log();
+		//! \brief Error which stopped the import (no connection etc.).
+		QString errorString();
+
+	private:
+		friend class ImportStageThread;
+
+		//! \brief Raw CSV block waiting for a parser.
+		typedef struct
+		{
+			int sequence;
+			QByteArray data;
+			qint64 position;
+		}
+		RawBlock;
+
+		//! \brief Parsed rows waiting for the writer.
+		typedef struct
+		{
+			QList<QStringList> rows;
+			//! \brief ImportTable::Reader::numberValues() per row. Empty for CSV.
+			QList<QBitArray> numbers;
+			qint64 position;
+		}
+		RowBlock;
+
+		enum WriterState
+		{
+			Inserting,
+			Inserted,
+			Committing,
+			Finished
+		};
+
+		ImportTable::Reader * m_reader;
+		//! \brief The same reader when it's a CSV one. Parsers are used then.
+		ImportTable::CSVReader * m_csv;
+		int m_skipHeader;
+		QString m_schema;
+		QString m_table;
+		FieldList m_fields;
+		int m_batchSize;
+		bool m_bulkLoad;
+		//! \brief See ImportTable::Reader::nullValues()
+		bool m_nullValues;
+		//! \brief See ImportTable::Reader::base64Blobs()
+		bool m_base64Blobs;
+		ImportCheckpoint * m_checkpoint;
+		qint64 m_firstRow;
+		QList<ImportStageThread*> m_threads;
+
+		//! \brief Guards everything below.
+		QMutex m_mutex;
+		//! \brief Woken on any change of the queues or states.
+		QWaitCondition m_changed;
+		QQueue<RawBlock> m_raw;
+		//! \brief Parsed blocks by their sequence number.
+		QMap<int,RowBlock> m_parsed;
+		//! \brief Blocks read and not taken by the writer yet.
+		int m_blocks;
+		bool m_readerDone;
+		int m_parsersRunning;
+		bool m_cancelled;
+		WriterState m_writerState;
+		bool m_commit;
+		bool m_committed;
+		QStringList m_log;
+		int m_lostLog;
+		QString m_error;
+		ImportPipelineStatistics m_stats;
+		QTime m_clock;
+
+		void runReader();
+		void runParser();
+		void runWriter();
+
+		/*! \brief Wait while there are MaxBlocks in the pipeline.
+		\retval bool false when the import is cancelled. */
+		bool waitForSpace();
+		void addLog(const QString & line);
+};
+
+#endif
@@ -6,6 +6,13 @@ for which a new license (GPL+exception) is in place.
 */
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QProgressDialog>
+#include <QTextCodec>
+#include <QFileInfo>
+#include <QTime>
+#include <QApplication>
+#include <QDate>
+#include <QRegExp>
 
 #if QT_VERSION >= 0x040300
 #include <QXmlStreamReader>
@@ -19,12 +26,22 @@ for which a new license (GPL+exception) is in place.
 
 #include "importtabledialog.h"
 #include "importtablelogdialog.h"
+#include "csvtokenizer.h"
+#include "importpipeline.h"
+#include "importinserter.h"
+#include "importcheckpoint.h"
+#include "spreadsheetreader.h"
+#include "jsonreader.h"
+#include "databasesession.h"
+#include "preferences.h"
+#include "createtabledialog.h"
 #include "database.h"
 #include "sqliteprocess.h"
 
 
 ImportTableDialog::ImportTableDialog(QWidget * parent, const QString & tableName, const QString & schema)
 	: QDialog(parent),
+	  update(false),
 	  m_parent(parent),
 	  m_tableName(tableName)
 {
@@ -50,6 +67,7 @@ ImportTableDialog::ImportTableDialog(QWidget * parent, const QString & tableName
 	connect(schemaComboBox, SIGNAL(currentIndexChanged(const QString &)),
 			this, SLOT(setTablesForSchema(const QString &)));
 	connect(fileButton, SIGNAL(clicked()), this, SLOT(fileButton_clicked()));
+	connect(createTableButton, SIGNAL(clicked()), this, SLOT(createTableButton_clicked()));
 	connect(buttonBox, SIGNAL(accepted()), this, SLOT(slotAccepted()));
 	connect(tabWidget, SIGNAL(currentChanged(int)),
 			this, SLOT(createPreview(int)));
@@ -70,6 +88,12 @@ ImportTableDialog::ImportTableDialog(QWidget * parent, const QString & tableName
 			this, SLOT(skipHeaderCheck_toggled(bool)));
 
 	skipHeaderCheck_toggled(false);
+	batchSizeBox->setValue(Preferences::instance()->importBatchSize());
+	// bulk load uses one transaction
+	connect(bulkLoadCheck, SIGNAL(toggled(bool)),
+			batchSizeBox, SLOT(setDisabled(bool)));
+	bulkLoadCheck->setChecked(Preferences::instance()->importBulkLoad());
+	batchSizeBox->setDisabled(bulkLoadCheck->isChecked());
 }
 
 void ImportTableDialog::fileButton_clicked()
@@ -78,22 +102,24 @@ void ImportTableDialog::fileButton_clicked()
 	pth = pth.isEmpty() ? QDir::currentPath() : pth;
 	QString fname = QFileDialog::getOpenFileName(this, tr("File to Import"),
 												 pth,
-												 tr("CSV Files (*.csv);;MS Excel XML (*.xml);;Text Files (*.txt);;All Files (*)"));
+												 tr("CSV Files (*.csv *.csv.gz);;MS Excel (*.xml *.xml.gz *.xlsx);;JSON (*.json *.jsonl *.ndjson *.json.gz *.jsonl.gz *.ndjson.gz);;Text Files (*.txt *.txt.gz);;Compressed Files (*.gz);;All Files (*)"));
 	if (fname.isEmpty())
 		return;
 
 	fileEdit->setText(fname);
+	// it's not a text file for sure
+	QString suffix(QFileInfo(fname).completeSuffix().toLower());
+	if (suffix.endsWith("xlsx") || suffix.endsWith("xml.gz"))
+		tabWidget->setCurrentIndex(1);
+	else if (suffix.endsWith("json") || suffix.endsWith("jsonl") || suffix.endsWith("ndjson")
+			 || suffix.endsWith("json.gz") || suffix.endsWith("jsonl.gz") || suffix.endsWith("ndjson.gz"))
+		tabWidget->setCurrentIndex(2);
 	createPreview();
 }
 
-void ImportTableDialog::slotAccepted()
+ImportTable::Reader * ImportTableDialog::createReader()
 {
-	QList<QStringList> values;
-
-	if (fileEdit->text().isEmpty())
-		return;
-	
-	int skipHeader = skipHeaderCheck->isChecked() ? skipHeaderBox->value() : 0;
+	ImportTable::Reader * reader = 0;
 
 	switch (tabWidget->currentIndex())
 	{
@@ -102,78 +128,384 @@ void ImportTableDialog::slotAccepted()
 			{
 				QMessageBox::warning(this, tr("Data Import"),
 									tr("Fields separator must be given"));
-				return;
+				return 0;
 			}
-			values = ImportTable::CSVModel(fileEdit->text(),
-										   skipHeader,
-										   sqliteSeparator(),
-										   this, 0).m_values;
+			reader = new ImportTable::CSVReader(fileEdit->text(), sqliteSeparator());
 			break;
 		case 1:
-			values = ImportTable::XMLModel(fileEdit->text(), skipHeader, this, 0).m_values;
+			reader = ImportTable::createSpreadsheetReader(fileEdit->text());
+			break;
+		case 2:
+			reader = new ImportTable::JSONReader(fileEdit->text());
+			break;
+		default:
+			return 0;
+	}
+
+	if (!reader->open())
+	{
+		QMessageBox::warning(this, tr("Data Import"), reader->errorString());
+		delete reader;
+		return 0;
+	}
+	return reader;
+}
+
+int ImportTableDialog::skipHeaderRows()
+{
+	if (tabWidget->currentIndex() == 2)
+		return 1;
+	return skipHeaderCheck->isChecked() ? skipHeaderBox->value() : 0;
+}
+
+void ImportTableDialog::slotAccepted()
+{
+	if (fileEdit->text().isEmpty())
+		return;
+	
+	int skipHeader = skipHeaderRows();
+	ImportTable::Reader * reader = createReader();
+	if (!reader)
+		return;
+	// JSON keys go into the columns of the same name
+	ImportTable::JSONReader * json = dynamic_cast<ImportTable::JSONReader*>(reader);
+	if (json)
+	{
+		QStringList columns;
+		foreach (DatabaseTableField f, Database::tableFields(tableComboBox->currentText(),
+															 schemaComboBox->currentText()))
+			columns.append(f.name);
+		json->setColumns(columns);
+	}
+	Preferences::instance()->setImportBatchSize(batchSizeBox->value());
+	Preferences::instance()->setImportBulkLoad(bulkLoadCheck->isChecked());
+
+	if (!ImportPipeline::canRun(schemaComboBox->currentText()))
+	{
+		bool done = importRows(reader, skipHeader);
+		delete reader;
+		if (done)
+			accept();
+		return;
+	}
+
+	// only CSV files can continue from a byte offset
+	ImportTable::CSVReader * csv = dynamic_cast<ImportTable::CSVReader*>(reader);
+	ImportCheckpoint checkpoint(fileEdit->text(), schemaComboBox->currentText(),
+								tableComboBox->currentText());
+	qint64 firstRow = 0;
+	if (csv && checkpoint.load())
+	{
+		int ret = QMessageBox::question(this, tr("Data Import"),
+						tr("The previous import of this file into %1 was interrupted.\n"
+						   "Resume from row %L2?\n\n"
+						   "Choose No to import the whole file again.")
+							.arg(tableComboBox->currentText()).arg(checkpoint.row() + 1),
+						QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel,
+						QMessageBox::Yes);
+		if (ret == QMessageBox::Cancel)
+		{
+			delete reader;
+			return;
+		}
+		if (ret == QMessageBox::Yes && csv->seek(checkpoint.offset()))
+		{
+			// the header is behind the offset
+			skipHeader = 0;
+			firstRow = checkpoint.row();
+		}
+		else
+		{
+			if (ret == QMessageBox::Yes)
+			{
+				QMessageBox::warning(this, tr("Data Import"),
+									 tr("Cannot resume the import: %1\n"
+										"The whole file is imported again.").arg(csv->errorString()));
+				// a failed gzip seek has read the stream partly
+				delete reader;
+				reader = createReader();
+				if (!reader)
+					return;
+				csv = dynamic_cast<ImportTable::CSVReader*>(reader);
+			}
+			checkpoint.remove();
+		}
 	}
 
+	bool done = importPipeline(reader, skipHeader, csv ? &checkpoint : 0, firstRow);
+	delete reader;
+	if (done)
+		accept();
+}
+
+void ImportTableDialog::createTableButton_clicked()
+{
+	if (fileEdit->text().isEmpty())
+	{
+		QMessageBox::warning(this, tr("Data Import"),
+							 tr("Select a file to import first."));
+		return;
+	}
+
+	int skipHeader = skipHeaderRows();
+	ImportTable::Reader * reader = createReader();
+	if (!reader)
+		return;
+
+	QApplication::setOverrideCursor(Qt::WaitCursor);
+	ImportTable::TypeSampler sampler;
+	sampler.sample(reader, skipHeader);
+	delete reader;
+	QApplication::restoreOverrideCursor();
+
+	if (sampler.fields().isEmpty())
+	{
+		QMessageBox::warning(this, tr("Data Import"),
+							 tr("There are no rows in the file."));
+		return;
+	}
+
+	CreateTableDialog dlg(this);
+	dlg.setColumns(schemaComboBox->currentText(),
+				   QFileInfo(fileEdit->text()).completeBaseName(),
+				   sampler.fields());
+	dlg.exec();
+	if (!dlg.update)
+		return;
+
+	update = true;
+	m_tableName = dlg.ui.nameEdit->text();
+	int ix = schemaComboBox->findText(dlg.ui.databaseCombo->currentText());
+	if (ix != -1 && ix != schemaComboBox->currentIndex())
+		schemaComboBox->setCurrentIndex(ix);
+	else
+		setTablesForSchema(schemaComboBox->currentText());
+}
+
+bool ImportTableDialog::importRows(ImportTable::Reader * reader, int skipHeader)
+{
 	// base import
 	bool result = true;
 	QStringList l;
 	QStringList log;
-	int cols = Database::tableFields(tableComboBox->currentText(),
-									 schemaComboBox->currentText()).count();
-	int row = 0;
-	int success = 0;
-	QString sql("insert into %1.%2 values (%3);");
-	QSqlQuery query(QSqlDatabase::database(SESSION_NAME));
-
-	QStringList binds;
-	for (int i = 0; i < cols; ++i)
-		binds << "?";
-	sql = sql.arg(schemaComboBox->currentText(),
-				  tableComboBox->currentText(),
-				  binds.join(", "));
-
-	if (!Database::execSql("BEGIN TRANSACTION;"))
-		return;
+	int lostLog = 0;
+	qint64 row = 0;
+	qint64 success = 0;
+	int skipped = 0;
+
+	// the main connection. TEMP tables and open transactions are visible there.
+	DatabaseSession session;
+	ImportInserter inserter(session.handle(),
+							schemaComboBox->currentText(),
+							tableComboBox->currentText(),
+							Database::tableFields(tableComboBox->currentText(),
+												  schemaComboBox->currentText()),
+							batchSizeBox->value());
+	inserter.setBulkLoad(bulkLoadCheck->isChecked());
+	inserter.setNullValues(reader->nullValues());
+	inserter.setBase64Blobs(reader->base64Blobs());
+	int cols = inserter.columnCount();
+
+	// per mille - the file size does not fit into int
+	QString fileName(QFileInfo(fileEdit->text()).fileName());
+	QProgressDialog progress(tr("Importing %1").arg(fileName), tr("Cancel"), 0, 1000, this);
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(500);
+	QTime shown;
+	shown.start();
+	QTime clock;
+	clock.start();
+	bool cancelled = false;
+
+	if (!inserter.begin())
+	{
+		QMessageBox::warning(this, tr("Data Import"),
+							 tr("Import failed: %1").arg(inserter.errorString()));
+		return false;
+	}
 
-	foreach (l, values)
+	while (reader->readRow(l))
 	{
+		if (skipped < skipHeader)
+		{
+			++skipped;
+			continue;
+		}
+
 		++row;
 		if (l.count() != cols)
 		{
-			log.append(tr("Row = %1; Imported values = %2; Table columns count = %3; Values = (%4)")
-					.arg(row).arg(l.count()).arg(cols).arg(l.join(", ")));
+			if (log.count() < ImportPipeline::MaxLogLines)
+				log.append(tr("Row = %1; Imported values = %2; Table columns count = %3; Values = (%4)")
+						.arg(row).arg(l.count()).arg(cols).arg(l.join(", ")));
+			else
+				++lostLog;
 			result = false;
 			continue;
 		}
 
-		query.prepare(sql);
-		for (int i = 0; i < cols ; ++i)
-			query.addBindValue(l.at(i));
-
-		query.exec();
-		if (query.lastError().isValid())
+		if (inserter.insert(l, reader->numberValues()))
+			++success;
+		else
 		{
-			log.append(tr("Row = %1; %2").arg(row).arg(query.lastError().text()));
+			if (log.count() < ImportPipeline::MaxLogLines)
+				log.append(tr("Row = %1; %2").arg(row).arg(inserter.errorString()));
+			else
+				++lostLog;
 			result = false;
+			if (inserter.fatal())
+				break;
 		}
+		if (inserter.batchFull() && !inserter.commitBatch())
+			break;
+
+		// the progress dialog runs the event loop. Do not call it too often.
+		if (shown.elapsed() >= 100)
+		{
+			shown.restart();
+			qint64 size = reader->size();
+			progress.setLabelText(tr("Importing %1\nRows: %2 (%3 of %4 kB)\nInsert: %5 rows/s")
+								  .arg(fileName).arg(success)
+								  .arg(reader->position() / 1024).arg(size / 1024)
+								  .arg(row * 1000 / qMax(1, clock.elapsed())));
+			progress.setValue(size > 0 ? int(reader->position() * 1000 / size) : 0);
+			if (progress.wasCanceled())
+			{
+				cancelled = true;
+				break;
+			}
+		}
+	}
+	// reset() clears the wasCanceled() flag
+	progress.reset();
+
+	if (cancelled || inserter.fatal())
+	{
+		inserter.rollback();
+		if (inserter.fatal())
+			QMessageBox::warning(this, tr("Data Import"),
+								 tr("Import failed: %1").arg(inserter.errorString()));
 		else
-			++success;
+			QMessageBox::information(this, tr("Data Import"), cancelledText(inserter.committed()));
+		return false;
 	}
 
-	if (result)
+	if (!reader->errorString().isEmpty())
 	{
-		Database::execSql("COMMIT;");
-		accept();
+		log.append(reader->errorString());
+		result = false;
 	}
-	else
+	if (lostLog > 0)
+		log.append(tr("... and %1 more errors").arg(lostLog));
+
+	if (!result)
 	{
 		ImportTableLogDialog dia(log, this);
-		if (dia.exec())
+		if (!dia.exec())
+		{
+			inserter.rollback();
+			return false;
+		}
+	}
+	if (inserter.commit())
+		return true;
+
+	QMessageBox::warning(this, tr("Data Import"),
+						 tr("Import failed: %1").arg(inserter.errorString()));
+	inserter.rollback();
+	return false;
+}
+
+QString ImportTableDialog::cancelledText(qint64 committed)
+{
+	if (committed > 0)
+		return tr("Import cancelled. %1 rows were already committed.").arg(committed);
+	return tr("Import cancelled. No rows were imported.");
+}
+
+bool ImportTableDialog::importPipeline(ImportTable::Reader * reader, int skipHeader,
+									   ImportCheckpoint * checkpoint, qint64 firstRow)
+{
+	ImportPipeline pipeline(reader, skipHeader,
+							schemaComboBox->currentText(),
+							tableComboBox->currentText(),
+							Database::tableFields(tableComboBox->currentText(),
+												  schemaComboBox->currentText()),
+							batchSizeBox->value());
+	pipeline.setBulkLoad(bulkLoadCheck->isChecked());
+	pipeline.setCheckpoint(checkpoint);
+	pipeline.setFirstRow(firstRow);
+
+	QString fileName(QFileInfo(fileEdit->text()).fileName());
+	QProgressDialog progress(tr("Importing %1").arg(fileName), tr("Cancel"), 0, 1000, this);
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(500);
+
+	bool cancelled = false;
+	pipeline.start();
+	// the progress dialog runs the event loop while the threads work
+	while (!pipeline.waitForInserted(100))
+	{
+		ImportPipelineStatistics s(pipeline.statistics());
+		int elapsed = qMax(1, s.elapsed);
+		QString stages;
+		if (s.parsers > 0)
+			stages = tr("Read: %1 kB/s (busy %2%)\nParse: %3 rows/s, %4 threads (busy %5%)")
+						.arg(s.read * 1000 / 1024 / elapsed)
+						.arg(s.readBusy * 100 / elapsed)
+						.arg(s.rowsParsed * 1000 / elapsed)
+						.arg(s.parsers)
+						.arg(s.parseBusy * 100 / elapsed / s.parsers);
+		else
+			stages = tr("Read: %1 rows/s (busy %2%)")
+						.arg(s.rowsParsed * 1000 / elapsed)
+						.arg(s.readBusy * 100 / elapsed);
+		stages += tr("\nInsert: %1 rows/s (busy %2%)")
+					.arg((s.rowsInserted + s.rowsFailed) * 1000 / elapsed)
+					.arg(s.writeBusy * 100 / elapsed);
+
+		progress.setLabelText(tr("Importing %1\nRows: %2 (%3 of %4 kB)\n%5")
+							  .arg(fileName).arg(s.rowsInserted)
+							  .arg(s.written / 1024).arg(s.size / 1024)
+							  .arg(stages));
+		progress.setValue(s.size > 0 ? int(s.written * 1000 / s.size) : 0);
+		if (progress.wasCanceled())
 		{
-			if (Database::execSql("COMMIT;"))
-				accept();
+			cancelled = true;
+			pipeline.cancel();
+			break;
 		}
-		Database::execSql("ROLLBACK;");
 	}
+	// reset() clears the wasCanceled() flag
+	progress.reset();
+
+	if (cancelled)
+	{
+		pipeline.finish(false);
+		QMessageBox::information(this, tr("Data Import"),
+								 cancelledText(pipeline.statistics().rowsCommitted));
+		return false;
+	}
+
+	QStringList log(pipeline.log());
+	bool commit = log.isEmpty();
+	if (!commit && pipeline.errorString().isEmpty())
+	{
+		ImportTableLogDialog dia(log, this);
+		commit = dia.exec();
+	}
+	bool committed = pipeline.finish(commit);
+	if (committed)
+	{
+		if (checkpoint)
+			checkpoint->remove();
+		return true;
+	}
+
+	if (!pipeline.errorString().isEmpty())
+		QMessageBox::warning(this, tr("Data Import"),
+							 tr("Import failed: %1").arg(pipeline.errorString()));
+	return false;
 }
 
 QString ImportTableDialog::sqliteSeparator()
@@ -201,6 +533,9 @@ void ImportTableDialog::createPreview(int)
 		case 1:
 			previewView->setModel(new ImportTable::XMLModel(fileEdit->text(), 0, this, 3));
 			break;
+		case 2:
+			previewView->setModel(new ImportTable::JSONModel(fileEdit->text(), this, 3));
+			break;
 	}
 }
 
@@ -267,24 +602,306 @@ QVariant ImportTable::BaseModel::headerData(int section, Qt::Orientation orienta
 	return QVariant();
 }
 
+ImportTable::CSVReader::CSVReader(const QString & fileName, const QString & separator)
+	: m_file(fileName),
+	  m_gzip(0),
+	  m_device(&m_file),
+	  m_read(0),
+	  m_separator(separator),
+	  m_codec(0),
+	  m_utf8(false),
+	  m_tokenizer(0),
+	  m_offset(0),
+	  m_atEnd(false)
+{
+}
+
+ImportTable::CSVReader::~CSVReader()
+{
+	delete m_tokenizer;
+	delete m_gzip;
+}
+
+bool ImportTable::CSVReader::open()
+{
+	// .gz files are inflated on the fly. It does not depend on the suffix.
+	if (GzipDevice::isGzip(m_file.fileName()))
+	{
+		m_gzip = new GzipDevice(m_file.fileName());
+		m_device = m_gzip;
+	}
+	// no QIODevice::Text. Line ends inside quoted fields are kept as they are.
+	if (!m_device->open(QIODevice::ReadOnly))
+	{
+		m_error = tr("Cannot open file %1 for reading.").arg(m_file.fileName());
+		return false;
+	}
+	// the same codec as QTextStream uses by default. BOM means UTF-8.
+	if (m_device->peek(3) == "\xEF\xBB\xBF")
+	{
+		m_device->read(3);
+		m_read = 3;
+		m_codec = QTextCodec::codecForName("UTF-8");
+	}
+	else
+		m_codec = QTextCodec::codecForLocale();
+	m_utf8 = (m_codec->name() == "UTF-8");
+	m_tokenizer = new CsvTokenizer(encodedSeparator());
+	return true;
+}
+
+bool ImportTable::CSVReader::seek(qint64 offset)
+{
+	// the encoding is known from open() already
+	if (m_gzip)
+	{
+		// inflate and forget the data up to the offset
+		if (offset < m_read)
+		{
+			m_error = tr("Error reading file %1: %2").arg(m_file.fileName()).arg(tr("cannot seek back"));
+			return false;
+		}
+		while (m_read < offset)
+		{
+			QByteArray skipped(m_gzip->read(qMin(offset - m_read, qint64(ChunkSize))));
+			if (skipped.isEmpty())
+			{
+				m_error = tr("Error reading file %1: %2").arg(m_file.fileName())
+						  .arg(m_gzip->failed() ? m_gzip->errorString() : tr("unexpected end of file"));
+				return false;
+			}
+			m_read += skipped.size();
+		}
+	}
+	else if (!m_file.seek(offset))
+	{
+		m_error = tr("Error reading file %1: %2").arg(m_file.fileName()).arg(m_file.errorString());
+		return false;
+	}
+	m_read = offset;
+	m_buffer.clear();
+	m_offset = 0;
+	m_atEnd = false;
+	return true;
+}
+
+bool ImportTable::CSVReader::readChunk()
+{
+	QByteArray raw(m_device->read(ChunkSize));
+	if (raw.isEmpty())
+	{
+		if (m_gzip ? m_gzip->failed() : m_file.error() != QFile::NoError)
+			m_error = tr("Error reading file %1: %2").arg(m_file.fileName()).arg(m_device->errorString());
+		return false;
+	}
+	m_read += raw.size();
+
+	// forget the already parsed records
+	if (m_offset > 0)
+	{
+		m_buffer.remove(0, m_offset);
+		m_offset = 0;
+	}
+	m_buffer += raw;
+	return true;
+}
+
+bool ImportTable::CSVReader::readRow(QStringList & row)
+{
+	if (!m_tokenizer)
+		return false;
+
+	int consumed;
+	CsvTokenizer::Result result;
+	// an unfinished record is parsed again from its start with the next chunk
+	while ((result = m_tokenizer->parse(m_buffer.constData() + m_offset,
+										m_buffer.size() - m_offset,
+										m_atEnd, consumed)) == CsvTokenizer::NeedMore)
+	{
+		if (!readChunk())
+		{
+			if (!m_error.isEmpty())
+				return false;
+			m_atEnd = true;
+		}
+	}
+	if (result == CsvTokenizer::End)
+		return false;
+
+	m_offset += consumed;
+	decodeRecord(*m_tokenizer, row);
+	return true;
+}
+
+bool ImportTable::CSVReader::readBlock(QByteArray & block)
+{
+	if (!m_tokenizer)
+		return false;
+
+	int start = m_offset;
+	int consumed;
+	CsvTokenizer::Result result;
+	while ((result = m_tokenizer->skip(m_buffer.constData() + m_offset,
+									   m_buffer.size() - m_offset,
+									   m_atEnd, consumed)) != CsvTokenizer::End)
+	{
+		if (result == CsvTokenizer::Record)
+		{
+			m_offset += consumed;
+			continue;
+		}
+		// the buffer is used up. Do not move the block start by readChunk().
+		if (m_offset > start)
+			break;
+		if (!readChunk())
+		{
+			if (!m_error.isEmpty())
+				return false;
+			m_atEnd = true;
+		}
+		start = m_offset;
+	}
+
+	block = m_buffer.mid(start, m_offset - start);
+	return !block.isEmpty();
+}
+
+QByteArray ImportTable::CSVReader::encodedSeparator() const
+{
+	return m_codec ? m_codec->fromUnicode(m_separator) : m_separator.toUtf8();
+}
+
+void ImportTable::CSVReader::decodeRecord(const CsvTokenizer & tokenizer, QStringList & row) const
+{
+	row.clear();
+	for (int i = 0; i < tokenizer.fieldCount(); ++i)
+	{
+		if (m_utf8)
+			row.append(QString::fromUtf8(tokenizer.fieldData(i), tokenizer.fieldLength(i)));
+		else
+			row.append(m_codec->toUnicode(tokenizer.fieldData(i), tokenizer.fieldLength(i)));
+	}
+}
+
+ImportTable::TypeSampler::ColumnType ImportTable::TypeSampler::valueType(const QString & value)
+{
+	static QRegExp integer("^[-+]?\\d+$");
+	static QRegExp isoDate("^(\\d{4})-(\\d{2})-(\\d{2})([ T]\\d{2}:\\d{2}(:\\d{2}(\\.\\d+)?)?)?$");
+
+	QString v(value.trimmed());
+	if (v.isEmpty())
+		return Unknown;
+
+	// 007 or 01234 are codes, not numbers
+	int digit = (v.at(0) == '-' || v.at(0) == '+') ? 1 : 0;
+	bool leadingZero = v.length() > digit + 1 && v.at(digit) == '0' && v.at(digit + 1) != '.';
+
+	bool ok;
+	if (integer.exactMatch(v))
+	{
+		v.toLongLong(&ok);
+		if (leadingZero)
+			return Text;
+		return ok ? Integer : Real;
+	}
+	v.toDouble(&ok);
+	if (ok && !leadingZero && v.at(v.length() - 1).isDigit())
+		return Real;
+	if (isoDate.exactMatch(v)
+		&& QDate(isoDate.cap(1).toInt(), isoDate.cap(2).toInt(), isoDate.cap(3).toInt()).isValid())
+		return Date;
+	return Text;
+}
+
+void ImportTable::TypeSampler::sample(Reader * reader, int skipHeader)
+{
+	QStringList row;
+	m_names.clear();
+	m_types.clear();
+	m_rows = 0;
+
+	for (int i = 0; i < skipHeader && reader->readRow(row); ++i)
+	{
+		if (i == 0)
+			m_names = row;
+	}
+
+	while (m_rows < SampleRows && reader->position() <= SampleBytes && reader->readRow(row))
+	{
+		++m_rows;
+		for (int i = 0; i < row.count(); ++i)
+		{
+			if (i == m_types.count())
+				m_types.append(Unknown);
+			ColumnType t = valueType(row.at(i));
+			ColumnType & current = m_types[i];
+			if (t == Unknown || t == current)
+				continue;
+			if (current == Unknown)
+				current = t;
+			else if ((current == Integer && t == Real) || (current == Real && t == Integer))
+				current = Real;
+			else
+				current = Text;
+		}
+	}
+}
+
+FieldList ImportTable::TypeSampler::fields() const
+{
+	FieldList ret;
+	QStringList used;
+	int count = qMax(m_types.count(), m_names.count());
+	for (int i = 0; i < count; ++i)
+	{
+		DatabaseTableField f;
+		f.cid = i;
+		f.name = (i < m_names.count()) ? m_names.at(i).simplified() : QString();
+		if (f.name.isEmpty())
+			f.name = QString("column%1").arg(i + 1);
+		// unique names
+		QString base(f.name);
+		for (int n = 2; used.contains(f.name, Qt::CaseInsensitive); ++n)
+			f.name = QString("%1_%2").arg(base).arg(n);
+		used.append(f.name);
+
+		switch (i < m_types.count() ? m_types.at(i) : Unknown)
+		{
+			case Integer:
+				f.type = "Integer";
+				break;
+			case Real:
+				f.type = "Real";
+				break;
+			case Date:
+				f.type = "Date";
+				break;
+			default:
+				f.type = "Text";
+		}
+		f.notnull = false;
+		f.pk = false;
+		ret.append(f);
+	}
+	return ret;
+}
+
 ImportTable::CSVModel::CSVModel(QString fileName, int skipHeader, QString separator, QObject * parent, int maxRows)
 	: BaseModel(parent)
 {
-	QFile f(fileName);
-	if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+	CSVReader reader(fileName, separator);
+	if (!reader.open())
 	{
 		QMessageBox::warning(qobject_cast<QWidget*>(parent), tr("Data Import"),
-							 tr("Cannot open file %1 for reading.").arg(fileName));
+							 reader.errorString());
 		return;
 	}
 
-	QTextStream in(&f);
 	int r = 0;
 	QStringList row;
 	int tmpSkipHeader = 0;
-	while (!in.atEnd())
+	while (reader.readRow(row))
 	{
-		row = in.readLine().split(separator);
 		if (tmpSkipHeader < skipHeader)
 		{
 			tmpSkipHeader++;
@@ -298,72 +915,54 @@ ImportTable::CSVModel::CSVModel(QString fileName, int skipHeader, QString separa
 		if (maxRows != 0)
 			++r;
 	}
-	f.close();
 }
 
 ImportTable::XMLModel::XMLModel(QString fileName, int skipHeader, QObject * parent, int maxRows)
 	: BaseModel(parent)
 {
-#if QT_VERSION >= 0x040300
-	QFile file(fileName);
-	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+	Reader * reader = createSpreadsheetReader(fileName);
+	if (!reader->open())
 	{
 		QMessageBox::warning(qobject_cast<QWidget*>(parent), tr("Data Import"),
-							 tr("Cannot open file %1 for reading.").arg(fileName));
+							 reader->errorString());
+		delete reader;
 		return;
 	}
 
-	QXmlStreamReader xml(&file);
 	QStringList row;
-	bool isCell = false;
-	int r = 0;
-	int tmpSkipHeader = 0;
-
-	while (!xml.atEnd())
+	for (int i = 0; i < skipHeader && reader->readRow(row); ++i)
+		;
+	while ((maxRows == 0 || m_values.count() < maxRows) && reader->readRow(row))
 	{
-		xml.readNext();
-		if (xml.isStartElement())
-		{
-			if (xml.name() == "Row")
-			{
-				row.clear();
-				isCell = false;
-			}
-			if (xml.name() == "Cell")
-				isCell = true;
-			if (isCell && xml.name() == "Data")
-				row.append(xml.readElementText());
-		}
-		if (xml.isEndElement())
-		{
-			if (xml.name() == "Cell")
-				isCell = false;
-			if (xml.name() == "Row")
-			{
-				if (tmpSkipHeader < skipHeader)
-				{
-					tmpSkipHeader++;
-					continue;
-				}
-				m_values.append(row);
-				if (row.count() > m_columns)
-					m_columns = row.count();
-				row.clear();
-				isCell = false;
-				if (r > maxRows)
-					break;
-				if (maxRows != 0)
-					++r;
-			}
-		}
+		m_values.append(row);
+		if (row.count() > m_columns)
+			m_columns = row.count();
 	}
-	if (xml.error() && xml.error() != QXmlStreamReader::PrematureEndOfDocumentError)
+	if (!reader->errorString().isEmpty())
+		qDebug() << "XML ERROR:" << reader->errorString();
+	delete reader;
+}
+
+ImportTable::JSONModel::JSONModel(QString fileName, QObject * parent, int maxRows)
+	: BaseModel(parent)
+{
+	JSONReader reader(fileName);
+	if (!reader.open())
 	{
-        qDebug() << "XML ERROR:" << xml.lineNumber() << ": " << xml.errorString();
-    }
+		QMessageBox::warning(qobject_cast<QWidget*>(parent), tr("Data Import"),
+							 reader.errorString());
+		return;
+	}
 
-	file.close();
-#endif
+	QStringList row;
+	while ((maxRows == 0 || m_values.count() < maxRows) && reader.readRow(row))
+	{
+		m_values.append(row);
+		if (row.count() > m_columns)
+			m_columns = row.count();
+	}
+	if (!reader.errorString().isEmpty())
+		qDebug() << "JSON ERROR:" << reader.errorString();
 }
 
 void ImportTableDialog::setTablesForSchema(const QString & schema)
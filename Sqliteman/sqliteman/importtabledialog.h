@@ -8,7 +8,18 @@ for which a new license (GPL+exception) is in place.
 #ifndef IMPORTTABLEDIALOG_H
 #define IMPORTTABLEDIALOG_H
 
+#include <QFile>
+#include <QBitArray>
+#include <QCoreApplication>
+
 #include "ui_importtabledialog.h"
+#include "database.h"
+#include "gzipdevice.h"
+
+class QTextCodec;
+class CsvTokenizer;
+class ImportCheckpoint;
+namespace ImportTable { class Reader; }
 
 
 /*! \brief Import data into table using various importer types.
@@ -22,17 +33,43 @@ class ImportTableDialog : public QDialog, public Ui::ImportTableDialog
 	public:
 		ImportTableDialog(QWidget * parent = 0, const QString & tableName = 0, const QString & schema = 0);
 
+		//! \brief True when a new table was created. The schema tree has to be refreshed.
+		bool update;
+
 	private:
 		QObject * m_parent;
 		//! Remember the originally requsted name
 		QString m_tableName;
 
 		QString sqliteSeparator();
+		/*! \brief Create a reader of the current file and type.
+		\retval ImportTable::Reader* an opened reader or 0 on error (reported already). */
+		ImportTable::Reader * createReader();
+		/*! \brief Header rows to skip. JSON readers return the column
+		names as the first row always. */
+		int skipHeaderRows();
 
 		void sqlitePreview();
+		/*! \brief Insert all rows of the reader into the selected table.
+		Rows are committed by batches of the batch size (one transaction
+		when it's 0 or with the bulk load). On cancel only the batch in
+		progress is rolled back, the committed batches stay in the table
+		(see cancelledText()).
+		\retval bool true when the dialog can be closed. */
+		bool importRows(ImportTable::Reader * reader, int skipHeader);
+		/*! \brief Insert all rows with the ImportPipeline threads.
+		The same as importRows() otherwise.
+		\param checkpoint state of the batches for a resume. It can be 0.
+		\param firstRow rows imported before when it's resumed. */
+		bool importPipeline(ImportTable::Reader * reader, int skipHeader,
+							ImportCheckpoint * checkpoint, qint64 firstRow);
+		//! \brief Message for the cancelled import.
+		QString cancelledText(qint64 committed);
 
 	private slots:
 		void fileButton_clicked();
+		//! \brief Propose a new table for the file. See ImportTable::TypeSampler.
+		void createTableButton_clicked();
 		//! \brief Main import is handled here
 		void slotAccepted();
 		//! \brief Overloaded due the defined Qt signal/slot
@@ -49,6 +86,146 @@ class ImportTableDialog : public QDialog, public Ui::ImportTableDialog
 namespace ImportTable
 {
 
+	/*! \brief Sequential source of the imported rows.
+	Readers keep only a small part of the input in the memory so
+	files of any size can be imported.
+	*/
+	class Reader
+	{
+			Q_DECLARE_TR_FUNCTIONS(ImportTable::Reader)
+
+		public:
+			virtual ~Reader() {};
+			//! \brief Open the input. Use errorString() on failure.
+			virtual bool open() = 0;
+			/*! \brief Read the next row.
+			\retval bool false at the end of input or on error. */
+			virtual bool readRow(QStringList & row) = 0;
+			//! \brief Input size for the progress. Units are up to the reader.
+			virtual qint64 size() = 0;
+			//! \brief Already consumed part of the size().
+			virtual qint64 position() = 0;
+			/*! \brief True when null QStrings of the rows are NULL values.
+			Empty values of the other readers are NULL for the numeric
+			columns only. */
+			virtual bool nullValues() const { return false; };
+			/*! \brief True when the values of BLOB columns are base64 text
+			(as DataExporter writes them into JSON). */
+			virtual bool base64Blobs() const { return false; };
+			/*! \brief Columns of the last readRow() whose values are numbers
+			in the input (JSON). Empty when the input has no types. */
+			virtual QBitArray numberValues() const { return QBitArray(); };
+			QString errorString() { return m_error; };
+
+		protected:
+			QString m_error;
+	};
+
+	/*! \brief Streaming CSV reader.
+	The file is read by ChunkSize blocks. Only the current block and
+	the unfinished record are held in the memory. Records are split
+	by CsvTokenizer on the raw bytes so quoted separators and new lines
+	are handled. Size and position are in bytes.
+	*/
+	class CSVReader : public Reader
+	{
+		public:
+			//! \brief Bytes read from the file at once
+			static const int ChunkSize = 256 * 1024;
+
+			CSVReader(const QString & fileName, const QString & separator);
+			~CSVReader();
+
+			bool open();
+			bool readRow(QStringList & row);
+			//! \brief File size. Compressed size for gzip files.
+			qint64 size() { return m_file.size(); };
+			//! \brief Bytes read from the file. It's ahead by the buffered chunk.
+			qint64 position() { return m_gzip ? m_gzip->compressedPosition() : m_file.pos(); };
+			/*! \brief Offset of the next record not read yet.
+			It's in the uncompressed data for gzip files. */
+			qint64 recordPosition() const { return m_read - (m_buffer.size() - m_offset); };
+			/*! \brief Continue reading at a record start.
+			Gzip files are read up to the offset as they cannot seek.
+			\param offset a recordPosition() value from an earlier import. */
+			bool seek(qint64 offset);
+
+			/*! \brief Read raw bytes of whole records (up to one chunk).
+			Blocks are parsed by the ImportPipeline workers.
+			\retval bool false at the end of input or on error. */
+			bool readBlock(QByteArray & block);
+			//! \brief The separator in the file encoding. See CsvTokenizer.
+			QByteArray encodedSeparator() const;
+			/*! \brief Convert the fields of the last parsed record.
+			It can be called from any thread. */
+			void decodeRecord(const CsvTokenizer & tokenizer, QStringList & row) const;
+
+		private:
+			QFile m_file;
+			//! \brief Inflating reader of .gz files. 0 for plain files.
+			GzipDevice * m_gzip;
+			//! \brief m_file or m_gzip
+			QIODevice * m_device;
+			//! \brief Bytes read from m_device
+			qint64 m_read;
+			QString m_separator;
+			//! \brief Locale codec or UTF-8 for files with BOM
+			QTextCodec * m_codec;
+			//! \brief QString::fromUtf8() is faster than the codec
+			bool m_utf8;
+			CsvTokenizer * m_tokenizer;
+			//! \brief Raw bytes not parsed yet (starts at m_offset)
+			QByteArray m_buffer;
+			int m_offset;
+			bool m_atEnd;
+
+			//! \brief Append the next chunk to m_buffer. False at the end of file.
+			bool readChunk();
+	};
+
+	/*! \brief Guess the column types from a sample of the input.
+	The first SampleBytes (at most SampleRows rows) are read. Each
+	column gets the narrowest type which fits all its non-empty
+	values: integer, real, ISO date or text. Numbers with leading
+	zeros (zip codes, IDs) are text so they are not changed.
+	*/
+	class TypeSampler
+	{
+		public:
+			enum ColumnType
+			{
+				//! \brief Empty values only
+				Unknown,
+				Integer,
+				Real,
+				Date,
+				Text
+			};
+
+			//! \brief Input bytes read for the guess
+			static const qint64 SampleBytes = 4 * 1024 * 1024;
+			//! \brief Max rows read for the guess
+			static const int SampleRows = 100000;
+
+			/*! \brief Read the sample from the start of an opened reader.
+			\param skipHeader count of header rows. Names of the columns
+			       are taken from the first of them. */
+			void sample(Reader * reader, int skipHeader);
+			/*! \brief Columns for CREATE TABLE. Types are "Integer",
+			"Real", "Date" or "Text". */
+			FieldList fields() const;
+			//! \brief Count of the sampled rows (without header).
+			int rows() const { return m_rows; };
+
+			//! \brief Type of one value.
+			static ColumnType valueType(const QString & value);
+
+		private:
+			QStringList m_names;
+			QList<ColumnType> m_types;
+			int m_rows;
+	};
+
 	/*! \brief A base Model for all import "modules".
 	It's a model in qt4 mvc architecture. See Qt4 docs for
 	methods meanings.
@@ -87,7 +264,8 @@ namespace ImportTable
 			CSVModel(QString fileName, int skipHeader, QString separator, QObject * parent = 0, int maxRows = 0);
 	};
 
-	/*! \brief MS Excel XML importer
+	/*! \brief MS Excel importer (XML and XLSX) for the preview.
+	See createSpreadsheetReader().
 	\note XML import requires Qt library at least in the 4.3.0 version.
 	*/
 	class XMLModel : public BaseModel
@@ -98,6 +276,17 @@ namespace ImportTable
 			XMLModel(QString fileName, int skipHeader, QObject * parent = 0, int maxRows = 0);
 	};
 
+	/*! \brief JSON Lines and JSON array importer for the preview.
+	The first row shows the column names. See JSONReader.
+	*/
+	class JSONModel : public BaseModel
+	{
+		Q_OBJECT
+
+		public:
+			JSONModel(QString fileName, QObject * parent = 0, int maxRows = 0);
+	};
+
 };
 
 #endif
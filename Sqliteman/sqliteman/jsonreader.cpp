@@ -0,0 +1,192 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <cstring>
+
+#include "jsonreader.h"
+
+
+ImportTable::JSONReader::JSONReader(const QString & fileName)
+	: m_file(fileName),
+	  m_gzip(0),
+	  m_device(&m_file),
+	  m_offset(0),
+	  m_atEnd(false),
+	  m_records(0),
+	  m_state(Header)
+{
+}
+
+ImportTable::JSONReader::~JSONReader()
+{
+	delete m_gzip;
+}
+
+void ImportTable::JSONReader::setColumns(const QStringList & columns)
+{
+	m_columns = columns;
+}
+
+bool ImportTable::JSONReader::open()
+{
+	if (GzipDevice::isGzip(m_file.fileName()))
+	{
+		m_gzip = new GzipDevice(m_file.fileName());
+		m_device = m_gzip;
+	}
+	if (!m_device->open(QIODevice::ReadOnly))
+	{
+		m_error = tr("Cannot open file %1 for reading.").arg(m_file.fileName());
+		return false;
+	}
+	// JSON is UTF-8. The BOM is not a part of it.
+	if (m_device->peek(3) == "\xEF\xBB\xBF")
+		m_device->read(3);
+	return true;
+}
+
+bool ImportTable::JSONReader::readChunk()
+{
+	QByteArray raw(m_device->read(ChunkSize));
+	if (raw.isEmpty())
+	{
+		if (m_gzip ? m_gzip->failed() : m_file.error() != QFile::NoError)
+			m_error = tr("Error reading file %1: %2").arg(m_file.fileName()).arg(m_device->errorString());
+		return false;
+	}
+
+	// forget the already parsed records
+	if (m_offset > 0)
+	{
+		m_buffer.remove(0, m_offset);
+		m_offset = 0;
+	}
+	m_buffer += raw;
+	return true;
+}
+
+bool ImportTable::JSONReader::nextRecord()
+{
+	while (true)
+	{
+		int consumed = 0;
+		switch (m_tokenizer.parse(m_buffer.constData() + m_offset, m_buffer.size() - m_offset,
+								  m_atEnd, consumed))
+		{
+			case JsonTokenizer::Record:
+				m_offset += consumed;
+				++m_records;
+				return true;
+			case JsonTokenizer::End:
+				return false;
+			case JsonTokenizer::Error:
+				m_error = tr("JSON error in the object %1: %2").arg(m_records + 1)
+							.arg(QString::fromUtf8(m_tokenizer.errorString()));
+				return false;
+			case JsonTokenizer::NeedMore:
+				if (!readChunk())
+				{
+					if (!m_error.isEmpty())
+						return false;
+					m_atEnd = true;
+				}
+				break;
+		}
+	}
+}
+
+int ImportTable::JSONReader::column(int field)
+{
+	const char * key = m_tokenizer.keyData(field);
+	int length = m_tokenizer.keyLength(field);
+	if (field < m_lastKeys.size())
+	{
+		const QByteArray & last = m_lastKeys.at(field);
+		if (last.size() == length && memcmp(last.constData(), key, length) == 0)
+			return m_lastColumns.at(field);
+	}
+	else
+	{
+		m_lastKeys.resize(field + 1);
+		m_lastColumns.resize(field + 1);
+	}
+	int c = m_index.value(QString::fromUtf8(key, length).toLower(), -1);
+	m_lastKeys[field] = QByteArray(key, length);
+	m_lastColumns[field] = c;
+	return c;
+}
+
+void ImportTable::JSONReader::convertRecord(QStringList & row)
+{
+	// missing keys are NULL
+	row.clear();
+	for (int i = 0; i < m_columns.count(); ++i)
+		row.append(QString());
+	m_numbers.fill(false, m_columns.count());
+
+	for (int i = 0; i < m_tokenizer.fieldCount(); ++i)
+	{
+		int c = column(i);
+		if (c < 0)
+			continue;
+		switch (m_tokenizer.valueType(i))
+		{
+			case JsonTokenizer::Null:
+				row[c] = QString();
+				break;
+			case JsonTokenizer::True:
+				row[c] = QLatin1String("1");
+				m_numbers.setBit(c);
+				break;
+			case JsonTokenizer::False:
+				row[c] = QLatin1String("0");
+				m_numbers.setBit(c);
+				break;
+			case JsonTokenizer::Number:
+				row[c] = QString::fromUtf8(m_tokenizer.valueData(i), m_tokenizer.valueLength(i));
+				m_numbers.setBit(c);
+				break;
+			default:
+				// an empty string is not NULL
+				if (m_tokenizer.valueLength(i) == 0)
+					row[c] = QLatin1String("");
+				else
+					row[c] = QString::fromUtf8(m_tokenizer.valueData(i), m_tokenizer.valueLength(i));
+				break;
+		}
+	}
+}
+
+bool ImportTable::JSONReader::readRow(QStringList & row)
+{
+	switch (m_state)
+	{
+		case Header:
+			// the columns are known from the first object
+			if (!nextRecord())
+				return false;
+			if (m_columns.isEmpty())
+			{
+				for (int i = 0; i < m_tokenizer.fieldCount(); ++i)
+					m_columns.append(QString::fromUtf8(m_tokenizer.keyData(i), m_tokenizer.keyLength(i)));
+			}
+			for (int i = 0; i < m_columns.count(); ++i)
+				m_index.insert(m_columns.at(i).toLower(), i);
+			m_state = FirstRecord;
+			row = m_columns;
+			return true;
+		case FirstRecord:
+			m_state = Reading;
+			break;
+		case Reading:
+			if (!nextRecord())
+				return false;
+			break;
+	}
+	convertRecord(row);
+	return true;
+}
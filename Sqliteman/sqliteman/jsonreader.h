@@ -0,0 +1,104 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef JSONREADER_H
+#define JSONREADER_H
+
+#include <QHash>
+#include <QVector>
+
+#include "importtabledialog.h"
+#include "jsontokenizer.h"
+
+
+namespace ImportTable
+{
+
+	/*! \brief Streaming reader of JSON Lines (NDJSON) and JSON arrays.
+	Each record is one JSON object. The file is read by ChunkSize
+	blocks and split by JsonTokenizer so only the current block and
+	the unfinished object are in the memory.
+
+	The first row returned is the column names. The import skips it
+	as a header. Columns are the keys of the first object or the ones
+	given by setColumns(). Keys of the objects are mapped to the columns
+	by the name (case insensitive) so their order does not matter. Unknown
+	keys are ignored, missing ones are NULL.
+
+	Values keep their JSON types for the typed ImportInserter: null is
+	a null QString (see nullValues()), numbers are unquoted, true and false
+	are 1 and 0 (numbers and booleans are flagged by numberValues()).
+	Nested objects and arrays are imported as JSON text.
+	Strings of the columns declared BLOB are base64 (see base64Blobs()).
+	Size and position are in bytes (compressed ones for gzip files).
+	*/
+	class JSONReader : public Reader
+	{
+		public:
+			//! \brief Bytes read from the file at once
+			static const int ChunkSize = 256 * 1024;
+
+			JSONReader(const QString & fileName);
+			~JSONReader();
+
+			/*! \brief Import the keys into these columns (e.g. of the target
+			table). Call it before the first readRow(). */
+			void setColumns(const QStringList & columns);
+
+			bool open();
+			bool readRow(QStringList & row);
+			qint64 size() { return m_file.size(); };
+			qint64 position() { return m_gzip ? m_gzip->compressedPosition() : m_file.pos(); };
+			bool nullValues() const { return true; };
+			bool base64Blobs() const { return true; };
+			QBitArray numberValues() const { return m_numbers; };
+
+		private:
+			enum State
+			{
+				//! \brief The column names are returned by the next readRow()
+				Header,
+				//! \brief The first object is parsed and not returned yet
+				FirstRecord,
+				Reading
+			};
+
+			QFile m_file;
+			//! \brief Inflating reader of .gz files. 0 for plain files.
+			GzipDevice * m_gzip;
+			//! \brief m_file or m_gzip
+			QIODevice * m_device;
+			JsonTokenizer m_tokenizer;
+			//! \brief Raw bytes not parsed yet (starts at m_offset)
+			QByteArray m_buffer;
+			int m_offset;
+			bool m_atEnd;
+			qint64 m_records;
+			State m_state;
+
+			QStringList m_columns;
+			//! \brief Number values of the last row. See numberValues().
+			QBitArray m_numbers;
+			//! \brief Column by the lower case key
+			QHash<QString,int> m_index;
+			/*! \brief Keys of the previous object and their columns. Objects
+			have the same keys usually - no lookup is needed then. */
+			QVector<QByteArray> m_lastKeys;
+			QVector<int> m_lastColumns;
+
+			//! \brief Append the next chunk to m_buffer. False at the end of file.
+			bool readChunk();
+			//! \brief Parse the next object. False at the end or on error.
+			bool nextRecord();
+			//! \brief Values of the parsed object in the column order.
+			void convertRecord(QStringList & row);
+			int column(int field);
+	};
+
+};
+
+#endif
@@ -0,0 +1,350 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <cstring>
+
+#include "jsontokenizer.h"
+
+
+//! \brief Value of a hex digit or -1.
+static inline int hexValue(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+//! \brief Value of 4 hex digits or -1.
+static int hex4(const char * p)
+{
+	int value = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		int h = hexValue(p[i]);
+		if (h < 0)
+			return -1;
+		value = (value << 4) | h;
+	}
+	return value;
+}
+
+static inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+
+JsonTokenizer::JsonTokenizer()
+	: m_used(0),
+	  m_fieldCount(0),
+	  m_data(0),
+	  m_size(0),
+	  m_pos(0),
+	  m_atEnd(false)
+{
+}
+
+void JsonTokenizer::append(const char * data, int length)
+{
+	if (m_used + length > m_record.size())
+		m_record.resize(qMax(m_record.size() * 2, m_used + length));
+	memcpy(m_record.data() + m_used, data, length);
+	m_used += length;
+}
+
+void JsonTokenizer::skipSpace()
+{
+	while (m_pos < m_size && isSpace(m_data[m_pos]))
+		++m_pos;
+}
+
+JsonTokenizer::Result JsonTokenizer::more()
+{
+	if (m_atEnd)
+		return fail("unexpected end of input");
+	return NeedMore;
+}
+
+JsonTokenizer::Result JsonTokenizer::fail(const char * message)
+{
+	m_error = QByteArray(message) + " at byte " + QByteArray::number(m_pos) + " of the record";
+	return Error;
+}
+
+JsonTokenizer::Result JsonTokenizer::parse(const char * data, int size, bool atEnd, int & consumed)
+{
+	m_data = data;
+	m_size = size;
+	m_pos = 0;
+	m_atEnd = atEnd;
+	m_used = 0;
+	m_fieldCount = 0;
+
+	// white space, commas and brackets of the JSON array
+	while (m_pos < m_size && (isSpace(m_data[m_pos]) || m_data[m_pos] == ','
+							  || m_data[m_pos] == '[' || m_data[m_pos] == ']'))
+		++m_pos;
+	if (m_pos >= m_size)
+		return atEnd ? End : NeedMore;
+	if (m_data[m_pos] != '{')
+		return fail("an object expected");
+	++m_pos;
+
+	skipSpace();
+	if (m_pos >= m_size)
+		return more();
+	if (m_data[m_pos] == '}')
+	{
+		consumed = ++m_pos;
+		return Record;
+	}
+
+	while (true)
+	{
+		skipSpace();
+		if (m_pos >= m_size)
+			return more();
+		if (m_data[m_pos] != '"')
+			return fail("a key expected");
+
+		Field f;
+		Result r = parseString(f.key, f.keyLength);
+		if (r != Record)
+			return r;
+
+		skipSpace();
+		if (m_pos >= m_size)
+			return more();
+		if (m_data[m_pos] != ':')
+			return fail("':' expected");
+		++m_pos;
+		skipSpace();
+		if (m_pos >= m_size)
+			return more();
+
+		f.value = m_used;
+		f.valueLength = 0;
+		switch (m_data[m_pos])
+		{
+			case '"':
+				f.type = String;
+				r = parseString(f.value, f.valueLength);
+				break;
+			case 't':
+				f.type = True;
+				r = parseLiteral("true");
+				break;
+			case 'f':
+				f.type = False;
+				r = parseLiteral("false");
+				break;
+			case 'n':
+				f.type = Null;
+				r = parseLiteral("null");
+				break;
+			case '{':
+			case '[':
+				f.type = Raw;
+				r = parseRaw(f.value, f.valueLength);
+				break;
+			default:
+				f.type = Number;
+				r = parseRaw(f.value, f.valueLength);
+				break;
+		}
+		if (r != Record)
+			return r;
+
+		if (m_fieldCount == m_fields.size())
+			m_fields.resize(m_fields.size() * 2 + 8);
+		m_fields[m_fieldCount++] = f;
+
+		skipSpace();
+		if (m_pos >= m_size)
+			return more();
+		if (m_data[m_pos] == ',')
+		{
+			++m_pos;
+			continue;
+		}
+		if (m_data[m_pos] == '}')
+		{
+			consumed = ++m_pos;
+			return Record;
+		}
+		return fail("',' or '}' expected");
+	}
+}
+
+JsonTokenizer::Result JsonTokenizer::parseString(int & start, int & length)
+{
+	++m_pos;
+	start = m_used;
+	while (true)
+	{
+		// copy the plain characters at once
+		int run = m_pos;
+		while (m_pos < m_size && m_data[m_pos] != '"' && m_data[m_pos] != '\\')
+			++m_pos;
+		append(m_data + run, m_pos - run);
+		if (m_pos >= m_size)
+			return more();
+		if (m_data[m_pos] == '"')
+		{
+			++m_pos;
+			length = m_used - start;
+			return Record;
+		}
+
+		if (m_pos + 1 >= m_size)
+			return more();
+		char c = m_data[m_pos + 1];
+		if (c != 'u')
+		{
+			switch (c)
+			{
+				case 'b':
+					c = '\b';
+					break;
+				case 'f':
+					c = '\f';
+					break;
+				case 'n':
+					c = '\n';
+					break;
+				case 'r':
+					c = '\r';
+					break;
+				case 't':
+					c = '\t';
+					break;
+				default:
+					// " \ / and the invalid ones as they are
+					break;
+			}
+			append(&c, 1);
+			m_pos += 2;
+			continue;
+		}
+
+		if (m_pos + 6 > m_size)
+			return more();
+		int code = hex4(m_data + m_pos + 2);
+		if (code < 0)
+			return fail("invalid \\u escape");
+		m_pos += 6;
+		if (code >= 0xD800 && code < 0xDC00)
+		{
+			// the low surrogate follows
+			if (m_pos + 6 > m_size && !m_atEnd)
+				return NeedMore;
+			int low = (m_pos + 6 <= m_size && m_data[m_pos] == '\\' && m_data[m_pos + 1] == 'u')
+					  ? hex4(m_data + m_pos + 2) : -1;
+			if (low >= 0xDC00 && low < 0xE000)
+			{
+				code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				m_pos += 6;
+			}
+			else
+				code = 0xFFFD;
+		}
+		else if (code >= 0xDC00 && code < 0xE000)
+			code = 0xFFFD;
+
+		char utf8[4];
+		int n;
+		if (code < 0x80)
+		{
+			utf8[0] = char(code);
+			n = 1;
+		}
+		else if (code < 0x800)
+		{
+			utf8[0] = char(0xC0 | (code >> 6));
+			utf8[1] = char(0x80 | (code & 0x3F));
+			n = 2;
+		}
+		else if (code < 0x10000)
+		{
+			utf8[0] = char(0xE0 | (code >> 12));
+			utf8[1] = char(0x80 | ((code >> 6) & 0x3F));
+			utf8[2] = char(0x80 | (code & 0x3F));
+			n = 3;
+		}
+		else
+		{
+			utf8[0] = char(0xF0 | (code >> 18));
+			utf8[1] = char(0x80 | ((code >> 12) & 0x3F));
+			utf8[2] = char(0x80 | ((code >> 6) & 0x3F));
+			utf8[3] = char(0x80 | (code & 0x3F));
+			n = 4;
+		}
+		append(utf8, n);
+	}
+}
+
+JsonTokenizer::Result JsonTokenizer::parseRaw(int & start, int & length)
+{
+	int begin = m_pos;
+	if (m_data[m_pos] == '{' || m_data[m_pos] == '[')
+	{
+		// the nested value ends with its bracket. Strings can contain brackets.
+		int depth = 0;
+		bool inString = false;
+		for (; m_pos < m_size; ++m_pos)
+		{
+			char c = m_data[m_pos];
+			if (inString)
+			{
+				if (c == '\\')
+					++m_pos;
+				else if (c == '"')
+					inString = false;
+			}
+			else if (c == '"')
+				inString = true;
+			else if (c == '{' || c == '[')
+				++depth;
+			else if ((c == '}' || c == ']') && --depth == 0)
+				break;
+		}
+		if (m_pos >= m_size)
+			return more();
+		++m_pos;
+	}
+	else
+	{
+		while (m_pos < m_size && ((m_data[m_pos] >= '0' && m_data[m_pos] <= '9')
+								  || (m_data[m_pos] && strchr("+-.eE", m_data[m_pos]))))
+			++m_pos;
+		// the number can continue in the next chunk
+		if (m_pos >= m_size && !m_atEnd)
+			return NeedMore;
+		if (m_pos == begin)
+			return fail("a value expected");
+	}
+
+	start = m_used;
+	append(m_data + begin, m_pos - begin);
+	length = m_pos - begin;
+	return Record;
+}
+
+JsonTokenizer::Result JsonTokenizer::parseLiteral(const char * literal)
+{
+	int length = qstrlen(literal);
+	if (m_pos + length > m_size)
+		return more();
+	if (memcmp(m_data + m_pos, literal, length) != 0)
+		return fail("a value expected");
+	m_pos += length;
+	return Record;
+}
@@ -0,0 +1,114 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef JSONTOKENIZER_H
+#define JSONTOKENIZER_H
+
+#include <QByteArray>
+#include <QVector>
+
+
+/*! \brief JSON tokenizer of the imported records working on raw UTF-8.
+It splits one record (a JSON object) at a time. Records can be
+JSON Lines (NDJSON) or items of a JSON array - the brackets, commas
+and white space between the top level objects are skipped.
+
+Members of the object are the fields. String keys and values are
+unescaped (including \\uXXXX surrogate pairs). Numbers are returned
+as they are written. Nested objects and arrays are returned as their
+raw JSON text.
+
+The interface is the same as of CsvTokenizer. Fields are valid until
+the next parse() call. No memory is allocated when the records are
+not growing.
+*/
+class JsonTokenizer
+{
+	public:
+		enum Result
+		{
+			//! \brief One record is parsed. See fieldCount().
+			Record,
+			//! \brief The record is not complete. Call it again with more data.
+			NeedMore,
+			//! \brief No more records.
+			End,
+			//! \brief The input is not valid. See errorString().
+			Error
+		};
+
+		enum ValueType
+		{
+			Null,
+			False,
+			True,
+			Number,
+			String,
+			//! \brief Nested object or array as JSON text
+			Raw
+		};
+
+		JsonTokenizer();
+
+		/*! \brief Parse one record from the beginning of data.
+		\param data the input starting after the previous record.
+		\param size the input size.
+		\param atEnd true when there is no more input after the size.
+		\param consumed bytes of the record including the separators before
+		       it. It's set for Record result only. The next record starts there.
+		*/
+		Result parse(const char * data, int size, bool atEnd, int & consumed);
+
+		int fieldCount() const { return m_fieldCount; };
+		const char * keyData(int i) const { return m_record.constData() + m_fields.at(i).key; };
+		int keyLength(int i) const { return m_fields.at(i).keyLength; };
+		ValueType valueType(int i) const { return m_fields.at(i).type; };
+		const char * valueData(int i) const { return m_record.constData() + m_fields.at(i).value; };
+		int valueLength(int i) const { return m_fields.at(i).valueLength; };
+
+		//! \brief Description of the last Error result.
+		QByteArray errorString() const { return m_error; };
+
+	private:
+		typedef struct
+		{
+			int key;
+			int keyLength;
+			int value;
+			int valueLength;
+			ValueType type;
+		}
+		Field;
+
+		//! \brief Unescaped keys and values of the current record. It's never shrinked.
+		QByteArray m_record;
+		int m_used;
+		QVector<Field> m_fields;
+		int m_fieldCount;
+		QByteArray m_error;
+
+		// parsing state of one parse() call
+		const char * m_data;
+		int m_size;
+		int m_pos;
+		bool m_atEnd;
+
+		void skipSpace();
+		/*! \brief Unescape the string at m_pos (the opening quote) into m_record.
+		\retval Result Record when the string is complete. */
+		Result parseString(int & start, int & length);
+		//! \brief Copy the number or the nested value at m_pos.
+		Result parseRaw(int & start, int & length);
+		//! \brief Check the literal (true, false, null) at m_pos.
+		Result parseLiteral(const char * literal);
+		Result fail(const char * message);
+		//! \brief NeedMore or the Error at the end of input.
+		Result more();
+		void append(const char * data, int length);
+};
+
+#endif
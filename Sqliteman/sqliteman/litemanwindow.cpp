@@ -42,12 +42,15 @@ for which a new license (GPL+exception) is in place.
 #include "dataviewer.h"
 #include "schemabrowser.h"
 #include "database.h"
+#include "databasesession.h"
 #include "sqleditor.h"
 #include "sqlmodels.h"
+#include "sqlresultmodel.h"
 #include "createindexdialog.h"
 #include "constraintsdialog.h"
 #include "analyzedialog.h"
 #include "vacuumdialog.h"
+#include "databasepooldialog.h"
 #include "helpbrowser.h"
 #include "importtabledialog.h"
 #include "sqliteprocess.h"
@@ -97,6 +100,8 @@ LiteManWindow::LiteManWindow(const QString & fileToOpen)
 	statusBar();
 	m_sqliteVersionLabel = new QLabel(this);
 	statusBar()->addPermanentWidget(m_sqliteVersionLabel);
+	m_profiledTime = -1;
+	m_profiling = false;
 
 	readSettings();
 
@@ -182,10 +187,24 @@ void LiteManWindow::initUI()
 	// sql editor
 	connect(sqlEditor, SIGNAL(showSqlResult(QString)),
 			this, SLOT(execSql(QString)));
+	connect(sqlEditor, SIGNAL(stopSqlResult()),
+			this, SLOT(stopSql()));
+	connect(sqlEditor, SIGNAL(aboutToWrite()),
+			this, SLOT(releaseResultLock()));
 	connect(sqlEditor, SIGNAL(sqlScriptStart()),
 			dataViewer, SLOT(sqlScriptStart()));
 	connect(sqlEditor, SIGNAL(showSqlScriptResult(QString)),
 			dataViewer, SLOT(showSqlScriptResult(QString)));
+	connect(sqlEditor, SIGNAL(showQueryPlan(const QString &)),
+			dataViewer, SLOT(showQueryPlan(const QString &)));
+	connect(sqlEditor, SIGNAL(showBytecode(const QString &)),
+			dataViewer, SLOT(showBytecode(const QString &)));
+	connect(sqlEditor, SIGNAL(sqlScriptStart()),
+			this, SLOT(startProfiling()));
+	connect(sqlEditor, SIGNAL(sqlScriptFinished()),
+			this, SLOT(stopProfiling()));
+	connect(sqlEditor, SIGNAL(statementProfiled(const SqlStatementProfile &)),
+			this, SLOT(mainProfiled(const SqlStatementProfile &)));
 	connect(sqlEditor, SIGNAL(rebuildViewTree(QString, QString)),
 			schemaBrowser->tableTree, SLOT(buildViewTree(QString,QString)));
 	connect(sqlEditor, SIGNAL(buildTree()),
@@ -321,6 +340,9 @@ void LiteManWindow::initActions()
 	vacuumAct = new QAction(tr("&Vacuum..."), this);
 	connect(vacuumAct, SIGNAL(triggered()), this, SLOT(vacuumDialog()));
 
+	poolAct = new QAction(tr("Connection &Pool..."), this);
+	connect(poolAct, SIGNAL(triggered()), this, SLOT(poolDialog()));
+
 	attachAct = new QAction(tr("A&ttach Database..."), this);
 	connect(attachAct, SIGNAL(triggered()), this, SLOT(attachDatabase()));
 
@@ -369,6 +391,7 @@ void LiteManWindow::initMenus()
 	adminMenu = menuBar()->addMenu(tr("&System"));
 	adminMenu->addAction(analyzeAct);
 	adminMenu->addAction(vacuumAct);
+	adminMenu->addAction(poolAct);
 	adminMenu->addSeparator();
 	adminMenu->addAction(attachAct);
 #ifdef ENABLE_EXTENSIONS
@@ -509,6 +532,9 @@ void LiteManWindow::openDatabase(const QString & fileName)
 {
 	bool isOpened = false;
 
+	// background statement uses the old database file
+	stopSql();
+
 	QSqlDatabase db = QSqlDatabase::database(SESSION_NAME);
 	if (db.isValid())
 	{
@@ -524,7 +550,13 @@ void LiteManWindow::openDatabase(const QString & fileName)
 	db.setDatabaseName(fileName);
 
 	QString msg = tr("Unable to open or create file %1. It is probably not a database").arg(QFileInfo(fileName).fileName());
-	if(!db.open())
+	bool ok;
+	{
+		// the main connection must not join the readers' shared cache
+		QMutexLocker openLocker(DatabaseSession::openMutex());
+		ok = db.open();
+	}
+	if(!ok)
 	{
 		QMessageBox::warning(this, m_appName, msg);
 		return;
@@ -559,6 +591,13 @@ void LiteManWindow::openDatabase(const QString & fileName)
 			ver = "n/a";
 		m_sqliteVersionLabel->setText("Sqlite: " + ver);
 
+		// the profile hook is set for the SQL editor statements only
+		m_profilePending.clear();
+		m_profiling = false;
+
+		// connections of the background jobs
+		DatabaseSession::setDatabases(Database::getDatabases(), true);
+
 #ifdef ENABLE_EXTENSIONS
 		// load startup exceptions
 		bool loadE = Preferences::instance()->allowExtensionLoading();
@@ -574,6 +613,7 @@ void LiteManWindow::openDatabase(const QString & fileName)
 
 		attachedDb.clear();
 		attachedDb["main"] = SESSION_NAME;
+		Database::invalidateCatalog();
 	
 		QFileInfo fi(fileName);
 		QDir::setCurrent(fi.absolutePath());
@@ -676,17 +716,61 @@ void LiteManWindow::execSql(QString query)
 	dataViewer->freeResources();
 	sqlEditor->setStatusMessage();
 
+	if (!SqlResultModel::canRunAsync(query))
+	{
+		execSqlDirect(query);
+		return;
+	}
+
+	// Run query in the background
+	SqlResultModel * model = new SqlResultModel(this);
+	connect(model, SIGNAL(progress(qint64, int)),
+			this, SLOT(sqlResultProgress(qint64, int)));
+	connect(model, SIGNAL(statusChanged()),
+			this, SLOT(sqlResultStatus()));
+	connect(model, SIGNAL(prepareFailed(const QString &)),
+			this, SLOT(sqlResultFailed()));
+	connect(model, SIGNAL(profiled(const SqlStatementProfile &)),
+			this, SLOT(sqlProfiled(const SqlStatementProfile &)));
+
+	if (!dataViewer->setTableModel(model, false))
+		return;
+
+	model->exec(query);
+	sqlEditor->setQueryRunning(true);
+	dataViewer->setStatusText(tr("Query is running...\n%1").arg(query));
+}
+
+void LiteManWindow::execSqlDirect(const QString & query)
+{
 	QTime time;
 	time.start();
+	SqlStatementProfile profile(SqlProfile::create(query));
 
 	// Run query
+	startProfiling();
 	SqlQueryModel * model = new SqlQueryModel(this);
 	model->setQuery(query, QSqlDatabase::database(SESSION_NAME));
+	stopProfiling();
+
+	profile.elapsed = time.elapsed();
+	if (!model->lastError().isValid())
+	{
+		if (model->query().isSelect())
+		{
+			profile.rows = model->rowCount();
+			profile.moreRows = model->canFetchMore();
+		}
+		else
+			profile.rows = model->query().numRowsAffected();
+	}
+	SqlProfile::readCounters(model->query(), profile);
+	mainProfiled(profile);
 
 	if (!dataViewer->setTableModel(model, false))
 		return;
 
-	sqlEditor->setStatusMessage(tr("Duration: %1 seconds").arg(time.elapsed() / 1000.0));
+	sqlEditor->setStatusMessage(tr("Duration: %1 seconds").arg(profile.elapsed / 1000.0));
 	
 	// Check For Error in the SQL
 	if(model->lastError().isValid())
@@ -704,6 +788,141 @@ void LiteManWindow::execSql(QString query)
 	}
 }
 
+void LiteManWindow::stopSql()
+{
+	SqlResultModel * model = qobject_cast<SqlResultModel*>(dataViewer->tableData());
+	if (model)
+		model->stop();
+}
+
+void LiteManWindow::releaseResultLock()
+{
+	SqlResultModel * model = qobject_cast<SqlResultModel*>(dataViewer->tableData());
+	if (model)
+		model->releaseLocks();
+}
+
+void LiteManWindow::sqlResultProgress(qint64 steps, int elapsed)
+{
+	sqlEditor->setStatusMessage(tr("Running: %1 VM steps, %2 seconds")
+									.arg(steps).arg(elapsed / 1000.0));
+}
+
+void LiteManWindow::sqlResultStatus()
+{
+	SqlResultModel * model = qobject_cast<SqlResultModel*>(sender());
+	// a result from the previous run
+	if (!model || model != dataViewer->tableData())
+		return;
+
+	sqlEditor->setQueryRunning(model->isRunning());
+
+	// the statement can sleep waiting for fetchMore() so the first
+	// row latency is more interesting for the user than total time
+	if (model->firstRowTime() < 0)
+		sqlEditor->setStatusMessage(tr("Duration: %1 seconds").arg(model->elapsed() / 1000.0));
+	else
+		sqlEditor->setStatusMessage(tr("Duration: %1 seconds (first row: %2 seconds)")
+										.arg(model->elapsed() / 1000.0)
+										.arg(model->firstRowTime() / 1000.0));
+
+	// big tables are counted in the background
+	QString rows(QString::number(model->rowCount()));
+	if (model->isEstimated())
+		rows = tr("%1 (estimated)").arg(rows);
+
+	if (!model->lastError().isEmpty())
+		dataViewer->setStatusText(tr("Query Error: %1\nRow(s) returned: %2\n\n%3")
+									.arg(model->lastError())
+									.arg(rows)
+									.arg(model->query()));
+	else
+	{
+		QString cached;
+		if (model->canFetchMore())
+			cached = DataViewer::canFetchMore();
+		dataViewer->setStatusText(tr("Query OK\nRow(s) returned: %1 %2\n%3")
+									.arg(rows).arg(cached).arg(model->query()));
+	}
+}
+
+void LiteManWindow::sqlResultFailed()
+{
+	SqlResultModel * model = qobject_cast<SqlResultModel*>(sender());
+	if (!model || model != dataViewer->tableData())
+		return;
+	// e.g. a function from runtime loaded extension. Main connection knows it.
+	sqlEditor->setQueryRunning(false);
+	execSqlDirect(model->query());
+}
+
+void LiteManWindow::sqlProfiled(const SqlStatementProfile & profile)
+{
+	SqlStatementProfile p(profile);
+	// the main connection statement can be finished already
+	if (p.vmTime < 0 && m_profiledSql == p.statement.simplified())
+		p.vmTime = m_profiledTime;
+	dataViewer->addProfile(p);
+	sqlEditor->setHistoryProfile(p);
+}
+
+void LiteManWindow::mainProfiled(const SqlStatementProfile & profile)
+{
+	sqlProfiled(profile);
+	QString sql(profile.statement.simplified());
+	if (m_profiledSql == sql)
+		return;
+	m_profilePending.append(sql);
+	// the same limit as the "Profile" tab
+	if (m_profilePending.count() > 30)
+		m_profilePending.removeFirst();
+	if (!m_profiling)
+	{
+		// the statement is finished later - keep the hook until then
+		sqlite3 * handle = Database::sqlite3handle();
+		if (handle)
+			sqlite3_profile(handle, profileCallback, this);
+	}
+}
+
+void LiteManWindow::startProfiling()
+{
+	sqlite3 * handle = Database::sqlite3handle();
+	if (!handle)
+		return;
+	m_profiling = true;
+	m_profiledSql = QString();
+	sqlite3_profile(handle, profileCallback, this);
+}
+
+void LiteManWindow::stopProfiling()
+{
+	m_profiling = false;
+	sqlite3 * handle = Database::sqlite3handle();
+	if (handle && m_profilePending.isEmpty())
+		sqlite3_profile(handle, 0, 0);
+}
+
+void LiteManWindow::profileCallback(void * window, const char * sql, sqlite3_uint64 ns)
+{
+	LiteManWindow * w = static_cast<LiteManWindow*>(window);
+	QString s(QString::fromUtf8(sql).simplified());
+	if (w->m_profiling)
+	{
+		w->m_profiledSql = s;
+		w->m_profiledTime = ns;
+	}
+	// other statements (catalog queries etc.) are not in the tab
+	int ix = w->m_profilePending.indexOf(s);
+	if (ix == -1)
+		return;
+	w->m_profilePending.removeAt(ix);
+	w->dataViewer->setProfileTime(s, ns);
+	w->sqlEditor->setHistoryProfileTime(s, ns);
+	if (!w->m_profiling && w->m_profilePending.isEmpty())
+		sqlite3_profile(Database::sqlite3handle(), 0, 0);
+}
+
 void LiteManWindow::exportSchema()
 {
 	QString fileName = QFileDialog::getSaveFileName(this, tr("Export Schema"),
@@ -733,6 +952,7 @@ void LiteManWindow::dumpDatabase()
 
 void LiteManWindow::createTable()
 {
+	releaseResultLock();
 	CreateTableDialog dlg(this);
 	dlg.exec();
 	if (dlg.update)
@@ -752,6 +972,7 @@ void LiteManWindow::alterTable()
 	if(!item)
 		return;
 
+	releaseResultLock();
 	AlterTableDialog dlg(this, item->text(0), item->text(1));
 	dlg.exec();
 	if (dlg.update)
@@ -776,6 +997,7 @@ void LiteManWindow::renameTable()
 								.arg(item->text(1))
 								.arg(item->text(0))
 								.arg(text);
+		releaseResultLock();
 		if (Database::execSql(sql))
 			schemaBrowser->tableTree->buildTables(item->parent(), item->text(1));
 	}
@@ -786,6 +1008,7 @@ void LiteManWindow::populateTable()
 	QTreeWidgetItem * item = schemaBrowser->tableTree->currentItem();
 	if(!item)
 		return;
+	releaseResultLock();
 	PopulatorDialog dlg(this, item->text(0), item->text(1));
 	dlg.exec();
 	treeItemActivated(item, 0);
@@ -795,16 +1018,21 @@ void LiteManWindow::importTable()
 {
 	QTreeWidgetItem * item = schemaBrowser->tableTree->currentItem();
 
-	if(item)
-	{
-		ImportTableDialog dlg(this, item->text(0), item->text(1));
-		dlg.exec();
-	}
-	else
+	// the import can write from its own connection. Do not hold a read lock.
+	dataViewer->freeResources();
+	ImportTableDialog dlg(this, item ? item->text(0) : "", item ? item->text(1) : "main");
+	dlg.exec();
+	if (dlg.update)
 	{
-		ImportTableDialog dlg(this, "", "main");
-		dlg.exec();
+		// a new table was created by the import. Old items are gone after the rebuild.
+		foreach (QTreeWidgetItem* i, schemaBrowser->tableTree->searchMask(schemaBrowser->tableTree->trTables))
+		{
+			if (i->type() == TableTree::TablesItemType)
+				schemaBrowser->tableTree->buildTables(i, i->text(1));
+		}
 	}
+	else if (item)
+		treeItemActivated(item, 0);
 }
 
 void LiteManWindow::dropTable()
@@ -820,6 +1048,7 @@ void LiteManWindow::dropTable()
 
 	if(ret == QMessageBox::Yes)
 	{
+		releaseResultLock();
 		if (Database::dropTable(item->text(0), item->text(1)))
 			schemaBrowser->tableTree->buildTables(item->parent(), item->text(1));
 	}
@@ -827,6 +1056,7 @@ void LiteManWindow::dropTable()
 
 void LiteManWindow::createView()
 {
+	releaseResultLock();
 	CreateViewDialog dia("", "", this);
 
 	dia.exec();
@@ -837,6 +1067,7 @@ void LiteManWindow::createView()
 void LiteManWindow::alterView()
 {
 	QTreeWidgetItem * item = schemaBrowser->tableTree->currentItem();
+	releaseResultLock();
 	AlterViewDialog dia(item->text(0), item->text(1), this);
 	dia.exec();
 	if (dia.update)
@@ -857,6 +1088,7 @@ void LiteManWindow::dropView()
 
 	if(ret == QMessageBox::Yes)
 	{
+		releaseResultLock();
 		if (Database::dropView(item->text(0), item->text(1)))
 			schemaBrowser->tableTree->buildViews(item->parent(), item->text(1));
 	}
@@ -864,6 +1096,7 @@ void LiteManWindow::dropView()
 
 void LiteManWindow::createIndex()
 {
+	releaseResultLock();
 	QString table(schemaBrowser->tableTree->currentItem()->parent()->text(0));
 	QString schema(schemaBrowser->tableTree->currentItem()->parent()->text(1));
 	CreateIndexDialog dia(table, schema, this);
@@ -886,6 +1119,7 @@ void LiteManWindow::dropIndex()
 
 	if(ret == QMessageBox::Yes)
 	{
+		releaseResultLock();
 		if (Database::dropIndex(item->text(0), item->text(1)))
 			schemaBrowser->tableTree->buildIndexes(item->parent(), item->text(1),
 												   item->parent()->parent()->text(0));
@@ -1006,6 +1240,7 @@ void LiteManWindow::describeObject()
 
 void LiteManWindow::analyzeDialog()
 {
+	releaseResultLock();
 	AnalyzeDialog *dia = new AnalyzeDialog(this);
 	dia->exec();
 	delete dia;
@@ -1018,11 +1253,19 @@ void LiteManWindow::analyzeDialog()
 
 void LiteManWindow::vacuumDialog()
 {
+	releaseResultLock();
 	VacuumDialog *dia = new VacuumDialog(this);
 	dia->exec();
 	delete dia;
 }
 
+void LiteManWindow::poolDialog()
+{
+	DatabasePoolDialog *dia = new DatabasePoolDialog(this);
+	dia->exec();
+	delete dia;
+}
+
 void LiteManWindow::attachDatabase()
 {
 	QString fileName;
@@ -1036,13 +1279,20 @@ void LiteManWindow::attachDatabase()
 										  f.baseName(), &ok);
 	if (!ok || schema.isEmpty())
 		return;
+	// the attached file must not join the readers' shared cache
+	releaseResultLock();
+	QMutexLocker openLocker(DatabaseSession::openMutex());
 	if (!Database::execSql(QString("attach database '%1' as \"%2\";").arg(fileName).arg(schema)))
 		return;
 
+	Database::invalidateCatalog(schema);
+	DatabaseSession::setDatabases(Database::getDatabases());
 	attachedDb[schema] = Database::sessionName(schema);
 	QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", attachedDb[schema]);
 	db.setDatabaseName(fileName);
-	if(!db.open())
+	bool opened = db.open();
+	openLocker.unlock();
+	if(!opened)
 	{
 		QString msg = tr("Unable to open or create file %1. It is probably not a database").arg(QFileInfo(fileName).fileName());
 		QMessageBox::warning(this, "", msg);
@@ -1055,12 +1305,15 @@ void LiteManWindow::attachDatabase()
 void LiteManWindow::detachDatabase()
 {
 	QString dbname(schemaBrowser->tableTree->currentItem()->text(0));
+	releaseResultLock();
 	if (!Database::execSql(QString("detach database \"%1\";").arg(dbname)))
 		return;
 
 	QSqlDatabase::database(attachedDb[dbname]).rollback();
 	QSqlDatabase::database(attachedDb[dbname]).close();
 	attachedDb.remove(dbname);
+	Database::invalidateCatalog(dbname);
+	DatabaseSession::setDatabases(Database::getDatabases());
 
 	delete schemaBrowser->tableTree->currentItem();
 }
@@ -1087,6 +1340,7 @@ void LiteManWindow::loadExtension()
 
 void LiteManWindow::createTrigger()
 {
+	releaseResultLock();
 	QTreeWidgetItem * item = schemaBrowser->tableTree->currentItem();
 	QString table(item->parent()->text(0));
 	QString schema(item->parent()->text(1));
@@ -1100,6 +1354,7 @@ void LiteManWindow::createTrigger()
 
 void LiteManWindow::alterTrigger()
 {
+	releaseResultLock();
 	QString table(schemaBrowser->tableTree->currentItem()->text(0));
 	QString schema(schemaBrowser->tableTree->currentItem()->text(1));
 	AlterTriggerDialog *dia = new AlterTriggerDialog(table, schema, this);
@@ -1122,6 +1377,7 @@ void LiteManWindow::dropTrigger()
 
 	if(ret == QMessageBox::Yes)
 	{
+		releaseResultLock();
 		if (Database::dropTrigger(item->text(0), item->text(1)))
 			schemaBrowser->tableTree->buildTriggers(item->parent(), item->text(1), item->parent()->parent()->text(0));
 	}
@@ -1129,6 +1385,7 @@ void LiteManWindow::dropTrigger()
 
 void LiteManWindow::constraintTriggers()
 {
+	releaseResultLock();
 	QString table(schemaBrowser->tableTree->currentItem()->parent()->text(0));
 	QString schema(schemaBrowser->tableTree->currentItem()->parent()->text(1));
 	ConstraintsDialog dia(table, schema, this);
@@ -1142,6 +1399,7 @@ void LiteManWindow::reindex()
 	QTreeWidgetItem * item = schemaBrowser->tableTree->currentItem();
 	if(!item)
 		return;
+	releaseResultLock();
 	QString sql(QString("REINDEX \"%1\".\"%2\";").arg(item->text(1)).arg(item->text(0)));
 	Database::execSql(sql);
 }
@@ -12,6 +12,8 @@ for which a new license (GPL+exception) is in place.
 #include <QPointer>
 #include <QMap>
 
+#include "sqlprofile.h"
+
 class QTreeWidgetItem;
 class DataViewer;
 class QSplitter;
@@ -79,6 +81,16 @@ class LiteManWindow : public QMainWindow
 		*/
 		void openDatabase(const QString & fileName);
 
+		/*! \brief Run the statement in the main connection and wait for it.
+		It's used when the statement cannot run in the background
+		(non-SELECT statements etc.). See SqlResultModel::canRunAsync(). */
+		void execSqlDirect(const QString & query);
+
+		/*! \brief sqlite3_profile() callback of the main connection.
+		The hook is set only while the SQL editor statements run (see
+		startProfiling()) or while their times are pending. */
+		static void profileCallback(void * window, const char * sql, sqlite3_uint64 ns);
+
 #ifdef ENABLE_EXTENSIONS
 		//! \brief Setup loading extensions actions and environment depending on prefs.
 		void handleExtensions(bool enable);
@@ -105,6 +117,28 @@ class LiteManWindow : public QMainWindow
 
 		void buildQuery();
 		void execSql(QString query);
+		//! \brief Interrupt the statement running in the background.
+		void stopSql();
+		/*! \brief Stop the paused background result (see SqlResultModel::releaseLocks()).
+		Its read lock would make the writes of the main connection fail
+		with "database is locked". Call it before any write. */
+		void releaseResultLock();
+		//! \brief Show VM steps and elapsed time of the running statement.
+		void sqlResultProgress(qint64 steps, int elapsed);
+		//! \brief Show the result state when the statement finishes or sleeps.
+		void sqlResultStatus();
+		//! \brief Fallback to the execSqlDirect().
+		void sqlResultFailed();
+		//! \brief Add the statement statistics into the "Profile" tab.
+		void sqlProfiled(const SqlStatementProfile & profile);
+		/*! \brief Add the statistics of a statement run in the main connection.
+		Its time is waited for when it's not reported yet (not fully fetched
+		SELECTs finish later). */
+		void mainProfiled(const SqlStatementProfile & profile);
+		//! \brief Set the sqlite3_profile() hook of the main connection.
+		void startProfiling();
+		//! \brief Remove the hook unless some statement time is pending.
+		void stopProfiling();
 		void exportSchema();
 		void dumpDatabase();
 
@@ -137,6 +171,8 @@ class LiteManWindow : public QMainWindow
 
 		void analyzeDialog();
 		void vacuumDialog();
+		//! \brief Show usage of the background connections.
+		void poolDialog();
 		void attachDatabase();
 		void detachDatabase();
 		void loadExtension();
@@ -157,6 +193,13 @@ class LiteManWindow : public QMainWindow
 		QString m_appName;
 		QString m_lang;
 		QLabel * m_sqliteVersionLabel;
+		//! \brief The last statement reported by profileCallback() and its time
+		QString m_profiledSql;
+		qint64 m_profiledTime;
+		//! \brief Statements of the "Profile" tab still waiting for their time
+		QStringList m_profilePending;
+		//! \brief True while the SQL editor runs statements in the main connection
+		bool m_profiling;
 
 		// \brief True if is sqlite3 binary available in the path
 // 		bool m_sqliteBinAvailable;
@@ -219,6 +262,7 @@ class LiteManWindow : public QMainWindow
 
 		QAction * analyzeAct;
 		QAction * vacuumAct;
+		QAction * poolAct;
 		QAction * attachAct;
 		QAction * detachAct;
 #ifdef ENABLE_EXTENSIONS
@@ -23,6 +23,7 @@ for which a new license (GPL+exception) is in place.
 #include <QTextStream>
 #include <QtDebug> //qDebug
 
+#include "benchmark.h"
 #include "litemanwindow.h"
 #include "preferences.h"
 #include "utils.h"
@@ -31,6 +32,7 @@ for which a new license (GPL+exception) is in place.
 #define ARG_HELP "--help"
 #define ARG_LANG "--lang"
 #define ARG_AVAILLANG "--langs"
+#define ARG_BENCHMARK "--benchmark"
 #define ARG_VERSION_SHORT "-v"
 #define ARG_HELP_SHORT "-h"
 #define ARG_LANG_SHORT "-l"
@@ -57,6 +59,8 @@ class ArgsParser
 		QString localeCode();
 		//! \brief No file is opened when the returned value is null
 		const QString & fileToOpen();
+		//! \brief Rows of the import/export benchmark. 0 when it's not requested.
+		int benchmarkRows() { return m_benchmarkRows; };
 	private:
 		int argc;
 		char ** argv;
@@ -64,13 +68,14 @@ class ArgsParser
 		QMap<int,QString> m_localeList;
 		void langsAvailable();
 		QString m_file;
+		int m_benchmarkRows;
 };
 
 /*! \brief Pre-fil available translations into QMap to cooperate
 with PreferencesDialog.
 */
 ArgsParser::ArgsParser(int c, char ** v)
-	: argc(c), argv(v), m_locale(""), m_file(QString())
+	: argc(c), argv(v), m_locale(""), m_file(QString()), m_benchmarkRows(0)
 {
 	QDir d(TRANSLATION_DIR, "*.qm");
 	int i = 1; // 0 is for system default
@@ -149,9 +154,25 @@ bool ArgsParser::parseArgs()
 			cout << QString("  --version -v  prints version") << endl;
 			cout << QString("  --lang    -l  set a GUI language. E.g. --lang cs for Czech") << endl;
 			cout << QString("  --langs   -la lists available languages") << endl;
+			cout << QString("  --benchmark [rows] measures the import/export speed and quits") << endl;
 			cout << QString("  + various Qt options") << endl << endl;
 			return false;
 		}
+		else if (arg == ARG_BENCHMARK)
+		{
+			m_benchmarkRows = Benchmark::DefaultRows;
+			if (i + 1 < argc)
+			{
+				bool ok;
+				int rows = QString(argv[i + 1]).toInt(&ok);
+				if (ok && rows > 0)
+				{
+					m_benchmarkRows = rows;
+					++i;
+				}
+			}
+			return true;
+		}
 		else if (arg == ARG_AVAILLANG || arg == ARG_AVAILLANG_SHORT)
 		{
 			langsAvailable();
@@ -183,6 +204,8 @@ int main(int argc, char ** argv)
 	ArgsParser cli(argc, argv);
 	if (!cli.parseArgs())
 		return 0;
+	if (cli.benchmarkRows() > 0)
+		return Benchmark(cli.benchmarkRows()).run();
 
 	int style = Preferences::instance()->GUIstyle();
 	if (style != 0)
@@ -0,0 +1,345 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QMutexLocker>
+#include <QBuffer>
+#include <QSqlQuery>
+
+#include "parallelexport.h"
+#include "dataexporter.h"
+#include "dataexportworker.h"
+#include "databasesession.h"
+#include "sqlrowblock.h"
+
+
+ParallelExportThread::ParallelExportThread(ParallelExport * owner, Stage stage)
+	: QThread(),
+	  m_owner(owner),
+	  m_stage(stage)
+{
+}
+
+void ParallelExportThread::run()
+{
+	if (m_stage == Scanner)
+		m_owner->runScanner();
+	else
+		m_owner->runWriter();
+}
+
+
+ParallelExport::ParallelExport(const QString & schema, const QString & table,
+							   DataExporter * exporter, QIODevice * device)
+	: m_schema(schema),
+	  m_table(table),
+	  m_exporter(exporter),
+	  m_device(device),
+	  m_first(0),
+	  m_last(0),
+	  m_width(RangeRows),
+	  m_ranges(0),
+	  m_scanners(0),
+	  m_cancelled(0),
+	  m_snapshot(0),
+	  m_nextRange(0),
+	  m_nextWrite(0),
+	  m_scannersRunning(0),
+	  m_scannersReading(0),
+	  m_rows(0)
+{
+}
+
+ParallelExport::~ParallelExport()
+{
+	cancel();
+	foreach (ParallelExportThread * t, m_threads)
+	{
+		t->wait();
+		delete t;
+	}
+	endSnapshot();
+}
+
+int ParallelExport::scannerCount()
+{
+	// one core is left for the writer and the GUI
+	return qMax(2, QThread::idealThreadCount() - 1);
+}
+
+bool ParallelExport::prepare()
+{
+	if (!m_exporter->canSplit())
+		return false;
+
+	endSnapshot();
+	m_snapshot = new DatabaseSession(DatabaseSession::ReadOnly);
+	DatabaseSession & session = *m_snapshot;
+	FieldList fields(session.tableFields(m_table, m_schema));
+	if (session.failed() || fields.isEmpty())
+	{
+		endSnapshot();
+		return false;
+	}
+
+	m_columns.clear();
+	foreach (DatabaseTableField f, fields)
+		m_columns.append(f.name);
+	// a column can hide the rowid under its name
+	m_rowid = QString();
+	foreach (QString alias, QStringList() << "rowid" << "_rowid_" << "oid")
+	{
+		if (!m_columns.contains(alias, Qt::CaseInsensitive))
+		{
+			m_rowid = alias;
+			break;
+		}
+	}
+	if (m_rowid.isEmpty() || !session.exec("BEGIN;"))
+	{
+		endSnapshot();
+		return false;
+	}
+
+	// both are lookups of the b-tree ends - not a scan. The read lock
+	// is held from here until the scanners have theirs.
+	{
+		QSqlQuery query(session.select(QString("SELECT min(%1), max(%1) FROM \"%2\".\"%3\";")
+									   .arg(m_rowid).arg(m_schema).arg(m_table)));
+		if (session.failed() || !query.next() || query.value(0).isNull())
+		{
+			endSnapshot();
+			return false;
+		}
+		m_first = query.value(0).toLongLong();
+		m_last = query.value(1).toLongLong();
+	}
+
+	// 0 when the span is the whole 64-bit range
+	quint64 span = quint64(m_last) - quint64(m_first) + 1;
+	if (span != 0 && span < quint64(MinRows))
+	{
+		endSnapshot();
+		return false;
+	}
+	quint64 width = (span == 0 ? ~quint64(0) : span - 1) / MaxRanges + 1;
+	m_width = qMax(quint64(RangeRows), width);
+	m_ranges = (span == 0) ? MaxRanges : int((span - 1) / m_width + 1);
+	return true;
+}
+
+void ParallelExport::start()
+{
+	m_scanners = qMin(scannerCount(), m_ranges);
+	m_scannersRunning = m_scanners;
+	for (int i = 0; i < m_scanners; ++i)
+		m_threads.append(new ParallelExportThread(this, ParallelExportThread::Scanner));
+	m_threads.append(new ParallelExportThread(this, ParallelExportThread::Writer));
+	foreach (ParallelExportThread * t, m_threads)
+		t->start();
+}
+
+void ParallelExport::endSnapshot()
+{
+	if (!m_snapshot)
+		return;
+	m_snapshot->exec("COMMIT;");
+	delete m_snapshot;
+	m_snapshot = 0;
+}
+
+bool ParallelExport::wait(int ms)
+{
+	// the snapshot connection belongs to this thread. The scanners
+	// open their connections and take the read lock quickly.
+	if (m_snapshot)
+	{
+		bool ready;
+		{
+			QMutexLocker locker(&m_mutex);
+			if (!m_cancelled && m_scannersReading < m_scanners)
+				m_changed.wait(&m_mutex, ms);
+			ready = m_cancelled || m_scannersReading >= m_scanners;
+		}
+		if (!ready)
+			return false;
+		endSnapshot();
+	}
+
+	foreach (ParallelExportThread * t, m_threads)
+	{
+		if (!t->wait(ms))
+			return false;
+	}
+	return true;
+}
+
+void ParallelExport::cancel()
+{
+	QMutexLocker locker(&m_mutex);
+	m_cancelled = 1;
+	m_changed.wakeAll();
+}
+
+qint64 ParallelExport::rows()
+{
+	QMutexLocker locker(&m_mutex);
+	return m_rows;
+}
+
+int ParallelExport::progress()
+{
+	QMutexLocker locker(&m_mutex);
+	return m_ranges > 0 ? int(qint64(m_nextWrite) * 1000 / m_ranges) : 0;
+}
+
+QString ParallelExport::errorString()
+{
+	QMutexLocker locker(&m_mutex);
+	return m_error;
+}
+
+void ParallelExport::fail(const QString & error)
+{
+	QMutexLocker locker(&m_mutex);
+	if (m_error.isEmpty())
+		m_error = error;
+	m_cancelled = 1;
+	m_changed.wakeAll();
+}
+
+int ParallelExport::progressHandler(void * owner)
+{
+	return static_cast<ParallelExport*>(owner)->m_cancelled ? 1 : 0;
+}
+
+void ParallelExport::runScanner()
+{
+	// not a DatabaseLease - the scanners are not limited by the pool readers
+	DatabaseSession session(DatabaseSession::PrivateReadOnly);
+	sqlite3 * db = session.handle();
+	sqlite3_stmt * stmt = 0;
+	QString sql(QString("SELECT * FROM \"%1\".\"%2\" WHERE %3 BETWEEN ?1 AND ?2 ORDER BY %3;")
+				.arg(m_schema).arg(m_table).arg(m_rowid));
+
+	if (!db)
+		fail(session.lastError().message);
+	else if (sqlite3_prepare16_v2(db, sql.constData(), (sql.size() + 1) * sizeof(QChar),
+								  &stmt, 0) != SQLITE_OK)
+		fail(QString(reinterpret_cast<const QChar *>(sqlite3_errmsg16(db))));
+	else
+	{
+		// one read transaction for all the ranges - no lock per range.
+		// The read lock is taken by the first read of the schema file.
+		QString lock(QString("BEGIN; SELECT 1 FROM \"%1\".sqlite_master LIMIT 1;").arg(m_schema));
+		if (sqlite3_exec(db, lock.toUtf8().constData(), 0, 0, 0) != SQLITE_OK)
+			fail(QString(reinterpret_cast<const QChar *>(sqlite3_errmsg16(db))));
+		else
+		{
+			QMutexLocker locker(&m_mutex);
+			++m_scannersReading;
+			m_changed.wakeAll();
+		}
+		sqlite3_progress_handler(db, ProgressSteps, progressHandler, this);
+		DataExporter * exporter = m_exporter->clone();
+		SqlRowBlock block(m_columns.count());
+
+		while (true)
+		{
+			int range;
+			{
+				QMutexLocker locker(&m_mutex);
+				while (!m_cancelled && m_nextRange < m_ranges
+					   && m_nextRange - m_nextWrite >= MaxPending * m_scanners)
+					m_changed.wait(&m_mutex);
+				if (m_cancelled || m_nextRange >= m_ranges)
+					break;
+				range = m_nextRange++;
+			}
+
+			qint64 lower = qint64(quint64(m_first) + quint64(range) * m_width);
+			qint64 upper = (range == m_ranges - 1) ? m_last : qint64(quint64(lower) + m_width - 1);
+			sqlite3_bind_int64(stmt, 1, lower);
+			sqlite3_bind_int64(stmt, 2, upper);
+
+			QBuffer buffer;
+			buffer.open(QIODevice::WriteOnly);
+			exporter->beginRows(&buffer, m_columns);
+			int rc;
+			do
+			{
+				rc = sqlite3_step(stmt);
+				if (rc == SQLITE_ROW)
+					block.appendRow(stmt);
+				if (block.rowCount() < DataExportWorker::BlockRows && rc == SQLITE_ROW)
+					continue;
+				for (int r = 0; r < block.rowCount(); ++r)
+					exporter->writeRow(block, r);
+				block.clear();
+			}
+			while (rc == SQLITE_ROW);
+			if (rc != SQLITE_DONE)
+			{
+				sqlite3_reset(stmt);
+				if (!m_cancelled)
+					fail(QString(reinterpret_cast<const QChar *>(sqlite3_errmsg16(db))));
+				break;
+			}
+			sqlite3_reset(stmt);
+			exporter->endRows();
+
+			Chunk chunk;
+			chunk.data = buffer.data();
+			chunk.rows = exporter->rows();
+			QMutexLocker locker(&m_mutex);
+			m_chunks.insert(range, chunk);
+			m_changed.wakeAll();
+		}
+
+		delete exporter;
+		sqlite3_progress_handler(db, 0, 0, 0);
+		sqlite3_finalize(stmt);
+		sqlite3_exec(db, "COMMIT;", 0, 0, 0);
+	}
+
+	QMutexLocker locker(&m_mutex);
+	--m_scannersRunning;
+	m_changed.wakeAll();
+}
+
+void ParallelExport::runWriter()
+{
+	m_exporter->begin(m_device, m_columns);
+
+	int next = 0;
+	while (next < m_ranges)
+	{
+		Chunk chunk;
+		{
+			QMutexLocker locker(&m_mutex);
+			// chunks are written in the rowid order
+			while (!m_chunks.contains(next) && !m_cancelled && m_scannersRunning > 0)
+				m_changed.wait(&m_mutex);
+			if (m_cancelled || !m_chunks.contains(next))
+				break;
+			chunk = m_chunks.take(next);
+		}
+
+		if (!m_exporter->writeChunk(chunk.data, chunk.rows))
+		{
+			fail(m_exporter->errorString());
+			break;
+		}
+
+		QMutexLocker locker(&m_mutex);
+		m_nextWrite = ++next;
+		m_rows += chunk.rows;
+		m_changed.wakeAll();
+	}
+
+	if (next == m_ranges && !m_exporter->end())
+		fail(m_exporter->errorString());
+}
@@ -0,0 +1,174 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef PARALLELEXPORT_H
+#define PARALLELEXPORT_H
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QStringList>
+#include <QMap>
+
+class QIODevice;
+class ParallelExport;
+class DataExporter;
+class DatabaseSession;
+
+
+/*! \brief A thread running one stage of the ParallelExport.
+*/
+class ParallelExportThread : public QThread
+{
+	public:
+		enum Stage
+		{
+			Scanner,
+			Writer
+		};
+
+		ParallelExportThread(ParallelExport * owner, Stage stage);
+
+	protected:
+		void run();
+
+	private:
+		ParallelExport * m_owner;
+		Stage m_stage;
+};
+
+
+/*! \brief Export a whole table by rowid ranges in more threads.
+The rowid span of the table is split into ranges (chunks). Scanner
+threads take the ranges one by one, read them on their own read-only
+connection and format them with their own copy
+of the DataExporter into memory. The writer thread appends the
+formatted chunks to the output in the rowid order - the file is the
+same as the one from DataExportWorker.
+
+All scanners read one snapshot of the table. prepare() starts a read
+transaction which is held until every scanner has started its own one
+(it's finished by wait() in the GUI thread) - no change can be committed in between. A writer waiting for the lock
+can make the scanners fail with "database is locked" then. Scanners use
+connections without the shared cache so they really read in parallel.
+
+There is scannerCount() scanners. They don't take the DatabasePool
+reader slots - the pool would serialize them. Count of the formatted chunks
+not written yet is limited by MaxPending so the memory is bounded
+when the output is the bottleneck.
+
+Use prepare() first. It refuses small tables, tables with all the
+rowid aliases used as column names and the formats which cannot
+be split into chunks (see DataExporter::canSplit()).
+*/
+class ParallelExport
+{
+		Q_DECLARE_TR_FUNCTIONS(ParallelExport)
+
+	public:
+		//! \brief Rowids in one range at least
+		static const int RangeRows = 20000;
+		//! \brief Max count of the ranges. Sparse rowids get wider ranges.
+		static const int MaxRanges = 65536;
+		//! \brief Smaller rowid spans are left to DataExportWorker
+		static const int MinRows = 200000;
+		//! \brief Max formatted chunks waiting for the writer per scanner
+		static const int MaxPending = 4;
+		//! \brief VM steps between the cancel checks of a running step
+		static const int ProgressSteps = 1000;
+
+		/*! \param exporter a format writer of the output. Its begin()
+		       and end() are called by the writer thread.
+		\param device an opened output. */
+		ParallelExport(const QString & schema, const QString & table,
+					   DataExporter * exporter, QIODevice * device);
+		//! \brief Cancels the export when it's still running.
+		~ParallelExport();
+
+		/*! \brief Split the table into the ranges. Call it in the GUI thread.
+		The snapshot read transaction is started here.
+		\retval bool false when the table should be exported by one thread. */
+		bool prepare();
+		//! \brief Count of the scanner threads. One per core but the writer's one.
+		static int scannerCount();
+
+		//! \brief Start the threads. It does not wait for them.
+		void start();
+		/*! \brief Wait for all threads. Call it in the GUI thread.
+		The snapshot of prepare() is finished here as soon as all
+		scanners hold their read transaction.
+		\retval bool true when the export is finished. */
+		bool wait(int ms);
+		//! \brief Stop all threads. Chunks written already stay in the output.
+		void cancel();
+
+		//! \brief Count of the rows written so far.
+		qint64 rows();
+		//! \brief Written part of the ranges (per mille).
+		int progress();
+		//! \brief Error which stopped the export. Empty when it succeeded or it was cancelled.
+		QString errorString();
+
+	private:
+		friend class ParallelExportThread;
+
+		//! \brief Formatted rows of one range.
+		typedef struct
+		{
+			QByteArray data;
+			qint64 rows;
+		}
+		Chunk;
+
+		QString m_schema;
+		QString m_table;
+		DataExporter * m_exporter;
+		QIODevice * m_device;
+		QStringList m_columns;
+		//! \brief Unused alias of the rowid (rowid, _rowid_ or oid)
+		QString m_rowid;
+		qint64 m_first;
+		qint64 m_last;
+		//! \brief Rowids in one range. The span can be bigger than qint64.
+		quint64 m_width;
+		int m_ranges;
+		int m_scanners;
+		QList<ParallelExportThread*> m_threads;
+		QAtomicInt m_cancelled;
+		//! \brief The read transaction of prepare(). 0 when it's finished.
+		DatabaseSession * m_snapshot;
+
+		//! \brief Guards everything below.
+		QMutex m_mutex;
+		//! \brief Woken on any change of the chunks or states.
+		QWaitCondition m_changed;
+		//! \brief The next range for a scanner
+		int m_nextRange;
+		//! \brief The next range for the writer
+		int m_nextWrite;
+		//! \brief Formatted chunks by their range number
+		QMap<int,Chunk> m_chunks;
+		int m_scannersRunning;
+		//! \brief Scanners holding their read transaction already
+		int m_scannersReading;
+		qint64 m_rows;
+		QString m_error;
+
+		void runScanner();
+		void runWriter();
+		//! \brief Finish the read transaction of prepare().
+		void endSnapshot();
+
+		//! \brief Stop the export with the error.
+		void fail(const QString & error);
+		//! \brief Interrupt the running statements on cancel()
+		static int progressHandler(void * owner);
+};
+
+#endif
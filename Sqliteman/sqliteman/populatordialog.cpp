@@ -13,6 +13,8 @@ for which a new license (GPL+exception) is in place.
 
 #include "populatordialog.h"
 #include "populatorcolumnwidget.h"
+#include "databasesession.h"
+#include "bulkload.h"
 
 
 PopulatorDialog::PopulatorDialog(QWidget * parent, const QString & table, const QString & schema)
@@ -136,14 +138,13 @@ void PopulatorDialog::populateButton_clicked()
 	for (int i = 0; i < columnTable->rowCount(); ++i)
 		m_columnList.append(qobject_cast<PopulatorColumnWidget*>(columnTable->cellWidget(i, 2))->column());
 
-	QSqlQuery query(QSqlDatabase::database(SESSION_NAME));
-	QString sql = "INSERT %1 INTO \"%2\".\"%3\" (\"%4\") VALUES (:%5);";
-	query.prepare(sql.arg(constraintBox->isChecked() ? "OR IGNORE" : "")
-			.arg(m_schema).arg(m_table)
-			.arg(sqlColumns()).arg(sqlBinds()));
-
 	cntPre = tableRowCount();
 
+	DatabaseSession session;
+	BulkLoad bulk(session.handle(), m_schema, m_table);
+	if (bulkLoadBox->isChecked() && !bulk.setPragmas())
+		textBrowser->append(tr("Bulk load pragmas cannot be set: %1").arg(bulk.errorString()));
+
 	if (!Database::execSql("BEGIN TRANSACTION;"))
 	{
 		textBrowser->append(tr("Begin transaction failed."));
@@ -151,6 +152,24 @@ void PopulatorDialog::populateButton_clicked()
 		return;
 	}
 
+	if (bulkLoadBox->isChecked())
+	{
+		if (!bulk.dropDependent())
+		{
+			textBrowser->append(tr("Indexes cannot be dropped: %1").arg(bulk.errorString()));
+			Database::execSql("ROLLBACK;");
+			return;
+		}
+		textBrowser->append(tr("Indexes and triggers dropped: %1").arg(bulk.dependentSql().count()));
+	}
+
+	// prepared after the DROPs. The schema is changed by them.
+	QSqlQuery query(QSqlDatabase::database(SESSION_NAME));
+	QString sql = "INSERT %1 INTO \"%2\".\"%3\" (\"%4\") VALUES (:%5);";
+	query.prepare(sql.arg(constraintBox->isChecked() ? "OR IGNORE" : "")
+			.arg(m_schema).arg(m_table)
+			.arg(sqlColumns()).arg(sqlBinds()));
+
 	foreach (Populator::PopColumn i, m_columnList)
 	{
 		switch (i.action)
@@ -190,9 +209,17 @@ void PopulatorDialog::populateButton_clicked()
 		textBrowser->append(query.lastError().text());
 	else
 		textBrowser->append(tr("Data inserted."));
+	query.finish();
 
-	if (!Database::execSql("COMMIT;"))
+	if (bulkLoadBox->isChecked() && !bulk.rebuild())
+	{
+		textBrowser->append(tr("Indexes cannot be created again: %1").arg(bulk.errorString()));
+		textBrowser->append(tr("All changes are rolled back."));
+		Database::execSql("ROLLBACK;");
+	}
+	else if (!Database::execSql("COMMIT;"))
 		textBrowser->append(tr("Transaction commit failed."));
+	bulk.restorePragmas();
 
 	cntPost = tableRowCount();
 	textBrowser->append(tr("It's done. Check messages above."));
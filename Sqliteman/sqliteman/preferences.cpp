@@ -37,6 +37,7 @@ Preferences::Preferences(QObject *parent)
 	m_GUIstyle = s.value("prefs/styleComboBox", 0).toInt();
 	m_GUIfont = s.value("prefs/applicationFont", f).value<QFont>();
 	m_cropColumns = s.value("prefs/cropColumnsCheckBox", false).toBool();
+	m_resultCacheSize = s.value("prefs/resultCacheSpinBox", 64).toInt();
 
 	m_sqlFont = s.value("prefs/sqleditor/font", f).value<QFont>();
 	m_sqlFontSize = s.value("prefs/sqleditor/fontSize", f.pointSize()).toInt();
@@ -63,11 +64,26 @@ Preferences::Preferences(QObject *parent)
 	// data
 	m_dateTimeFormat = s.value("data/dateTimeFormat", "MM/dd/yyyy").toString();
 	// data export
-	m_exportFormat = s.value("dataExport/format", 0).toInt();
+	m_exportFormat = s.value("dataExport/formatKey").toString();
+	if (m_exportFormat.isEmpty())
+	{
+		// older versions stored the index of the sorted format names
+		static const char * oldFormats[] = { "csv", "html", "xls", "py",
+											 "qore_select", "qore_selectRows", "sql" };
+		int ix = s.value("dataExport/format", 0).toInt();
+		m_exportFormat = (ix >= 0 && ix < 7) ? oldFormats[ix] : "csv";
+	}
 	m_exportDestination = s.value("dataExport/destination", 0).toInt();
 	m_exportHeaders = s.value("dataExport/headers", true).toBool();
 	m_exportEncoding = s.value("dataExport/encoding", "UTF-8").toString();
 	m_exportEol = s.value("dataExport/eol", 0).toInt();
+	m_exportGzip = s.value("dataExport/gzip", false).toBool();
+	m_exportBatchRows = s.value("dataExport/batchRows", 65536).toInt();
+	m_exportSqlInserts = s.value("dataExport/sqlInserts", 0).toInt();
+	m_exportSqlSchema = s.value("dataExport/sqlSchema", false).toBool();
+	// data import
+	m_importBatchSize = s.value("dataImport/batchSize", 0).toInt();
+	m_importBulkLoad = s.value("dataImport/bulkLoad", false).toBool();
     // extensions
     m_allowExtensionLoading = s.value("extensions/allowLoading", true).toBool();
     m_extensionList = s.value("extensions/list", QStringList()).toStringList();
@@ -92,6 +108,7 @@ Preferences::~Preferences()
 	settings.setValue("prefs/blobAliasEdit", m_blobHighlightText);
 	settings.setValue("prefs/blobBgButton", m_blobHighlightColor);
 	settings.setValue("prefs/cropColumnsCheckBox", m_cropColumns);
+	settings.setValue("prefs/resultCacheSpinBox", m_resultCacheSize);
 	// sql editor
 	settings.setValue("prefs/sqleditor/font", m_sqlFont);
     settings.setValue("prefs/sqleditor/fontSize", m_sqlFontSize);
@@ -112,11 +129,18 @@ Preferences::~Preferences()
 	//
 	settings.setValue("data/dateTimeFormat", m_dateTimeFormat);
 	// data export
-	settings.setValue("dataExport/format", m_exportFormat);
+	settings.setValue("dataExport/formatKey", m_exportFormat);
 	settings.setValue("dataExport/destination", m_exportDestination);
 	settings.setValue("dataExport/headers", m_exportHeaders);
 	settings.setValue("dataExport/encoding", m_exportEncoding);
 	settings.setValue("dataExport/eol", m_exportEol);
+	settings.setValue("dataExport/gzip", m_exportGzip);
+	settings.setValue("dataExport/batchRows", m_exportBatchRows);
+	settings.setValue("dataExport/sqlInserts", m_exportSqlInserts);
+	settings.setValue("dataExport/sqlSchema", m_exportSqlSchema);
+	// data import
+	settings.setValue("dataImport/batchSize", m_importBatchSize);
+	settings.setValue("dataImport/bulkLoad", m_importBulkLoad);
     // extensions
     settings.setValue("extensions/allowLoading", m_allowExtensionLoading);
     settings.setValue("extensions/list", m_extensionList);
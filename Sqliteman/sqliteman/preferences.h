@@ -70,6 +70,10 @@ class Preferences : public QObject
 		bool cropColumns() { return m_cropColumns; };
 		void setCropColumns(bool v) { m_cropColumns = v; };
 
+		//! \brief Memory budget (MB) for rows cached by the SqlResultModel
+		int resultCacheSize() { return m_resultCacheSize; };
+		void setResultCacheSize(int v) { m_resultCacheSize = v; };
+
 		QFont sqlFont() { return m_sqlFont; };
 		void setSqlFont(QFont v) { m_sqlFont = v; };
 
@@ -104,8 +108,9 @@ class Preferences : public QObject
 		void setDateTimeFormat(const QString & v) { m_dateTimeFormat = v; };
 
 		// data export
-		int exportFormat() { return m_exportFormat; };
-		void setExportFormat(int v) { m_exportFormat = v; };
+		//! \brief DataExporter format key ("csv", "arrow" etc.)
+		QString exportFormat() { return m_exportFormat; };
+		void setExportFormat(const QString & v) { m_exportFormat = v; };
 
 		int exportDestination() { return m_exportDestination; };
 		void setExportDestination(int v) { m_exportDestination = v; };
@@ -119,6 +124,26 @@ class Preferences : public QObject
 		int exportEol() { return m_exportEol; };
 		void setExportEol(int v) { m_exportEol = v; };
 
+		bool exportGzip() { return m_exportGzip; };
+		void setExportGzip(bool v) { m_exportGzip = v; };
+
+		int exportBatchRows() { return m_exportBatchRows; };
+		void setExportBatchRows(int v) { m_exportBatchRows = v; };
+
+		//! \brief DataExporter::SqlInserts of the SQL export
+		int exportSqlInserts() { return m_exportSqlInserts; };
+		void setExportSqlInserts(int v) { m_exportSqlInserts = v; };
+
+		bool exportSqlSchema() { return m_exportSqlSchema; };
+		void setExportSqlSchema(bool v) { m_exportSqlSchema = v; };
+
+		// data import
+		int importBatchSize() { return m_importBatchSize; };
+		void setImportBatchSize(int v) { m_importBatchSize = v; };
+
+		bool importBulkLoad() { return m_importBulkLoad; };
+		void setImportBulkLoad(bool v) { m_importBulkLoad = v; };
+
 		// qscintilla syntax
 		QColor syDefaultColor() { return m_syDefaultColor; };
 		void setSyDefaultColor(const QColor & v ) { m_syDefaultColor = v; };
@@ -167,6 +192,7 @@ class Preferences : public QObject
 		int m_GUIstyle;
 		QFont m_GUIfont;
 		bool m_cropColumns;
+		int m_resultCacheSize;
 		QFont m_sqlFont;
 		int m_sqlFontSize;
 		bool m_activeHighlighting;
@@ -184,11 +210,18 @@ class Preferences : public QObject
 		QColor m_syStringColor;
 		QColor m_syCommentColor;
 		// data export
-		int m_exportFormat;
+		QString m_exportFormat;
 		int m_exportDestination;
 		bool m_exportHeaders;
 		QString m_exportEncoding;
 		int m_exportEol;
+		bool m_exportGzip;
+		int m_exportBatchRows;
+		int m_exportSqlInserts;
+		bool m_exportSqlSchema;
+		// data import
+		int m_importBatchSize;
+		bool m_importBulkLoad;
         // extensions
         bool m_allowExtensionLoading;
         QStringList m_extensionList;
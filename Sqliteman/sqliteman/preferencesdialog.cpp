@@ -214,6 +214,7 @@ PreferencesDialog::PreferencesDialog(QWidget * parent)
 	m_prefsData->blobBgButton->setPalette(prefs->blobHighlightColor());
 
 	m_prefsData->cropColumnsCheckBox->setChecked(prefs->cropColumns());
+	m_prefsData->resultCacheSpinBox->setValue(prefs->resultCacheSize());
 
 	m_prefsSQL->fontComboBox->setCurrentFont(prefs->sqlFont());
 	m_prefsSQL->fontSizeSpin->setValue(prefs->sqlFontSize());
@@ -255,6 +256,7 @@ bool PreferencesDialog::saveSettings()
 	prefs->setBlobHighlightText(m_prefsData->blobAliasEdit->text());
 	prefs->setBlobHighlightColor(m_prefsData->blobBgButton->palette().color(QPalette::Background));
 	prefs->setCropColumns(m_prefsData->cropColumnsCheckBox->isChecked());
+	prefs->setResultCacheSize(m_prefsData->resultCacheSpinBox->value());
 	// sql editor
 	prefs->setSqlFont(m_prefsSQL->fontComboBox->currentFont());
 	prefs->setSqlFontSize(m_prefsSQL->fontSizeSpin->value());
@@ -295,6 +297,7 @@ void PreferencesDialog::restoreDefaults()
 	m_prefsData->blobBgButton->setPalette(Preferences::stdLightColor());
 
 	m_prefsData->cropColumnsCheckBox->setChecked(false);
+	m_prefsData->resultCacheSpinBox->setValue(64);
 
 	QFont fTmp;
 	m_prefsSQL->fontComboBox->setCurrentFont(fTmp);
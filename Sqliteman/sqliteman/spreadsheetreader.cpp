@@ -0,0 +1,456 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include "spreadsheetreader.h"
+
+#define SPREADSHEETML_NS "urn:schemas-microsoft-com:office:spreadsheet"
+#define RELATIONSHIPS_NS "http://schemas.openxmlformats.org/officeDocument/2006/relationships"
+
+
+//! \brief Elements handled by the readers.
+enum SheetTag
+{
+	OtherTag,
+	WorksheetTag,	// Worksheet
+	RowTag,			// Row, row
+	CellTag,		// Cell, c
+	DataTag,		// Data
+	ValueTag,		// v
+	TextTag,		// t
+	ItemTag,		// si
+	PhoneticTag,	// rPh
+	SheetTag,		// sheet
+	RelationshipTag	// Relationship
+};
+
+/*! \brief Map an element name to its tag.
+Names are told apart by the length and the first character so most
+of the elements are skipped without any string comparison.
+*/
+static SheetTag sheetTag(const QStringRef & name)
+{
+	switch (name.size())
+	{
+		case 1:
+			switch (name.at(0).unicode())
+			{
+				case 'c':
+					return CellTag;
+				case 'v':
+					return ValueTag;
+				case 't':
+					return TextTag;
+			}
+			break;
+		case 2:
+			if (name.at(0) == 's' && name.at(1) == 'i')
+				return ItemTag;
+			break;
+		case 3:
+			if (name.at(0) == 'r' || name.at(0) == 'R')
+			{
+				if (name == QLatin1String("row") || name == QLatin1String("Row"))
+					return RowTag;
+				if (name == QLatin1String("rPh"))
+					return PhoneticTag;
+			}
+			break;
+		case 4:
+			if (name == QLatin1String("Cell"))
+				return CellTag;
+			if (name == QLatin1String("Data"))
+				return DataTag;
+			break;
+		case 5:
+			if (name == QLatin1String("sheet"))
+				return SheetTag;
+			break;
+		case 9:
+			if (name == QLatin1String("Worksheet"))
+				return WorksheetTag;
+			break;
+		case 12:
+			if (name == QLatin1String("Relationship"))
+				return RelationshipTag;
+			break;
+	}
+	return OtherTag;
+}
+
+//! \brief Put the value into its column. Skipped columns are empty.
+static void setCell(QStringList & row, int column, const QString & value)
+{
+	while (row.count() < column)
+		row.append(QString());
+	row.append(value);
+}
+
+
+ImportTable::SpreadsheetMLReader::SpreadsheetMLReader(const QString & fileName)
+	: m_file(fileName),
+	  m_gzip(0),
+	  m_done(false)
+{
+}
+
+ImportTable::SpreadsheetMLReader::~SpreadsheetMLReader()
+{
+	delete m_gzip;
+}
+
+bool ImportTable::SpreadsheetMLReader::open()
+{
+	QIODevice * device = &m_file;
+	if (GzipDevice::isGzip(m_file.fileName()))
+	{
+		m_gzip = new GzipDevice(m_file.fileName());
+		device = m_gzip;
+	}
+	// the XML parser handles the encoding and new lines
+	if (!device->open(QIODevice::ReadOnly))
+	{
+		m_error = tr("Cannot open file %1 for reading.").arg(m_file.fileName());
+		return false;
+	}
+	m_xml.setDevice(device);
+	return true;
+}
+
+bool ImportTable::SpreadsheetMLReader::readRow(QStringList & row)
+{
+	QString value;
+	bool inRow = false;
+	bool hasValue = false;
+	bool collect = false;
+	int column = 0;
+	int merge = 0;
+
+	row.clear();
+	while (!m_done && !m_xml.atEnd())
+	{
+		switch (m_xml.readNext())
+		{
+			case QXmlStreamReader::StartElement:
+				switch (sheetTag(m_xml.name()))
+				{
+					case RowTag:
+						inRow = true;
+						row.clear();
+						column = 0;
+						break;
+					case CellTag:
+					{
+						QXmlStreamAttributes a(m_xml.attributes());
+						QStringRef index(a.value(QLatin1String(SPREADSHEETML_NS), QLatin1String("Index")));
+						// 1-based
+						if (!index.isEmpty())
+							column = qMax(column, index.toString().toInt() - 1);
+						merge = a.value(QLatin1String(SPREADSHEETML_NS), QLatin1String("MergeAcross")).toString().toInt();
+						value.clear();
+						hasValue = false;
+						break;
+					}
+					case DataTag:
+						// it can contain formatted text (html:B etc.)
+						collect = inRow;
+						hasValue = inRow;
+						break;
+					default:
+						break;
+				}
+				break;
+			case QXmlStreamReader::Characters:
+				if (collect)
+					value.append(m_xml.text());
+				break;
+			case QXmlStreamReader::EndElement:
+				switch (sheetTag(m_xml.name()))
+				{
+					case DataTag:
+						collect = false;
+						break;
+					case CellTag:
+						if (hasValue)
+							setCell(row, column, value);
+						column += 1 + merge;
+						break;
+					case RowTag:
+						return true;
+					case WorksheetTag:
+						// the first worksheet only
+						m_done = true;
+						return false;
+					default:
+						break;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	// a broken .gz file ends the XML prematurely
+	if (m_gzip && m_gzip->failed())
+		m_error = tr("Error reading file %1: %2").arg(m_file.fileName()).arg(m_gzip->errorString());
+	else if (m_xml.hasError() && m_xml.error() != QXmlStreamReader::PrematureEndOfDocumentError)
+		m_error = tr("XML error at line %1: %2").arg(m_xml.lineNumber()).arg(m_xml.errorString());
+	return false;
+}
+
+
+ImportTable::XLSXReader::XLSXReader(const QString & fileName)
+	: m_zip(fileName),
+	  m_sheet(0),
+	  m_size(0)
+{
+}
+
+ImportTable::XLSXReader::~XLSXReader()
+{
+	delete m_sheet;
+}
+
+void ImportTable::XLSXReader::locateParts(QString & sheet, QString & strings)
+{
+	sheet = "xl/worksheets/sheet1.xml";
+	strings = "xl/sharedStrings.xml";
+
+	// the first <sheet> of the workbook is the first tab
+	QString id;
+	ZipEntryDevice workbook(m_zip, "xl/workbook.xml");
+	if (!workbook.open(QIODevice::ReadOnly))
+		return;
+	QXmlStreamReader xml(&workbook);
+	while (!xml.atEnd() && id.isEmpty())
+	{
+		if (xml.readNext() == QXmlStreamReader::StartElement && sheetTag(xml.name()) == SheetTag)
+			id = xml.attributes().value(QLatin1String(RELATIONSHIPS_NS), QLatin1String("id")).toString();
+	}
+
+	ZipEntryDevice rels(m_zip, "xl/_rels/workbook.xml.rels");
+	if (!rels.open(QIODevice::ReadOnly))
+		return;
+	xml.setDevice(&rels);
+	while (!xml.atEnd())
+	{
+		if (xml.readNext() != QXmlStreamReader::StartElement || sheetTag(xml.name()) != RelationshipTag)
+			continue;
+		QXmlStreamAttributes a(xml.attributes());
+		// targets are relative to xl/ or absolute in the package
+		QString target(a.value(QLatin1String("Target")).toString());
+		target = target.startsWith('/') ? target.mid(1) : "xl/" + target;
+		if (!id.isEmpty() && a.value(QLatin1String("Id")) == id)
+			sheet = target;
+		else if (a.value(QLatin1String("Type")).toString().endsWith("/sharedStrings"))
+			strings = target;
+	}
+}
+
+bool ImportTable::XLSXReader::readSharedStrings(const QString & path)
+{
+	ZipEntryDevice device(m_zip, path);
+	if (!device.open(QIODevice::ReadOnly))
+	{
+		m_error = device.errorString();
+		return false;
+	}
+
+	QXmlStreamReader xml(&device);
+	bool collect = false;
+	int phonetic = 0;
+	m_strings.clear();
+	m_stringStart.clear();
+	while (!xml.atEnd())
+	{
+		switch (xml.readNext())
+		{
+			case QXmlStreamReader::StartElement:
+				switch (sheetTag(xml.name()))
+				{
+					case ItemTag:
+						m_stringStart.append(m_strings.size());
+						break;
+					case TextTag:
+						// rich text is split in more <t>s. Phonetic hints are not the text.
+						collect = (phonetic == 0);
+						break;
+					case PhoneticTag:
+						++phonetic;
+						break;
+					default:
+						break;
+				}
+				break;
+			case QXmlStreamReader::Characters:
+				if (collect)
+					m_strings.append(xml.text());
+				break;
+			case QXmlStreamReader::EndElement:
+				switch (sheetTag(xml.name()))
+				{
+					case TextTag:
+						collect = false;
+						break;
+					case PhoneticTag:
+						--phonetic;
+						break;
+					default:
+						break;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	m_stringStart.append(m_strings.size());
+	m_strings.squeeze();
+
+	if (xml.hasError())
+	{
+		m_error = tr("Cannot read the shared strings: %1").arg(xml.errorString());
+		return false;
+	}
+	return true;
+}
+
+QString ImportTable::XLSXReader::sharedString(int index) const
+{
+	if (index < 0 || index >= m_stringStart.count() - 1)
+		return QString();
+	return m_strings.mid(m_stringStart.at(index),
+						 m_stringStart.at(index + 1) - m_stringStart.at(index));
+}
+
+bool ImportTable::XLSXReader::open()
+{
+	if (!m_zip.open())
+	{
+		m_error = m_zip.errorString();
+		return false;
+	}
+
+	QString sheet;
+	QString strings;
+	locateParts(sheet, strings);
+	if (!m_zip.contains(sheet))
+	{
+		m_error = tr("There is no worksheet in the file %1.").arg(m_zip.fileName());
+		return false;
+	}
+	// a sheet with numbers only has no shared strings
+	if (m_zip.contains(strings) && !readSharedStrings(strings))
+		return false;
+
+	m_sheet = new ZipEntryDevice(m_zip, sheet);
+	if (!m_sheet->open(QIODevice::ReadOnly))
+	{
+		m_error = m_sheet->errorString();
+		return false;
+	}
+	m_size = m_zip.entry(sheet).compressedSize;
+	m_xml.setDevice(m_sheet);
+	return true;
+}
+
+bool ImportTable::XLSXReader::readRow(QStringList & row)
+{
+	QString value;
+	bool inCell = false;
+	bool hasValue = false;
+	bool collect = false;
+	bool shared = false;
+	int phonetic = 0;
+	int column = 0;
+
+	row.clear();
+	while (!m_xml.atEnd())
+	{
+		switch (m_xml.readNext())
+		{
+			case QXmlStreamReader::StartElement:
+				switch (sheetTag(m_xml.name()))
+				{
+					case RowTag:
+						row.clear();
+						column = 0;
+						break;
+					case CellTag:
+					{
+						QXmlStreamAttributes a(m_xml.attributes());
+						QStringRef type(a.value(QLatin1String("t")));
+						shared = (type.size() == 1 && type.at(0) == 's');
+						// "B12" - the letters are the column
+						QStringRef ref(a.value(QLatin1String("r")));
+						if (!ref.isEmpty())
+						{
+							int c = 0;
+							for (int i = 0; i < ref.size() && ref.at(i).isLetter(); ++i)
+								c = c * 26 + (ref.at(i).toUpper().unicode() - 'A' + 1);
+							if (c > 0)
+								column = c - 1;
+						}
+						value.clear();
+						inCell = true;
+						hasValue = false;
+						break;
+					}
+					case ValueTag:
+					case TextTag:
+						// <v> for values, <is><t> for inline strings
+						collect = inCell && phonetic == 0;
+						hasValue = hasValue || collect;
+						break;
+					case PhoneticTag:
+						++phonetic;
+						break;
+					default:
+						break;
+				}
+				break;
+			case QXmlStreamReader::Characters:
+				if (collect)
+					value.append(m_xml.text());
+				break;
+			case QXmlStreamReader::EndElement:
+				switch (sheetTag(m_xml.name()))
+				{
+					case ValueTag:
+					case TextTag:
+						collect = false;
+						break;
+					case PhoneticTag:
+						--phonetic;
+						break;
+					case CellTag:
+						if (hasValue)
+							setCell(row, column, shared ? sharedString(value.toInt()) : value);
+						inCell = false;
+						++column;
+						break;
+					case RowTag:
+						return true;
+					default:
+						break;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	if (m_xml.hasError())
+		m_error = tr("XML error at line %1: %2").arg(m_xml.lineNumber()).arg(m_xml.errorString());
+	return false;
+}
+
+
+ImportTable::Reader * ImportTable::createSpreadsheetReader(const QString & fileName)
+{
+	if (ZipFile::isZip(fileName))
+		return new XLSXReader(fileName);
+	return new SpreadsheetMLReader(fileName);
+}
@@ -0,0 +1,90 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef SPREADSHEETREADER_H
+#define SPREADSHEETREADER_H
+
+#include <QVector>
+#include <QXmlStreamReader>
+
+#include "importtabledialog.h"
+#include "zipfile.h"
+#include "gzipdevice.h"
+
+
+namespace ImportTable
+{
+
+	/*! \brief Streaming reader of MS Excel 2003 XML (SpreadsheetML).
+	Rows of the first worksheet are parsed one by one as they are
+	requested. ss:Index and ss:MergeAcross of the cells are respected
+	so the values stay in their columns. Size and position are in bytes
+	(compressed ones for gzip files).
+	*/
+	class SpreadsheetMLReader : public Reader
+	{
+		public:
+			SpreadsheetMLReader(const QString & fileName);
+			~SpreadsheetMLReader();
+
+			bool open();
+			bool readRow(QStringList & row);
+			qint64 size() { return m_file.size(); };
+			qint64 position() { return m_gzip ? m_gzip->compressedPosition() : m_file.pos(); };
+
+		private:
+			QFile m_file;
+			//! \brief Inflating reader of .xml.gz files. 0 for plain files.
+			GzipDevice * m_gzip;
+			QXmlStreamReader m_xml;
+			//! \brief The end of the first worksheet is reached
+			bool m_done;
+	};
+
+	/*! \brief Streaming reader of MS Excel 2007 files (.xlsx).
+	The first worksheet is inflated from the zip archive on the fly
+	(see ZipEntryDevice) and parsed row by row. The shared strings
+	table is decoded once in open() into one buffer (the arena) with
+	the string offsets - there is no QString allocation per string.
+	Numbers and dates are imported as the raw cell values.
+	Size and position are in compressed bytes of the worksheet.
+	*/
+	class XLSXReader : public Reader
+	{
+		public:
+			XLSXReader(const QString & fileName);
+			~XLSXReader();
+
+			bool open();
+			bool readRow(QStringList & row);
+			qint64 size() { return m_size; };
+			qint64 position() { return m_sheet ? m_sheet->compressedPosition() : 0; };
+
+		private:
+			ZipFile m_zip;
+			ZipEntryDevice * m_sheet;
+			QXmlStreamReader m_xml;
+			qint64 m_size;
+			//! \brief All shared strings one after another
+			QString m_strings;
+			//! \brief Start of each shared string in m_strings. The last item is the end.
+			QVector<int> m_stringStart;
+
+			/*! \brief Find the first worksheet and the shared strings in the
+			workbook relations. Default part names are used when it fails. */
+			void locateParts(QString & sheet, QString & strings);
+			bool readSharedStrings(const QString & path);
+			QString sharedString(int index) const;
+	};
+
+	/*! \brief Create a reader for a MS Excel file.
+	XLSXReader is used for zip archives, SpreadsheetMLReader otherwise. */
+	Reader * createSpreadsheetReader(const QString & fileName);
+
+};
+
+#endif
@@ -16,15 +16,18 @@ for which a new license (GPL+exception) is in place.
 #include <QShortcut>
 #include <QSettings>
 #include <QDateTime>
+#include <QTime>
 
 #include <qscilexer.h>
 
 #include "createviewdialog.h"
+#include "dataexportdialog.h"
 #include "preferences.h"
 #include "sqleditor.h"
 #include "sqlkeywords.h"
 #include "utils.h"
 #include "database.h"
+#include "sqlresultmodel.h"
 
 
 SqlEditor::SqlEditor(QWidget * parent)
@@ -70,12 +73,15 @@ SqlEditor::SqlEditor(QWidget * parent)
 	ui.nextToolButton->setIcon(Utils::getIcon("go-next.png"));
 	ui.action_Run_SQL->setIcon(Utils::getIcon("runsql.png"));
 	ui.actionRun_Explain->setIcon(Utils::getIcon("runexplain.png"));
+	ui.actionRun_Explain_Bytecode->setIcon(Utils::getIcon("runexplain.png"));
 	ui.actionRun_as_Script->setIcon(Utils::getIcon("runscript.png"));
+	ui.actionStop->setIcon(Utils::getIcon("close.png"));
 	ui.action_Open->setIcon(Utils::getIcon("document-open.png"));
 	ui.action_Save->setIcon(Utils::getIcon("document-save.png"));
 	ui.action_New->setIcon(Utils::getIcon("document-new.png"));
 	ui.actionSave_As->setIcon(Utils::getIcon("document-save-as.png"));
 	ui.actionCreateView->setIcon(Utils::getIcon("view.png"));
+	ui.actionExport_Query->setIcon(Utils::getIcon("document-export.png"));
 	ui.actionSearch->setIcon(Utils::getIcon("system-search.png"));
 
     QShortcut * alternativeSQLRun = new QShortcut(this);
@@ -83,6 +89,16 @@ SqlEditor::SqlEditor(QWidget * parent)
 
 	QSettings settings("yarpen.cz", "sqliteman");
 	restoreState(settings.value("sqleditor/state").toByteArray());
+	// statement, time and its statistics
+	foreach (QVariant v, settings.value("sqleditor/history").toList())
+	{
+		QStringList l(v.toStringList());
+		if (l.isEmpty())
+			continue;
+		QTreeWidgetItem * item = new QTreeWidgetItem(ui.historyTreeWidget, l);
+		for (int i = 2; i < l.count(); ++i)
+			item->setTextAlignment(i, Qt::AlignRight);
+	}
 
     connect(ui.actionShow_History, SIGNAL(triggered()),
             this, SLOT(actionShow_History_triggered()));
@@ -95,8 +111,12 @@ SqlEditor::SqlEditor(QWidget * parent)
             this, SLOT(action_Run_SQL_triggered()));
 	connect(ui.actionRun_Explain, SIGNAL(triggered()),
 			this, SLOT(actionRun_Explain_triggered()));
+	connect(ui.actionRun_Explain_Bytecode, SIGNAL(triggered()),
+			this, SLOT(actionRun_Explain_Bytecode_triggered()));
 	connect(ui.actionRun_as_Script, SIGNAL(triggered()),
 			this, SLOT(actionRun_as_Script_triggered()));
+	connect(ui.actionStop, SIGNAL(triggered()),
+			this, SIGNAL(stopSqlResult()));
 	connect(ui.action_Open, SIGNAL(triggered()),
 			this, SLOT(action_Open_triggered()));
 	connect(ui.action_Save, SIGNAL(triggered()),
@@ -107,6 +127,8 @@ SqlEditor::SqlEditor(QWidget * parent)
 			this, SLOT(actionSave_As_triggered()));
 	connect(ui.actionCreateView, SIGNAL(triggered()),
 			this, SLOT(actionCreateView_triggered()));
+	connect(ui.actionExport_Query, SIGNAL(triggered()),
+			this, SLOT(actionExport_Query_triggered()));
 	connect(ui.sqlTextEdit, SIGNAL(cursorPositionChanged(int,int)),
 			this, SLOT(sqlTextEdit_cursorPositionChanged(int,int)));
 	connect(ui.sqlTextEdit, SIGNAL(modificationChanged(bool)),
@@ -127,6 +149,16 @@ SqlEditor::~SqlEditor()
 {
 	QSettings settings("yarpen.cz", "sqliteman");
     settings.setValue("sqleditor/state", saveState());
+	QList<QVariant> history;
+	for (int i = 0; i < ui.historyTreeWidget->topLevelItemCount(); ++i)
+	{
+		QTreeWidgetItem * item = ui.historyTreeWidget->topLevelItem(i);
+		QStringList l;
+		for (int c = 0; c < ui.historyTreeWidget->columnCount(); ++c)
+			l << item->text(c);
+		history.append(l);
+	}
+	settings.setValue("sqleditor/history", history);
 }
 
 void SqlEditor::setStatusMessage(const QString & message)
@@ -136,6 +168,11 @@ void SqlEditor::setStatusMessage(const QString & message)
 	ui.statusBar->showMessage(message);
 }
 
+void SqlEditor::setQueryRunning(bool running)
+{
+	ui.actionStop->setEnabled(running);
+}
+
 QString SqlEditor::query()
 {
 	if (ui.sqlTextEdit->hasSelectedText())
@@ -250,16 +287,23 @@ QString SqlEditor::prepareExec(toSQLParse::tokenizer &tokens, int line, int pos)
 void SqlEditor::action_Run_SQL_triggered()
 {
     QString sql(query());
-	emit showSqlResult(sql);
+	// before the run - the statistics are stored with the history item
     appendHistory(sql);
+	emit showSqlResult(sql);
 }
 
 void SqlEditor::actionRun_Explain_triggered()
 {
-    QString s("explain query plan %1");
-    s = s.arg(query());
-	emit showSqlResult(s);
-    appendHistory(s);
+    QString sql(query());
+	emit showQueryPlan(sql);
+    appendHistory(sql);
+}
+
+void SqlEditor::actionRun_Explain_Bytecode_triggered()
+{
+    QString sql(query());
+	emit showBytecode(sql);
+    appendHistory(sql);
 }
 
 void SqlEditor::actionRun_as_Script_triggered()
@@ -281,6 +325,7 @@ void SqlEditor::actionRun_as_Script_triggered()
 	QString sql;
 	bool isError = false;
 
+	emit aboutToWrite();
 	emit sqlScriptStart();
 	emit showSqlScriptResult("-- " + tr("Script started"));
 	do {
@@ -305,8 +350,17 @@ void SqlEditor::actionRun_as_Script_triggered()
 		{
 			sql = prepareExec(tokens, line, pos);
 			emit showSqlScriptResult(sql);
+			appendHistory(sql);
+			SqlStatementProfile profile(SqlProfile::create(sql));
+			QTime time;
+			time.start();
 			query.exec(sql);
-            appendHistory(sql);
+			profile.elapsed = time.elapsed();
+			// script does not fetch the rows
+			if (!query.lastError().isValid() && !query.isSelect())
+				profile.rows = query.numRowsAffected();
+			SqlProfile::readCounters(query, profile);
+			emit statementProfiled(profile);
 			if (query.lastError().isValid())
 			{
 				emit showSqlScriptResult("-- " + tr("Error: %1.").arg(query.lastError().text()));
@@ -337,10 +391,12 @@ void SqlEditor::actionRun_as_Script_triggered()
 	ui.sqlTextEdit->setSelection(cline, cpos, tokens.line(), tokens.offset());
 	if (!isError)
 		emit showSqlScriptResult("-- " + tr("Script finished"));
+	emit sqlScriptFinished();
 }
 
 void SqlEditor::actionCreateView_triggered()
 {
+	emit aboutToWrite();
 	CreateViewDialog dia("", "", this);
 
 	dia.setText(query());
@@ -349,6 +405,23 @@ void SqlEditor::actionCreateView_triggered()
 		emit rebuildViewTree(dia.schema(), dia.name());
 }
 
+void SqlEditor::actionExport_Query_triggered()
+{
+	QString sql(query());
+	// the rows are read by other connection. See DataExportWorker.
+	if (!SqlResultModel::canRunAsync(sql))
+	{
+		QMessageBox::warning(this, tr("Export Query Result"),
+							 tr("Only a SELECT statement of a database file can be exported directly.\n"
+								"Commit the open transaction and do not use TEMP objects."));
+		return;
+	}
+
+	DataExportDialog dia(sql, this);
+	if (dia.exec() && !dia.doExport())
+		QMessageBox::warning(this, tr("Export Error"), tr("Data export failed"));
+}
+
 void SqlEditor::showEvent(QShowEvent * event)
 {
 	ui.sqlTextEdit->setFocus();
@@ -435,6 +508,40 @@ void SqlEditor::appendHistory(const QString & sql)
         delete ui.historyTreeWidget->takeTopLevelItem(0);
 }
 
+QTreeWidgetItem * SqlEditor::historyItem(const QString & statement, int column)
+{
+	QString s(statement.simplified());
+	for (int i = ui.historyTreeWidget->topLevelItemCount() - 1; i >= 0; --i)
+	{
+		QTreeWidgetItem * item = ui.historyTreeWidget->topLevelItem(i);
+		if (item->text(column).isEmpty() && item->text(0).simplified() == s)
+			return item;
+	}
+	return 0;
+}
+
+void SqlEditor::setHistoryProfile(const SqlStatementProfile & profile)
+{
+	// columns 2-4: duration, SQLite time and rows
+	QTreeWidgetItem * item = historyItem(profile.statement, 2);
+	if (!item)
+		return;
+	item->setText(2, profile.elapsed < 0 ? QString() : QString::number(profile.elapsed / 1000.0));
+	if (profile.vmTime >= 0)
+		item->setText(3, QString::number(profile.vmTime / 1000000000.0));
+	if (profile.rows >= 0)
+		item->setText(4, QString::number(profile.rows) + (profile.moreRows ? "+" : ""));
+	for (int i = 2; i < 5; ++i)
+		item->setTextAlignment(i, Qt::AlignRight);
+}
+
+void SqlEditor::setHistoryProfileTime(const QString & statement, qint64 vmTime)
+{
+	QTreeWidgetItem * item = historyItem(statement, 3);
+	if (item && !item->text(2).isEmpty())
+		item->setText(3, QString::number(vmTime / 1000000000.0));
+}
+
 void SqlEditor::actionShow_History_triggered()
 {
     ui.historyTreeWidget->setVisible(ui.actionShow_History->isChecked());
@@ -13,6 +13,7 @@ for which a new license (GPL+exception) is in place.
 
 #include "ui_sqleditor.h"
 #include "sqlparser/tosqlparse.h"
+#include "sqlprofile.h"
 
 class QTextDocument;
 class QLabel;
@@ -39,6 +40,15 @@ class SqlEditor : public QMainWindow
 		QString fileName() { return m_fileName; };
 
 		void setStatusMessage(const QString & message = 0);
+		//! \brief Enable the "Stop" action while a statement is running
+		void setQueryRunning(bool running);
+
+		/*! \brief Store the statistics with the newest history item of
+		the statement which has none yet. Runs of one statement can be
+		compared in the history then. It's kept between sessions. */
+		void setHistoryProfile(const SqlStatementProfile & profile);
+		//! \brief Set the sqlite3_profile() time of the newest history run.
+		void setHistoryProfileTime(const QString & statement, qint64 vmTime);
 
    	signals:
 		/*! \brief This signal is emitted when user clicks on the one
@@ -46,11 +56,25 @@ class SqlEditor : public QMainWindow
 		\param command current SQL statement in the editor.
 		*/
 		void showSqlResult(QString command);
+		/*! \brief User wants to stop the statement started
+		by showSqlResult(). */
+		void stopSqlResult();
+		//! \brief Show the query plan tree of the current statement.
+		void showQueryPlan(const QString & command);
+		//! \brief Show EXPLAIN bytecode of the current statement.
+		void showBytecode(const QString & command);
+		/*! \brief The editor is going to write by the main connection.
+		A paused result must not hold its read lock then. */
+		void aboutToWrite();
 		//! \brief It's emitted when the script is started
 		void sqlScriptStart();
+		//! \brief It's emitted when the script is finished or cancelled
+		void sqlScriptFinished();
 		/*! \brief Emitted on demand in the script.
 		Line is appended to the script output. */
 		void showSqlScriptResult(QString line);
+		//! \brief Statistics of one statement executed in the script.
+		void statementProfiled(const SqlStatementProfile & profile);
 
 		/*! \brief Request for complete object tree refresh.
 		It's used in "Run as Script" */
@@ -80,6 +104,8 @@ class SqlEditor : public QMainWindow
 
 
         void appendHistory(const QString & sql);
+		//! \brief The newest history item of the statement without the column value.
+		QTreeWidgetItem * historyItem(const QString & statement, int column);
 
 		void showEvent(QShowEvent * event);
 		bool changedConfirm();
@@ -101,12 +127,15 @@ class SqlEditor : public QMainWindow
 	private slots:
 		void action_Run_SQL_triggered();
 		void actionRun_Explain_triggered();
+		void actionRun_Explain_Bytecode_triggered();
 		void actionRun_as_Script_triggered();
 		void action_Open_triggered();
 		void action_Save_triggered();
 		void action_New_triggered();
 		void actionSave_As_triggered();
 		void actionCreateView_triggered();
+		//! \brief Stream the result of the current statement into a file. See DataExportWorker.
+		void actionExport_Query_triggered();
 		void sqlTextEdit_cursorPositionChanged(int,int);
 		void documentChanged(bool state);
 		void cancel();
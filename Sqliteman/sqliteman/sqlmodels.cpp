@@ -7,6 +7,7 @@ for which a new license (GPL+exception) is in place.
 
 #include <QColor>
 #include <QSqlField>
+#include <QSqlQuery>
 
 #include "sqlmodels.h"
 #include "database.h"
@@ -17,7 +18,9 @@ for which a new license (GPL+exception) is in place.
 SqlTableModel::SqlTableModel(QObject * parent, QSqlDatabase db)
 	: QSqlTableModel(parent, db),
 	m_pending(false),
-	m_schema("")
+	m_schema(""),
+	m_windowStart(0),
+	m_windowKey(0)
 {
 	m_deleteCache.clear();
 	Preferences * prefs = Preferences::instance();
@@ -152,7 +155,11 @@ QVariant SqlTableModel::headerData(int section, Qt::Orientation orientation, int
 				break;
 		}
 	}
-	return QSqlTableModel::headerData(section, orientation, role);
+	// "*" and "!" of the inserted and deleted rows are strings
+	QVariant ret(QSqlTableModel::headerData(section, orientation, role));
+	if (orientation == Qt::Vertical && m_windowStart > 0 && ret.type() == QVariant::Int)
+		return QVariant(ret.toInt() + m_windowStart);
+	return ret;
 }
 
 void SqlTableModel::doPrimeInsert(int row, QSqlRecord & record)
@@ -222,9 +229,96 @@ void SqlTableModel::setTable(const QString &tableName)
 		m_header[c.cid] = SqlTableModel::None;
 	}
 
+	// a column can hide the rowid under its name
+	m_rowid = QString();
+	foreach (QString alias, QStringList() << "rowid" << "_rowid_" << "oid")
+	{
+		bool used = false;
+		foreach (DatabaseTableField c, columns)
+			used = used || c.name.compare(alias, Qt::CaseInsensitive) == 0;
+		if (!used)
+		{
+			m_rowid = alias;
+			break;
+		}
+	}
+	m_windowStart = 0;
+
 	QSqlTableModel::setTable(tableName);
 }
 
+QString SqlTableModel::exportStatement()
+{
+	QString sql(QString("SELECT * FROM \"%1\".\"%2\"").arg(m_schema).arg(tableName()));
+	if (!filter().isEmpty())
+		sql += " WHERE " + filter();
+	QString order(orderByClause());
+	if (!order.isEmpty())
+		sql += " " + order;
+	return sql;
+}
+
+int SqlTableModel::totalRowCount()
+{
+	if (!canFetchMore() && m_windowStart == 0)
+		return rowCount();
+	QString sql(QString("SELECT count(*) FROM \"%1\".\"%2\"").arg(m_schema).arg(tableName()));
+	if (!filter().isEmpty())
+		sql += " WHERE " + filter();
+	QSqlQuery query(sql, database());
+	if (!query.next())
+		return m_windowStart + rowCount();
+	// rows inserted into the cache are not in the table yet
+	return qMax(m_windowStart + rowCount(), query.value(0).toInt());
+}
+
+bool SqlTableModel::canSeek()
+{
+	return !m_rowid.isEmpty() && naturalOrder() && !m_pending;
+}
+
+bool SqlTableModel::seekRow(int row)
+{
+	if (!canSeek())
+		return false;
+	if (row <= 0)
+	{
+		m_windowStart = 0;
+		return select();
+	}
+
+	// only the rowid b-tree is walked - no values are read
+	QSqlQuery query(QString("SELECT %1 FROM \"%2\".\"%3\" ORDER BY %1 LIMIT 1 OFFSET %4;")
+					.arg(m_rowid).arg(m_schema).arg(tableName()).arg(row),
+					database());
+	if (!query.next())
+		return false;
+	m_windowStart = row;
+	m_windowKey = query.value(0).toLongLong();
+	return select();
+}
+
+void SqlTableModel::setFilter(const QString & filter)
+{
+	m_windowStart = 0;
+	QSqlTableModel::setFilter(filter);
+}
+
+void SqlTableModel::setSort(int column, Qt::SortOrder order)
+{
+	m_windowStart = 0;
+	QSqlTableModel::setSort(column, order);
+}
+
+QString SqlTableModel::selectStatement() const
+{
+	QString sql(QSqlTableModel::selectStatement());
+	if (m_windowStart == 0 || sql.isEmpty())
+		return sql;
+	// the window is used in the natural order only - no WHERE or ORDER BY yet
+	return sql + QString(" WHERE %1 >= %2 ORDER BY %1").arg(m_rowid).arg(m_windowKey);
+}
+
 void SqlTableModel::setPendingTransaction(bool pending)
 {
 	m_pending = pending;
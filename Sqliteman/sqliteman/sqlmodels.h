@@ -39,6 +39,27 @@ class SqlTableModel : public QSqlTableModel
 		bool removeRows ( int row, int count, const QModelIndex & parent = QModelIndex() );
 		
 		void setTable ( const QString & tableName );
+		/*! \brief SELECT of the model data (including filter and sort)
+		for other connections. The table is qualified by the schema. */
+		QString exportStatement();
+		//! \brief True when all rows are shown in the rowid order (no filter or sort).
+		bool naturalOrder() { return filter().isEmpty() && orderByClause().isEmpty(); };
+		/*! \brief Rows of the table (with the filter) including the ones
+		not fetched yet. rowCount() is returned on error. */
+		int totalRowCount();
+		//! \brief True when seekRow() is possible (natural order, no pending changes).
+		bool canSeek();
+		/*! \brief Show the table from the row on. The model row 0 is the table
+		row then (see windowStart()). The rowid of the row is looked up by sqlite
+		so the rows before it are not fetched into the model. Row 0 shows
+		the whole table again. It's reset by the filter or sort change.
+		\retval bool false when the seek is not possible or it failed. */
+		bool seekRow(int row);
+		//! \brief Table row shown as the model row 0. See seekRow().
+		int windowStart() { return m_windowStart; };
+
+		void setFilter(const QString & filter);
+		void setSort(int column, Qt::SortOrder order);
 		
 		/*! override parent to make public */
 		QModelIndex createIndex(int row, int column, void *ptr = 0) const
@@ -66,6 +87,12 @@ class SqlTableModel : public QSqlTableModel
 		QList<int> m_deleteCache;
 		bool m_cropColumns;
 		QMap<int,IndexType> m_header;
+		//! \brief Unused alias of the rowid (rowid, _rowid_ or oid). Empty when all are columns.
+		QString m_rowid;
+		//! \brief Table row of the model row 0
+		int m_windowStart;
+		//! \brief rowid of the model row 0 when m_windowStart is not 0
+		qint64 m_windowKey;
 
 		QVariant data(const QModelIndex & item, int role = Qt::DisplayRole) const;
 		bool setData(const QModelIndex & ix, const QVariant & value, int role = Qt::EditRole);
@@ -74,6 +101,10 @@ class SqlTableModel : public QSqlTableModel
 							Qt::Orientation orientation,
 							int role = Qt::DisplayRole) const;
 
+	protected:
+		//! \brief The window of seekRow() is added to the statement.
+		QString selectStatement() const;
+
 	private slots:
 		//! \brief Called when is new row created in the view (not in the model).
 		void doPrimeInsert(int, QSqlRecord &);
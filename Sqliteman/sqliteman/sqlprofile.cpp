@@ -0,0 +1,44 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QSqlQuery>
+#include <QSqlResult>
+
+#include "sqlprofile.h"
+
+
+SqlStatementProfile SqlProfile::create(const QString & statement)
+{
+	SqlStatementProfile p;
+	p.statement = statement;
+	p.started = QDateTime::currentDateTime();
+	p.elapsed = -1;
+	p.vmTime = -1;
+	p.rows = -1;
+	p.moreRows = false;
+	p.fullScanSteps = -1;
+	p.sorts = -1;
+	return p;
+}
+
+void SqlProfile::readCounters(sqlite3_stmt * stmt, SqlStatementProfile & profile)
+{
+	if (!stmt)
+		return;
+	profile.fullScanSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0);
+	profile.sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 0);
+}
+
+void SqlProfile::readCounters(const QSqlQuery & query, SqlStatementProfile & profile)
+{
+	if (!query.result())
+		return;
+	QVariant v(query.result()->handle());
+	if (!v.isValid() || qstrcmp(v.typeName(), "sqlite3_stmt*") != 0)
+		return;
+	readCounters(*static_cast<sqlite3_stmt **>(v.data()), profile);
+}
@@ -0,0 +1,62 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef SQLPROFILE_H
+#define SQLPROFILE_H
+
+#include <QString>
+#include <QDateTime>
+#include <QMetaType>
+
+#include "sqlite3.h"
+
+class QSqlQuery;
+
+
+/*! \brief Execution statistics of one statement.
+It's displayed in the DataViewer "Profile" tab. Unknown
+numbers are -1.
+*/
+typedef struct
+{
+	QString statement;
+	QDateTime started;
+	//! \brief Wall clock time spent in the statement (ms)
+	int elapsed;
+	/*! \brief Time reported by sqlite3_profile() (ns). It's known when
+	the statement is stepped to its end only. */
+	qint64 vmTime;
+	//! \brief Rows returned (SELECT) or changed (DML)
+	int rows;
+	//! \brief Not all rows were fetched. Rows is the fetched count.
+	bool moreRows;
+	//! \brief SQLITE_STMTSTATUS_FULLSCAN_STEP
+	int fullScanSteps;
+	//! \brief SQLITE_STMTSTATUS_SORT
+	int sorts;
+}
+SqlStatementProfile;
+
+Q_DECLARE_METATYPE(SqlStatementProfile)
+
+
+//! \brief Helpers to fill SqlStatementProfile
+namespace SqlProfile {
+
+//! \brief A new profile started now. All numbers are unknown.
+SqlStatementProfile create(const QString & statement);
+
+//! \brief Read sqlite3_stmt_status() counters of the statement.
+void readCounters(sqlite3_stmt * stmt, SqlStatementProfile & profile);
+
+/*! \brief Read counters of the statement owned by the Qt sqlite driver.
+It works with the sqlite3 driver only (others are skipped). */
+void readCounters(const QSqlQuery & query, SqlStatementProfile & profile);
+
+};
+
+#endif
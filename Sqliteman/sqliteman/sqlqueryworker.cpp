@@ -0,0 +1,349 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QMutexLocker>
+
+#include <climits>
+
+#include "sqlqueryworker.h"
+#include "databasesession.h"
+
+
+SqlQueryWorker::SqlQueryWorker(const QString & query,
+							   const DbAttach & databases,
+							   const QStringList & extensions,
+							   QObject * parent)
+	: QThread(parent),
+	  m_query(query),
+	  m_databases(databases),
+	  m_extensions(extensions),
+	  m_db(0),
+	  m_wanted(0),
+	  m_stopped(0),
+	  m_cancelled(0),
+	  m_serving(false),
+	  m_seekStmt(0),
+	  m_steps(0),
+	  m_vmTime(-1),
+	  m_busy(0)
+{
+	qRegisterMetaType<SqlRowBlock>("SqlRowBlock");
+	qRegisterMetaType<SqlStatementProfile>("SqlStatementProfile");
+}
+
+SqlQueryWorker::~SqlQueryWorker()
+{
+	cancel();
+	wait();
+}
+
+void SqlQueryWorker::fetchMore(int rows)
+{
+	QMutexLocker locker(&m_mutex);
+	// prevent an overflow for "fetch all" requests
+	m_wanted = (rows > INT_MAX - m_wanted) ? INT_MAX : m_wanted + rows;
+	m_demand.wakeAll();
+}
+
+void SqlQueryWorker::fetchBlock(int block, qint64 seek)
+{
+	QMutexLocker locker(&m_mutex);
+	m_blockRequests.append(qMakePair(block, seek));
+	m_demand.wakeAll();
+}
+
+void SqlQueryWorker::stop()
+{
+	QMutexLocker locker(&m_mutex);
+	m_stopped = 1;
+	if (m_db)
+		sqlite3_interrupt(m_db);
+	m_demand.wakeAll();
+}
+
+void SqlQueryWorker::cancel()
+{
+	QMutexLocker locker(&m_mutex);
+	m_cancelled = 1;
+	if (m_db)
+		sqlite3_interrupt(m_db);
+	m_demand.wakeAll();
+}
+
+bool SqlQueryWorker::openConnection(QString & error)
+{
+	QString mainFile(m_databases.value("main"));
+	if (mainFile.isEmpty() || mainFile == ":memory:")
+	{
+		error = tr("In-memory database cannot be shared with other connection");
+		return false;
+	}
+
+	sqlite3 * db = 0;
+	// do not join the shared cache of DatabaseSession readers
+	QMutexLocker openLocker(DatabaseSession::openMutex());
+	if (sqlite3_open_v2(mainFile.toUtf8().data(), &db, SQLITE_OPEN_READONLY, 0) != SQLITE_OK)
+	{
+		error = db ? QString::fromUtf8(sqlite3_errmsg(db)) : tr("Cannot open database");
+		sqlite3_close(db);
+		return false;
+	}
+	sqlite3_busy_timeout(db, 5000);
+
+	QMapIterator<QString,QString> it(m_databases);
+	while (it.hasNext())
+	{
+		it.next();
+		if (it.key() == "main" || it.key() == "temp")
+			continue;
+		QString sql(QString("ATTACH DATABASE '%1' AS \"%2\";")
+						.arg(QString(it.value()).replace('\'', "''"))
+						.arg(it.key()));
+		if (sqlite3_exec(db, sql.toUtf8().data(), 0, 0, 0) != SQLITE_OK)
+		{
+			error = QString::fromUtf8(sqlite3_errmsg(db));
+			sqlite3_close(db);
+			return false;
+		}
+	}
+	openLocker.unlock();
+
+	// extension functions can be used in the statement.
+	// Failures are ignored here - the statement preparation fails later
+	if (!m_extensions.isEmpty()
+		&& sqlite3_enable_load_extension(db, 1) == SQLITE_OK)
+	{
+		foreach (QString f, m_extensions)
+			sqlite3_load_extension(db, f.toUtf8().data(), 0, 0);
+	}
+
+	sqlite3_progress_handler(db, ProgressSteps, progressHandler, this);
+	sqlite3_profile(db, profileCallback, this);
+
+	QMutexLocker locker(&m_mutex);
+	m_db = db;
+	if (m_cancelled)
+		sqlite3_interrupt(m_db);
+	return true;
+}
+
+void SqlQueryWorker::closeConnection()
+{
+	QMutexLocker locker(&m_mutex);
+	if (!m_db)
+		return;
+	sqlite3_finalize(m_seekStmt);
+	m_seekStmt = 0;
+	sqlite3_close(m_db);
+	m_db = 0;
+}
+
+int SqlQueryWorker::elapsed()
+{
+	return m_busy + m_clock.elapsed();
+}
+
+QString SqlQueryWorker::errorMessage()
+{
+	return QString(reinterpret_cast<const QChar *>(sqlite3_errmsg16(m_db)));
+}
+
+int SqlQueryWorker::progressHandler(void * worker)
+{
+	SqlQueryWorker * w = static_cast<SqlQueryWorker*>(worker);
+	// seek blocks are not a part of the statement progress
+	if (w->m_serving)
+		return w->m_cancelled ? 1 : 0;
+
+	w->m_steps += ProgressSteps;
+	if (w->m_reported.elapsed() >= ProgressInterval)
+	{
+		w->m_reported.restart();
+		emit w->progress(w->m_steps, w->elapsed());
+	}
+	// non-zero value interrupts the statement
+	return (w->m_cancelled || w->m_stopped) ? 1 : 0;
+}
+
+void SqlQueryWorker::profileCallback(void * worker, const char *, sqlite3_uint64 ns)
+{
+	SqlQueryWorker * w = static_cast<SqlQueryWorker*>(worker);
+	if (!w->m_serving)
+		w->m_vmTime = ns;
+}
+
+SqlRowBlock SqlQueryWorker::readBlock(qint64 seek)
+{
+	if (!m_seekStmt)
+	{
+		const void * tail = 0;
+		if (sqlite3_prepare16_v2(m_db, m_seekQuery.constData(),
+								 (m_seekQuery.size() + 1) * sizeof(QChar),
+								 &m_seekStmt, &tail) != SQLITE_OK)
+		{
+			sqlite3_finalize(m_seekStmt);
+			m_seekStmt = 0;
+			return SqlRowBlock();
+		}
+	}
+
+	m_serving = true;
+	sqlite3_bind_int64(m_seekStmt, 1, seek);
+	sqlite3_bind_int(m_seekStmt, 2, BatchSize);
+	SqlRowBlock rows(sqlite3_column_count(m_seekStmt));
+	int rc;
+	while ((rc = sqlite3_step(m_seekStmt)) == SQLITE_ROW)
+		rows.appendRow(m_seekStmt);
+	// partial block is useless
+	if (rc != SQLITE_DONE)
+		rows.clear();
+	sqlite3_reset(m_seekStmt);
+	m_serving = false;
+	return rows;
+}
+
+void SqlQueryWorker::serveBlocks(QMutexLocker & locker)
+{
+	while (!m_blockRequests.isEmpty() && !m_cancelled)
+	{
+		QPair<int,qint64> request(m_blockRequests.takeFirst());
+		locker.unlock();
+		SqlRowBlock rows(readBlock(request.second));
+		emit blockFetched(request.first, rows);
+		locker.relock();
+	}
+}
+
+bool SqlQueryWorker::waitForDemand(SqlRowBlock & rows, int firstRow)
+{
+	QMutexLocker locker(&m_mutex);
+	if (!m_blockRequests.isEmpty())
+		serveBlocks(locker);
+	if (m_wanted > 0 || m_cancelled || m_stopped)
+		return !(m_cancelled || m_stopped);
+
+	// idle time does not belong to the statement duration
+	if (!rows.isEmpty())
+	{
+		emit rowsFetched(rows);
+		rows.clear();
+	}
+	m_busy += m_clock.elapsed();
+	emit fetchPaused(firstRow, m_busy);
+
+	while (m_wanted <= 0 && !m_cancelled && !m_stopped)
+	{
+		if (m_blockRequests.isEmpty())
+			m_demand.wait(&m_mutex);
+		else
+			serveBlocks(locker);
+	}
+
+	m_clock.restart();
+	m_reported.restart();
+	return !(m_cancelled || m_stopped);
+}
+
+void SqlQueryWorker::run()
+{
+	QString error;
+	m_clock.start();
+	m_reported.start();
+
+	if (!openConnection(error))
+	{
+		emit prepareFailed(error);
+		return;
+	}
+
+	sqlite3_stmt * stmt = 0;
+	const void * tail = 0;
+	int rc = sqlite3_prepare16_v2(m_db, m_query.constData(),
+								  (m_query.size() + 1) * sizeof(QChar),
+								  &stmt, &tail);
+	if (rc != SQLITE_OK || !stmt)
+	{
+		error = (rc == SQLITE_OK) ? tr("No SQL statement") : errorMessage();
+		sqlite3_finalize(stmt);
+		closeConnection();
+		if (m_cancelled || m_stopped)
+			emit queryFinished(tr("Query cancelled"), -1, elapsed());
+		else
+			emit prepareFailed(error);
+		return;
+	}
+
+	int columns = sqlite3_column_count(stmt);
+	QStringList names;
+	for (int i = 0; i < columns; ++i)
+		names.append(QString(reinterpret_cast<const QChar *>(sqlite3_column_name16(stmt, i))));
+	emit columnsFetched(names);
+
+	SqlStatementProfile profile(SqlProfile::create(m_query));
+	profile.rows = 0;
+	SqlRowBlock rows(columns);
+	QTime flush;
+	flush.start();
+	int firstRow = -1;
+	rc = SQLITE_DONE;
+
+	while (waitForDemand(rows, firstRow))
+	{
+		rc = sqlite3_step(stmt);
+		if (rc != SQLITE_ROW)
+			break;
+		if (firstRow < 0)
+			firstRow = elapsed();
+		rows.appendRow(stmt);
+		++profile.rows;
+		{
+			QMutexLocker locker(&m_mutex);
+			--m_wanted;
+		}
+		if (rows.rowCount() >= BatchSize || flush.elapsed() >= FlushInterval)
+		{
+			emit rowsFetched(rows);
+			rows.clear();
+			flush.restart();
+		}
+	}
+
+	if (!rows.isEmpty())
+		emit rowsFetched(rows);
+
+	if (m_cancelled || m_stopped || rc == SQLITE_INTERRUPT)
+		error = tr("Query cancelled");
+	else if (rc != SQLITE_DONE && rc != SQLITE_ROW)
+	{
+		// sqlite3_reset() returns the specific error code and message
+		sqlite3_reset(stmt);
+		error = errorMessage();
+	}
+
+	int total = elapsed();
+	profile.elapsed = total;
+	profile.moreRows = (rc != SQLITE_DONE);
+	SqlProfile::readCounters(stmt, profile);
+	sqlite3_finalize(stmt);
+	profile.vmTime = m_vmTime;
+	emit profiled(profile);
+	emit queryFinished(error, firstRow, total);
+
+	// evicted blocks can be requested until the result is released
+	if (!m_seekQuery.isEmpty())
+	{
+		QMutexLocker locker(&m_mutex);
+		while (!m_cancelled)
+		{
+			if (m_blockRequests.isEmpty())
+				m_demand.wait(&m_mutex);
+			else
+				serveBlocks(locker);
+		}
+	}
+	closeConnection();
+}
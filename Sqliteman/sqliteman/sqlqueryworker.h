@@ -0,0 +1,162 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef SQLQUERYWORKER_H
+#define SQLQUERYWORKER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QStringList>
+#include <QTime>
+#include <QPair>
+
+#include "database.h"
+#include "sqlrowblock.h"
+#include "sqlprofile.h"
+
+
+/*! \brief Run one SELECT statement outside the GUI thread.
+The worker opens its own read-only sqlite3 connection to the main
+database file (and to the attached ones) so the GUI connection
+is never blocked by a long running statement.
+Rows are sent in batches with rowsFetched() signal. The worker
+fetches only as many rows as requested by fetchMore() and it sleeps
+between requests - the same behaviour as QSqlQueryModel has.
+Statement can be stopped anytime by stop() which uses
+sqlite3_interrupt() on the worker connection.
+
+When there is a seek query set the worker stays alive after the
+statement is finished and it reads blocks of rows again on
+fetchBlock() requests. See SqlResultModel for the block handling.
+The thread is finished by cancel() only.
+*/
+class SqlQueryWorker : public QThread
+{
+	Q_OBJECT
+
+	public:
+		//! \brief Count of rows sent to the GUI in one rowsFetched() signal
+		static const int BatchSize = 256;
+		//! \brief Max time (ms) to hold fetched rows before they are sent
+		static const int FlushInterval = 100;
+		//! \brief VM instructions between the progress handler calls
+		static const int ProgressSteps = 1000;
+		//! \brief Min time (ms) between progress() signals
+		static const int ProgressInterval = 250;
+
+		/*! \brief Prepare the worker.
+		\param query a SQL statement to run. Only the first statement is used.
+		\param databases a "name - file" map of databases from PRAGMA database_list.
+		\param extensions sqlite3 extensions to load into the worker connection.
+		*/
+		SqlQueryWorker(const QString & query,
+					   const DbAttach & databases,
+					   const QStringList & extensions = QStringList(),
+					   QObject * parent = 0);
+		~SqlQueryWorker();
+
+		/*! \brief Set a statement to re-read one block of the result.
+		It has to have 2 parameters: ?1 is the seek value (a key or an offset)
+		and ?2 is the LIMIT. It must be called before start().
+		*/
+		void setSeekQuery(const QString & query) { m_seekQuery = query; };
+
+		//! \brief Allow the worker to fetch next rows count.
+		void fetchMore(int rows);
+		/*! \brief Ask for a block of rows with the seek query.
+		\param block a block number used in blockFetched() signal.
+		\param seek a value bound to the ?1 parameter of the seek query.
+		*/
+		void fetchBlock(int block, qint64 seek);
+		/*! \brief Stop the main statement as soon as possible.
+		Seek requests are still handled. It's safe to call it from any thread. */
+		void stop();
+		/*! \brief Stop everything and finish the thread.
+		It's safe to call it from any thread. */
+		void cancel();
+
+	signals:
+		//! \brief Column names are known. Emitted once, before any row.
+		void columnsFetched(const QStringList & columns);
+		void rowsFetched(const SqlRowBlock & rows);
+		//! \brief Rows of the fetchBlock() request. Empty on error.
+		void blockFetched(int block, const SqlRowBlock & rows);
+		/*! \brief Statement is running.
+		\param steps count of the VM instructions executed so far.
+		\param elapsed time spent in the statement (ms).
+		*/
+		void progress(qint64 steps, int elapsed);
+		/*! \brief No more rows are requested now and the worker sleeps.
+		\param firstRow time to the first row (ms) or -1 when there is no row yet.
+		\param elapsed time spent in the statement (ms).
+		*/
+		void fetchPaused(int firstRow, int elapsed);
+		/*! \brief The statement cannot be run on the worker connection
+		(e.g. it uses a function from runtime loaded extension).
+		Caller should use the GUI connection for it. */
+		void prepareFailed(const QString & error);
+		/*! \brief The statement is finished.
+		\param error empty string on success.
+		\param firstRow time to the first row (ms) or -1 for empty result.
+		\param elapsed total time spent in the statement (ms).
+		*/
+		void queryFinished(const QString & error, int firstRow, int elapsed);
+		//! \brief Statistics of the statement. Emitted just before queryFinished().
+		void profiled(const SqlStatementProfile & profile);
+
+	protected:
+		void run();
+
+	private:
+		QString m_query;
+		QString m_seekQuery;
+		DbAttach m_databases;
+		QStringList m_extensions;
+
+		//! \brief Guards m_db, m_wanted and m_blockRequests.
+		QMutex m_mutex;
+		QWaitCondition m_demand;
+		sqlite3 * m_db;
+		int m_wanted;
+		QList<QPair<int,qint64> > m_blockRequests;
+		QAtomicInt m_stopped;
+		QAtomicInt m_cancelled;
+		//! \brief True while the worker reads a seek block (worker thread only)
+		bool m_serving;
+		sqlite3_stmt * m_seekStmt;
+
+		qint64 m_steps;
+		//! \brief sqlite3_profile() time of the main statement or -1
+		qint64 m_vmTime;
+		//! \brief Time spent in the statement before the last pause
+		int m_busy;
+		QTime m_clock;
+		QTime m_reported;
+
+		//! \brief Open and configure the worker connection.
+		bool openConnection(QString & error);
+		void closeConnection();
+		/*! \brief Block until there are rows requested.
+		Seek requests are handled while waiting.
+		\retval bool false when the worker is stopped or cancelled. */
+		bool waitForDemand(SqlRowBlock & rows, int firstRow);
+		/*! \brief Handle all pending seek requests.
+		\param locker a locked m_mutex. It's unlocked while reading. */
+		void serveBlocks(QMutexLocker & locker);
+		SqlRowBlock readBlock(qint64 seek);
+		int elapsed();
+		QString errorMessage();
+
+		//! \brief sqlite3_progress_handler() callback
+		static int progressHandler(void * worker);
+		//! \brief sqlite3_profile() callback
+		static void profileCallback(void * worker, const char * sql, sqlite3_uint64 ns);
+};
+
+#endif
@@ -0,0 +1,779 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QEventLoop>
+#include <QRegExp>
+
+#include <climits>
+
+#include "sqlresultmodel.h"
+#include "preferences.h"
+
+
+//! \brief The first keyword of the statement (uppercased) without leading comments.
+static QString firstKeyword(const QString & query)
+{
+	int i = 0;
+	int len = query.length();
+	while (i < len)
+	{
+		if (query.at(i).isSpace())
+			++i;
+		else if (query.mid(i, 2) == "--")
+		{
+			i = query.indexOf('\n', i);
+			if (i == -1)
+				return QString();
+		}
+		else if (query.mid(i, 2) == "/*")
+		{
+			i = query.indexOf("*/", i + 2);
+			if (i == -1)
+				return QString();
+			i += 2;
+		}
+		else
+			break;
+	}
+	int end = i;
+	while (end < len && query.at(end).isLetter())
+		++end;
+	return query.mid(i, end - i).toUpper();
+}
+
+//! \brief The statement without trailing semicolons and whitespaces.
+static QString trimStatement(const QString & query)
+{
+	QString statement(query.trimmed());
+	while (statement.endsWith(';'))
+		statement = statement.left(statement.length() - 1).trimmed();
+	return statement;
+}
+
+static QString unquote(const QString & name)
+{
+	if (name.length() > 1 && name.startsWith('"') && name.endsWith('"'))
+		return name.mid(1, name.length() - 2).replace("\"\"", "\"");
+	return name;
+}
+
+
+SqlResultModel::SqlResultModel(QObject * parent)
+	: QAbstractTableModel(parent),
+	  m_worker(0),
+	  m_running(false),
+	  m_fetching(false),
+	  m_firstRow(-1),
+	  m_elapsed(0),
+	  m_fetched(0),
+	  m_rowCount(0),
+	  m_bytes(0),
+	  m_budget(0),
+	  m_useClock(0),
+	  m_lastBlock(0),
+	  m_canDrop(false),
+	  m_keyset(false),
+	  m_seekNav(false),
+	  m_sparse(false),
+	  m_estimate(-1),
+	  m_estimated(false),
+	  m_maxKey(0),
+	  m_counter(0)
+{
+	Preferences * prefs = Preferences::instance();
+	m_useNull = prefs->nullHighlight();
+	m_nullColor = prefs->nullHighlightColor();
+	m_nullText = prefs->nullHighlightText();
+	m_useBlob = prefs->blobHighlight();
+	m_blobColor = prefs->blobHighlightColor();
+	m_blobText = prefs->blobHighlightText();
+	m_cropColumns = prefs->cropColumns();
+}
+
+SqlResultModel::~SqlResultModel()
+{
+	releaseWorker();
+}
+
+bool SqlResultModel::canRunAsync(const QString & query)
+{
+	QString keyword(firstKeyword(query));
+	if (keyword != "SELECT" && keyword != "EXPLAIN")
+		return false;
+
+	QString mainFile(Database::getDatabases().value("main"));
+	if (mainFile.isEmpty() || mainFile == ":memory:")
+		return false;
+
+	// uncommitted changes are visible in the main connection only
+	sqlite3 * handle = Database::sqlite3handle();
+	if (!handle || sqlite3_get_autocommit(handle) == 0)
+		return false;
+
+	// as well as TEMP objects
+	return Database::getObjects(QString(), "temp").isEmpty();
+}
+
+bool SqlResultModel::keysetQueries(const QString & query, QString & mainQuery, QString & seekQuery,
+								   QString & table, QString & schema)
+{
+	QString statement(trimStatement(query));
+	if (statement.contains(';'))
+		return false;
+
+	QRegExp select("^SELECT\\s+(.+)\\s+FROM\\s+(\"[^\"]+\"|\\w+)(\\s*\\.\\s*(\"[^\"]+\"|\\w+))?(\\s+WHERE\\s+(.+))?$",
+				   Qt::CaseInsensitive);
+	if (!select.exactMatch(statement))
+		return false;
+
+	// joins, subqueries, user ordering etc. are left to OFFSET
+	QString columns(select.cap(1));
+	QString condition(select.cap(6));
+	QRegExp complex("\\b(FROM|JOIN|WHERE|GROUP|ORDER|LIMIT|OFFSET|UNION|INTERSECT|EXCEPT|HAVING|DISTINCT)\\b",
+					Qt::CaseInsensitive);
+	if (columns.contains(complex) || condition.contains(complex))
+		return false;
+	// aggregates (count(*) etc.) return other rows than the table has.
+	// Scalar functions are rejected as well - they cannot be told apart.
+	if (columns.contains('('))
+		return false;
+
+	schema = "main";
+	table = unquote(select.cap(2));
+	if (!select.cap(4).isEmpty())
+	{
+		schema = table;
+		table = unquote(select.cap(4));
+	}
+	// views have no rowid
+	if (!Database::getObjects("table", schema).contains(table.toLower()))
+		return false;
+	// rowid is hidden by a real column
+	foreach (DatabaseTableField f, Database::tableFields(table, schema))
+	{
+		QString name(f.name.toLower());
+		if (name == "rowid" || name == "oid" || name == "_rowid_")
+			return false;
+	}
+
+	// no arg() here - user's text can contain %1 etc.
+	QString source(select.cap(2) + select.cap(3));
+	mainQuery = "SELECT rowid, " + columns + " FROM " + source
+				+ (condition.isEmpty() ? QString() : " WHERE " + condition)
+				+ " ORDER BY rowid";
+	seekQuery = "SELECT rowid, " + columns + " FROM " + source + " WHERE "
+				+ (condition.isEmpty() ? QString() : "(" + condition + ") AND ")
+				+ "rowid >= ?1 ORDER BY rowid LIMIT ?2";
+	// filtered rows cannot be counted or interpolated cheaply
+	if (!condition.isEmpty())
+		table = QString();
+	return true;
+}
+
+void SqlResultModel::exec(const QString & query)
+{
+	clear();
+	m_query = query;
+	m_budget = qint64(Preferences::instance()->resultCacheSize()) * 1024 * 1024;
+
+	QString mainQuery(query);
+	QString seekQuery;
+	QString table;
+	QString schema;
+	m_keyset = keysetQueries(query, mainQuery, seekQuery, table, schema);
+	if (!m_keyset && firstKeyword(query) == "SELECT")
+	{
+		QString statement(trimStatement(query));
+		// new line closes a possible trailing "--" comment
+		if (!statement.contains(';'))
+			seekQuery = "SELECT * FROM (" + statement + "\n) LIMIT ?2 OFFSET ?1";
+	}
+	m_canDrop = !seekQuery.isEmpty();
+
+	QStringList extensions;
+#ifdef ENABLE_EXTENSIONS
+	Preferences * prefs = Preferences::instance();
+	if (prefs->allowExtensionLoading())
+		extensions = prefs->extensionList();
+#endif
+
+	m_worker = new SqlQueryWorker(mainQuery, Database::getDatabases(), extensions, this);
+	m_worker->setSeekQuery(seekQuery);
+	connect(m_worker, SIGNAL(columnsFetched(const QStringList &)),
+			this, SLOT(worker_columnsFetched(const QStringList &)));
+	connect(m_worker, SIGNAL(rowsFetched(const SqlRowBlock &)),
+			this, SLOT(worker_rowsFetched(const SqlRowBlock &)));
+	connect(m_worker, SIGNAL(blockFetched(int, const SqlRowBlock &)),
+			this, SLOT(worker_blockFetched(int, const SqlRowBlock &)));
+	connect(m_worker, SIGNAL(progress(qint64, int)),
+			this, SLOT(worker_progress(qint64, int)));
+	connect(m_worker, SIGNAL(fetchPaused(int, int)),
+			this, SLOT(worker_fetchPaused(int, int)));
+	connect(m_worker, SIGNAL(prepareFailed(const QString &)),
+			this, SLOT(worker_prepareFailed(const QString &)));
+	connect(m_worker, SIGNAL(queryFinished(const QString &, int, int)),
+			this, SLOT(worker_queryFinished(const QString &, int, int)));
+	connect(m_worker, SIGNAL(profiled(const SqlStatementProfile &)),
+			this, SLOT(worker_profiled(const SqlStatementProfile &)));
+
+	m_running = true;
+	m_fetching = true;
+	m_worker->fetchMore(BlockSize);
+	m_worker->start();
+
+	// an empty table has no max(rowid)
+	m_seekNav = !table.isEmpty() && Database::maxRowid(table, schema, m_maxKey);
+	if (!m_seekNav)
+		return;
+
+	qint64 stat = Database::statRowCount(table, schema);
+	if (stat >= 0)
+	{
+		m_estimate = int(qMin<qint64>(stat, INT_MAX));
+		m_estimated = true;
+	}
+
+	m_counter = new SqlQueryWorker(QString("SELECT count(*) FROM \"%1\".\"%2\";").arg(schema).arg(table),
+								   Database::getDatabases(), extensions, this);
+	connect(m_counter, SIGNAL(rowsFetched(const SqlRowBlock &)),
+			this, SLOT(counter_rowsFetched(const SqlRowBlock &)));
+	connect(m_counter, SIGNAL(queryFinished(const QString &, int, int)),
+			this, SLOT(counter_queryFinished()));
+	m_counter->fetchMore(1);
+	m_counter->start();
+}
+
+void SqlResultModel::stop()
+{
+	if (m_worker && m_running)
+		m_worker->stop();
+}
+
+void SqlResultModel::releaseLocks()
+{
+	// the worker finalizes its statement asynchronously. The writer
+	// waits for it by the busy timeout of the main connection.
+	stop();
+	if (m_counter)
+	{
+		m_counter->cancel();
+		m_counter->deleteLater();
+		m_counter = 0;
+	}
+}
+
+void SqlResultModel::clear()
+{
+	releaseWorker();
+	m_columns.clear();
+	m_error = QString();
+	m_firstRow = -1;
+	m_elapsed = 0;
+	m_fetched = 0;
+	m_rowCount = 0;
+	m_blocks.clear();
+	m_bytes = 0;
+	m_lastBlock = 0;
+	m_canDrop = false;
+	m_keyset = false;
+	m_blockKeys.clear();
+	m_seekNav = false;
+	m_sparse = false;
+	m_estimate = -1;
+	m_estimated = false;
+	reset();
+}
+
+void SqlResultModel::fetchAll()
+{
+	if (!m_running)
+		return;
+
+	m_fetching = true;
+	m_worker->fetchMore(INT_MAX);
+
+	QEventLoop loop;
+	connect(this, SIGNAL(statusChanged()), &loop, SLOT(quit()));
+	connect(this, SIGNAL(prepareFailed(const QString &)), &loop, SLOT(quit()));
+	while (m_running)
+		loop.exec(QEventLoop::ExcludeUserInputEvents);
+}
+
+QVariant SqlResultModel::value(int row, int column)
+{
+	if (row < 0 || row >= m_rowCount || column < 0 || column >= m_columns.count())
+		return QVariant();
+
+	int block = row / BlockSize;
+	if (m_keyset && !m_blockKeys.contains(block))
+	{
+		// walk from the last exactly known block. The block 0 is always known.
+		QMap<int,qint64>::const_iterator it = m_blockKeys.lowerBound(block);
+		for (int b = (--it).key(); b < block && m_worker; ++b)
+			waitForBlock(b, true);
+	}
+	waitForBlock(block, true);
+
+	int offset;
+	const SqlRowBlock * b = cachedBlock(row, offset);
+	return b ? b->value(offset, column + (m_keyset ? 1 : 0)) : QVariant();
+}
+
+void SqlResultModel::releaseWorker()
+{
+	if (!m_worker)
+		return;
+	// Pending signals of the worker are ignored - see sender() checks.
+	// The destructor waits for the thread.
+	m_worker->cancel();
+	m_worker->deleteLater();
+	m_worker = 0;
+	m_running = false;
+	m_fetching = false;
+	m_pending.clear();
+
+	if (m_counter)
+	{
+		m_counter->cancel();
+		m_counter->deleteLater();
+		m_counter = 0;
+	}
+}
+
+qint64 SqlResultModel::blockKey(int block, bool & exact) const
+{
+	exact = true;
+	QMap<int,qint64>::const_iterator it = m_blockKeys.constFind(block);
+	if (it != m_blockKeys.constEnd())
+		return it.value();
+
+	// continue after the previous block
+	QHash<int,SqlResultBlock>::const_iterator prev = m_blocks.constFind(block - 1);
+	if (prev != m_blocks.constEnd() && prev.value().rows.rowCount() == BlockSize)
+	{
+		exact = prev.value().exact;
+		return prev.value().rows.integer(BlockSize - 1, 0) + 1;
+	}
+
+	// interpolate between the nearest known keys
+	exact = false;
+	int highBlock = (m_rowCount + BlockSize - 1) / BlockSize;
+	qint64 highKey = m_maxKey + 1;
+	it = m_blockKeys.lowerBound(block);
+	if (it != m_blockKeys.constEnd())
+	{
+		highBlock = it.key();
+		highKey = it.value();
+	}
+	if (it == m_blockKeys.constBegin())
+		return highKey;
+	--it;
+	return it.value() + qint64(double(highKey - it.value()) * (block - it.key()) / (highBlock - it.key()));
+}
+
+void SqlResultModel::requestBlock(int block) const
+{
+	if (!m_worker || !m_canDrop
+		|| block < 0 || block * BlockSize >= m_rowCount
+		|| m_blocks.contains(block) || m_pending.contains(block))
+		return;
+
+	m_pending.insert(block);
+	if (!m_keyset)
+	{
+		m_worker->fetchBlock(block, qint64(block) * BlockSize);
+		return;
+	}
+
+	bool exact;
+	qint64 key = blockKey(block, exact);
+	// the block is exact when it arrives. See worker_blockFetched()
+	if (exact)
+		m_blockKeys.insert(block, key);
+	m_worker->fetchBlock(block, key);
+}
+
+void SqlResultModel::waitForBlock(int block, bool exact)
+{
+	QEventLoop loop;
+	connect(this, SIGNAL(blockArrived()), &loop, SLOT(quit()));
+
+	// the second attempt is for an interpolated block requested by the view
+	for (int attempt = 0; attempt < 2 && m_worker; ++attempt)
+	{
+		QHash<int,SqlResultBlock>::iterator it = m_blocks.find(block);
+		if (it != m_blocks.end())
+		{
+			if (!exact || it.value().exact)
+				return;
+			m_bytes -= it.value().rows.bytes();
+			m_blocks.erase(it);
+		}
+
+		requestBlock(block);
+		while (m_worker && m_pending.contains(block))
+			loop.exec(QEventLoop::ExcludeUserInputEvents);
+	}
+}
+
+void SqlResultModel::applyEstimate()
+{
+	if (!m_seekNav || m_estimate < 0 || m_fetched == 0)
+		return;
+
+	if (!m_sparse)
+	{
+		// small tables are fetched as usual
+		if (!m_running || m_estimate <= m_fetched)
+			return;
+
+		m_sparse = true;
+		m_running = false;
+		m_fetching = false;
+		// the worker keeps serving seek requests
+		m_worker->stop();
+		// the incomplete last block is read again by the seek
+		int tail = (m_fetched - 1) / BlockSize;
+		if (m_fetched % BlockSize != 0 && m_blocks.contains(tail))
+		{
+			m_bytes -= m_blocks.value(tail).rows.bytes();
+			m_blocks.remove(tail);
+		}
+	}
+
+	int rows = qMax(m_estimate, m_fetched);
+	if (rows > m_rowCount)
+	{
+		beginInsertRows(QModelIndex(), m_rowCount, rows - 1);
+		m_rowCount = rows;
+		endInsertRows();
+	}
+	else if (rows < m_rowCount)
+	{
+		// the ANALYZE statistics were too optimistic
+		beginRemoveRows(QModelIndex(), rows, m_rowCount - 1);
+		m_rowCount = rows;
+		int last = (m_rowCount - 1) / BlockSize;
+		foreach (int block, m_blocks.keys())
+		{
+			if (block > last)
+			{
+				m_bytes -= m_blocks.value(block).rows.bytes();
+				m_blocks.remove(block);
+			}
+		}
+		endRemoveRows();
+	}
+}
+
+void SqlResultModel::dropBlocks(int keep)
+{
+	if (!m_canDrop)
+		return;
+
+	// the last block is still growing
+	int tail = m_running ? (m_fetched - 1) / BlockSize : -1;
+	while (m_bytes > m_budget && m_blocks.count() > MinBlocks)
+	{
+		int victim = -1;
+		quint64 oldest = ULLONG_MAX;
+		QHash<int,SqlResultBlock>::const_iterator it;
+		for (it = m_blocks.constBegin(); it != m_blocks.constEnd(); ++it)
+		{
+			if (it.key() != keep && it.key() != tail && it.value().used < oldest)
+			{
+				oldest = it.value().used;
+				victim = it.key();
+			}
+		}
+		if (victim == -1)
+			break;
+		m_bytes -= m_blocks.value(victim).rows.bytes();
+		m_blocks.remove(victim);
+	}
+}
+
+const SqlRowBlock * SqlResultModel::cachedBlock(int row, int & offset) const
+{
+	int block = row / BlockSize;
+
+	// prefetch in the scroll direction
+	if (block != m_lastBlock)
+	{
+		requestBlock(block > m_lastBlock ? block + 1 : block - 1);
+		m_lastBlock = block;
+	}
+
+	QHash<int,SqlResultBlock>::const_iterator it = m_blocks.constFind(block);
+	if (it == m_blocks.constEnd())
+	{
+		requestBlock(block);
+		return 0;
+	}
+
+	it.value().used = ++m_useClock;
+	offset = row - block * BlockSize;
+	if (offset >= it.value().rows.rowCount())
+		return 0;
+	return &it.value().rows;
+}
+
+int SqlResultModel::rowCount(const QModelIndex & parent) const
+{
+	return parent.isValid() ? 0 : m_rowCount;
+}
+
+int SqlResultModel::columnCount(const QModelIndex & parent) const
+{
+	return parent.isValid() ? 0 : m_columns.count();
+}
+
+QVariant SqlResultModel::data(const QModelIndex & item, int role) const
+{
+	if (!item.isValid()
+		|| item.row() >= m_rowCount || item.column() >= m_columns.count())
+		return QVariant();
+
+	// a dropped block is being read again. See worker_blockFetched()
+	int offset;
+	const SqlRowBlock * b = cachedBlock(item.row(), offset);
+	if (!b)
+		return (role == Qt::TextAlignmentRole) ? QVariant(Qt::AlignTop) : QVariant();
+
+	int column = item.column() + (m_keyset ? 1 : 0);
+	int type = b->type(offset, column);
+
+	// numbers. Texts can contain numbers too.
+	if (role == Qt::TextAlignmentRole)
+	{
+		if (type == SQLITE_INTEGER || type == SQLITE_FLOAT)
+			return QVariant(Qt::AlignRight | Qt::AlignTop);
+		if (type == SQLITE_TEXT)
+		{
+			bool ok;
+			b->value(offset, column).toString().toDouble(&ok);
+			if (ok)
+				return QVariant(Qt::AlignRight | Qt::AlignTop);
+		}
+		return QVariant(Qt::AlignTop);
+	}
+
+	// the cell is converted for the roles used below only
+	if (role != Qt::DisplayRole && role != Qt::EditRole
+		&& role != Qt::ToolTipRole && role != Qt::BackgroundColorRole)
+		return QVariant();
+
+	QVariant value(b->value(offset, column));
+	QString curr(value.toString());
+
+	if (m_useNull && curr.isNull())
+	{
+		if (role == Qt::BackgroundColorRole)
+			return QVariant(m_nullColor);
+		if (role == Qt::ToolTipRole)
+			return QVariant(tr("NULL value"));
+		if (role == Qt::DisplayRole)
+			return QVariant(m_nullText);
+	}
+
+	if (m_useBlob && value.type() == QVariant::ByteArray)
+	{
+		if (role == Qt::BackgroundColorRole)
+			return QVariant(m_blobColor);
+		if (role == Qt::ToolTipRole)
+			return QVariant(tr("BLOB value"));
+		if (role == Qt::DisplayRole)
+			return QVariant(m_blobText);
+	}
+
+	// advanced tooltips
+	if (role == Qt::ToolTipRole)
+		return QVariant("<qt>" + curr + "</qt>");
+
+	if (role == Qt::DisplayRole && m_cropColumns)
+		return QVariant(curr.length() > 20 ? curr.left(20)+"..." : curr);
+
+	if (role == Qt::DisplayRole || role == Qt::EditRole)
+		return value;
+
+	return QVariant();
+}
+
+QVariant SqlResultModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if (orientation == Qt::Horizontal && role == Qt::DisplayRole
+		&& section >= 0 && section < m_columns.count())
+		return QVariant(m_columns.at(section));
+	return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+bool SqlResultModel::canFetchMore(const QModelIndex & parent) const
+{
+	return !parent.isValid() && m_running;
+}
+
+void SqlResultModel::fetchMore(const QModelIndex & parent)
+{
+	// views call it repeatedly - ask for the next batch only when
+	// the previous one is delivered
+	if (parent.isValid() || !m_running || m_fetching)
+		return;
+	m_fetching = true;
+	m_worker->fetchMore(BlockSize);
+}
+
+void SqlResultModel::worker_columnsFetched(const QStringList & columns)
+{
+	if (sender() != m_worker)
+		return;
+	m_columns = columns;
+	// hidden rowid
+	if (m_keyset && !m_columns.isEmpty())
+		m_columns.removeFirst();
+	reset();
+}
+
+void SqlResultModel::worker_rowsFetched(const SqlRowBlock & rows)
+{
+	// rows sent before the switch into the seek mode
+	if (sender() != m_worker || rows.isEmpty() || m_sparse)
+		return;
+
+	beginInsertRows(QModelIndex(), m_rowCount, m_rowCount + rows.rowCount() - 1);
+	int done = 0;
+	while (done < rows.rowCount())
+	{
+		int block = m_rowCount / BlockSize;
+		int count = qMin(rows.rowCount() - done, BlockSize - m_rowCount % BlockSize);
+		if (m_keyset && m_rowCount % BlockSize == 0)
+			m_blockKeys.insert(block, rows.integer(done, 0));
+
+		if (!m_blocks.contains(block))
+		{
+			SqlResultBlock b;
+			b.rows = SqlRowBlock(rows.columnCount());
+			b.exact = true;
+			m_blocks.insert(block, b);
+		}
+		SqlResultBlock & b = m_blocks[block];
+		m_bytes -= b.rows.bytes();
+		b.rows.appendRows(rows, done, count);
+		b.used = ++m_useClock;
+		m_bytes += b.rows.bytes();
+
+		m_fetched += count;
+		m_rowCount += count;
+		done += count;
+	}
+	endInsertRows();
+
+	dropBlocks((m_rowCount - 1) / BlockSize);
+}
+
+void SqlResultModel::worker_blockFetched(int block, const SqlRowBlock & rows)
+{
+	if (sender() != m_worker)
+		return;
+
+	m_pending.remove(block);
+	// Nothing is emitted for an empty (failed) block. The view
+	// would ask for it again in the repaint immediately.
+	if (!rows.isEmpty() && !m_blocks.contains(block))
+	{
+		SqlResultBlock b;
+		b.used = ++m_useClock;
+		// see requestBlock()
+		b.exact = !m_keyset || m_blockKeys.contains(block);
+		int count = qMin(rows.rowCount(), m_rowCount - block * BlockSize);
+		if (count == rows.rowCount())
+			b.rows = rows;
+		else
+		{
+			b.rows = SqlRowBlock(rows.columnCount());
+			b.rows.appendRows(rows, 0, count);
+		}
+		m_blocks.insert(block, b);
+		m_bytes += b.rows.bytes();
+		dropBlocks(block);
+
+		if (count > 0)
+			emit dataChanged(index(block * BlockSize, 0),
+							 index(block * BlockSize + count - 1, m_columns.count() - 1));
+	}
+	emit blockArrived();
+}
+
+void SqlResultModel::worker_progress(qint64 steps, int elapsed)
+{
+	if (sender() != m_worker)
+		return;
+	emit progress(steps, elapsed);
+}
+
+void SqlResultModel::worker_fetchPaused(int firstRow, int elapsed)
+{
+	if (sender() != m_worker)
+		return;
+	m_fetching = false;
+	m_firstRow = firstRow;
+	m_elapsed = elapsed;
+	applyEstimate();
+	emit statusChanged();
+}
+
+void SqlResultModel::worker_prepareFailed(const QString & error)
+{
+	if (sender() != m_worker)
+		return;
+	releaseWorker();
+	m_error = error;
+	emit prepareFailed(error);
+}
+
+void SqlResultModel::worker_queryFinished(const QString & error, int firstRow, int elapsed)
+{
+	// the seek mode stops the statement. It's not an user's "cancel".
+	if (sender() != m_worker || m_sparse)
+		return;
+	m_running = false;
+	m_fetching = false;
+	// the worker stays alive to read dropped blocks again
+	if (!m_canDrop)
+		releaseWorker();
+	m_error = error;
+	m_firstRow = firstRow;
+	m_elapsed = elapsed;
+	emit statusChanged();
+}
+
+void SqlResultModel::worker_profiled(const SqlStatementProfile & profile)
+{
+	if (sender() != m_worker)
+		return;
+	// the worker can run the rewritten keyset statement
+	SqlStatementProfile p(profile);
+	p.statement = m_query;
+	emit profiled(p);
+}
+
+void SqlResultModel::counter_rowsFetched(const SqlRowBlock & rows)
+{
+	if (sender() != m_counter || rows.isEmpty())
+		return;
+	m_estimate = int(qMin<qint64>(rows.integer(0, 0), INT_MAX));
+	m_estimated = false;
+	applyEstimate();
+	emit statusChanged();
+}
+
+void SqlResultModel::counter_queryFinished()
+{
+	if (sender() != m_counter)
+		return;
+	m_counter->deleteLater();
+	m_counter = 0;
+}
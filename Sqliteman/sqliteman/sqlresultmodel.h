@@ -0,0 +1,230 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef SQLRESULTMODEL_H
+#define SQLRESULTMODEL_H
+
+#include <QAbstractTableModel>
+#include <QColor>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+
+#include "sqlqueryworker.h"
+
+
+/*! \brief One cached part of the result set. See SqlResultModel.
+*/
+typedef struct
+{
+	SqlRowBlock rows;
+	//! \brief LRU stamp. It's updated in the const data() calls.
+	mutable quint64 used;
+	//! \brief False when the block position is interpolated. See SqlResultModel.
+	bool exact;
+}
+SqlResultBlock;
+
+
+/*! \brief Read only model for the SQL editor results.
+The statement runs in the SqlQueryWorker thread and the rows
+are appended into this model as they are arriving. It provides
+the same look (NULL and BLOB highlighting etc.) as the SqlQueryModel.
+Use canRunAsync() to check if the statement can run outside
+the main connection. Use the SqlQueryModel otherwise.
+
+Rows are kept in blocks of BlockSize rows (see SqlRowBlock - QVariants
+are created for requested cells only). When the blocks
+take more memory than Preferences::resultCacheSize() the least
+recently used ones are dropped. A dropped block is read again
+by the worker when the view needs it:
+ - simple "SELECT ... FROM table [WHERE ...]" statements are
+   ordered by rowid and the block is found by the rowid seek
+   (a keyset). Only the first rowid of each block is remembered.
+ - other SELECTs are read with LIMIT/OFFSET.
+ - EXPLAIN results are never dropped.
+The block next to the requested one (in the scroll direction)
+is prefetched.
+
+Unfiltered keyset statements ("SELECT ... FROM table") are not
+fetched sequentially when the table is big. The row count is taken
+from sqlite_stat1 (when there is ANALYZE) and later from a count(*)
+running in its own worker. All rows are reachable for the view at once
+then (scrollbar, Goto Line) and a block far from the known ones is
+found by the rowid seek interpolated between the nearest known block
+keys and max(rowid). Such a block is not exact - its position
+is estimated. Its neighbours continue from its last rowid so scrolling
+is seamless. The value() reads exact blocks only.
+*/
+class SqlResultModel : public QAbstractTableModel
+{
+	Q_OBJECT
+
+	public:
+		//! \brief Rows in one block. It's the fetchMore() size too.
+		static const int BlockSize = SqlQueryWorker::BatchSize;
+		//! \brief Blocks which are never dropped (visible area)
+		static const int MinBlocks = 4;
+
+		SqlResultModel(QObject * parent = 0);
+		~SqlResultModel();
+
+		/*! \brief Check if the statement can run on a separate connection.
+		Only plain SELECTs and EXPLAINs can. It must be a file database
+		and the main connection has to be in the autocommit mode (there
+		is no uncommitted data) without any TEMP objects. */
+		static bool canRunAsync(const QString & query);
+
+		//! \brief Start the statement in the background.
+		void exec(const QString & query);
+		//! \brief Interrupt the running statement. Already fetched rows stay.
+		void stop();
+		/*! \brief Do not hold any read lock of the database.
+		The paused statement and the count(*) are stopped. Fetched rows stay
+		and dropped blocks are still read by the seek (short locks only).
+		Call it before any write of the main connection. */
+		void releaseLocks();
+		//! \brief Stop the statement and remove all data.
+		void clear();
+		/*! \brief Fetch all remaining rows.
+		It blocks until the statement is finished but it
+		keeps the GUI event loop running. */
+		void fetchAll();
+		/*! \brief Raw value of the cell.
+		Unlike the data() it waits for dropped block to be read again.
+		It's used in the data export. */
+		QVariant value(int row, int column);
+
+		QString query() { return m_query; };
+		//! \brief True while the statement is not finished (even sleeping).
+		bool isRunning() { return m_running; };
+		//! \brief True when the row count is the ANALYZE estimation.
+		bool isEstimated() { return m_sparse && m_estimated; };
+		//! \brief Error message. Empty string when there is no error.
+		QString lastError() { return m_error; };
+		//! \brief Time to the first row (ms) or -1 when there is no row.
+		int firstRowTime() { return m_firstRow; };
+		//! \brief Time spent in the statement (ms).
+		int elapsed() { return m_elapsed; };
+
+		int rowCount(const QModelIndex & parent = QModelIndex()) const;
+		int columnCount(const QModelIndex & parent = QModelIndex()) const;
+		QVariant data(const QModelIndex & item, int role = Qt::DisplayRole) const;
+		QVariant headerData(int section,
+							Qt::Orientation orientation,
+							int role = Qt::DisplayRole) const;
+		bool canFetchMore(const QModelIndex & parent = QModelIndex()) const;
+		void fetchMore(const QModelIndex & parent = QModelIndex());
+
+	signals:
+		//! \brief Relayed SqlQueryWorker::progress()
+		void progress(qint64 steps, int elapsed);
+		/*! \brief The statement is finished or it is waiting for fetchMore().
+		Use isRunning(), lastError() etc. to get current state. */
+		void statusChanged();
+		/*! \brief The statement cannot run on the separate connection.
+		It should be executed in the main connection by the caller. */
+		void prepareFailed(const QString & error);
+		//! \brief A block requested by value() arrived (or failed).
+		void blockArrived();
+		//! \brief Relayed SqlQueryWorker::profiled() with the user's statement text.
+		void profiled(const SqlStatementProfile & profile);
+
+	private:
+		QString m_query;
+		SqlQueryWorker * m_worker;
+		bool m_running;
+		//! \brief True when there is a fetchMore() request in progress
+		bool m_fetching;
+		QStringList m_columns;
+		QString m_error;
+		int m_firstRow;
+		int m_elapsed;
+
+		//! \brief Count of rows fetched by the main statement
+		int m_fetched;
+		//! \brief Count of rows provided to views. See m_sparse.
+		int m_rowCount;
+		QHash<int,SqlResultBlock> m_blocks;
+		qint64 m_bytes;
+		qint64 m_budget;
+		mutable quint64 m_useClock;
+		//! \brief Blocks requested from the worker
+		mutable QSet<int> m_pending;
+		mutable int m_lastBlock;
+		//! \brief Dropping blocks is allowed (there is a seek query)
+		bool m_canDrop;
+		//! \brief The first column is a hidden rowid
+		bool m_keyset;
+		//! \brief The first rowid of blocks with exactly known position (keyset mode only)
+		mutable QMap<int,qint64> m_blockKeys;
+
+		//! \brief The keyset statement is not filtered. Rows can be estimated.
+		bool m_seekNav;
+		/*! \brief The main statement is stopped and rows are
+		provided up to m_estimate by seek reads only. */
+		bool m_sparse;
+		//! \brief Expected count of rows or -1
+		int m_estimate;
+		//! \brief m_estimate comes from sqlite_stat1 (not from count(*))
+		bool m_estimated;
+		qint64 m_maxKey;
+		//! \brief count(*) of the m_seekNav table
+		SqlQueryWorker * m_counter;
+
+		bool m_useNull;
+		QColor m_nullColor;
+		QString m_nullText;
+		bool m_useBlob;
+		QColor m_blobColor;
+		QString m_blobText;
+		bool m_cropColumns;
+
+		/*! \brief Prepare keyset statements for simple table SELECTs.
+		\param query an user statement.
+		\param mainQuery the statement ordered by rowid with rowid as the first column.
+		\param seekQuery the statement reading one block by rowid.
+		\param table a table name when the select has no WHERE clause. Empty otherwise.
+		\param schema a schema of the table.
+		\retval bool false when the query is not a simple table select.
+		*/
+		static bool keysetQueries(const QString & query, QString & mainQuery, QString & seekQuery,
+								  QString & table, QString & schema);
+
+		//! \brief Detach and destroy the current workers.
+		void releaseWorker();
+		/*! \brief The first rowid of the block for the seek query.
+		\param exact set to false when the key is interpolated. */
+		qint64 blockKey(int block, bool & exact) const;
+		//! \brief Ask the worker for the dropped block.
+		void requestBlock(int block) const;
+		/*! \brief Request the block and wait for it.
+		\param exact an interpolated block is read again from the exact position. */
+		void waitForBlock(int block, bool exact);
+		//! \brief Switch to the m_sparse mode or update the count of rows.
+		void applyEstimate();
+		//! \brief Drop the least recently used blocks over the budget.
+		void dropBlocks(int keep);
+		/*! \brief The block of the row or 0 when it's not in the memory.
+		The missing block is requested from the worker.
+		\param offset the row position in the block. */
+		const SqlRowBlock * cachedBlock(int row, int & offset) const;
+
+	private slots:
+		void worker_columnsFetched(const QStringList & columns);
+		void worker_rowsFetched(const SqlRowBlock & rows);
+		void worker_blockFetched(int block, const SqlRowBlock & rows);
+		void worker_progress(qint64 steps, int elapsed);
+		void worker_fetchPaused(int firstRow, int elapsed);
+		void worker_prepareFailed(const QString & error);
+		void worker_queryFinished(const QString & error, int firstRow, int elapsed);
+		void worker_profiled(const SqlStatementProfile & profile);
+		void counter_rowsFetched(const SqlRowBlock & rows);
+		void counter_queryFinished();
+};
+
+#endif
@@ -0,0 +1,149 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <cstring>
+
+#include "sqlrowblock.h"
+
+
+SqlRowBlock::SqlRowBlock(int columns)
+	: m_rows(0),
+	  m_columns(columns)
+{
+}
+
+void SqlRowBlock::appendArena(SqlColumnData & column, int type, const char * data, int length)
+{
+	qint64 offset = m_arena.size();
+	m_arena.append(data, length);
+	column.values.append((offset << 32) | quint32(length));
+	column.types.append(type);
+}
+
+void SqlRowBlock::appendRow(sqlite3_stmt * stmt)
+{
+	for (int i = 0; i < m_columns.count(); ++i)
+	{
+		SqlColumnData & column = m_columns[i];
+		int type = sqlite3_column_type(stmt, i);
+		switch (type)
+		{
+			case SQLITE_INTEGER:
+				column.values.append(sqlite3_column_int64(stmt, i));
+				column.types.append(type);
+				break;
+			case SQLITE_FLOAT:
+			{
+				double d = sqlite3_column_double(stmt, i);
+				qint64 bits;
+				memcpy(&bits, &d, sizeof(bits));
+				column.values.append(bits);
+				column.types.append(type);
+				break;
+			}
+			case SQLITE_NULL:
+				column.values.append(0);
+				column.types.append(type);
+				break;
+			case SQLITE_BLOB:
+			{
+				// sqlite3_column_bytes() has to be called after the pointer getter
+				const char * data = static_cast<const char *>(sqlite3_column_blob(stmt, i));
+				appendArena(column, type, data, sqlite3_column_bytes(stmt, i));
+				break;
+			}
+			default:
+			{
+				const char * data = reinterpret_cast<const char *>(sqlite3_column_text(stmt, i));
+				appendArena(column, SQLITE_TEXT, data, sqlite3_column_bytes(stmt, i));
+				break;
+			}
+		}
+	}
+	++m_rows;
+}
+
+void SqlRowBlock::appendRows(const SqlRowBlock & other, int first, int count)
+{
+	for (int i = 0; i < m_columns.count(); ++i)
+	{
+		SqlColumnData & column = m_columns[i];
+		const SqlColumnData & src = other.m_columns.at(i);
+		for (int r = first; r < first + count; ++r)
+		{
+			int type = src.types.at(r);
+			qint64 v = src.values.at(r);
+			if (type == SQLITE_TEXT || type == SQLITE_BLOB)
+				appendArena(column, type, other.m_arena.constData() + (v >> 32), quint32(v));
+			else
+			{
+				column.values.append(v);
+				column.types.append(type);
+			}
+		}
+	}
+	m_rows += count;
+}
+
+void SqlRowBlock::clear()
+{
+	m_rows = 0;
+	m_arena.clear();
+	for (int i = 0; i < m_columns.count(); ++i)
+	{
+		m_columns[i].values.clear();
+		m_columns[i].types.clear();
+	}
+}
+
+QVariant SqlRowBlock::value(int row, int column) const
+{
+	const SqlColumnData & c = m_columns.at(column);
+	qint64 v = c.values.at(row);
+	switch (c.types.at(row))
+	{
+		case SQLITE_INTEGER:
+			return QVariant(v);
+		case SQLITE_FLOAT:
+		{
+			double d;
+			memcpy(&d, &v, sizeof(d));
+			return QVariant(d);
+		}
+		case SQLITE_NULL:
+			return QVariant(QVariant::String);
+		case SQLITE_BLOB:
+			return QVariant(QByteArray(m_arena.constData() + (v >> 32), quint32(v)));
+		default:
+			// empty text must not look like NULL
+			if (quint32(v) == 0)
+				return QVariant(QString(""));
+			return QVariant(QString::fromUtf8(m_arena.constData() + (v >> 32), quint32(v)));
+	}
+}
+
+double SqlRowBlock::real(int row, int column) const
+{
+	qint64 v = m_columns.at(column).values.at(row);
+	double d;
+	memcpy(&d, &v, sizeof(d));
+	return d;
+}
+
+const char * SqlRowBlock::data(int row, int column, int & size) const
+{
+	qint64 v = m_columns.at(column).values.at(row);
+	size = quint32(v);
+	return m_arena.constData() + (v >> 32);
+}
+
+int SqlRowBlock::bytes() const
+{
+	// 8 bytes slot and 1 byte type per cell
+	return sizeof(SqlRowBlock) + m_arena.capacity()
+		   + m_columns.count() * (sizeof(SqlColumnData) + m_rows * 9);
+}
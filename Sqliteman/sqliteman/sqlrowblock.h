@@ -0,0 +1,88 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef SQLROWBLOCK_H
+#define SQLROWBLOCK_H
+
+#include <QVector>
+#include <QVariant>
+#include <QByteArray>
+#include <QMetaType>
+
+#include "sqlite3.h"
+
+
+/*! \brief Values of one result column. See SqlRowBlock.
+*/
+typedef struct
+{
+	/*! \brief One 8 byte slot per row. It holds the integer, the bits
+	of the double or the "offset << 32 | length" of the arena data
+	depending on the type. */
+	QVector<qint64> values;
+	//! \brief sqlite3 fundamental datatype (SQLITE_INTEGER etc.) per row.
+	QVector<quint8> types;
+}
+SqlColumnData;
+
+
+/*! \brief Fetched rows stored column by column.
+Values are kept in their sqlite3 storage class without any
+QVariant or QString. Texts are copied as UTF-8 into one
+arena shared by all columns, blobs too. NULL is a type code only.
+The QVariant is created by value() when it's really needed
+(e.g. for visible cells).
+The block is implicitly shared (all members are Qt containers)
+so it can be passed by queued signals cheaply.
+*/
+class SqlRowBlock
+{
+	public:
+		SqlRowBlock(int columns = 0);
+
+		int columnCount() const { return m_columns.count(); };
+		int rowCount() const { return m_rows; };
+		bool isEmpty() const { return m_rows == 0; };
+
+		//! \brief Append the current row of the stepped statement.
+		void appendRow(sqlite3_stmt * stmt);
+		//! \brief Append rows [first, first + count) of other block with the same columns.
+		void appendRows(const SqlRowBlock & other, int first, int count);
+		//! \brief Remove all rows. Columns stay.
+		void clear();
+
+		//! \brief sqlite3 type of the cell (SQLITE_NULL etc.)
+		int type(int row, int column) const
+			{ return m_columns.at(column).types.at(row); };
+		bool isNull(int row, int column) const
+			{ return type(row, column) == SQLITE_NULL; };
+		//! \brief Raw integer value. Valid for SQLITE_INTEGER cells only.
+		qint64 integer(int row, int column) const
+			{ return m_columns.at(column).values.at(row); };
+		//! \brief Raw double value. Valid for SQLITE_FLOAT cells only.
+		double real(int row, int column) const;
+		/*! \brief Raw bytes of a SQLITE_TEXT (UTF-8) or SQLITE_BLOB cell.
+		They are valid until the block is changed. */
+		const char * data(int row, int column, int & size) const;
+		/*! \brief The cell converted as the Qt sqlite driver does it.
+		NULL is an invalid QVariant::String. */
+		QVariant value(int row, int column) const;
+
+		//! \brief Memory used by the block data (estimation).
+		int bytes() const;
+
+	private:
+		int m_rows;
+		QVector<SqlColumnData> m_columns;
+		QByteArray m_arena;
+
+		void appendArena(SqlColumnData & column, int type, const char * data, int length);
+};
+
+Q_DECLARE_METATYPE(SqlRowBlock)
+
+#endif
@@ -6,6 +6,7 @@ for which a new license (GPL+exception) is in place.
 */
 #include <QMouseEvent>
 #include <QApplication>
+#include <QScrollBar>
 
 #include "database.h"
 #include "tabletree.h"
@@ -32,6 +33,13 @@ TableTree::TableTree(QWidget * parent) : QTreeWidget(parent)
 	setDragEnabled(true);
 	setDropIndicatorShown(true);
 	setAcceptDrops(false);
+
+	connect(this, SIGNAL(itemExpanded(QTreeWidgetItem*)),
+			this, SLOT(fetchOnExpand(QTreeWidgetItem*)));
+	connect(this, SIGNAL(itemActivated(QTreeWidgetItem*, int)),
+			this, SLOT(fetchOnActivate(QTreeWidgetItem*, int)));
+	connect(verticalScrollBar(), SIGNAL(valueChanged(int)),
+			this, SLOT(fetchVisible()));
 }
 
 void TableTree::buildTree()
@@ -78,28 +86,10 @@ void TableTree::buildTables(QTreeWidgetItem * tablesItem, const QString & schema
 {
 	deleteChildren(tablesItem);
 
-	QStringList tables = Database::getObjects("table", schema).keys();
-	tablesItem->setText(0, trLabel(trTables).arg(tables.size()));
+	int count = Database::getObjects("table", schema).count();
+	tablesItem->setText(0, trLabel(trTables).arg(count));
 	tablesItem->setText(1, schema);
-
-	foreach(QString table, tables)
-	{
-		QTreeWidgetItem * tableItem = new QTreeWidgetItem(tablesItem, TableType);
-		tableItem->setText(0, table);
-		tableItem->setText(1, schema);
-		// columns
-		QTreeWidgetItem *columnsItem = new QTreeWidgetItem(tableItem, ColumnItemType);
-		buildColumns(columnsItem, schema, table);
-		// indexes
-		QTreeWidgetItem *indexesItem = new QTreeWidgetItem(tableItem, IndexesItemType);
-		buildIndexes(indexesItem, schema, table);
-		// system indexes (unique)
-		QTreeWidgetItem *sysIndexesItem = new QTreeWidgetItem(tableItem, SysIndexesItemType);
-		buildSysIndexes(sysIndexesItem, schema, table);
-		// triggers
-		QTreeWidgetItem *triggersItem = new QTreeWidgetItem(tableItem, TriggersItemType);
-		buildTriggers(triggersItem, schema, table);
-	}
+	setPending(tablesItem, count > 0);
 }
 
 void TableTree::buildIndexes(QTreeWidgetItem *indexesItem, const QString & schema, const QString & table)
@@ -168,32 +158,147 @@ void TableTree::buildViews(QTreeWidgetItem * viewsItem, const QString & schema)
 {
 	deleteChildren(viewsItem);
 
-	// Build views tree
-	QStringList views = Database::getObjects("view", schema).keys();
-	viewsItem->setText(0, trLabel(trViews).arg(views.size()));
+	int count = Database::getObjects("view", schema).count();
+	viewsItem->setText(0, trLabel(trViews).arg(count));
 	viewsItem->setText(1, schema);
-	foreach(QString view, views)
-	{
-		QTreeWidgetItem * viewItem = new QTreeWidgetItem(viewsItem, ViewType);
-		viewItem->setText(0, view);
-		viewItem->setText(1, schema);
-		QTreeWidgetItem *triggersItem = new QTreeWidgetItem(viewItem, TriggersItemType);
-		buildTriggers(triggersItem, schema, view);
-	}
+	setPending(viewsItem, count > 0);
 }
 
 void TableTree::buildCatalogue(QTreeWidgetItem * systemItem, const QString & schema)
 {
 	deleteChildren(systemItem);
 
-	QStringList values = Database::getSysObjects(schema).keys();
-	systemItem->setText(0, trLabel(trSys).arg(values.size()));
+	int count = Database::getSysObjects(schema).count();
+	systemItem->setText(0, trLabel(trSys).arg(count));
 	systemItem->setText(1, schema);
-	foreach(QString i, values)
+	setPending(systemItem, count > 0);
+}
+
+bool TableTree::canFetchMore(QTreeWidgetItem * item)
+{
+	return item && item->data(0, Qt::UserRole).toBool();
+}
+
+void TableTree::fetchMore(QTreeWidgetItem * item)
+{
+	if (!canFetchMore(item))
+		return;
+	item->setData(0, Qt::UserRole, false);
+
+	QString schema(item->text(1));
+	switch (item->type())
+	{
+		case TablesItemType:
+			fetchNames(item, Database::getObjects("table", schema).keys(), TableType);
+			break;
+		case ViewsItemType:
+			fetchNames(item, Database::getObjects("view", schema).keys(), ViewType);
+			break;
+		case SystemItemType:
+			fetchNames(item, Database::getSysObjects(schema).keys(), SystemType);
+			break;
+		case TableType:
+		{
+			QString table(item->text(0));
+			// columns
+			QTreeWidgetItem *columnsItem = new QTreeWidgetItem(item, ColumnItemType);
+			buildColumns(columnsItem, schema, table);
+			// indexes
+			QTreeWidgetItem *indexesItem = new QTreeWidgetItem(item, IndexesItemType);
+			buildIndexes(indexesItem, schema, table);
+			// system indexes (unique)
+			QTreeWidgetItem *sysIndexesItem = new QTreeWidgetItem(item, SysIndexesItemType);
+			buildSysIndexes(sysIndexesItem, schema, table);
+			// triggers
+			QTreeWidgetItem *triggersItem = new QTreeWidgetItem(item, TriggersItemType);
+			buildTriggers(triggersItem, schema, table);
+			break;
+		}
+		case ViewType:
+		{
+			QTreeWidgetItem *triggersItem = new QTreeWidgetItem(item, TriggersItemType);
+			buildTriggers(triggersItem, schema, item->text(0));
+			break;
+		}
+	}
+}
+
+void TableTree::fetchNames(QTreeWidgetItem * item, const QStringList & names, int type)
+{
+	QString schema(item->text(1));
+	int loaded = item->childCount();
+
+	// remove the placeholder of the previous batch
+	if (loaded > 0 && item->child(loaded - 1)->type() == MoreItemType)
+	{
+		delete item->takeChild(loaded - 1);
+		--loaded;
+	}
+
+	int last = qMin(loaded + FetchBatch, names.size());
+	QList<QTreeWidgetItem*> items;
+	for (int i = loaded; i < last; ++i)
+	{
+		QTreeWidgetItem * child = new QTreeWidgetItem(type);
+		child->setText(0, names.at(i));
+		child->setText(1, schema);
+		if (type == TableType || type == ViewType)
+		{
+			child->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+			child->setData(0, Qt::UserRole, true);
+		}
+		items.append(child);
+	}
+
+	if (last < names.size())
+	{
+		QTreeWidgetItem * more = new QTreeWidgetItem(MoreItemType);
+		more->setText(0, tr("(%1 more...)").arg(names.size() - last));
+		more->setText(1, schema);
+		items.append(more);
+		item->setData(0, Qt::UserRole, true);
+	}
+
+	item->addChildren(items);
+}
+
+void TableTree::setPending(QTreeWidgetItem * item, bool pending)
+{
+	item->setChildIndicatorPolicy(pending
+			? QTreeWidgetItem::ShowIndicator
+			: QTreeWidgetItem::DontShowIndicatorWhenChildless);
+	item->setData(0, Qt::UserRole, pending);
+	if (pending && item->isExpanded())
+		fetchMore(item);
+}
+
+void TableTree::fetchOnExpand(QTreeWidgetItem * item)
+{
+	if (canFetchMore(item) && item->childCount() == 0)
+		fetchMore(item);
+}
+
+void TableTree::fetchOnActivate(QTreeWidgetItem * item, int /*column*/)
+{
+	if (item && item->type() == MoreItemType)
+		fetchMore(item->parent());
+}
+
+void TableTree::fetchVisible()
+{
+	for (int i = 0; i < topLevelItemCount(); ++i)
 	{
-		QTreeWidgetItem * sysItem = new QTreeWidgetItem(systemItem, SystemType);
-		sysItem->setText(0, i);
-		sysItem->setText(1, schema);
+		QTreeWidgetItem * dbItem = topLevelItem(i);
+		for (int j = 0; j < dbItem->childCount(); ++j)
+		{
+			QTreeWidgetItem * folder = dbItem->child(j);
+			if (!folder->isExpanded() || !canFetchMore(folder) || folder->childCount() == 0)
+				continue;
+			QTreeWidgetItem * more = folder->child(folder->childCount() - 1);
+			if (more->type() == MoreItemType
+				&& visualItemRect(more).intersects(viewport()->rect()))
+				fetchMore(folder);
+		}
 	}
 }
 
@@ -13,6 +13,10 @@ for which a new license (GPL+exception) is in place.
 
 /*! \brief Schema browser.
 A tree structure containing sorted database objects.
+The tree is populated lazily. Folders and tables get their children
+when they are expanded for the first time and huge folders are filled
+by FetchBatch items as user scrolls down (a Qt model-like
+canFetchMore()/fetchMore() pair).
 \author Petr Vanek <petr@scribus.info>
 */
 class TableTree : public QTreeWidget
@@ -34,6 +38,11 @@ class TableTree : public QTreeWidget
 		static const int SysIndexType = QTreeWidgetItem::UserType + 12;
 		static const int ColumnType = QTreeWidgetItem::UserType + 13;
 		static const int ColumnItemType = QTreeWidgetItem::UserType + 14;
+		//! \brief Placeholder at the end of partially fetched folder.
+		static const int MoreItemType = QTreeWidgetItem::UserType + 15;
+
+		//! \brief Count of the items created by one fetchMore() call.
+		static const int FetchBatch = 256;
 
 		TableTree(QWidget * parent = 0);
 		~TableTree(){};
@@ -59,13 +68,33 @@ class TableTree : public QTreeWidget
 
 		QList<QTreeWidgetItem*> searchMask(const QString & trStr);
 
+		//! \brief True if there are children of the item to be created.
+		bool canFetchMore(QTreeWidgetItem * item);
+		/*! \brief Create next children of the item.
+		Tables and views are created completely. Folders get next
+		FetchBatch items and a MoreItemType placeholder if there are
+		more objects in the schema. */
+		void fetchMore(QTreeWidgetItem * item);
+
 	public slots:
 		void buildTree();
 		void buildViewTree(QString schema, QString name);
 
+	private slots:
+		void fetchOnExpand(QTreeWidgetItem * item);
+		void fetchOnActivate(QTreeWidgetItem * item, int column);
+		//! \brief Continue in fetching when the placeholder is scrolled into view.
+		void fetchVisible();
+
 	private:
 		void deleteChildren(QTreeWidgetItem * item);
 		QString trLabel(const QString & trStr);
+		/*! \brief Mark item as "children not created yet".
+		The expand indicator is shown even for childless item then.
+		Already expanded items are fetched immediately. */
+		void setPending(QTreeWidgetItem * item, bool pending);
+		//! \brief Append next batch of names as new children of type.
+		void fetchNames(QTreeWidgetItem * item, const QStringList & names, int type);
 
 		QPoint m_dragStartPosition;
 
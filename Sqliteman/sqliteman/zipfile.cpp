@@ -0,0 +1,254 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <string.h>
+
+#include "zipfile.h"
+
+// record signatures
+#define ZIP_LOCAL_HEADER 0x04034b50
+#define ZIP_CENTRAL_HEADER 0x02014b50
+#define ZIP_END_OF_CENTRAL 0x06054b50
+
+
+static quint16 le16(const char * p)
+{
+	const uchar * u = reinterpret_cast<const uchar*>(p);
+	return u[0] | (u[1] << 8);
+}
+
+static quint32 le32(const char * p)
+{
+	const uchar * u = reinterpret_cast<const uchar*>(p);
+	return u[0] | (u[1] << 8) | (u[2] << 16) | (quint32(u[3]) << 24);
+}
+
+
+ZipFile::ZipFile(const QString & fileName)
+	: m_fileName(fileName)
+{
+}
+
+bool ZipFile::isZip(const QString & fileName)
+{
+	QFile f(fileName);
+	if (!f.open(QIODevice::ReadOnly))
+		return false;
+	QByteArray sig(f.read(4));
+	return sig.size() == 4 && le32(sig.constData()) == ZIP_LOCAL_HEADER;
+}
+
+bool ZipFile::open()
+{
+	m_entries.clear();
+	m_error = QString();
+
+	QFile f(m_fileName);
+	if (!f.open(QIODevice::ReadOnly))
+	{
+		m_error = tr("Cannot open file %1 for reading.").arg(m_fileName);
+		return false;
+	}
+
+	// the end record is followed by a comment up to 64 kB long
+	qint64 tail = qMin(f.size(), qint64(22 + 0xffff));
+	f.seek(f.size() - tail);
+	QByteArray buf(f.read(tail));
+	int end = buf.size() - 22;
+	while (end >= 0 && le32(buf.constData() + end) != ZIP_END_OF_CENTRAL)
+		--end;
+	if (end < 0)
+	{
+		m_error = tr("File %1 is not a zip archive.").arg(m_fileName);
+		return false;
+	}
+
+	const char * e = buf.constData() + end;
+	quint16 count = le16(e + 10);
+	quint32 cdSize = le32(e + 12);
+	quint32 cdOffset = le32(e + 16);
+	if (count == 0xffff || cdSize == 0xffffffff || cdOffset == 0xffffffff)
+	{
+		m_error = tr("ZIP64 archives are not supported.");
+		return false;
+	}
+
+	f.seek(cdOffset);
+	QByteArray cd(f.read(cdSize));
+	const char * p = cd.constData();
+	const char * cdEnd = p + cd.size();
+	for (int i = 0; i < count; ++i)
+	{
+		if (p + 46 > cdEnd || le32(p) != ZIP_CENTRAL_HEADER)
+		{
+			m_error = tr("The zip archive %1 is corrupted.").arg(m_fileName);
+			return false;
+		}
+		quint16 flags = le16(p + 8);
+		int nameLength = le16(p + 28);
+		int extraLength = le16(p + 30);
+		int commentLength = le16(p + 32);
+		if (p + 46 + nameLength > cdEnd)
+		{
+			m_error = tr("The zip archive %1 is corrupted.").arg(m_fileName);
+			return false;
+		}
+
+		ZipEntry entry;
+		entry.method = le16(p + 10);
+		entry.compressedSize = le32(p + 20);
+		entry.size = le32(p + 24);
+		entry.offset = le32(p + 42);
+		// bit 11: the name is in UTF-8
+		QString name((flags & 0x800)
+					 ? QString::fromUtf8(p + 46, nameLength)
+					 : QString::fromLatin1(p + 46, nameLength));
+		m_entries.insert(name, entry);
+
+		p += 46 + nameLength + extraLength + commentLength;
+	}
+	return true;
+}
+
+
+ZipEntryDevice::ZipEntryDevice(const ZipFile & zip, const QString & name)
+	: QIODevice(),
+	  m_file(zip.fileName()),
+	  m_name(name),
+	  m_entry(zip.entry(name)),
+	  m_found(zip.contains(name)),
+	  m_inflating(false),
+	  m_end(false),
+	  m_read(0),
+	  m_written(0)
+{
+}
+
+ZipEntryDevice::~ZipEntryDevice()
+{
+	close();
+}
+
+bool ZipEntryDevice::open(OpenMode mode)
+{
+	if ((mode & QIODevice::WriteOnly) || !m_found)
+	{
+		setErrorString(QCoreApplication::translate("ZipFile", "Cannot open %1 in the zip archive.")
+					   .arg(m_name));
+		return false;
+	}
+	if (m_entry.method != 0 && m_entry.method != Z_DEFLATED)
+	{
+		setErrorString(QCoreApplication::translate("ZipFile", "Compression method %1 of %2 is not supported.")
+					   .arg(m_entry.method).arg(m_name));
+		return false;
+	}
+	if (!m_file.open(QIODevice::ReadOnly))
+	{
+		setErrorString(m_file.errorString());
+		return false;
+	}
+
+	// the local header has its own name and extra field lengths
+	m_file.seek(m_entry.offset);
+	QByteArray header(m_file.read(30));
+	if (header.size() != 30 || le32(header.constData()) != ZIP_LOCAL_HEADER)
+	{
+		setErrorString(QCoreApplication::translate("ZipFile", "The zip archive %1 is corrupted.")
+					   .arg(m_file.fileName()));
+		m_file.close();
+		return false;
+	}
+	m_file.seek(m_entry.offset + 30 + le16(header.constData() + 26) + le16(header.constData() + 28));
+
+	if (m_entry.method == Z_DEFLATED)
+	{
+		memset(&m_zstream, 0, sizeof(m_zstream));
+		// raw deflate data without the zlib header
+		if (inflateInit2(&m_zstream, -MAX_WBITS) != Z_OK)
+		{
+			m_file.close();
+			return false;
+		}
+		m_inflating = true;
+	}
+	m_read = 0;
+	m_written = 0;
+	m_end = false;
+	return QIODevice::open(mode);
+}
+
+void ZipEntryDevice::close()
+{
+	if (m_inflating)
+		inflateEnd(&m_zstream);
+	m_inflating = false;
+	m_file.close();
+	QIODevice::close();
+}
+
+qint64 ZipEntryDevice::bytesAvailable() const
+{
+	return (m_end ? 0 : m_entry.size - m_written) + QIODevice::bytesAvailable();
+}
+
+qint64 ZipEntryDevice::readData(char * data, qint64 maxSize)
+{
+	if (m_end)
+		return 0;
+
+	if (m_entry.method == 0)
+	{
+		qint64 n = m_file.read(data, qMin(maxSize, m_entry.size - m_written));
+		if (n <= 0)
+			m_end = true;
+		else
+		{
+			m_read += n;
+			m_written += n;
+		}
+		return n;
+	}
+
+	m_zstream.next_out = reinterpret_cast<Bytef*>(data);
+	m_zstream.avail_out = uInt(qMin(maxSize, qint64(0x7fffffff)));
+	uInt wanted = m_zstream.avail_out;
+	while (m_zstream.avail_out == wanted)
+	{
+		if (m_zstream.avail_in == 0)
+		{
+			qint64 left = qMin(qint64(ChunkSize), m_entry.compressedSize - m_read);
+			m_input = m_file.read(left);
+			if (m_input.isEmpty())
+			{
+				m_end = true;
+				break;
+			}
+			m_read += m_input.size();
+			m_zstream.next_in = reinterpret_cast<Bytef*>(m_input.data());
+			m_zstream.avail_in = m_input.size();
+		}
+
+		int rc = inflate(&m_zstream, Z_NO_FLUSH);
+		if (rc == Z_STREAM_END)
+		{
+			m_end = true;
+			break;
+		}
+		if (rc != Z_OK)
+		{
+			setErrorString(QCoreApplication::translate("ZipFile", "Cannot decompress %1: %2")
+						   .arg(m_name).arg(m_zstream.msg ? m_zstream.msg : ""));
+			m_end = true;
+			return -1;
+		}
+	}
+
+	qint64 produced = wanted - m_zstream.avail_out;
+	m_written += produced;
+	return produced;
+}
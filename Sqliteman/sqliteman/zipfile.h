@@ -0,0 +1,104 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef ZIPFILE_H
+#define ZIPFILE_H
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QMap>
+#include <QStringList>
+
+#include <zlib.h>
+
+
+/*! \brief Position of one entry in a zip archive.
+See the "central directory" of the PKWARE APPNOTE. */
+typedef struct
+{
+	//! \brief 0 = stored, 8 = deflated
+	int method;
+	qint64 compressedSize;
+	qint64 size;
+	//! \brief Offset of the local file header
+	qint64 offset;
+} ZipEntry;
+
+
+/*! \brief A read-only zip archive.
+Only the central directory is read in open(). Entries are
+inflated on the fly by ZipEntryDevice so even large sheets
+of an XLSX file are never kept in memory.
+Stored and deflated entries are supported. ZIP64 archives,
+encryption and the other methods are not.
+*/
+class ZipFile
+{
+		Q_DECLARE_TR_FUNCTIONS(ZipFile)
+
+	public:
+		ZipFile(const QString & fileName);
+
+		//! \brief Read the central directory. See errorString() on error.
+		bool open();
+		bool contains(const QString & name) const { return m_entries.contains(name); };
+		QStringList entries() const { return m_entries.keys(); };
+		ZipEntry entry(const QString & name) const { return m_entries.value(name); };
+		QString fileName() const { return m_fileName; };
+		QString errorString() const { return m_error; };
+
+		//! \brief Check the "PK\3\4" signature of a file.
+		static bool isZip(const QString & fileName);
+
+	private:
+		QString m_fileName;
+		QMap<QString,ZipEntry> m_entries;
+		QString m_error;
+};
+
+
+/*! \brief A sequential device with the uncompressed data of one entry.
+It reads the archive with its own file handle so more entries
+can be open at once.
+*/
+class ZipEntryDevice : public QIODevice
+{
+	public:
+		//! \brief Chunk of the compressed data read at once
+		static const int ChunkSize = 64 * 1024;
+
+		ZipEntryDevice(const ZipFile & zip, const QString & name);
+		~ZipEntryDevice();
+
+		bool open(OpenMode mode);
+		void close();
+		bool isSequential() const { return true; };
+		qint64 size() const { return m_entry.size; };
+		qint64 bytesAvailable() const;
+		//! \brief Compressed bytes read from the archive so far.
+		qint64 compressedPosition() const { return m_read; };
+
+	protected:
+		qint64 readData(char * data, qint64 maxSize);
+		qint64 writeData(const char *, qint64) { return -1; };
+
+	private:
+		QFile m_file;
+		QString m_name;
+		ZipEntry m_entry;
+		bool m_found;
+		z_stream m_zstream;
+		bool m_inflating;
+		bool m_end;
+		QByteArray m_input;
+		//! \brief Compressed bytes read
+		qint64 m_read;
+		//! \brief Uncompressed bytes returned
+		qint64 m_written;
+};
+
+#endif